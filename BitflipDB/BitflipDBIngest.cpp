@@ -0,0 +1,535 @@
+#include "tools/bitflip_db.h"
+#include "tools/bitflip_map.h"
+#include "tools/row_mapping.h"
+#include "tools/json_object_file.h"
+#include "tools/json_struct.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <unordered_map>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define GREEN_TXT "\033[32m"
+#define YELLOW_TXT "\033[33m"
+#define NORMAL_TXT "\033[0m"
+
+// Adds the bitflip locations in the outputs of the U-TRR tools to a bitflip database (see tools/bitflip_db.h). Each input file is a run:
+//   - TRR Analyzer outputs written with --location_out: a trial per iteration, the bank is given with --bank
+//   - RowScout outputs: a single trial, the cells are the bitflip_locs of each row
+//   - RowHammerAttacker bitflip maps (--output_format binary): a single trial, the cells are the chunks the bitflips were counted in
+//   - RowHammerAttacker text outputs: as bitflip maps, with the row layout given with --row_layout and the bank with --bank unless
+//     the output has a bank per line (--attack_banks). Only the rows with bitflips are known to be tested
+// The files are parsed in parallel. The module of a file is --module, or the name of the directory the file is in, which matches the
+// output directories of the Orchestrator. The row IDs are logical row IDs as the tools print them, so the physical victim rows of
+// RowHammerAttacker are converted with --row_mapping_file.
+
+#define BITFLIP_DB_ROW_BITS (8192*8) // ROW_SIZE of the tools, in bits
+
+// the parts of a RowScout row group the database needs
+typedef struct IngestWeakRow {
+    uint row_id;
+    std::vector<uint> bitflip_locs;
+} IngestWeakRow;
+
+JS_OBJECT_EXTERNAL(IngestWeakRow,
+                JS_MEMBER(row_id),
+                JS_MEMBER(bitflip_locs));
+
+typedef struct IngestWeakRowSet {
+    std::vector<IngestWeakRow> row_group;
+    uint bank_id;
+} IngestWeakRowSet;
+
+JS_OBJECT_EXTERNAL(IngestWeakRowSet,
+                JS_MEMBER(row_group),
+                JS_MEMBER(bank_id));
+
+// the run in an input file, before the module and run IDs are assigned
+typedef struct IngestedFile {
+    std::string path;
+    std::string module;
+    std::string tool;
+    std::string error;
+    uint32_t num_trials = 1;
+    uint32_t granularity_bits = 1;
+    std::unordered_map<uint64_t, uint32_t> flips; // cell_key() -> number of flips
+    std::vector<uint64_t> tested_rows; // cell_key() with bit 0
+} IngestedFile;
+
+typedef struct IngestOptions {
+    uint bank;
+    std::string row_layout;
+    RowMapping phys_to_log;
+} IngestOptions;
+
+uint64_t cell_key(const uint32_t bank, const uint32_t row, const uint32_t bit) {
+    return ((uint64_t) bank << 48) | ((uint64_t) row << 16) | bit;
+}
+
+std::string check_cell(const uint32_t bank, const uint32_t bit) {
+    if (bank > UINT16_MAX)
+        return "bank " + to_string(bank) + " is out of range";
+
+    if (bit >= BITFLIP_DB_ROW_BITS)
+        return "bit " + to_string(bit) + " is out of range";
+
+    return "";
+}
+
+bool starts_with(const char* p, const char* end, const char* prefix) {
+    size_t len = strlen(prefix);
+    return (size_t)(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+// the rows of the victims of anchor_row, in the order RowHammerAttacker reports them
+std::vector<uint32_t> victim_rows(const std::string& row_layout, const uint32_t anchor_row, const RowMapping& phys_to_log) {
+    std::vector<uint32_t> rows;
+    for (uint i = 0; i < row_layout.size(); i++)
+        if (row_layout[i] == 'V')
+            rows.push_back(map_row_id(phys_to_log, anchor_row + i));
+
+    return rows;
+}
+
+std::string ingest_trran(const std::string& contents, IngestedFile& f, const IngestOptions& opts) {
+    f.tool = "TRRAnalyzer";
+    f.num_trials = 0;
+
+    size_t pos = contents.find("--- END OF HEADER ---");
+    if (pos == string::npos)
+        return "missing header";
+
+    uint line_num = 1 + std::count(contents.begin(), contents.begin() + pos, '\n');
+    pos = contents.find('\n', pos);
+
+    while (pos != string::npos && pos + 1 < contents.size()) {
+        line_num++;
+        size_t line_end = contents.find('\n', pos + 1);
+        if (line_end == string::npos)
+            line_end = contents.size();
+
+        const char* p = contents.data() + pos + 1;
+        const char* end = contents.data() + line_end;
+        pos = line_end;
+
+        if (starts_with(p, end, "Iteration ")) {
+            f.num_trials++;
+            continue;
+        }
+
+        // the totals at the end repeat the counts of the iterations
+        if (starts_with(p, end, "Total bitflips:"))
+            break;
+
+        if (!starts_with(p, end, "Victim row"))
+            continue;
+
+        p += strlen("Victim row");
+        if (starts_with(p, end, "(U)"))
+            p += strlen("(U)");
+
+        char* next;
+        uint32_t row = strtoul(p, &next, 10);
+        if (next == p || *next != ':')
+            return "malformed line " + to_string(line_num);
+
+        p = next + 1;
+        uint32_t num_bitflips = strtoul(p, &next, 10);
+        if (next == p)
+            return "malformed line " + to_string(line_num);
+        p = next;
+
+        f.tested_rows.push_back(cell_key(opts.bank, row, 0));
+
+        if (num_bitflips == 0)
+            continue;
+
+        if (p == end || *p != ':')
+            return "no bitflip locations on line " + to_string(line_num) + ", the output was not written with --location_out";
+        p++;
+
+        uint32_t num_locs = 0;
+        while (true) {
+            while (p < end && (*p == ' ' || *p == ','))
+                p++;
+            if (p >= end)
+                break;
+
+            uint32_t bit = strtoul(p, &next, 10);
+            if (next == p || next > end)
+                return "malformed line " + to_string(line_num);
+            p = next;
+
+            std::string error = check_cell(opts.bank, bit);
+            if (!error.empty())
+                return error + " on line " + to_string(line_num);
+
+            f.flips[cell_key(opts.bank, row, bit)]++;
+            num_locs++;
+        }
+
+        if (num_locs != num_bitflips)
+            return "line " + to_string(line_num) + " has " + to_string(num_locs) + " bitflip locations instead of " + to_string(num_bitflips);
+    }
+
+    if (f.num_trials == 0)
+        return "no iterations";
+
+    return "";
+}
+
+std::string ingest_rowscout(IngestedFile& f) {
+    f.tool = "RowScout";
+
+    // the inputs may be in read-only directories, so no sidecar index is written next to them
+    JSONObjectFile file;
+    std::string error = file.open(f.path, false);
+    if (!error.empty())
+        return error;
+
+    std::vector<size_t> indices(file.num_objects());
+    for (size_t i = 0; i < indices.size(); i++)
+        indices[i] = i;
+
+    std::vector<IngestWeakRowSet> row_groups;
+    error = file.parse_objects(indices, row_groups);
+    if (!error.empty())
+        return error;
+
+    for (auto& wrs : row_groups) {
+        for (auto& wr : wrs.row_group) {
+            f.tested_rows.push_back(cell_key(wrs.bank_id, wr.row_id, 0));
+
+            // a row may be in more than one row group, but each of its bitflips counts once
+            for (auto bit : wr.bitflip_locs) {
+                if (!(error = check_cell(wrs.bank_id, bit)).empty())
+                    return error + " in row " + to_string(wr.row_id);
+
+                f.flips[cell_key(wrs.bank_id, wr.row_id, bit)] = 1;
+            }
+        }
+    }
+
+    return "";
+}
+
+std::string ingest_bitflip_map(IngestedFile& f, const IngestOptions& opts) {
+    f.tool = "RowHammerAttacker";
+
+    BitflipMapReader reader;
+    std::string error = reader.open(f.path);
+    if (!error.empty())
+        return error;
+
+    const BitflipMapHeader& header = reader.get_header();
+    if (header.chunks_per_victim == 0 || BITFLIP_DB_ROW_BITS % header.chunks_per_victim != 0)
+        return "unsupported number of chunks per victim: " + to_string(header.chunks_per_victim);
+
+    f.granularity_bits = BITFLIP_DB_ROW_BITS/header.chunks_per_victim;
+    if (!(error = check_cell(header.bank, 0)).empty())
+        return error;
+
+    // every anchor row in the tested range was hammered, with or without bitflips. When the run did not finish, only the rows up to
+    // the last recovered one are known to be tested
+    uint64_t end_row = (uint64_t)header.last_row + 1;
+    if (reader.is_recovered())
+        end_row = reader.get_blocks().empty() ? header.first_row : (uint64_t)reader.get_blocks().back().last_anchor + 1;
+
+    for (uint64_t anchor_row = header.first_row; anchor_row < end_row; anchor_row++)
+        for (auto row : victim_rows(header.row_layout, anchor_row, opts.phys_to_log))
+            f.tested_rows.push_back(cell_key(header.bank, row, 0));
+
+    bool ok = reader.for_each_row(0, UINT32_MAX, [&](uint32_t anchor_row, const uint32_t* chunk_counts) {
+        auto rows = victim_rows(header.row_layout, anchor_row, opts.phys_to_log);
+
+        for (uint v = 0; v < rows.size(); v++)
+            for (uint c = 0; c < header.chunks_per_victim; c++)
+                if (chunk_counts[v*header.chunks_per_victim + c] > 0)
+                    f.flips[cell_key(header.bank, rows[v], c*f.granularity_bits)] += chunk_counts[v*header.chunks_per_victim + c];
+    });
+
+    return ok ? "" : "corrupted bitflip map";
+}
+
+std::string ingest_rha_text(const std::string& contents, IngestedFile& f, const IngestOptions& opts) {
+    f.tool = "RowHammerAttacker";
+
+    if (opts.row_layout.empty())
+        return "not a TRR Analyzer or RowScout output, pass --row_layout for RowHammerAttacker outputs";
+
+    uint num_victims = std::count(opts.row_layout.begin(), opts.row_layout.end(), 'V');
+    uint chunks_per_victim = 0;
+
+    std::istringstream iss(contents);
+    std::string line;
+    uint line_num = 0;
+    while (std::getline(iss, line)) {
+        line_num++;
+
+        size_t colon = line.find(':');
+        if (colon == string::npos)
+            continue;
+
+        // "<anchor row>: <counts>", or "<bank> <anchor row>: <counts>" when attacking multiple banks
+        std::istringstream prefix(line.substr(0, colon)), counts_ss(line.substr(colon + 1));
+        std::vector<uint64_t> ids;
+        uint64_t id;
+        while (prefix >> id)
+            ids.push_back(id);
+
+        if (ids.empty() || ids.size() > 2 || !prefix.eof())
+            return "malformed line " + to_string(line_num);
+
+        uint32_t bank = (ids.size() == 2) ? ids[0] : opts.bank;
+        uint32_t anchor_row = ids.back();
+
+        std::vector<uint32_t> counts;
+        uint32_t count;
+        while (counts_ss >> count)
+            counts.push_back(count);
+
+        if (counts.empty() || counts.size() % num_victims != 0 || (chunks_per_victim != 0 && counts.size() != num_victims*chunks_per_victim))
+            return "line " + to_string(line_num) + " does not match --row_layout " + opts.row_layout;
+
+        chunks_per_victim = counts.size()/num_victims;
+        if (BITFLIP_DB_ROW_BITS % chunks_per_victim != 0)
+            return "unsupported number of chunks per victim on line " + to_string(line_num);
+
+        f.granularity_bits = BITFLIP_DB_ROW_BITS/chunks_per_victim;
+
+        std::string error = check_cell(bank, 0);
+        if (!error.empty())
+            return error + " on line " + to_string(line_num);
+
+        auto rows = victim_rows(opts.row_layout, anchor_row, opts.phys_to_log);
+        for (uint v = 0; v < rows.size(); v++) {
+            f.tested_rows.push_back(cell_key(bank, rows[v], 0));
+
+            for (uint c = 0; c < chunks_per_victim; c++)
+                if (counts[v*chunks_per_victim + c] > 0)
+                    f.flips[cell_key(bank, rows[v], c*f.granularity_bits)] += counts[v*chunks_per_victim + c];
+        }
+    }
+
+    return "";
+}
+
+// finds out what kind of output the file is and reads its run into f
+void ingest_file(IngestedFile& f, const IngestOptions& opts) {
+    std::ifstream in(f.path, std::ios::binary);
+    if (!in.is_open()) {
+        f.error = "could not open the file";
+        return;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t first_char = contents.find_first_not_of(" \t\r\n");
+
+    if (contents.compare(0, BITFLIP_MAP_MAGIC_SIZE, BITFLIP_MAP_MAGIC) == 0) {
+        contents.clear();
+        f.error = ingest_bitflip_map(f, opts);
+    } else if (first_char != string::npos && contents[first_char] == '{') {
+        contents.clear();
+        f.error = ingest_rowscout(f);
+    } else if (contents.find("--- END OF HEADER ---") != string::npos) {
+        f.error = ingest_trran(contents, f, opts);
+    } else {
+        f.error = ingest_rha_text(contents, f, opts);
+    }
+
+    std::sort(f.tested_rows.begin(), f.tested_rows.end());
+    f.tested_rows.erase(std::unique(f.tested_rows.begin(), f.tested_rows.end()), f.tested_rows.end());
+}
+
+int main(int argc, char** argv)
+{
+    string db_filename;
+    vector<string> input_filenames;
+    string module;
+    uint bank = 1;
+    string row_layout;
+    string row_mapping_filename;
+    uint num_jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    options_description desc("BitflipDBIngest Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("db", value(&db_filename), "Specifies the bitflip database to add the runs to. The database is created if it does not exist.")
+        ("inputs", value<vector<string>>(&input_filenames)->multitoken(), "Specifies the TRR Analyzer, RowScout, and RowHammerAttacker outputs to add, a run each. Files that are already in the database are skipped.")
+        ("module", value(&module), "Specifies the module the inputs were produced with. By default, the module of an input is the name of the directory it is in (e.g., the output directories of the Orchestrator).")
+        ("bank,b", value(&bank)->default_value(bank), "Specifies the bank of TRR Analyzer outputs and RowHammerAttacker text outputs, which do not record it.")
+        ("row_layout", value(&row_layout), "Specifies the --row_layout of RowHammerAttacker text outputs.")
+        ("row_mapping_file", value(&row_mapping_filename), "Specifies the logical to physical row mapping RowHammerAttacker used (see tools/row_mapping.h). Its physical victim rows are stored as logical row IDs like the rows of the other tools. The mapping is sequential by default.")
+        ("jobs,j", value(&num_jobs)->default_value(num_jobs), "Specifies the number of files to parse in parallel.")
+        ;
+
+    positional_options_description pos_desc;
+    pos_desc.add("inputs", -1);
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(desc).positional(pos_desc).run(), vm);
+    notify(vm);
+
+    if (vm.count("help") || db_filename.empty() || input_filenames.empty()) {
+        cout << "Usage: BitflipDBIngest --db <database> [options] <inputs>..." << endl;
+        cout << desc << endl;
+        return vm.count("help") ? 0 : -1;
+    }
+
+    if (num_jobs == 0) {
+        cerr << RED_TXT << "ERROR: --jobs must be at least 1" << NORMAL_TXT << endl;
+        exit(-3);
+    }
+
+    if (!row_layout.empty() && (row_layout.find_first_not_of("VAR-") != string::npos || row_layout.find('V') == string::npos)) {
+        cerr << RED_TXT << "ERROR: --row_layout must contain at least one 'V' and only 'V', 'A', 'R', and '-'. Provided: " << row_layout << NORMAL_TXT << endl;
+        exit(-3);
+    }
+
+    IngestOptions opts;
+    opts.bank = bank;
+    opts.row_layout = row_layout;
+
+    RowMapping mapping = identity_row_mapping();
+    if (!row_mapping_filename.empty()) {
+        string error = load_row_mapping(row_mapping_filename, mapping);
+        if (error.empty())
+            error = invert_row_mapping(mapping, opts.phys_to_log);
+
+        if (!error.empty()) {
+            cerr << RED_TXT << "ERROR: Invalid row mapping: " << error << NORMAL_TXT << endl;
+            exit(-3);
+        }
+    } else {
+        opts.phys_to_log = mapping;
+    }
+
+    auto t_start = chrono::steady_clock::now();
+
+    BitflipDBBuilder builder;
+    std::set<string> ingested_sources;
+
+    // held until the new database replaces the old one, so that concurrent ingests add their runs one after the other
+    int lock_fd = lock_bitflip_db(db_filename);
+    if (lock_fd < 0) {
+        cerr << RED_TXT << "ERROR: Could not lock " << db_filename << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    if (boost::filesystem::exists(db_filename)) {
+        BitflipDB db;
+        string error = db.open(db_filename);
+        if (error.empty())
+            error = builder.add_db(db);
+
+        if (!error.empty()) {
+            cerr << RED_TXT << "ERROR: Could not read " << db_filename << ": " << error << NORMAL_TXT << endl;
+            return -1;
+        }
+
+        for (auto& run : builder.get_runs())
+            ingested_sources.insert(run.source);
+    }
+
+    vector<IngestedFile> files;
+    for (auto& input_filename : input_filenames) {
+        boost::filesystem::path path = boost::filesystem::absolute(input_filename);
+        if (!boost::filesystem::is_regular_file(path)) {
+            cerr << RED_TXT << "ERROR: " << input_filename << " is not a file" << NORMAL_TXT << endl;
+            exit(-3);
+        }
+
+        string source = boost::filesystem::canonical(path).string();
+        if (!ingested_sources.insert(source).second) {
+            cout << YELLOW_TXT << "Skipping " << input_filename << ", it is already in the database" << NORMAL_TXT << endl;
+            continue;
+        }
+
+        IngestedFile f;
+        f.path = source;
+        f.module = module.empty() ? path.parent_path().filename().string() : module;
+        files.push_back(std::move(f));
+    }
+
+    // the files are parsed by a pool of threads that take the next file when they finish one
+    std::atomic<size_t> next_file(0);
+    auto ingest_files = [&]() {
+        size_t i;
+        while ((i = next_file++) < files.size())
+            ingest_file(files[i], opts);
+    };
+
+    vector<thread> threads;
+    for (uint t = 1; t < std::min<size_t>(num_jobs, files.size()); t++)
+        threads.emplace_back(ingest_files);
+    ingest_files();
+    for (auto& t : threads)
+        t.join();
+
+    bool failed = false;
+    for (auto& f : files) {
+        if (!f.error.empty()) {
+            cerr << RED_TXT << "ERROR: " << f.path << ": " << f.error << NORMAL_TXT << endl;
+            failed = true;
+        }
+    }
+
+    // nothing is written unless every input could be read, so that fixing and rerunning the ingest does not add runs twice
+    if (failed)
+        return -1;
+
+    uint64_t num_cells = 0;
+    for (auto& f : files) {
+        uint32_t module_id = builder.add_module(f.module);
+        uint32_t run_id = builder.add_run(BitflipDBRun{f.path, f.tool, module_id, f.num_trials, f.granularity_bits});
+
+        for (auto key : f.tested_rows)
+            builder.add_tested_row(module_id, key >> 48, (key >> 16) & UINT32_MAX, run_id);
+
+        for (auto& flip : f.flips)
+            builder.add_flips(module_id, flip.first >> 48, (flip.first >> 16) & UINT32_MAX, flip.first & UINT16_MAX, run_id, flip.second);
+
+        num_cells += f.flips.size();
+
+        std::unordered_map<uint64_t, uint32_t>().swap(f.flips);
+        std::vector<uint64_t>().swap(f.tested_rows);
+    }
+
+    string error = builder.write(db_filename);
+    if (!error.empty()) {
+        cerr << RED_TXT << "ERROR: Could not write " << db_filename << ": " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    close(lock_fd);
+
+    BitflipDB db;
+    if (!(error = db.open(db_filename)).empty()) {
+        cerr << RED_TXT << "ERROR: " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+    const BitflipDBHeader& header = db.get_header();
+    cout << GREEN_TXT << "Added " << files.size() << " runs (" << num_cells << " cells) in " << elapsed_s << " s. " << db_filename << " has "
+        << header.num_runs << " runs of " << header.num_modules << " modules, " << header.num_cells << " cells in " << header.num_rows << " rows" << NORMAL_TXT << endl;
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "tools/bitflip_db.h"
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define NORMAL_TXT "\033[0m"
+
+// Queries the bitflip databases BitflipDBIngest builds (see tools/bitflip_db.h), e.g., the cells in bank 1 that flipped in at
+// least 10% of the TRR Analyzer iterations of all runs that tested their rows:
+//   $ ./BitflipDBQuery utrr.bdb --cells --bank 1 --tool TRRAnalyzer --min_fraction 0.1
+int main(int argc, char** argv)
+{
+    string db_filename;
+    vector<string> modules;
+    int bank = -1;
+    vector<uint> row_range;
+    int bit = -1;
+    vector<string> tools;
+    vector<uint> run_ids;
+    uint32_t granularity_bits = 1;
+    uint min_flips = 1;
+    uint min_runs = 1;
+    double min_fraction = 0.0;
+    bool print_info = false;
+    bool print_cells = false;
+    bool print_rows = false;
+    bool print_count = false;
+
+    options_description desc("BitflipDBQuery Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("db", value(&db_filename), "Specifies the bitflip database to query.")
+        ("info", bool_switch(&print_info), "Prints the modules and runs in the database.")
+        ("cells", bool_switch(&print_cells), "Prints the matching cells as CSV: module, bank, row, bit, flips, trials of the runs that tested the row, and runs that flipped the cell.")
+        ("rows", bool_switch(&print_rows), "Prints the rows with matching cells as CSV: module, bank, row, matching cells, and their flips.")
+        ("count", bool_switch(&print_count), "Prints the number of matching cells.")
+        ("module", value<vector<string>>(&modules)->multitoken(), "Restricts the query to these modules.")
+        ("bank,b", value(&bank), "Restricts the query to a bank.")
+        ("range", value<vector<uint>>(&row_range)->multitoken(), "Restricts the query to a range of rows (start and end values are both inclusive).")
+        ("bit", value(&bit), "Restricts the query to the cells at this bit of their row.")
+        ("tool", value<vector<string>>(&tools)->multitoken(), "Only counts the runs of these tools (TRRAnalyzer, RowScout, RowHammerAttacker).")
+        ("runs", value<vector<uint>>(&run_ids)->multitoken(), "Only counts these runs (see --info for their IDs).")
+        ("granularity", value(&granularity_bits)->default_value(granularity_bits), "Only counts the runs whose cells stand for this many bits, i.e., 1 for the runs that record the bit of each bitflip, or the chunk size of the RowHammerAttacker runs that count bitflips per chunk of a row (see --info). The cells of runs with different granularities are never counted together.")
+        ("min_flips", value(&min_flips)->default_value(min_flips), "Only matches the cells that flipped at least this many times in the counted runs.")
+        ("min_runs", value(&min_runs)->default_value(min_runs), "Only matches the cells that flipped in at least this many of the counted runs.")
+        ("min_fraction", value(&min_fraction)->default_value(min_fraction), "Only matches the cells that flipped in at least this fraction of the trials (e.g., TRR Analyzer iterations) of the counted runs that tested their row.")
+        ;
+
+    positional_options_description pos_desc;
+    pos_desc.add("db", 1);
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(desc).positional(pos_desc).run(), vm);
+    notify(vm);
+
+    if (vm.count("help") || db_filename.empty()) {
+        cout << "Usage: BitflipDBQuery <database> [--info] [--cells] [--rows] [--count] [filters]" << endl;
+        cout << desc << endl;
+        return vm.count("help") ? 0 : -1;
+    }
+
+    uint32_t first_row = 0;
+    uint32_t last_row = numeric_limits<uint32_t>::max();
+    if (row_range.size() == 2) {
+        first_row = min(row_range[0], row_range[1]);
+        last_row = max(row_range[0], row_range[1]);
+    } else if (!row_range.empty()) {
+        cerr << RED_TXT << "ERROR: --range must specify exactly two tokens. E.g., <--range 0 5>" << NORMAL_TXT << endl;
+        exit(-3);
+    }
+
+    BitflipDB db;
+    string error = db.open(db_filename);
+    if (!error.empty()) {
+        cerr << RED_TXT << "ERROR: " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    const vector<BitflipDBRun>& runs = db.get_runs();
+
+    vector<uint32_t> module_ids;
+    for (auto& module : modules) {
+        int module_id = db.find_module(module);
+        if (module_id < 0) {
+            cerr << RED_TXT << "ERROR: There is no module " << module << " in " << db_filename << NORMAL_TXT << endl;
+            exit(-3);
+        }
+        module_ids.push_back(module_id);
+    }
+    if (modules.empty())
+        for (uint32_t m = 0; m < db.get_modules().size(); m++)
+            module_ids.push_back(m);
+
+    // The runs whose flips and trials are counted. A cell of a run that counts bitflips per chunk is stored at the first bit of the
+    // chunk, i.e., at the same key as that bit in the runs that record each bit, so only runs of the same granularity are counted
+    vector<bool> counted(runs.size(), run_ids.empty() && tools.empty());
+    for (auto run_id : run_ids) {
+        if (run_id >= runs.size()) {
+            cerr << RED_TXT << "ERROR: There is no run " << run_id << " in " << db_filename << NORMAL_TXT << endl;
+            exit(-3);
+        }
+        if (runs[run_id].granularity_bits != granularity_bits) {
+            cerr << RED_TXT << "ERROR: Run " << run_id << " counts bitflips per " << runs[run_id].granularity_bits << "-bit chunk. Query it with --granularity "
+                << runs[run_id].granularity_bits << NORMAL_TXT << endl;
+            exit(-3);
+        }
+        counted[run_id] = tools.empty() || std::find(tools.begin(), tools.end(), runs[run_id].tool) != tools.end();
+    }
+    if (run_ids.empty() && !tools.empty())
+        for (uint r = 0; r < runs.size(); r++)
+            counted[r] = std::find(tools.begin(), tools.end(), runs[r].tool) != tools.end();
+
+    for (uint r = 0; r < runs.size(); r++)
+        counted[r] = counted[r] && runs[r].granularity_bits == granularity_bits;
+
+    bool all_counted = std::all_of(counted.begin(), counted.end(), [](bool c) { return c; });
+
+    if (!print_cells && !print_rows && !print_count)
+        print_info = true;
+
+    if (print_info) {
+        const BitflipDBHeader& header = db.get_header();
+        cout << "Modules:      " << header.num_modules << endl;
+        cout << "Runs:         " << header.num_runs << endl;
+        cout << "Rows:         " << header.num_rows << endl;
+        cout << "Cells:        " << header.num_cells << " (" << header.num_observations << " with flips in a run)" << endl;
+        for (uint r = 0; r < runs.size(); r++)
+            cout << setw(5) << r << ": " << db.get_modules()[runs[r].module] << " " << runs[r].tool << ", " << runs[r].num_trials << " trial(s)"
+                << (runs[r].granularity_bits > 1 ? ", " + to_string(runs[r].granularity_bits) + "-bit chunks" : "") << ", " << runs[r].source << endl;
+    }
+
+    if (!print_cells && !print_rows && !print_count)
+        return 0;
+
+    auto t_start = chrono::steady_clock::now();
+
+    // the rows can be answered from the index alone when every cell of every run counts
+    bool index_only = !print_cells && print_rows && !print_count && all_counted && bit < 0 && min_flips <= 1 && min_runs <= 1 && min_fraction <= 0.0;
+
+    if (print_cells)
+        cout << "module,bank,row,bit,flips,trials,runs" << endl;
+    else if (print_rows)
+        cout << "module,bank,row,cells,flips" << endl;
+
+    uint64_t num_matching_cells = 0, num_matching_rows = 0;
+    BitflipDBRowData row_data;
+    bool ok = true;
+
+    for (auto module_id : module_ids) {
+        const string& module = db.get_modules()[module_id];
+
+        vector<uint32_t> banks = (bank >= 0) ? vector<uint32_t>{(uint32_t) bank} : db.banks_of(module_id);
+        for (auto b : banks) {
+            auto rows = db.find_rows(module_id, b, first_row, last_row);
+
+            for (const BitflipDBRow* row = rows.first; row != rows.second; row++) {
+                if (row->num_cells == 0)
+                    continue;
+
+                if (index_only) {
+                    cout << module << "," << b << "," << row->row << "," << row->num_cells << "," << row->total_flips << "\n";
+                    num_matching_cells += row->num_cells;
+                    num_matching_rows++;
+                    continue;
+                }
+
+                if (!db.decode_row(*row, row_data)) {
+                    ok = false;
+                    break;
+                }
+
+                uint64_t trials = 0;
+                for (auto run : row_data.tested_runs)
+                    if (run < runs.size() && counted[run])
+                        trials += runs[run].num_trials;
+
+                uint64_t row_cells = 0, row_flips = 0;
+                for (uint32_t i = 0; i < row_data.bits.size(); i++) {
+                    if (bit >= 0 && row_data.bits[i] != (uint32_t) bit)
+                        continue;
+
+                    uint64_t flips = 0;
+                    uint32_t flipped_runs = 0;
+                    for (uint32_t j = row_data.obs_begin[i]; j < row_data.obs_begin[i + 1]; j++) {
+                        if (row_data.runs[j] < runs.size() && counted[row_data.runs[j]]) {
+                            flips += row_data.counts[j];
+                            flipped_runs++;
+                        }
+                    }
+
+                    if (flips < min_flips || flips == 0 || flipped_runs < min_runs)
+                        continue;
+
+                    if (min_fraction > 0.0 && (trials == 0 || (double) flips/trials < min_fraction))
+                        continue;
+
+                    if (print_cells)
+                        cout << module << "," << b << "," << row->row << "," << row_data.bits[i] << "," << flips << "," << trials << "," << flipped_runs << "\n";
+
+                    row_cells++;
+                    row_flips += flips;
+                }
+
+                if (row_cells == 0)
+                    continue;
+
+                if (print_rows && !print_cells)
+                    cout << module << "," << b << "," << row->row << "," << row_cells << "," << row_flips << "\n";
+
+                num_matching_cells += row_cells;
+                num_matching_rows++;
+            }
+        }
+    }
+
+    double elapsed_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t_start).count();
+
+    if (print_count)
+        cout << num_matching_cells << endl;
+    cout.flush();
+
+    if (!ok) {
+        cerr << RED_TXT << "ERROR: " << db_filename << " is corrupted" << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    cerr << num_matching_cells << " cells in " << num_matching_rows << " rows matched (" << fixed << setprecision(2) << elapsed_ms << " ms)" << endl;
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "tools/experiment_server.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define NORMAL_TXT "\033[0m"
+
+int main(int argc, char** argv)
+{
+    string socket_path = DEFAULT_EXPSRV_SOCKET;
+    ExperimentJob job;
+
+    // everything after '--' is passed to the tool as is
+    int num_client_args = argc;
+    for(int i = 1; i < argc; i++) {
+        if(string(argv[i]) == "--") {
+            num_client_args = i;
+            break;
+        }
+    }
+
+    for(int i = num_client_args + 1; i < argc; i++)
+        job.args.push_back(argv[i]);
+
+    options_description desc("ExperimentClient Options (usage: ExperimentClient --tool <tool> [options] -- <tool arguments>)");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("socket,s", value(&socket_path)->default_value(socket_path), "Specifies the Unix domain socket of the ExperimentServer.")
+        ("tool,t", value(&job.tool), "Specifies the tool to run: RowScout, TRRAnalyzer, or RowHammerAttacker.")
+        ("out,o", value(&job.out), "Specifies a path for the output file of the tool (passed to the tool as --out).")
+        ;
+
+    variables_map vm;
+    store(parse_command_line(num_client_args, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help") || job.tool.empty()) {
+        cout << desc << endl;
+        return vm.count("help") ? 0 : -1;
+    }
+
+    char cwd[4096];
+    if(getcwd(cwd, sizeof(cwd)) != nullptr)
+        job.cwd = cwd;
+
+    string error;
+    int exit_code = run_remote_job(socket_path, job, cout, error);
+    if(exit_code == -1 && !error.empty()) {
+        cerr << RED_TXT << "ERROR: " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    return exit_code;
+}
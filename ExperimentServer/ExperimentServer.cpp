@@ -0,0 +1,321 @@
+#include "instruction.h"
+#include "prog.h"
+#include "platform.h"
+#include "tools/softmc_session.h"
+#include "tools/experiment_server.h"
+
+#include <string>
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <csignal>
+#include <algorithm>
+#include <climits>
+
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define GREEN_TXT "\033[32m"
+#define YELLOW_TXT "\033[33m"
+#define NORMAL_TXT "\033[0m"
+
+#define POLL_PERIOD_MS 100
+
+// tools that can be run as jobs. The server loads them from <tool_dir>/<tool>/lib<tool>.so (build them with 'make lib')
+const vector<string> SUPPORTED_TOOLS = {"RowScout", "TRRAnalyzer", "RowHammerAttacker"};
+
+typedef struct QueuedJob {
+    int client_fd;
+    uint job_id;
+    ExperimentJob job;
+} QueuedJob;
+
+typedef struct RunningJob {
+    pid_t pid;
+    QueuedJob qjob;
+    chrono::time_point<chrono::high_resolution_clock> t_start;
+} RunningJob;
+
+string tool_lib_path(const string& tool_dir, const string& tool) {
+    return tool_dir + "/" + tool + "/lib" + tool + ".so";
+}
+
+int create_server_socket(const string& socket_path) {
+    sockaddr_un addr;
+    if(!make_unix_sockaddr(socket_path, addr)) {
+        cerr << RED_TXT << "ERROR: Socket path is too long: " << socket_path << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        cerr << RED_TXT << "ERROR: Could not create socket: " << strerror(errno) << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    // remove a stale socket left behind by a server that did not exit cleanly. We hold the board lock, so no other server can be running
+    unlink(socket_path.c_str());
+
+    if(::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        cerr << RED_TXT << "ERROR: Could not listen on " << socket_path << ": " << strerror(errno) << NORMAL_TXT << endl;
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// reads the job description sent by a newly connected client
+bool receive_job(const int client_fd, ExperimentJob& job, string& error) {
+    // do not let a misbehaving client block the server
+    timeval tv;
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    string s_job;
+    if(!recv_line(client_fd, s_job)) {
+        error = "could not receive the job description";
+        return false;
+    }
+
+    if(!job_from_string(s_job, job)) {
+        error = "malformed job description: " + s_job;
+        return false;
+    }
+
+    if(find(SUPPORTED_TOOLS.begin(), SUPPORTED_TOOLS.end(), job.tool) == SUPPORTED_TOOLS.end()) {
+        error = "unknown tool: " + job.tool;
+        return false;
+    }
+
+    return true;
+}
+
+// runs in the forked child process. Never returns
+void run_job(SoftMCPlatform& platform, const string& tool_dir, const QueuedJob& qjob) {
+    // keep running the experiment even if the client goes away, the results are in the output file anyway
+    signal(SIGPIPE, SIG_IGN);
+
+    // the job's output is streamed to the client
+    dup2(qjob.client_fd, STDOUT_FILENO);
+    dup2(qjob.client_fd, STDERR_FILENO);
+    close(qjob.client_fd);
+
+    const ExperimentJob& job = qjob.job;
+
+    // every job captures to (or replays) its own files, e.g., <UTRR_CAPTURE>.job3.RowScout (see tools/softmc_capture.h).
+    // Relative paths stay relative to the directory of the server
+    for(const char* var : {"UTRR_CAPTURE", "UTRR_REPLAY"}) {
+        const char* path = getenv(var);
+        if(path == nullptr || path[0] == '\0')
+            continue;
+
+        string job_path = string(path) + ".job" + to_string(qjob.job_id);
+        char cwd[PATH_MAX];
+        if(job_path[0] != '/' && getcwd(cwd, sizeof(cwd)) != nullptr)
+            job_path = string(cwd) + "/" + job_path;
+
+        setenv(var, job_path.c_str(), 1);
+    }
+
+    if(!job.cwd.empty() && chdir(job.cwd.c_str()) != 0) {
+        cerr << EXPSRV_MSG_PREFIX << " ERROR: could not change the working directory to " << job.cwd << endl;
+        _exit(-1);
+    }
+
+    string lib_path = tool_lib_path(tool_dir, job.tool);
+    void* lib = dlopen(lib_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(lib == nullptr) {
+        cerr << EXPSRV_MSG_PREFIX << " ERROR: could not load " << lib_path << ": " << dlerror() << endl;
+        _exit(-1);
+    }
+
+    UTRRToolMainFn tool_main = (UTRRToolMainFn) dlsym(lib, UTRR_TOOL_MAIN_SYMBOL);
+    if(tool_main == nullptr) {
+        cerr << EXPSRV_MSG_PREFIX << " ERROR: " << lib_path << " does not export " << UTRR_TOOL_MAIN_SYMBOL << endl;
+        _exit(-1);
+    }
+
+    vector<string> args;
+    args.push_back(job.tool);
+    args.insert(args.end(), job.args.begin(), job.args.end());
+    if(!job.out.empty()) {
+        args.push_back("--out");
+        args.push_back(job.out);
+    }
+
+    vector<char*> argv;
+    for(auto& arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    int ret = tool_main(&platform, argv.size() - 1, argv.data());
+
+    cout.flush();
+    cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    _exit(ret);
+}
+
+int main(int argc, char** argv)
+{
+    string socket_path = DEFAULT_EXPSRV_SOCKET;
+    string tool_dir = "..";
+
+    options_description desc("ExperimentServer Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("socket,s", value(&socket_path)->default_value(socket_path), "Specifies the path of the Unix domain socket to accept jobs from.")
+        ("tool_dir", value(&tool_dir)->default_value(tool_dir), "Specifies the directory that contains the RowScout, TRRAnalyzer, and RowHammerAttacker directories. The tools must be built with 'make lib'.")
+        ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+
+    for(auto& tool : SUPPORTED_TOOLS) {
+        if(access(tool_lib_path(tool_dir, tool).c_str(), R_OK) != 0)
+            cout << YELLOW_TXT << "WARNING: " << tool_lib_path(tool_dir, tool) << " not found. " << tool << " jobs will fail. Run 'make lib' in the " << tool << " directory." << NORMAL_TXT << endl;
+    }
+
+    // the server owns the board for its whole lifetime
+    SoftMCPlatform platform;
+    int err;
+    if((err = init_softmc_platform(platform)) != SOFTMC_SUCCESS)
+        return err;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = create_server_socket(socket_path);
+    if(listen_fd < 0)
+        return -1;
+
+    cout << GREEN_TXT << "ExperimentServer is accepting jobs on " << socket_path << NORMAL_TXT << endl;
+
+    deque<QueuedJob> job_queue;
+    RunningJob running;
+    bool job_running = false;
+    uint next_job_id = 0;
+
+    while(true) {
+        vector<pollfd> pfds;
+        pfds.push_back({listen_fd, POLLIN, 0});
+        for(auto& qjob : job_queue)
+            pfds.push_back({qjob.client_fd, POLLIN, 0});
+
+        if(poll(pfds.data(), pfds.size(), POLL_PERIOD_MS) < 0 && errno != EINTR) {
+            cerr << RED_TXT << "ERROR: poll failed: " << strerror(errno) << NORMAL_TXT << endl;
+            break;
+        }
+
+        // drop the queued jobs whose clients disconnected. A queued client is not expected to send anything else
+        for(uint i = pfds.size() - 1; i >= 1; i--) {
+            if(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                QueuedJob& qjob = job_queue[i - 1];
+                cout << YELLOW_TXT << "Job " << qjob.job_id << " (" << qjob.job.tool << ") cancelled by the client" << NORMAL_TXT << endl;
+                close(qjob.client_fd);
+                job_queue.erase(job_queue.begin() + (i - 1));
+            }
+        }
+
+        if(pfds[0].revents & POLLIN) {
+            int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+
+            if(client_fd >= 0) {
+                QueuedJob qjob;
+                string error;
+
+                qjob.client_fd = client_fd;
+                qjob.job_id = next_job_id++;
+
+                if(receive_job(client_fd, qjob.job, error)) {
+                    job_queue.push_back(qjob);
+                    uint num_ahead = job_queue.size() - 1 + (job_running ? 1 : 0);
+                    send_line(client_fd, string(EXPSRV_MSG_PREFIX) + " job " + to_string(qjob.job_id) + " queued, " + to_string(num_ahead) + " job(s) ahead");
+                    cout << "Job " << qjob.job_id << " (" << qjob.job.tool << ") queued" << endl;
+                } else {
+                    send_line(client_fd, string(EXPSRV_MSG_PREFIX) + " ERROR: " + error);
+                    send_line(client_fd, string(EXPSRV_EXIT_MSG) + "-1");
+                    close(client_fd);
+                }
+            }
+        }
+
+        if(job_running) {
+            int status;
+            pid_t ret = waitpid(running.pid, &status, WNOHANG);
+
+            if(ret == running.pid) {
+                int exit_code = WIFEXITED(status) ? (int)(int8_t)WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                double elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - running.t_start).count();
+
+                send_line(running.qjob.client_fd, string(EXPSRV_EXIT_MSG) + to_string(exit_code));
+                close(running.qjob.client_fd);
+
+                cout << "Job " << running.qjob.job_id << " (" << running.qjob.job.tool << ") finished in " << (int)elapsed << " s with exit code " << exit_code << endl;
+                job_running = false;
+
+                // a job that did not exit cleanly may have left the FPGA in the middle of a program
+                if(exit_code != 0) {
+                    cout << YELLOW_TXT << "Resetting the FPGA after the failed job" << NORMAL_TXT << endl;
+                    platform.reset_fpga();
+                    platform.set_aref(false);
+                }
+            }
+        }
+
+        if(!job_running && !job_queue.empty()) {
+            running.qjob = job_queue.front();
+            job_queue.pop_front();
+
+            send_line(running.qjob.client_fd, string(EXPSRV_MSG_PREFIX) + " job " + to_string(running.qjob.job_id) + " started");
+
+            cout.flush();
+            cerr.flush();
+
+            pid_t pid = fork();
+            if(pid == 0) {
+                close(listen_fd);
+                for(auto& qjob : job_queue)
+                    close(qjob.client_fd);
+
+                run_job(platform, tool_dir, running.qjob);
+            }
+
+            if(pid < 0) {
+                send_line(running.qjob.client_fd, string(EXPSRV_MSG_PREFIX) + " ERROR: could not fork: " + strerror(errno));
+                send_line(running.qjob.client_fd, string(EXPSRV_EXIT_MSG) + "-1");
+                close(running.qjob.client_fd);
+                continue;
+            }
+
+            running.pid = pid;
+            running.t_start = chrono::high_resolution_clock::now();
+            job_running = true;
+
+            cout << "Job " << running.qjob.job_id << " (" << running.qjob.job.tool << ") started" << endl;
+        }
+    }
+
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    return 0;
+}
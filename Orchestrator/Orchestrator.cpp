@@ -0,0 +1,444 @@
+#include "tools/experiment_server.h"
+#include "tools/shard_queue.h"
+#include "tools/json_struct.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define GREEN_TXT "\033[32m"
+#define YELLOW_TXT "\033[33m"
+#define NORMAL_TXT "\033[0m"
+
+// Runs a campaign of RowScout, TRR Analyzer, and RowHammerAttacker jobs on several boards at once. Each board holds one of the modules
+// in tested_modules_info.csv and is driven by its own ExperimentServer, e.g.,
+//   $ UTRR_BOARD_LOCK=/tmp/utrr_board_A1.lock ./ExperimentServer --socket /tmp/utrr_A1.sock &
+// The Orchestrator splits the jobs of the campaign into shards, e.g., row ranges of a RowHammerAttacker sweep, and submits them to the
+// servers such that every board runs one shard at a time. A board that runs out of shards steals shards it can run from the other boards
+// (see tools/shard_queue.h). The output of each shard is tagged with the module it ran on.
+//
+// The campaign file is a JSON object such as:
+// {
+//     "boards" : [ { "module" : "A1", "socket" : "/tmp/utrr_A1.sock" }, { "module" : "A2", "socket" : "/tmp/utrr_A2.sock" } ],
+//     "jobs" : [
+//         { "name" : "rha_b1", "tool" : "RowHammerAttacker", "modules" : ["A1", "A2"], "args" : ["--bank", "1"], "range" : [0, 32767], "shard_rows" : 4096 },
+//         { "name" : "trr_hammers", "tool" : "TRRAnalyzer", "modules" : ["A1"], "args" : ["--row_scout_file", "a1.R-R"],
+//           "points" : [ ["--hammers_per_round", "1000"], ["--hammers_per_round", "2000"] ] }
+//     ]
+// }
+// A job runs on each of its "modules": every module gets all shards of the job, e.g., rha_b1 sweeps rows 0-32767 of both A1 and A2, and
+// the shards of a module only run on the board that holds it, so that no shard changes the device under test. A job without "modules"
+// runs once, and each of its shards runs on whichever board takes it first, e.g., for jobs whose results do not depend on the module.
+// "range" and "shard_rows" split the job into shards of shard_rows rows, each passed to the tool as --range <first row> <last row>.
+// "points" makes a shard of each list of arguments.
+
+#define DEFAULT_MOCK_SHARD_MS 100
+
+typedef struct CampaignBoard {
+    std::string module;
+    std::string socket; // of the ExperimentServer that drives the board
+    double mock_shard_ms = 0; // with --mock, how long a shard takes on this board (0 for --mock_shard_ms)
+    uint mock_shards = 0; // with --mock, the board leaves the campaign, as if its ExperimentServer went away, after this many shards (0: never)
+} CampaignBoard;
+
+JS_OBJECT_EXTERNAL(CampaignBoard,
+                JS_MEMBER(module),
+                JS_MEMBER(socket),
+                JS_MEMBER(mock_shard_ms),
+                JS_MEMBER(mock_shards));
+
+typedef struct CampaignJob {
+    std::string name;
+    std::string tool;
+    std::vector<std::string> modules;
+    std::vector<std::string> args;
+    std::vector<int> range;
+    uint shard_rows = 0;
+    std::vector<std::vector<std::string>> points;
+} CampaignJob;
+
+JS_OBJECT_EXTERNAL(CampaignJob,
+                JS_MEMBER(name),
+                JS_MEMBER(tool),
+                JS_MEMBER(modules),
+                JS_MEMBER(args),
+                JS_MEMBER(range),
+                JS_MEMBER(shard_rows),
+                JS_MEMBER(points));
+
+typedef struct Campaign {
+    std::vector<CampaignBoard> boards;
+    std::vector<CampaignJob> jobs;
+} Campaign;
+
+JS_OBJECT_EXTERNAL(Campaign,
+                JS_MEMBER(boards),
+                JS_MEMBER(jobs));
+
+// a line of the results file, written when a shard finishes
+typedef struct ShardResult {
+    std::string job;
+    uint shard;
+    std::vector<std::string> args;
+    std::string module;
+    std::string model; // from tested_modules_info.csv
+    std::string trr_mechanism;
+    uint board;
+    bool stolen;
+    std::string out;
+    std::string log;
+    int exit_code;
+    double elapsed_s;
+} ShardResult;
+
+JS_OBJECT_EXTERNAL(ShardResult,
+                JS_MEMBER(job),
+                JS_MEMBER(shard),
+                JS_MEMBER(args),
+                JS_MEMBER(module),
+                JS_MEMBER(model),
+                JS_MEMBER(trr_mechanism),
+                JS_MEMBER(board),
+                JS_MEMBER(stolen),
+                JS_MEMBER(out),
+                JS_MEMBER(log),
+                JS_MEMBER(exit_code),
+                JS_MEMBER(elapsed_s));
+
+typedef struct ModuleInfo {
+    std::string model;
+    std::string vendor;
+    std::string trr_mechanism;
+} ModuleInfo;
+
+const vector<string> SUPPORTED_TOOLS = {"RowScout", "TRRAnalyzer", "RowHammerAttacker"};
+
+bool load_campaign(const string& filename, Campaign& campaign) {
+    std::ifstream f_campaign(filename);
+    if(!f_campaign.is_open()) {
+        cerr << RED_TXT << "ERROR: Could not open the campaign file " << filename << NORMAL_TXT << endl;
+        return false;
+    }
+
+    string s_campaign((std::istreambuf_iterator<char>(f_campaign)), std::istreambuf_iterator<char>());
+
+    JS::ParseContext context(s_campaign);
+    if(context.parseTo(campaign) != JS::Error::NoError) {
+        cerr << RED_TXT << "ERROR: Could not parse the campaign file " << filename << ": " << context.makeErrorString() << NORMAL_TXT << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// reads the module IDs, model numbers, vendors, and TRR mechanisms in tested_modules_info.csv
+string load_module_info(const string& filename, map<string, ModuleInfo>& modules) {
+    std::ifstream f_modules(filename);
+    if(!f_modules.is_open())
+        return "could not open " + filename;
+
+    string line;
+    getline(f_modules, line); // the header
+
+    while(getline(f_modules, line)) {
+        vector<string> fields;
+        stringstream ss(line);
+        string field;
+        while(getline(ss, field, ','))
+            fields.push_back(field);
+
+        if(fields.size() < 7)
+            continue;
+
+        modules[fields[1]] = ModuleInfo{fields[0], fields[2], fields[6]};
+    }
+
+    return "";
+}
+
+// splits the jobs into shards and queues them on the boards they can run on
+string make_shards(const Campaign& campaign, ShardQueue& queue, uint& num_shards) {
+    num_shards = 0;
+
+    for(uint job_ind = 0; job_ind < campaign.jobs.size(); job_ind++) {
+        const CampaignJob& job = campaign.jobs[job_ind];
+
+        if(job.name.empty())
+            return "job " + to_string(job_ind) + " has no name";
+
+        if(find(SUPPORTED_TOOLS.begin(), SUPPORTED_TOOLS.end(), job.tool) == SUPPORTED_TOOLS.end())
+            return "job " + job.name + " has an unknown tool: " + job.tool;
+
+        // the boards that can run each set of shards of the job: the board of each module, or any board
+        vector<vector<uint>> shard_sets;
+        if(job.modules.empty()) {
+            shard_sets.push_back({});
+            for(uint b = 0; b < campaign.boards.size(); b++)
+                shard_sets.back().push_back(b);
+        }
+
+        for(uint m = 0; m < job.modules.size(); m++) {
+            const string& module = job.modules[m];
+            if(find(job.modules.begin(), job.modules.begin() + m, module) != job.modules.begin() + m)
+                continue;
+
+            shard_sets.push_back({});
+            for(uint b = 0; b < campaign.boards.size(); b++) {
+                if(campaign.boards[b].module == module)
+                    shard_sets.back().push_back(b);
+            }
+
+            if(shard_sets.back().empty())
+                return "none of the boards has module " + module + " of job " + job.name;
+        }
+
+        vector<vector<string>> shard_args;
+        if(!job.points.empty()) {
+            shard_args = job.points;
+        } else if(job.shard_rows > 0) {
+            if(job.range.size() != 2 || job.range[0] > job.range[1])
+                return "job " + job.name + " needs a \"range\" of a first and a last row to be split into shards of rows";
+
+            for(int first = job.range[0]; first <= job.range[1]; first += job.shard_rows) {
+                int last = std::min(job.range[1], first + (int) job.shard_rows - 1);
+                shard_args.push_back({"--range", to_string(first), to_string(last)});
+            }
+        } else if(job.range.size() == 2) {
+            shard_args.push_back({"--range", to_string(job.range[0]), to_string(job.range[1])});
+        } else {
+            shard_args.push_back({});
+        }
+
+        for(auto& eligible_boards : shard_sets) {
+            for(uint shard_ind = 0; shard_ind < shard_args.size(); shard_ind++) {
+                queue.push(Shard{job_ind, shard_ind, shard_args[shard_ind], eligible_boards});
+                num_shards++;
+            }
+        }
+    }
+
+    return "";
+}
+
+int orchestrator_main(int argc, char** argv)
+{
+    string campaign_filename = "";
+    string out_dir = "./campaign";
+    string modules_filename = "../tested_modules_info.csv";
+    bool mock = false;
+    double mock_shard_ms = DEFAULT_MOCK_SHARD_MS;
+
+    options_description desc("Orchestrator Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("campaign,c", value(&campaign_filename)->required(), "Specifies the campaign file that lists the boards and the jobs to run on them (see Orchestrator.cpp for the format).")
+        ("out_dir,o", value(&out_dir)->default_value(out_dir), "Specifies the directory to write the results to. The output of shard i of job <job> that ran on module <module> is written to <out_dir>/<module>/<job>.<i>.out and what the tool printed to <out_dir>/<module>/<job>.<i>.log. Each finished shard is appended to <out_dir>/results.json.")
+        ("modules_info", value(&modules_filename)->default_value(modules_filename), "Specifies the list of tested modules (tested_modules_info.csv) to tag the results with the model and TRR mechanism of each module.")
+        ("mock", bool_switch(&mock), "When specified, the shards are not submitted to ExperimentServers but each board pretends to run them for --mock_shard_ms (or the mock_shard_ms of the board in the campaign file), e.g., to try out a campaign file or the scheduling of the shards without boards.")
+        ("mock_shard_ms", value(&mock_shard_ms)->default_value(mock_shard_ms), "Specifies how long a shard takes on a mock board.")
+        ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+
+    notify(vm);
+
+    Campaign campaign;
+    if(!load_campaign(campaign_filename, campaign))
+        return -1;
+
+    if(campaign.boards.empty()) {
+        cerr << RED_TXT << "ERROR: The campaign file does not list any boards" << NORMAL_TXT << endl;
+        return -3;
+    }
+
+    map<string, ModuleInfo> module_info;
+    string modules_error = load_module_info(modules_filename, module_info);
+    if(!modules_error.empty())
+        cout << YELLOW_TXT << "WARNING: The results will not be tagged with the module models: " << modules_error << NORMAL_TXT << endl;
+
+    for(uint b = 0; b < campaign.boards.size(); b++) {
+        const CampaignBoard& board = campaign.boards[b];
+
+        if(board.socket.empty() && !mock) {
+            cerr << RED_TXT << "ERROR: Board " << b << " (" << board.module << ") has no ExperimentServer socket" << NORMAL_TXT << endl;
+            return -3;
+        }
+
+        for(uint other = 0; other < b; other++) {
+            if(campaign.boards[other].module == board.module || (!mock && campaign.boards[other].socket == board.socket)) {
+                cerr << RED_TXT << "ERROR: Boards " << other << " and " << b << " have the same module or ExperimentServer" << NORMAL_TXT << endl;
+                return -3;
+            }
+        }
+
+        if(modules_error.empty() && module_info.find(board.module) == module_info.end())
+            cout << YELLOW_TXT << "WARNING: Module " << board.module << " is not in " << modules_filename << NORMAL_TXT << endl;
+    }
+
+    ShardQueue queue(campaign.boards.size());
+    uint num_shards;
+    string shard_error = make_shards(campaign, queue, num_shards);
+    if(!shard_error.empty()) {
+        cerr << RED_TXT << "ERROR: " << shard_error << NORMAL_TXT << endl;
+        return -3;
+    }
+
+    for(auto& board : campaign.boards)
+        boost::filesystem::create_directories(out_dir + "/" + board.module);
+
+    char cwd[4096];
+    string s_cwd = getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "";
+
+    std::ofstream f_results(out_dir + "/results.json", std::ios::app);
+    if(!f_results.is_open()) {
+        cerr << RED_TXT << "ERROR: Could not open " << out_dir << "/results.json" << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    cout << GREEN_TXT << "Running " << num_shards << " shard(s) of " << campaign.jobs.size() << " job(s) on " << campaign.boards.size()
+        << " board(s)" << (mock ? " (mock)" : "") << NORMAL_TXT << endl;
+
+    std::mutex results_mutex;
+    vector<uint> board_shards(campaign.boards.size(), 0), board_steals(campaign.boards.size(), 0);
+    uint num_failed = 0, num_done = 0;
+    auto t_start = chrono::steady_clock::now();
+
+    auto run_board = [&](const uint b) {
+        const CampaignBoard& board = campaign.boards[b];
+
+        Shard shard;
+        bool stolen;
+        while(queue.next(b, shard, stolen)) {
+            const CampaignJob& job = campaign.jobs[shard.job_ind];
+            string shard_path = out_dir + "/" + board.module + "/" + job.name + "." + to_string(shard.shard_ind);
+
+            ExperimentJob exp_job;
+            exp_job.tool = job.tool;
+            exp_job.args = job.args;
+            exp_job.args.insert(exp_job.args.end(), shard.args.begin(), shard.args.end());
+            exp_job.out = shard_path + ".out";
+            exp_job.cwd = s_cwd;
+
+            std::ofstream f_log(shard_path + ".log");
+            auto t_shard_start = chrono::steady_clock::now();
+
+            int exit_code;
+            string error;
+            if(mock && board.mock_shards > 0 && board_shards[b] == board.mock_shards) {
+                exit_code = -1;
+                error = "the mock board left after " + to_string(board.mock_shards) + " shard(s)";
+            } else if(mock) {
+                f_log << "[mock] " << exp_job.tool;
+                for(auto& arg : exp_job.args)
+                    f_log << " " << arg;
+                f_log << " --out " << exp_job.out << endl;
+
+                double shard_ms = board.mock_shard_ms > 0 ? board.mock_shard_ms : mock_shard_ms;
+                this_thread::sleep_for(chrono::duration<double, milli>(shard_ms));
+                exit_code = 0;
+            } else {
+                exit_code = run_remote_job(board.socket, exp_job, f_log, error);
+            }
+
+            // the server is not there. The shard and the rest of the board's shards go to the other boards
+            if(exit_code == -1 && !error.empty()) {
+                vector<Shard> orphans = queue.retire(b);
+
+                bool requeued = queue.push(shard);
+                if(!requeued)
+                    orphans.push_back(shard);
+
+                std::lock_guard<std::mutex> lock(results_mutex);
+                cerr << RED_TXT << "ERROR: Board " << b << " (" << board.module << ") left the campaign: " << error << NORMAL_TXT << endl;
+                for(auto& orphan : orphans) {
+                    cerr << RED_TXT << "ERROR: No board is left to run shard " << orphan.shard_ind << " of job " << campaign.jobs[orphan.job_ind].name << NORMAL_TXT << endl;
+                    num_failed++;
+                }
+
+                return;
+            }
+
+            ShardResult result;
+            result.job = job.name;
+            result.shard = shard.shard_ind;
+            result.args = shard.args;
+            result.module = board.module;
+            auto it_info = module_info.find(board.module);
+            if(it_info != module_info.end()) {
+                result.model = it_info->second.model;
+                result.trr_mechanism = it_info->second.trr_mechanism;
+            }
+            result.board = b;
+            result.stolen = stolen;
+            result.out = exp_job.out;
+            result.log = shard_path + ".log";
+            result.exit_code = exit_code;
+            result.elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - t_shard_start).count();
+
+            std::lock_guard<std::mutex> lock(results_mutex);
+            f_results << JS::serializeStruct(result, JS::SerializerOptions(JS::SerializerOptions::Compact)) << endl;
+
+            num_done++;
+            board_shards[b]++;
+            if(stolen)
+                board_steals[b]++;
+
+            if(exit_code != 0) {
+                num_failed++;
+                cout << RED_TXT << "[" << num_done << "/" << num_shards << "] " << job.name << "." << shard.shard_ind << " on " << board.module
+                    << " failed with exit code " << exit_code << " (see " << result.log << ")" << NORMAL_TXT << endl;
+            } else {
+                cout << "[" << num_done << "/" << num_shards << "] " << job.name << "." << shard.shard_ind << " finished on " << board.module
+                    << (stolen ? " (stolen)" : "") << " in " << (int) result.elapsed_s << " s" << endl;
+            }
+        }
+    };
+
+    vector<thread> board_threads;
+    for(uint b = 0; b < campaign.boards.size(); b++)
+        board_threads.emplace_back(run_board, b);
+
+    for(auto& t : board_threads)
+        t.join();
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+
+    cout << "Board shards:" << endl;
+    for(uint b = 0; b < campaign.boards.size(); b++)
+        cout << "  " << campaign.boards[b].module << ": " << board_shards[b] << " shard(s), " << board_steals[b] << " stolen" << endl;
+
+    if(num_failed > 0) {
+        cout << RED_TXT << num_failed << " of " << num_shards << " shard(s) failed in " << (int) elapsed << " s" << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    cout << GREEN_TXT << "The campaign has finished in " << (int) elapsed << " s" << NORMAL_TXT << endl;
+    return 0;
+}
+
+// the tests (OrchestratorTest.cpp) run the Orchestrator in their own process
+#ifndef ORCHESTRATOR_LIBRARY
+int main(int argc, char** argv) {
+    return orchestrator_main(argc, argv);
+}
+#endif
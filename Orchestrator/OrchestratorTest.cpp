@@ -0,0 +1,239 @@
+// Tests of the Orchestrator (run with 'make test'): the shard queue, how the jobs of a campaign are split into shards, and whole
+// campaigns on --mock boards. Orchestrator.cpp is compiled into this file as a library (i.e., without its main function), so the
+// tests check exactly the code that the Orchestrator runs.
+
+#define ORCHESTRATOR_LIBRARY
+#include "Orchestrator.cpp"
+
+uint num_checks = 0, num_failed = 0;
+
+void check(const bool cond, const std::string& what) {
+    num_checks++;
+    if(cond)
+        return;
+
+    num_failed++;
+    std::cerr << RED_TXT << "FAILED: " << what << NORMAL_TXT << std::endl;
+}
+
+Shard make_shard(const uint shard_ind, const std::vector<uint>& eligible_boards) {
+    return Shard{0, shard_ind, {}, eligible_boards};
+}
+
+void test_shard_queue() {
+    ShardQueue queue(3);
+
+    // alternates between boards 0 and 1, which have the same number of queued shards after each pair
+    for(uint i = 0; i < 6; i++)
+        check(queue.push(make_shard(i, {0, 1})), "shard " + to_string(i) + " is queued");
+    check(queue.push(make_shard(6, {2})), "shard 6 is queued");
+
+    Shard shard;
+    bool stolen;
+    for(uint expected : {0, 2, 4}) {
+        check(queue.next(0, shard, stolen) && shard.shard_ind == expected && !stolen, "board 0 takes its shard " + to_string(expected));
+    }
+
+    // board 0 steals from the back of board 1's deque
+    check(queue.next(0, shard, stolen) && shard.shard_ind == 5 && stolen, "board 0 steals shard 5 of board 1");
+
+    // board 2 cannot run the shards of boards 0 and 1
+    check(queue.next(2, shard, stolen) && shard.shard_ind == 6 && !stolen, "board 2 takes its shard");
+    check(!queue.next(2, shard, stolen), "board 2 does not steal shards it cannot run");
+
+    // the shards of a board that leaves go to the boards that can run them
+    check(queue.retire(1).empty(), "the shards of board 1 are requeued");
+    for(uint expected : {1, 3}) {
+        check(queue.next(0, shard, stolen) && shard.shard_ind == expected && !stolen, "board 0 takes the requeued shard " + to_string(expected));
+    }
+    check(!queue.next(0, shard, stolen), "no shard is left");
+    check(!queue.next(1, shard, stolen), "a retired board gets no shards");
+
+    // shards that only a retired board can run are returned, and are not queued again
+    ShardQueue pinned(2);
+    pinned.push(make_shard(0, {1}));
+    pinned.push(make_shard(1, {0, 1}));
+    pinned.push(make_shard(2, {0, 1}));
+    std::vector<Shard> orphans = pinned.retire(1);
+    check(orphans.size() == 1 && orphans[0].shard_ind == 0, "the shard only board 1 can run is an orphan");
+    check(!pinned.push(make_shard(3, {1})), "a shard only a retired board can run is not queued");
+
+    uint num_taken = 0;
+    while(pinned.next(0, shard, stolen))
+        num_taken++;
+    check(num_taken == 2, "board 0 runs the shards it can run, got " + to_string(num_taken));
+}
+
+CampaignJob make_job(const std::string& name, const std::vector<std::string>& modules, const std::vector<int>& range, const uint shard_rows,
+                        const uint num_points = 0) {
+    CampaignJob job;
+    job.name = name;
+    job.tool = "RowHammerAttacker";
+    job.modules = modules;
+    job.range = range;
+    job.shard_rows = shard_rows;
+    for(uint i = 0; i < num_points; i++)
+        job.points.push_back({"--hammers_per_ref_loop", to_string(i)});
+
+    return job;
+}
+
+Campaign make_campaign(const std::vector<std::string>& modules) {
+    Campaign campaign;
+    for(auto& module : modules) {
+        CampaignBoard board;
+        board.module = module;
+        campaign.boards.push_back(board);
+    }
+
+    return campaign;
+}
+
+void test_make_shards() {
+    Campaign campaign = make_campaign({"A1", "A2"});
+    campaign.jobs.push_back(make_job("sweep", {"A1", "A2"}, {0, 32767}, 4096));
+    campaign.jobs.push_back(make_job("points", {"A2"}, {}, 0, 3));
+    campaign.jobs.push_back(make_job("any", {}, {}, 0, 4));
+
+    ShardQueue queue(campaign.boards.size());
+    uint num_shards;
+    check(make_shards(campaign, queue, num_shards).empty(), "the campaign is split into shards");
+    check(num_shards == 2*8 + 3 + 4, "the campaign has 23 shards, got " + to_string(num_shards));
+
+    // each module is swept over the whole range, and its shards only run on its board
+    for(uint b = 0; b < campaign.boards.size(); b++) {
+        std::vector<uint> swept(32768, 0);
+        uint num_points = 0;
+
+        Shard shard;
+        bool stolen;
+        while(queue.next(b, shard, stolen)) {
+            const std::string& job = campaign.jobs[shard.job_ind].name;
+            check(shard.eligible_boards.size() == (job == "any" ? 2 : 1), job + " shards run on " + (job == "any" ? "any board" : "the board of their module"));
+
+            if(job == "points")
+                num_points++;
+
+            if(job != "sweep")
+                continue;
+
+            check(!stolen && shard.args.size() == 3 && shard.args[0] == "--range", "sweep shards pass --range and are not stolen");
+            for(int row = stoi(shard.args[1]); row <= stoi(shard.args[2]); row++)
+                swept[row]++;
+        }
+
+        check(std::all_of(swept.begin(), swept.end(), [](const uint s) { return s == 1; }), campaign.boards[b].module + " is swept over the whole range, each row once");
+        check(num_points == (b == 1 ? 3 : 0), "only A2 runs the points of its job");
+    }
+
+    Campaign missing = make_campaign({"A1"});
+    missing.jobs.push_back(make_job("sweep", {"A1", "A3"}, {0, 1023}, 256));
+    ShardQueue missing_queue(1);
+    check(!make_shards(missing, missing_queue, num_shards).empty(), "a job with a module no board holds is rejected");
+}
+
+// runs the Orchestrator with --mock on the campaign and returns the lines of its results file
+int run_mock_campaign(const std::string& s_campaign, std::vector<ShardResult>& results) {
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("utrr_orchestrator_test_%%%%%%%%");
+    boost::filesystem::create_directories(dir);
+
+    std::string campaign_filename = (dir / "campaign.json").string();
+    std::ofstream(campaign_filename) << s_campaign;
+
+    std::vector<std::string> args = {"Orchestrator", "--campaign", campaign_filename, "--out_dir", (dir / "out").string(), "--mock",
+                                        "--mock_shard_ms", "1", "--modules_info", (dir / "none.csv").string()};
+    std::vector<char*> argv;
+    for(auto& arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    // the progress of the campaign, and the errors the tests cause on purpose, are not part of the test output
+    std::streambuf* cout_buf = std::cout.rdbuf();
+    std::streambuf* cerr_buf = std::cerr.rdbuf();
+    std::stringstream campaign_out;
+    std::cout.rdbuf(campaign_out.rdbuf());
+    std::cerr.rdbuf(campaign_out.rdbuf());
+    int ret = orchestrator_main(argv.size() - 1, argv.data());
+    std::cout.rdbuf(cout_buf);
+    std::cerr.rdbuf(cerr_buf);
+
+    std::ifstream f_results((dir / "out" / "results.json").string());
+    std::string line;
+    while(getline(f_results, line)) {
+        ShardResult result;
+        JS::ParseContext context(line);
+        check(context.parseTo(result) == JS::Error::NoError, "the results file has a valid line: " + line);
+        results.push_back(result);
+    }
+
+    boost::filesystem::remove_all(dir);
+    return ret;
+}
+
+uint count_results(const std::vector<ShardResult>& results, const std::string& job, const std::string& module, const uint shard_ind) {
+    return std::count_if(results.begin(), results.end(), [&](const ShardResult& r) {
+        return r.job == job && r.module == module && r.shard == shard_ind;
+    });
+}
+
+void test_mock_stealing() {
+    // A1 is much faster than A2, so it steals the shards of the job without modules, but not the sweep shards of A2
+    std::vector<ShardResult> results;
+    int ret = run_mock_campaign(R"({
+        "boards" : [ { "module" : "A1", "mock_shard_ms" : 1 }, { "module" : "A2", "mock_shard_ms" : 50 } ],
+        "jobs" : [
+            { "name" : "sweep", "tool" : "RowHammerAttacker", "modules" : ["A1", "A2"], "range" : [0, 1023], "shard_rows" : 256 },
+            { "name" : "any", "tool" : "RowScout", "points" : [ ["--bank", "0"], ["--bank", "1"], ["--bank", "2"], ["--bank", "3"] ] }
+        ]
+    })", results);
+
+    check(ret == 0, "the mock campaign finishes");
+    check(results.size() == 2*4 + 4, "every shard has a result, got " + to_string(results.size()));
+
+    for(uint i = 0; i < 4; i++) {
+        check(count_results(results, "sweep", "A1", i) == 1 && count_results(results, "sweep", "A2", i) == 1,
+                "sweep shard " + to_string(i) + " runs on both modules");
+        check(count_results(results, "any", "A1", i) + count_results(results, "any", "A2", i) == 1, "shard " + to_string(i) + " of any runs once");
+    }
+
+    uint stolen_by_A1 = std::count_if(results.begin(), results.end(), [](const ShardResult& r) { return r.stolen && r.module == "A1"; });
+    check(stolen_by_A1 > 0, "A1 steals shards from A2");
+    check(std::none_of(results.begin(), results.end(), [](const ShardResult& r) { return r.stolen && r.job == "sweep"; }), "no sweep shard is stolen");
+}
+
+void test_mock_retire() {
+    // A1 leaves after two shards: its other sweep shards cannot run anywhere else, and the shards of the job without modules are
+    // requeued on A2
+    std::vector<ShardResult> results;
+    int ret = run_mock_campaign(R"({
+        "boards" : [ { "module" : "A1", "mock_shards" : 2 }, { "module" : "A2", "mock_shard_ms" : 5 } ],
+        "jobs" : [
+            { "name" : "sweep", "tool" : "RowHammerAttacker", "modules" : ["A1", "A2"], "range" : [0, 1023], "shard_rows" : 256 },
+            { "name" : "any", "tool" : "RowScout", "points" : [ ["--bank", "0"], ["--bank", "1"], ["--bank", "2"], ["--bank", "3"] ] }
+        ]
+    })", results);
+
+    check(ret != 0, "the campaign fails when shards are left that no board can run");
+
+    for(uint i = 0; i < 4; i++) {
+        check(count_results(results, "sweep", "A1", i) == (i < 2 ? 1 : 0), "A1 runs sweep shard " + to_string(i) + " only before it leaves");
+        check(count_results(results, "sweep", "A2", i) == 1, "A2 runs sweep shard " + to_string(i));
+        check(count_results(results, "any", "A2", i) == 1, "shard " + to_string(i) + " of any is requeued on A2");
+    }
+}
+
+int main()
+{
+    test_shard_queue();
+    test_make_shards();
+    test_mock_stealing();
+    test_mock_retire();
+
+    if(num_failed > 0) {
+        std::cerr << RED_TXT << num_failed << " of " << num_checks << " checks failed" << NORMAL_TXT << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN_TXT << "All " << num_checks << " checks passed" << NORMAL_TXT << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "instruction.h"
+#include "prog.h"
+#include "platform.h"
+#include "tools/softmc_session.h"
+#include "tools/row_group_pipeline.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <thread>
+
+#include <dlfcn.h>
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define GREEN_TXT "\033[32m"
+#define NORMAL_TXT "\033[0m"
+
+// Runs RowScout and TRR Analyzer in the same process on one board. TRR Analyzer picks row groups as soon as RowScout verifies them,
+// instead of waiting for RowScout to find all of them and for the operator to start TRR Analyzer (see tools/row_group_pipeline.h).
+// RowScout still writes every row group it finds to its output file, so the experiment can be reproduced from the file later on.
+// The tools are loaded from <tool_dir>/<tool>/lib<tool>.so (build them with 'make lib')
+
+typedef struct PipelineTool {
+    string name;
+    UTRRToolMainFn main;
+    UTRRSetRowGroupQueueFn set_queue;
+} PipelineTool;
+
+bool load_tool(const string& tool_dir, const string& name, PipelineTool& tool) {
+    string lib_path = tool_dir + "/" + name + "/lib" + name + ".so";
+
+    // RTLD_LOCAL keeps the globals of the tools (e.g., NUM_ROWS, the row mapping) separate from each other
+    void* lib = dlopen(lib_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(lib == nullptr) {
+        cerr << RED_TXT << "ERROR: Could not load " << lib_path << ": " << dlerror() << ". Run 'make lib' in the " << name << " directory." << NORMAL_TXT << endl;
+        return false;
+    }
+
+    tool.name = name;
+    tool.main = (UTRRToolMainFn) dlsym(lib, UTRR_TOOL_MAIN_SYMBOL);
+    tool.set_queue = (UTRRSetRowGroupQueueFn) dlsym(lib, UTRR_SET_ROW_GROUP_QUEUE_SYMBOL);
+
+    if(tool.main == nullptr || tool.set_queue == nullptr) {
+        cerr << RED_TXT << "ERROR: " << lib_path << " does not export " << UTRR_TOOL_MAIN_SYMBOL << " and " << UTRR_SET_ROW_GROUP_QUEUE_SYMBOL << NORMAL_TXT << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int run_tool(const PipelineTool& tool, SoftMCPlatform& platform, const string& s_args, const vector<string>& extra_args) {
+    vector<string> args;
+    args.push_back(tool.name);
+    for(auto& arg : split_unix(s_args))
+        args.push_back(arg);
+    args.insert(args.end(), extra_args.begin(), extra_args.end());
+
+    vector<char*> argv;
+    for(auto& arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    return tool.main(&platform, argv.size() - 1, argv.data());
+}
+
+int main(int argc, char** argv)
+{
+    string tool_dir = "..";
+    string row_scout_out = "";
+    string row_scout_args = "";
+    string trr_analyzer_args = "";
+
+    options_description desc("Pipeline Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("tool_dir", value(&tool_dir)->default_value(tool_dir), "Specifies the directory that contains the RowScout and TRRAnalyzer directories. The tools must be built with 'make lib'.")
+        ("row_scout_out", value(&row_scout_out)->required(), "Specifies the output file of RowScout (passed to RowScout as --out and to TRR Analyzer as --row_scout_file). The extension of the file determines the row layout of TRR Analyzer unless --row_layout is passed to it.")
+        ("row_scout_args", value(&row_scout_args), "Specifies the arguments of RowScout as a single string, e.g., \"--bank 1 --row_group_pattern R-R --num_row_groups 16\". RowScout stops as soon as TRR Analyzer has picked its row groups.")
+        ("trr_analyzer_args", value(&trr_analyzer_args), "Specifies the arguments of TRR Analyzer as a single string. TRR Analyzer picks --num_row_groups hammerable row groups from the ones RowScout finds, in the order RowScout finds them. --row_group_indices is not supported.")
+        ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+
+    notify(vm);
+
+    PipelineTool row_scout, trr_analyzer;
+    if(!load_tool(tool_dir, "RowScout", row_scout) || !load_tool(tool_dir, "TRRAnalyzer", trr_analyzer))
+        return -1;
+
+    SoftMCPlatform platform;
+    int err;
+    if((err = init_softmc_platform(platform)) != SOFTMC_SUCCESS)
+        return err;
+
+    RowGroupQueue queue;
+    row_scout.set_queue(&queue);
+    trr_analyzer.set_queue(&queue);
+
+    int row_scout_ret = 0;
+    thread row_scout_thread([&]() {
+        row_scout_ret = run_tool(row_scout, platform, row_scout_args, {"--out", row_scout_out});
+
+        // lets TRR Analyzer know that no more row groups will arrive
+        queue.close();
+    });
+
+    int trr_analyzer_ret = run_tool(trr_analyzer, platform, trr_analyzer_args, {"--row_scout_file", row_scout_out});
+
+    // TRR Analyzer may have returned before picking row groups (e.g., when resuming)
+    queue.stop();
+    row_scout_thread.join();
+
+    if(row_scout_ret != 0) {
+        cerr << RED_TXT << "ERROR: RowScout exited with " << row_scout_ret << NORMAL_TXT << endl;
+        return row_scout_ret;
+    }
+
+    if(trr_analyzer_ret != 0) {
+        cerr << RED_TXT << "ERROR: TRR Analyzer exited with " << trr_analyzer_ret << NORMAL_TXT << endl;
+        return trr_analyzer_ret;
+    }
+
+    cout << GREEN_TXT << "The pipeline has finished!" << NORMAL_TXT << endl;
+
+    return trr_analyzer_ret;
+}
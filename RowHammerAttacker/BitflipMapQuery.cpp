@@ -0,0 +1,156 @@
+#include "tools/bitflip_map.h"
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <limits>
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using namespace std;
+
+#define RED_TXT "\033[31m"
+#define NORMAL_TXT "\033[0m"
+
+// Inspects the bitflip maps RowHammerAttacker writes with --output_format binary
+int main(int argc, char** argv)
+{
+    string map_filename;
+    vector<uint> row_range;
+    bool print_info = false;
+    bool print_rows = false;
+    bool print_total = false;
+    uint heatmap_row_bucket = 0;
+
+    options_description desc("BitflipMapQuery Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("map,m", value(&map_filename), "Specifies the bitflip map to query.")
+        ("range", value<vector<uint>>(&row_range)->multitoken(), "Restricts the query to a range of anchor rows (start and end values are both inclusive). The whole map is queried when --range is not provided.")
+        ("info", bool_switch(&print_info), "Prints the configuration the map was produced with and a summary of its contents.")
+        ("rows", bool_switch(&print_rows), "Prints the bitflip counts of each row in the same format as RowHammerAttacker's text output.")
+        ("total", bool_switch(&print_total), "Prints the total number of bitflips.")
+        ("heatmap", value(&heatmap_row_bucket), "Prints a CSV heatmap of bitflips where each line sums the chunk counts of the specified number of consecutive anchor rows.")
+        ;
+
+    positional_options_description pos_desc;
+    pos_desc.add("map", 1);
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(desc).positional(pos_desc).run(), vm);
+    notify(vm);
+
+    if (vm.count("help") || map_filename.empty()) {
+        cout << "Usage: BitflipMapQuery <map> [--info] [--rows] [--total] [--heatmap <rows>] [--range <first> <last>]" << endl;
+        cout << desc << endl;
+        return vm.count("help") ? 0 : -1;
+    }
+
+    BitflipMapReader reader;
+    string error = reader.open(map_filename);
+    if (!error.empty()) {
+        cerr << RED_TXT << "ERROR: " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    if (reader.is_recovered())
+        cerr << "Warning: " << map_filename << " has no index, the run that wrote it did not finish. Only its complete blocks are read" << endl;
+
+    const BitflipMapHeader& header = reader.get_header();
+
+    uint32_t first_row = 0;
+    uint32_t last_row = numeric_limits<uint32_t>::max();
+    if (row_range.size() == 2) {
+        first_row = min(row_range[0], row_range[1]);
+        last_row = max(row_range[0], row_range[1]);
+    } else if (!row_range.empty()) {
+        cerr << RED_TXT << "ERROR: --range must specify exactly two tokens. E.g., <--range 0 5>" << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    if (!print_rows && !print_total && heatmap_row_bucket == 0)
+        print_info = true;
+
+    if (print_info) {
+        uint64_t num_rows = 0, total = 0;
+        for (auto& block : reader.get_blocks()) {
+            num_rows += block.num_rows;
+            total += block.total_bitflips;
+        }
+
+        cout << "Command line:      " << header.config << endl;
+        cout << "Bank:              " << header.bank << endl;
+        cout << "Anchor rows:       " << header.first_row << " - " << header.last_row << endl;
+        cout << "Row layout:        " << header.row_layout << " (" << header.num_victims << " victims)" << endl;
+        cout << "Chunks per victim: " << header.chunks_per_victim;
+        if (header.chunk_bytes > 0)
+            cout << " (" << header.chunk_bytes << " bytes each)";
+        cout << endl;
+        cout << "Rows w/ bitflips:  " << num_rows << " in " << reader.get_blocks().size() << " blocks" << endl;
+        cout << "Total bitflips:    " << total << endl;
+    }
+
+    bool ok = true;
+
+    if (print_rows) {
+        ok &= reader.for_each_row(first_row, last_row, [&](uint32_t anchor_row, const uint32_t* chunk_counts) {
+            cout << setw(5) << anchor_row << ": ";
+            for (uint32_t i = 0; i < reader.num_chunks(); i++)
+                cout << chunk_counts[i] << " ";
+            cout << endl;
+        });
+    }
+
+    if (print_total) {
+        uint64_t total;
+        ok &= reader.total_bitflips(first_row, last_row, total);
+        cout << total << endl;
+    }
+
+    if (heatmap_row_bucket > 0) {
+        vector<uint64_t> bucket_counts(reader.num_chunks(), 0);
+        uint32_t cur_bucket = 0;
+        bool bucket_empty = true;
+
+        auto print_bucket = [&]() {
+            cout << cur_bucket*heatmap_row_bucket;
+            for (auto count : bucket_counts)
+                cout << "," << count;
+            cout << endl;
+        };
+
+        // header: the first anchor row of the bucket, then a column per victim chunk
+        cout << "anchor_row";
+        for (uint32_t v = 0; v < header.num_victims; v++)
+            for (uint32_t c = 0; c < header.chunks_per_victim; c++)
+                cout << ",v" << v << "_c" << c;
+        cout << endl;
+
+        ok &= reader.for_each_row(first_row, last_row, [&](uint32_t anchor_row, const uint32_t* chunk_counts) {
+            uint32_t bucket = anchor_row/heatmap_row_bucket;
+
+            if (bucket != cur_bucket && !bucket_empty) {
+                print_bucket();
+                fill(bucket_counts.begin(), bucket_counts.end(), 0);
+            }
+
+            cur_bucket = bucket;
+            bucket_empty = false;
+
+            for (uint32_t i = 0; i < reader.num_chunks(); i++)
+                bucket_counts[i] += chunk_counts[i];
+        });
+
+        if (!bucket_empty)
+            print_bucket();
+    }
+
+    if (!ok) {
+        cerr << RED_TXT << "ERROR: " << map_filename << " is corrupted" << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    return 0;
+}
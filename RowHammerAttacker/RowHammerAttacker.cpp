@@ -4,7 +4,12 @@
 #include "platform.h"
 
 #include "tools/perfect_hash.h"
+#include "tools/softmc_session.h"
+#include "tools/hammer_pattern.h"
+#include "tools/bitflip_map.h"
 #include "tools/ProgressBar.hpp"
+#include "tools/metrics.h"
+#include "tools/buffer_arena.h"
 
 #include <string>
 #include <fstream>
@@ -14,6 +19,7 @@
 #include <cassert>
 #include <bitset>
 #include <chrono>
+#include <future>
 
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
@@ -60,9 +66,14 @@ float DEFAULT_TWR = 15.0f; // ns
 float DEFAULT_TRFC = 260.0f; // ns
 float DEFAULT_TRRDS = 5.3f; // ns (ACT-ACT to different bank groups)
 float DEFAULT_TRRDL = 6.4f; // ns (ACT-ACT to same bank group)
+float DEFAULT_TFAW = 21.0f; // ns (four ACT window, 1KB page size)
 float DEFAULT_TREFI = 7800.0f;
 /******/
 
+/*** SoftMC Parameters - UPDATE if the instruction memory of your DRAM Bender design differs ***/
+#define SOFTMC_MAX_PROG_INSTS 8192u
+/******/
+
 int trcd_cycles = (int) ceil(DEFAULT_TRCD/FPGA_PERIOD);
 int tras_cycles = (int) ceil(DEFAULT_TRAS/FPGA_PERIOD);
 int trp_cycles = (int) ceil(DEFAULT_TRP/FPGA_PERIOD);
@@ -71,6 +82,7 @@ int trfc_cycles = (int) ceil(DEFAULT_TRFC/FPGA_PERIOD);
 int trrds_cycles = (int) ceil(DEFAULT_TRRDS/FPGA_PERIOD);
 int trrdl_cycles = (int) ceil(DEFAULT_TRRDL/FPGA_PERIOD);
 int trefi_cycles = (int) ceil(DEFAULT_TREFI/FPGA_PERIOD);
+int tfaw_cycles = (int) ceil(DEFAULT_TFAW/FPGA_PERIOD);
 
 // TRR Attacker Parameters
 const uint DUMMY_ROW_DIST = 2; // the minimum row distance between two dummy rows
@@ -116,14 +128,12 @@ void checkForLeftoverPCIeData(SoftMCPlatform& platform) {
     // checking if there is more data to receive
     uint additional_bytes = 0;
 
-    char* buf = new char[4];
+    ArenaBuffer buf = receive_buffers.acquire(4);
 
-    while (additional_bytes += platform.receiveData(buf, 4)) { // try to receive 4 bytes
+    while (additional_bytes += drain_data(platform, buf.data(), 4)) { // try to receive 4 bytes
         cout << "Received total of " << additional_bytes << " additional bytes" << endl;
-        cout << "Data: " << *(int*)buf << endl;
+        cout << "Data: " << *(int*)buf.data() << endl;
     }
-
-    delete[] buf;
 }
 
 bitset<512> setup_data_pattern(const uint data_pattern_type) {
@@ -163,41 +173,36 @@ bitset<512> setup_data_pattern(const uint data_pattern_type) {
 }
 
 // last_row_id is inclusive
-void init_data_row_range(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void init_data_row_range(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
     const uint first_row_id, const uint last_row_id, const bitset<512>& data_patt) {
 
     uint initial_free_regs = reg_alloc.num_free_regs();
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
-
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each WRITE writes 8 columns
+    prog.add_li(8, CASR); // Load 8 into CASR since each WRITE writes 8 columns
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
 
     SMC_REG reg_last_row_id = reg_alloc.allocate_SMC_REG();
-    prog.add_inst(SMC_LI(first_row_id, reg_row_addr));
-    prog.add_inst(SMC_LI(last_row_id + 1, reg_last_row_id)); // +1 because we don't have BL_TYPE::BLE
+    prog.add_li(first_row_id, reg_row_addr);
+    prog.add_li(last_row_id + 1, reg_last_row_id); // +1 because we don't have BL_TYPE::BLE
 
     // initialize the wide register that contains data to write to DRAM
     SMC_REG reg_wrdata = reg_alloc.allocate_SMC_REG();
-    for (int pos = 0; pos < 16; pos++) {
-        prog.add_inst(SMC_LI((((data_patt >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), reg_wrdata));
-        prog.add_inst(SMC_LDWD(reg_wrdata, pos));
-    }
+    load_wide_data(prog, reg_wrdata, data_patt);
 
     std::string lbl_init_row_it = createSMCLabel("INIT_ROW_IT");
     prog.add_label(lbl_init_row_it);
         // activate the target row
-        uint remaining = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 1), 0, trcd_cycles - 5);
+        uint remaining = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 1), 0, trcd_cycles - 5, {reg_row_addr});
 
         // write data to the row and precharge
-        add_op_with_delay(prog, SMC_LI(0, reg_col_addr), remaining, 0);
+        add_li_with_delay(prog, 0, reg_col_addr, remaining, 0);
 
         string new_lbl = createSMCLabel("INIT_ROW");
         prog.add_label(new_lbl);
             uint unroll_factor = 16;
             for(uint i_unroll = 0; i_unroll < unroll_factor; i_unroll++){
-                add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0);
+                add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0, {reg_col_addr});
             }
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, new_lbl);
         
@@ -233,14 +238,12 @@ void toLogicalRowIDs(std::vector<uint>& row_ids) {
     }
 }
 
-void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void init_row_data(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
     const vector<LogicalRowID>& rows_to_init, const vector<bitset<512>>& data_patts) {
 
     uint initial_free_regs = reg_alloc.num_free_regs();
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
-
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each WRITE writes 8 columns
+    prog.add_li(8, CASR); // Load 8 into CASR since each WRITE writes 8 columns
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
 
@@ -248,15 +251,12 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
     for(uint i = 0; i < rows_to_init.size(); i++){
         uint target_row = rows_to_init[i];
 
-        prog.add_inst(SMC_LI(target_row, reg_row_addr));
+        prog.add_li(target_row, reg_row_addr);
 
         if(i == 0 || data_patts[i-1] != data_patts[i]) {
             // set up the input data in the wide register
             SMC_REG reg_wrdata = reg_alloc.allocate_SMC_REG();
-            for (int pos = 0; pos < 16; pos++) {
-                prog.add_inst(SMC_LI((((data_patts[i] >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), reg_wrdata));
-                prog.add_inst(SMC_LDWD(reg_wrdata, pos));
-            }
+            load_wide_data(prog, reg_wrdata, data_patts[i]);
             reg_alloc.free_SMC_REG(reg_wrdata);
         }
 
@@ -264,11 +264,11 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
         uint remaining = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, trcd_cycles - 5);
 
         // write data to the row and precharge
-        add_op_with_delay(prog, SMC_LI(0, reg_col_addr), remaining, 0);
+        add_li_with_delay(prog, 0, reg_col_addr, remaining, 0);
 
         string new_lbl = createSMCLabel("INIT_ROW");
         prog.add_label(new_lbl);
-        add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0);
+        add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0, {reg_col_addr});
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, new_lbl);
         
         // precharge the open bank
@@ -281,24 +281,24 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
     assert(reg_alloc.num_free_regs() == initial_free_regs);
 }
 
-void perform_refresh(Program& prog, SoftMCRegAllocator& reg_alloc, const uint num_refs_per_cycle,
+void perform_refresh(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const uint num_refs_per_cycle,
                         const uint pre_ref_delay, const bool fake_ref) {
 
     SMC_REG reg_num_refs_per_cycle = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_it_refs_per_cycle = reg_alloc.allocate_SMC_REG();
 
-    prog.add_inst(SMC_LI(num_refs_per_cycle, reg_num_refs_per_cycle));
-    prog.add_inst(SMC_LI(0, reg_it_refs_per_cycle));
+    prog.add_li(num_refs_per_cycle, reg_num_refs_per_cycle);
+    prog.add_li(0, reg_it_refs_per_cycle);
 
     if (pre_ref_delay >= 8) {
-        prog.add_inst(SMC_SLEEP(std::ceil(pre_ref_delay/4.0f)));
+        prog.add_sleep(std::ceil(pre_ref_delay/4.0f));
     }
 
     std::string lbl_issue_per_cycle_refs = createSMCLabel("PER_CYCLE_REFS");
     prog.add_label(lbl_issue_per_cycle_refs);    
         add_op_with_delay(prog, fake_ref ? SMC_NOP() : SMC_REF(), 0, 0);
-        add_op_with_delay(prog, SMC_SLEEP(ceil((trfc_cycles - 1 - 24 - 4)/4.0f)), 0, 0);
-        add_op_with_delay(prog, SMC_ADDI(reg_it_refs_per_cycle, 1, reg_it_refs_per_cycle), 0, 0);
+        add_sleep_with_delay(prog, ceil((trfc_cycles - 1 - 24 - 4)/4.0f), 0, 0);
+        prog.add_addi(reg_it_refs_per_cycle, 1, reg_it_refs_per_cycle);
     prog.add_branch(prog.BR_TYPE::BL, reg_it_refs_per_cycle, reg_num_refs_per_cycle, lbl_issue_per_cycle_refs);
 
     reg_alloc.free_SMC_REG(reg_num_refs_per_cycle);
@@ -310,7 +310,7 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs) {
     if (num_refs == 0) // do nothing if no REFs are to be performed
         return;
 
-    Program prog;
+    SoftMCProgram prog;
     SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
 
     add_op_with_delay(prog, SMC_PRE(5, 0, 1), 0, 0); // precharge all banks
@@ -318,20 +318,125 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs) {
     perform_refresh(prog, reg_alloc, num_refs, 0, 0);
     prog.add_inst(SMC_END());
 
-    platform.execute(prog);
+    execute_program(platform, prog);
     #ifdef PRINT_SOFTMC_PROGS
     prog.pretty_print();
     #endif
 }
 
-void perform_hammers(Program& prog, SoftMCRegAllocator& reg_alloc, SMC_REG reg_bank_addr, const std::vector<LogicalRowID> rows_to_hammer, 
-                        const std::vector<uint>& num_hammers, const uint num_aggressors, const uint aggr_bank_id,
+// the bank group bits are the low bits of the SoftMC bank address
+int bank_group(int bank) {
+    return bank % NUM_BANK_GROUPS;
+}
+
+bool in_same_bg(int bank1, int bank2) {
+    return bank_group(bank1) == bank_group(bank2);
+}
+
+// The cycles between consecutive ACTs when activating a row in each of 'banks' (in order) at the tightest spacing
+// tRRD_S, tRRD_L, and tFAW allow. gaps[i] is the distance between the ACTs to banks[i-1] and banks[i], and gaps[0] is 0.
+// add_op_with_delay() puts consecutive ACTs into different instructions, so they are at least an instruction apart. Without a
+// register dedicated to each bank, each ACT is preceded by an LI that sets the bank address, which takes another instruction
+std::vector<int> multiBankACTGaps(const std::vector<uint>& banks, const bool dedicated_bank_regs) {
+    const int MIN_GAP = dedicated_bank_regs ? SOFTMC_INST_CYCLES : 2*SOFTMC_INST_CYCLES;
+
+    std::vector<int> act_times(banks.size(), 0);
+    std::vector<int> gaps(banks.size(), 0);
+
+    for(uint i = 1; i < banks.size(); i++) {
+        int rrd = in_same_bg(banks[i - 1], banks[i]) ? trrdl_cycles : trrds_cycles;
+        act_times[i] = act_times[i - 1] + std::max(rrd, MIN_GAP);
+
+        // at most four ACTs within a tFAW window
+        if(i >= 4)
+            act_times[i] = std::max(act_times[i], act_times[i - 4] + tfaw_cycles);
+
+        gaps[i] = act_times[i] - act_times[i - 1];
+    }
+
+    return gaps;
+}
+
+// Activates the row in reg_row_addr in all 'banks' one after another. The last ACT is followed by 'after' cycles.
+// reg_banks[i] holds banks[i] if registers are dedicated to the banks. Otherwise, reg_banks is empty and each ACT is preceded
+// by an LI that loads its bank into reg_bank_addr. The caller precharges all banks. A row is hammered at least tRAS + tRP apart,
+// which is longer than tFAW, so only the ACTs of a single call need to be spaced
+int activate_in_banks(SoftMCProgram& prog, const SMC_REG reg_bank_addr, const std::vector<SMC_REG>& reg_banks, const SMC_REG reg_row_addr,
+                        const std::vector<uint>& banks, int remaining_cycs, const int after, const bool fake_hammer) {
+
+    const bool dedicated = !reg_banks.empty();
+    const int li_cycles = dedicated ? 0 : SOFTMC_INST_CYCLES;
+    auto gaps = multiBankACTGaps(banks, dedicated);
+
+    for(uint i = 0; i < banks.size(); i++) {
+        if(!dedicated)
+            prog.add_li(banks[i], reg_bank_addr);
+
+        SMC_REG reg_bank = dedicated ? reg_banks[i] : reg_bank_addr;
+        int act_after = (i + 1 < banks.size()) ? gaps[i + 1] - 1 - li_cycles : after;
+        remaining_cycs = add_op_with_delay(prog, fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank, 0, reg_row_addr, 0), remaining_cycs, act_after);
+    }
+
+    return remaining_cycs;
+}
+
+// perform_hammers() dedicates a register to each attack bank when it hammers more than one bank and there are enough free
+// registers, so that the ACTs to the banks are not separated by bank address loads.
+// Returns the number of registers to dedicate, or zero if they do not fit into num_free_regs
+uint dedicatedBankRegs(const uint num_aggr_banks, const uint num_free_regs) {
+    return (num_aggr_banks > 1 && num_aggr_banks <= num_free_regs) ? num_aggr_banks : 0;
+}
+
+// perform_hammers() keeps each row address and each dummy bank ID in a dedicated register when there are enough free registers.
+// The loads in the hammer loops then write the value the register already holds, and SoftMCProgram::lower() removes them.
+// Returns the number of registers to dedicate, or zero if they do not fit into num_free_regs
+uint dedicatedHammerRegs(const uint num_rows, const uint num_aggressors, const uint num_dummy_banks, const uint num_free_regs) {
+    uint num_regs = num_rows + (num_rows > num_aggressors ? num_dummy_banks : 0);
+    return num_regs <= num_free_regs ? num_regs : 0;
+}
+
+// The number of free registers perform_hammers() sees when hammer_aggressors() calls it. All registers except the reserved ones, 
+// reg_bank_addr and reg_num_cols of buildHammerBatch(), the two of hammer_aggressors(), and the three perform_hammers() allocates itself
+uint hammerCallFreeRegs() {
+    return NUM_SOFTMC_REGS - reserved_regs.size() - 7;
+}
+
+void perform_hammers(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, SMC_REG reg_bank_addr, const std::vector<LogicalRowID> rows_to_hammer, 
+                        const std::vector<uint>& num_hammers, const uint num_aggressors, const std::vector<uint>& aggr_banks,
                         const bool cascaded_hammer, const std::vector<uint> dummy_banks, const bool fake_hammer, const bool fake_dummy_hammer){
 
     SMC_REG reg_cur_hammers = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_num_hammers = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
 
+    // all rows share reg_row_addr and all dummy banks share reg_bank_addr unless there are enough registers to dedicate one to each
+    std::vector<SMC_REG> reg_rows(rows_to_hammer.size(), reg_row_addr);
+    std::vector<SMC_REG> reg_dummy_banks(dummy_banks.size(), reg_bank_addr);
+    std::vector<SMC_REG> reg_aggr_banks;
+    std::vector<SMC_REG> dedicated_regs;
+
+    if(dedicatedBankRegs(aggr_banks.size(), reg_alloc.num_free_regs()) > 0) {
+        for(uint i = 0; i < aggr_banks.size(); i++) {
+            reg_aggr_banks.push_back(reg_alloc.allocate_SMC_REG());
+            prog.add_li(aggr_banks[i], reg_aggr_banks[i]);
+            dedicated_regs.push_back(reg_aggr_banks[i]);
+        }
+    }
+
+    if(dedicatedHammerRegs(rows_to_hammer.size(), num_aggressors, dummy_banks.size(), reg_alloc.num_free_regs()) > 0) {
+        for(uint i = 0; i < rows_to_hammer.size(); i++) {
+            reg_rows[i] = reg_alloc.allocate_SMC_REG();
+            prog.add_li(rows_to_hammer[i], reg_rows[i]);
+            dedicated_regs.push_back(reg_rows[i]);
+        }
+
+        for(uint i = 0; i < dummy_banks.size() && rows_to_hammer.size() > num_aggressors; i++) {
+            reg_dummy_banks[i] = reg_alloc.allocate_SMC_REG();
+            prog.add_li(dummy_banks[i], reg_dummy_banks[i]);
+            dedicated_regs.push_back(reg_dummy_banks[i]);
+        }
+    }
+
     uint remaining_cycs = 0;
 
     if(!cascaded_hammer){
@@ -357,8 +462,8 @@ void perform_hammers(Program& prog, SoftMCRegAllocator& reg_alloc, SMC_REG reg_b
             uint min_elem = *min_non_zero;
 
             // perform hammering
-            prog.add_inst(SMC_LI(min_elem, reg_num_hammers));
-            prog.add_inst(SMC_LI(0, reg_cur_hammers));
+            prog.add_li(min_elem, reg_num_hammers);
+            prog.add_li(0, reg_cur_hammers);
             std::string lbl_rh = createSMCLabel("ROWHAMMERING");
             prog.add_label(lbl_rh);
             for (int ind_row = 0; ind_row < rows_to_hammer.size(); ind_row++) {
@@ -366,7 +471,7 @@ void perform_hammers(Program& prog, SoftMCRegAllocator& reg_alloc, SMC_REG reg_b
                     continue;
 
                 int row_id = rows_to_hammer[ind_row];
-                prog.add_inst(SMC_LI(row_id, reg_row_addr));
+                prog.add_li(row_id, reg_rows[ind_row]);
 
                 // take into account fake_dummy_hammer for the dummy rows. Dummy rows follow the aggressor rows in the rows_to_hammer vector
                 bool n_fake_hammer = ind_row >= num_aggressors ? fake_hammer | fake_dummy_hammer : fake_hammer;
@@ -374,20 +479,23 @@ void perform_hammers(Program& prog, SoftMCRegAllocator& reg_alloc, SMC_REG reg_b
                 if(ind_row >= num_aggressors) { // hammering a dummy aggressor row
                     // hammer the same dummy row in all dummy_banks
                     const uint RRD_CYCLES = 5; // the spec says 6.4ns when activating rows in the same bank group. 5*1.5ns = 7.5ns
-                    for(auto dummy_bank_id : dummy_banks){
-                        prog.add_inst(SMC_LI(dummy_bank_id, reg_bank_addr));
-                        remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), remaining_cycs, RRD_CYCLES - 1 - 4);
+                    for(uint i = 0; i < dummy_banks.size(); i++){
+                        prog.add_li(dummy_banks[i], reg_dummy_banks[i]);
+                        remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_dummy_banks[i], 0, reg_rows[ind_row], 0), remaining_cycs, RRD_CYCLES - 1 - 4);
                     }
 
-                    prog.add_inst(SMC_LI(aggr_bank_id, reg_bank_addr)); // reload the aggressors' bank ID
+                    prog.add_li(aggr_banks[0], reg_bank_addr); // reload the aggressors' bank ID
                     remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 1), tras_cycles - 5, 0); // precharge all banks
+                } else if(aggr_banks.size() > 1) { // hammering an aggressor row in all attack banks
+                    remaining_cycs = activate_in_banks(prog, reg_bank_addr, reg_aggr_banks, reg_rows[ind_row], aggr_banks, remaining_cycs, tras_cycles - 1, n_fake_hammer);
+                    remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 1), 0, trp_cycles - 5); // precharge all banks
                 } else { // hammering an aggressor row
-                    remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, tras_cycles - 1);
+                    remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_rows[ind_row], 0), 0, tras_cycles - 1);
                     remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 0), 0, trp_cycles - 5);
                 }
             }
 
-            prog.add_inst(SMC_ADDI(reg_cur_hammers, 1, reg_cur_hammers));
+            prog.add_addi(reg_cur_hammers, 1, reg_cur_hammers);
             prog.add_branch(Program::BR_TYPE::BL, reg_cur_hammers, reg_num_hammers, lbl_rh);
 
 
@@ -406,38 +514,44 @@ void perform_hammers(Program& prog, SoftMCRegAllocator& reg_alloc, SMC_REG reg_b
             // take into account fake_dummy_hammer for the dummy rows. Dummy rows follow the aggressor rows in the rows_to_hammer vector
             bool n_fake_hammer = ind_row >= num_aggressors ? fake_hammer | fake_dummy_hammer : fake_hammer;
 
-            prog.add_inst(SMC_LI(row_id, reg_row_addr));
-            prog.add_inst(SMC_LI(num_hammers[ind_row], reg_num_hammers));
-            prog.add_inst(SMC_LI(0, reg_cur_hammers));
+            prog.add_li(row_id, reg_rows[ind_row]);
+            prog.add_li(num_hammers[ind_row], reg_num_hammers);
+            prog.add_li(0, reg_cur_hammers);
 
             string lbl_rh = createSMCLabel("ROWHAMMERING");
             prog.add_label(lbl_rh);
 
-            prog.add_inst(SMC_ADDI(reg_cur_hammers, 0, reg_cur_hammers)); // Hasan: this is doing functionally nothing. 
+            prog.add_addi(reg_cur_hammers, 0, reg_cur_hammers); // Hasan: this is doing functionally nothing. 
                                                                           // I put it here to make the interleaved and cascaded hammering loops have the same latency. 
                                                                           // The reason is that these additional 4 cycles spent while the bank is precharged causes more bitflips (at least for Micron 'mic03').
 
             if(ind_row >= num_aggressors) { // hammering a dummy aggressor row
                 // hammer the same dummy row in all dummy_banks
                 const uint RRD_CYCLES = 5; // the spec says 6.4ns when activating rows in the same bank group. 5*1.5ns = 7.5ns
-                for(auto dummy_bank_id : dummy_banks){
-                    prog.add_inst(SMC_LI(dummy_bank_id, reg_bank_addr));
-                    remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), remaining_cycs, RRD_CYCLES - 1 - 4);
+                for(uint i = 0; i < dummy_banks.size(); i++){
+                    prog.add_li(dummy_banks[i], reg_dummy_banks[i]);
+                    remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_dummy_banks[i], 0, reg_rows[ind_row], 0), remaining_cycs, RRD_CYCLES - 1 - 4);
                 }
 
-                prog.add_inst(SMC_LI(aggr_bank_id, reg_bank_addr)); // reload the aggressors' bank ID
+                prog.add_li(aggr_banks[0], reg_bank_addr); // reload the aggressors' bank ID
                 remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 1), tras_cycles - 5, 0); // precharge all banks
 
+            } else if(aggr_banks.size() > 1) { // hammering an aggressor row in all attack banks
+                remaining_cycs = activate_in_banks(prog, reg_bank_addr, reg_aggr_banks, reg_rows[ind_row], aggr_banks, 0, tras_cycles - 1, n_fake_hammer);
+                remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
             } else { // hammering an aggressor row
-                remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, tras_cycles - 1);
+                remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_rows[ind_row], 0), 0, tras_cycles - 1);
                 remaining_cycs = add_op_with_delay(prog, n_fake_hammer ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 0), 0, 0);
             }
             remaining_cycs = 0;
-            prog.add_inst(SMC_ADDI(reg_cur_hammers, 1, reg_cur_hammers));
+            prog.add_addi(reg_cur_hammers, 1, reg_cur_hammers);
             prog.add_branch(Program::BR_TYPE::BL, reg_cur_hammers, reg_num_hammers, lbl_rh);
         }
     }
 
+    for(auto reg : dedicated_regs)
+        reg_alloc.free_SMC_REG(reg);
+
     reg_alloc.free_SMC_REG(reg_cur_hammers);
     reg_alloc.free_SMC_REG(reg_num_hammers);
     reg_alloc.free_SMC_REG(reg_row_addr);
@@ -509,14 +623,27 @@ uint scheduleHammersPerStep(std::vector<uint>& scheduled_rows_to_hammer, std::ve
     return scheduled_hammer_cnt;
 }
 
-void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const vector<uint>& aggressors,
-                        const std::vector<uint>& hammers_per_aggressor, const uint aggr_bank_id, const std::vector<LogicalRowID> dummy_rows, const uint hammers_per_dummy, 
-                        const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint> dummy_banks,
-                        const uint num_refs, const uint refs_per_loop, const bool trrref_sync, const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, 
-                        const bool fake_hammer = false, const bool fake_dummy_hammer = false, const bool fake_ref = false) {
-
+// a single perform_hammers() call
+typedef struct HammerCall {
+    std::vector<LogicalRowID> rows_to_hammer;
+    std::vector<uint> num_hammers;
+    uint num_aggressors;
+    bool cascaded_hammer;
+} HammerCall;
+
+// the hammers performed before issuing num_refs REF commands. A refresh loop consists of one such step, or refs_per_loop steps with --trrref_sync
+typedef struct RefreshStep {
+    std::vector<HammerCall> hammer_calls;
+    uint num_refs;
+} RefreshStep;
+
+// Determines what hammer_aggressors() hammers in a single refresh loop. hammer_aggressors() emits the plan as is, 
+// and refreshLoopCycles() uses the same plan to calculate how long a refresh loop takes
+std::vector<RefreshStep> planRefreshLoop(const vector<uint>& aggressors, const std::vector<uint>& hammers_per_aggressor, 
+                        const std::vector<LogicalRowID>& dummy_rows, const uint hammers_per_dummy, 
+                        const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after,
+                        const uint refs_per_loop, const bool trrref_sync, const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy) {
 
-    
     vector<uint> rows_to_hammer(aggressors);
     std::vector<uint> num_hammers(hammers_per_aggressor);
 
@@ -526,22 +653,8 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
         for (uint i = 0; i < dummy_rows.size(); i++) // add dummy hammer count at the back, one hammer count per dummy
             num_hammers.push_back(hammers_per_dummy);
     }
-    
-
-    if(rows_to_hammer.size() < 1 && (!hammer_dummies_independently || dummy_rows.size() < 1))
-        return; // nothing to hammer
-
-    uint initial_free_regs = reg_alloc.num_free_regs();
-    uint remaining_cycs = 0;
-
-    SMC_REG reg_ref_it = reg_alloc.allocate_SMC_REG();
-    SMC_REG reg_num_refs = reg_alloc.allocate_SMC_REG();
-
-    prog.add_inst(SMC_LI(0, reg_ref_it));
-    prog.add_inst(SMC_LI(num_refs, reg_num_refs));
 
-    std::string lbl_hammer_loop = createSMCLabel("HAMMER_LOOP");
-    prog.add_label(lbl_hammer_loop);
+    std::vector<RefreshStep> steps;
 
     if (trrref_sync) { 
         // when --trrref_sync is specified, instead of issuing all of the --refs_per_loop as a batch,
@@ -582,10 +695,11 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
                 remaining_step_hammers = total_hammer_bugdet - (step_hammer_bugdet*(refs_per_loop - 1));
             }
 
+            RefreshStep step;
+            step.num_refs = 1;
+
             // determine what to hammer in this step
-            std::vector<uint> step_row_to_hammer;
-            std::vector<uint> step_num_hammers;
-            uint step_num_aggr = 0;
+            HammerCall call;
 
             // std::cout << YELLOW_TXT << "[DEBUG] Ref step: " << i << NORMAL_TXT << std::endl;
             // std::cout << YELLOW_TXT << "[DEBUG] Performing " << remaining_step_hammers << " hammers in this step" << NORMAL_TXT << std::endl;
@@ -593,85 +707,102 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
             if(remaining_step_hammers > 0 && hammer_dummies_independently && hammer_dummies_before){
                 // std::cout << YELLOW_TXT << "[DEBUG] Scheduling only dummy hammers via --hammer_dummies_independently..." << NORMAL_TXT << std::endl;
                 remaining_num_aggr = 0;
-                remaining_step_hammers -= scheduleHammersPerStep(step_row_to_hammer, step_num_hammers, step_num_aggr, 
+                remaining_step_hammers -= scheduleHammersPerStep(call.rows_to_hammer, call.num_hammers, call.num_aggressors, 
                     vec_remaining_dummies_to_hammer, vec_remaining_dummy_hammers_before, remaining_num_aggr, remaining_step_hammers, cascaded_hammer_dummy);
 
-                // std::cout << YELLOW_TXT << "[DEBUG] Hammering only dummies via --hammer_dummies_independently" << NORMAL_TXT << std::endl;
-                // std::cout << YELLOW_TXT << "[DEBUG] Scheduled row hammers:" << NORMAL_TXT << std::endl;
-
-                // for(uint row_ind = 0; row_ind < step_row_to_hammer.size(); row_ind++){
-                //     std::cout << YELLOW_TXT << "[DEBUG] RowID (hammers):" << step_row_to_hammer[row_ind] << " (" << step_num_hammers[row_ind] << ")" << NORMAL_TXT << std::endl;
-                // }
-
-                perform_hammers(prog, reg_alloc, reg_bank_addr, step_row_to_hammer, step_num_hammers, step_num_aggr, aggr_bank_id, cascaded_hammer_dummy, dummy_banks, fake_hammer, fake_dummy_hammer);
+                call.cascaded_hammer = cascaded_hammer_dummy;
+                step.hammer_calls.push_back(call);
             }
 
             if (remaining_total_aggr_hammers > 0) {
                 // std::cout << YELLOW_TXT << "[DEBUG] Scheduling aggressor and dummy hammers..." << NORMAL_TXT << std::endl;
 
-                uint scheduled_hammers = scheduleHammersPerStep(step_row_to_hammer, step_num_hammers, step_num_aggr, 
+                uint scheduled_hammers = scheduleHammersPerStep(call.rows_to_hammer, call.num_hammers, call.num_aggressors, 
                     vec_remaining_rows_to_hammer, vec_remaining_aggr_hammers, remaining_num_aggr, remaining_step_hammers, cascaded_hammer_aggr);
 
                 remaining_step_hammers -= scheduled_hammers;
                 remaining_total_aggr_hammers -= scheduled_hammers;
 
-                // std::cout << YELLOW_TXT << "[DEBUG] Step num aggr: " << step_num_aggr << NORMAL_TXT << std::endl;
+                // std::cout << YELLOW_TXT << "[DEBUG] Step num aggr: " << call.num_aggressors << NORMAL_TXT << std::endl;
                 // std::cout << YELLOW_TXT << "[DEBUG] Remaining num aggr: " << remaining_num_aggr << NORMAL_TXT << std::endl;
                 // std::cout << YELLOW_TXT << "[DEBUG] Remaining step hammers: " << remaining_step_hammers << NORMAL_TXT << std::endl;
                 // std::cout << YELLOW_TXT << "[DEBUG] Step hammer budget: " << step_hammer_bugdet << NORMAL_TXT << std::endl;
-                // std::cout << YELLOW_TXT << "[DEBUG] Hammering aggressors and dummies" << NORMAL_TXT << std::endl;
-                // std::cout << YELLOW_TXT << "[DEBUG] Scheduled row hammers:" << NORMAL_TXT << std::endl;
-
-                // for(uint row_ind = 0; row_ind < step_row_to_hammer.size(); row_ind++){
-                //     std::cout << YELLOW_TXT << "[DEBUG] RowID (hammers):" << step_row_to_hammer[row_ind] << " (" << step_num_hammers[row_ind] << ")" << NORMAL_TXT << std::endl;
-                // }
-                
-                perform_hammers(prog, reg_alloc, reg_bank_addr, step_row_to_hammer, step_num_hammers, step_num_aggr, aggr_bank_id, cascaded_hammer_aggr, dummy_banks, fake_hammer, fake_dummy_hammer);
+
+                call.cascaded_hammer = cascaded_hammer_aggr;
+                step.hammer_calls.push_back(call);
             }
 
             if(remaining_step_hammers > 0 && hammer_dummies_independently && hammer_dummies_after){
                 // std::cout << YELLOW_TXT << "[DEBUG] Scheduling only dummy hammers via --hammer_dummies_independently..." << NORMAL_TXT << std::endl;
                 remaining_num_aggr = 0;
-                remaining_step_hammers -= scheduleHammersPerStep(step_row_to_hammer, step_num_hammers, step_num_aggr, 
+                remaining_step_hammers -= scheduleHammersPerStep(call.rows_to_hammer, call.num_hammers, call.num_aggressors, 
                     vec_remaining_dummies_to_hammer, vec_remaining_dummy_hammers_after, remaining_num_aggr, remaining_step_hammers, cascaded_hammer_dummy);
 
-                // std::cout << YELLOW_TXT << "[DEBUG] Hammering only dummies via --hammer_dummies_independently" << NORMAL_TXT << std::endl;
-                // std::cout << YELLOW_TXT << "[DEBUG] Scheduled row hammers:" << NORMAL_TXT << std::endl;
-
-                // for(uint row_ind = 0; row_ind < step_row_to_hammer.size(); row_ind++){
-                //     std::cout << YELLOW_TXT << "[DEBUG] RowID (hammers):" << step_row_to_hammer[row_ind] << " (" << step_num_hammers[row_ind] << ")" << NORMAL_TXT << std::endl;
-                // }
-
-                perform_hammers(prog, reg_alloc, reg_bank_addr, step_row_to_hammer, step_num_hammers, step_num_aggr, aggr_bank_id, cascaded_hammer_dummy, dummy_banks, fake_hammer, fake_dummy_hammer);
+                call.cascaded_hammer = cascaded_hammer_dummy;
+                step.hammer_calls.push_back(call);
             }
 
             assert(remaining_step_hammers == 0);
-            
-            perform_refresh(prog, reg_alloc, 1, 0, fake_ref);
+
+            steps.push_back(step);
         }
     } else {
-        if(hammer_dummies_independently && hammer_dummies_before){
-            std::vector<uint> dummy_hammers;
-            for (uint i = 0; i < dummy_rows.size(); i++) // add dummy hammer counts, one hammer count per dummy
-                dummy_hammers.push_back(hammers_per_dummy);
+        RefreshStep step;
+        step.num_refs = refs_per_loop;
 
-            perform_hammers(prog, reg_alloc, reg_bank_addr, dummy_rows, dummy_hammers, 0, aggr_bank_id, cascaded_hammer_dummy, dummy_banks, fake_hammer, fake_dummy_hammer);
-        }
+        std::vector<uint> dummy_hammers(dummy_rows.size(), hammers_per_dummy); // one hammer count per dummy
+
+        if(hammer_dummies_independently && hammer_dummies_before)
+            step.hammer_calls.push_back(HammerCall{dummy_rows, dummy_hammers, 0, cascaded_hammer_dummy});
+
+        step.hammer_calls.push_back(HammerCall{rows_to_hammer, num_hammers, (uint)aggressors.size(), cascaded_hammer_aggr});
+
+        if(hammer_dummies_independently && hammer_dummies_after)
+            step.hammer_calls.push_back(HammerCall{dummy_rows, dummy_hammers, 0, cascaded_hammer_dummy});
+
+        steps.push_back(step);
+    }
+
+    return steps;
+}
+
+void hammer_aggressors(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const vector<uint>& aggressors,
+                        const std::vector<uint>& hammers_per_aggressor, const std::vector<uint>& aggr_banks, const std::vector<LogicalRowID> dummy_rows, const uint hammers_per_dummy, 
+                        const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint> dummy_banks,
+                        const uint num_refs, const uint refs_per_loop, const bool trrref_sync, const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, 
+                        const bool fake_hammer = false, const bool fake_dummy_hammer = false, const bool fake_ref = false) {
+
+
+    if(aggressors.size() < 1 && dummy_rows.size() < 1)
+        return; // nothing to hammer
+
+    auto steps = planRefreshLoop(aggressors, hammers_per_aggressor, dummy_rows, hammers_per_dummy, hammer_dummies_independently, 
+        hammer_dummies_before, hammer_dummies_after, refs_per_loop, trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy);
+
+    uint initial_free_regs = reg_alloc.num_free_regs();
+
+    SMC_REG reg_ref_it = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_refs = reg_alloc.allocate_SMC_REG();
+
+    prog.add_li(0, reg_ref_it);
+    prog.add_li(num_refs, reg_num_refs);
 
-        perform_hammers(prog, reg_alloc, reg_bank_addr, rows_to_hammer, num_hammers, aggressors.size(), aggr_bank_id, cascaded_hammer_aggr, dummy_banks, fake_hammer, fake_dummy_hammer);
+    std::string lbl_hammer_loop = createSMCLabel("HAMMER_LOOP");
+    prog.add_label(lbl_hammer_loop);
 
-        if(hammer_dummies_independently && hammer_dummies_after){
-            std::vector<uint> dummy_hammers;
-            for (uint i = 0; i < dummy_rows.size(); i++) // add dummy hammer counts, one hammer count per dummy
-                dummy_hammers.push_back(hammers_per_dummy);
+    // perform_hammers_cycles() assumes this number of free registers to decide whether perform_hammers() dedicates registers to the rows
+    assert(reg_alloc.num_free_regs() == hammerCallFreeRegs() + 3);
 
-            perform_hammers(prog, reg_alloc, reg_bank_addr, dummy_rows, dummy_hammers, 0, aggr_bank_id, cascaded_hammer_dummy, dummy_banks, fake_hammer, fake_dummy_hammer);
+    for (auto& step : steps) {
+        for (auto& call : step.hammer_calls) {
+            perform_hammers(prog, reg_alloc, reg_bank_addr, call.rows_to_hammer, call.num_hammers, call.num_aggressors, aggr_banks, 
+                call.cascaded_hammer, dummy_banks, fake_hammer, fake_dummy_hammer);
         }
 
-        perform_refresh(prog, reg_alloc, refs_per_loop, 0, fake_ref);
+        perform_refresh(prog, reg_alloc, step.num_refs, 0, fake_ref);
     }
 
-    prog.add_inst(SMC_ADDI(reg_ref_it, 1, reg_ref_it));
+    prog.add_addi(reg_ref_it, 1, reg_ref_it);
     prog.add_branch(prog.BR_TYPE::BL, reg_ref_it, reg_num_refs, lbl_hammer_loop);
 
     reg_alloc.free_SMC_REG(reg_num_refs);
@@ -680,27 +811,148 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
     assert(reg_alloc.num_free_regs() == initial_free_regs);
 }
 
-void read_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+// The number of cycles the code perform_hammers() emits for 'call' takes to execute. Mirrors perform_hammers() instruction by instruction
+ulong perform_hammers_cycles(const HammerCall& call, const std::vector<uint>& aggr_banks, const uint num_dummy_banks) {
+
+    const int RRD_CYCLES = 5; // as in perform_hammers()
+    const ulong INST = SOFTMC_INST_CYCLES;
+
+    // the loads of the dedicated bank, row address, and dummy bank registers
+    const uint bank_regs = dedicatedBankRegs(aggr_banks.size(), hammerCallFreeRegs());
+    ulong cycles = INST*(bank_regs + dedicatedHammerRegs(call.rows_to_hammer.size(), call.num_aggressors, num_dummy_banks, hammerCallFreeRegs() - bank_regs));
+    int remaining_cycs = 0;
+
+    // the cycles of the instructions that hammer a row once
+    auto row_hammer_cycles = [&](const uint ind_row) {
+        ulong row_cycles = 0;
+
+        if(ind_row >= call.num_aggressors) {
+            for(uint i = 0; i < num_dummy_banks; i++)
+                row_cycles += INST + INST*op_with_delay_insts(remaining_cycs, RRD_CYCLES - 1 - 4, remaining_cycs);
+
+            row_cycles += INST + INST*op_with_delay_insts(tras_cycles - 5, 0, remaining_cycs);
+        } else if(aggr_banks.size() > 1) {
+            auto gaps = multiBankACTGaps(aggr_banks, bank_regs > 0);
+            const int li_cycles = bank_regs > 0 ? 0 : INST;
+            if(call.cascaded_hammer)
+                remaining_cycs = 0;
+
+            for(uint i = 0; i < aggr_banks.size(); i++)
+                row_cycles += li_cycles + INST*op_with_delay_insts(remaining_cycs, (i + 1 < aggr_banks.size()) ? gaps[i + 1] - 1 - li_cycles : tras_cycles - 1, remaining_cycs);
+
+            row_cycles += INST*op_with_delay_insts(0, call.cascaded_hammer ? 0 : trp_cycles - 5, remaining_cycs);
+        } else {
+            row_cycles += INST*op_with_delay_insts(0, tras_cycles - 1, remaining_cycs);
+            row_cycles += INST*op_with_delay_insts(0, call.cascaded_hammer ? 0 : trp_cycles - 5, remaining_cycs);
+        }
+
+        return row_cycles;
+    };
+
+    if(!call.cascaded_hammer) {
+        auto hammers_per_ref = call.num_hammers;
+
+        while (1) {
+            auto min_non_zero = std::min_element(hammers_per_ref.begin(), hammers_per_ref.end(), 
+                    [](const uint& a, const uint& b) {return ((a > 0) && (a < b)) || (b == 0);}
+                );
+
+            if (min_non_zero == hammers_per_ref.end() || *min_non_zero == 0)
+                break;
+
+            uint min_elem = *min_non_zero;
+
+            ulong loop_cycles = 0;
+            for (uint ind_row = 0; ind_row < call.rows_to_hammer.size(); ind_row++) {
+                if(hammers_per_ref[ind_row] == 0)
+                    continue;
+
+                loop_cycles += INST + row_hammer_cycles(ind_row); // LI of the row address
+            }
+            loop_cycles += INST + SOFTMC_BRANCH_CYCLES; // ADDI + BL
+
+            cycles += 2*INST + min_elem*loop_cycles;
+
+            std::for_each(hammers_per_ref.begin(), hammers_per_ref.end(), [&](uint& a) {if (a > 0) a -= min_elem;});
+        }
+    } else {
+        for (uint ind_row = 0; ind_row < call.rows_to_hammer.size(); ind_row++) {
+            if(call.num_hammers[ind_row] == 0)
+                continue;
+
+            // ADDI that equalizes the interleaved and cascaded loop latencies, the row hammer, and ADDI + BL
+            ulong loop_cycles = INST + row_hammer_cycles(ind_row) + INST + SOFTMC_BRANCH_CYCLES;
+            remaining_cycs = 0;
+
+            cycles += 3*INST + call.num_hammers[ind_row]*loop_cycles;
+        }
+    }
+
+    return cycles;
+}
+
+// The number of cycles the code perform_refresh() emits takes to execute. Mirrors perform_refresh()
+ulong perform_refresh_cycles(const uint num_refs_per_cycle, const uint pre_ref_delay) {
+
+    const ulong INST = SOFTMC_INST_CYCLES;
+    ulong cycles = 2*INST;
+
+    if (pre_ref_delay >= 8)
+        cycles += INST*(ulong)std::ceil(pre_ref_delay/4.0f);
+
+    // REF, SLEEP (takes 4 cycles per sleep cycle), ADDI + BL
+    ulong ref_cycles = INST + INST*(ulong)ceil((trfc_cycles - 1 - 24 - 4)/4.0f) + INST + SOFTMC_BRANCH_CYCLES;
+
+    return cycles + std::max(num_refs_per_cycle, 1u)*ref_cycles;
+}
+
+// The number of cycles a single iteration of the refresh loop hammer_aggressors() emits takes
+ulong refreshLoopCycles(const std::vector<RefreshStep>& steps, const std::vector<uint>& aggr_banks, const uint num_dummy_banks) {
+
+    ulong cycles = 0;
+    for (auto& step : steps) {
+        for (auto& call : step.hammer_calls)
+            cycles += perform_hammers_cycles(call, aggr_banks, num_dummy_banks);
+
+        cycles += perform_refresh_cycles(step.num_refs, 0);
+    }
+
+    return cycles + SOFTMC_INST_CYCLES + SOFTMC_BRANCH_CYCLES; // ADDI + BL
+}
+
+// the number of ACT commands a single iteration of the refresh loop issues
+ulong refreshLoopACTs(const std::vector<RefreshStep>& steps, const uint num_aggr_banks, const uint num_dummy_banks) {
+
+    ulong num_acts = 0;
+    for (auto& step : steps)
+        for (auto& call : step.hammer_calls)
+            for (uint ind_row = 0; ind_row < call.rows_to_hammer.size(); ind_row++)
+                num_acts += (ulong)call.num_hammers[ind_row]*(ind_row >= call.num_aggressors ? num_dummy_banks : num_aggr_banks);
+
+    return num_acts;
+}
+
+void read_row_data(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
                     const vector<uint>& rows_to_read) {
 
     uint initial_free_regs = reg_alloc.num_free_regs();
 
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
+    prog.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
 
     for(auto target_row : rows_to_read) {
-        prog.add_inst(SMC_LI(target_row, reg_row_addr));
+        prog.add_li(target_row, reg_row_addr);
 
         // activate the victim row
         add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, trcd_cycles - 1);
         
         // read data from the row and precharge
         SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
-        prog.add_inst(SMC_LI(0, reg_col_addr));
+        prog.add_li(0, reg_col_addr);
 
         string new_lbl = createSMCLabel("READ_ROW");
         prog.add_label(new_lbl);
-        add_op_with_delay(prog, SMC_READ(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0);
+        add_op_with_delay(prog, SMC_READ(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0, {reg_col_addr});
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, new_lbl);
         reg_alloc.free_SMC_REG(reg_col_addr);
 
@@ -715,7 +967,7 @@ void read_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
 
 // performing REF at nominal rate, i.e., a REF cmd is issued once every 7.8us
 // dummy rows are hammered between the REF cmds
-void hammer_dummies(Program& prog, SoftMCRegAllocator& reg_alloc, const uint bank_id, 
+void hammer_dummies(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const uint bank_id, 
     const vector<LogicalRowID>& dummy_aggrs, const uint num_refs) {
 
     
@@ -724,10 +976,10 @@ void hammer_dummies(Program& prog, SoftMCRegAllocator& reg_alloc, const uint ban
 
     SMC_REG reg_row_id = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_bank_id = reg_alloc.allocate_SMC_REG();
-    prog.add_inst(SMC_LI(bank_id, reg_bank_id));
+    prog.add_li(bank_id, reg_bank_id);
   
-    prog.add_inst(SMC_LI(num_refs, reg_num_refs));
-    prog.add_inst(SMC_LI(0, reg_issued_refs));
+    prog.add_li(num_refs, reg_num_refs);
+    prog.add_li(0, reg_issued_refs);
 
     int remaining_cycs = 0;
 
@@ -747,24 +999,24 @@ void hammer_dummies(Program& prog, SoftMCRegAllocator& reg_alloc, const uint ban
         // hammer the dummy rows
         SMC_REG reg_hammer_it = reg_alloc.allocate_SMC_REG();
         SMC_REG reg_hammers_per_ref = reg_alloc.allocate_SMC_REG();
-        prog.add_inst(SMC_LI(0, reg_hammer_it));
-        prog.add_inst(SMC_LI(hammers_per_ref, reg_hammers_per_ref));
+        prog.add_li(0, reg_hammer_it);
+        prog.add_li(hammers_per_ref, reg_hammers_per_ref);
 
         std::string lbl_hammer = createSMCLabel("AFTER_INIT_DUMMY_HAMMERING");
         prog.add_label(lbl_hammer);
             remaining_cycs = 0;
             for (uint dummy_row_id : dummy_aggrs) {
-                prog.add_inst(SMC_LI(dummy_row_id, reg_row_id));
+                prog.add_li(dummy_row_id, reg_row_id);
 
                 remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_id, 0, reg_row_id, 0), remaining_cycs, tras_cycles - 1);
                 remaining_cycs = add_op_with_delay(prog, SMC_PRE(reg_bank_id, 0, 0), remaining_cycs, trp_cycles - 1);
             }
 
-            add_op_with_delay(prog, SMC_ADDI(reg_hammer_it, 1, reg_hammer_it), 0, 0);
+            prog.add_addi(reg_hammer_it, 1, reg_hammer_it);
         prog.add_branch(prog.BR_TYPE::BL, reg_hammer_it, reg_hammers_per_ref, lbl_hammer);
 
 
-        prog.add_inst(SMC_ADDI(reg_issued_refs, 1, reg_issued_refs));
+        prog.add_addi(reg_issued_refs, 1, reg_issued_refs);
     prog.add_branch(prog.BR_TYPE::BL, reg_issued_refs, reg_num_refs, lbl_issue_refs);
 
     reg_alloc.free_SMC_REG(reg_num_refs);
@@ -776,9 +1028,13 @@ void hammer_dummies(Program& prog, SoftMCRegAllocator& reg_alloc, const uint ban
 }
 
 
-void performHammer(SoftMCPlatform& platform, const uint target_bank, const PhysicalRowID anchor_row, const std::string row_layout, 
-                    const std::vector<uint> num_hammers, const std::vector<LogicalRowID> dummy_rows, const uint hammers_per_dummy, 
-                    const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint> dummy_banks,
+// appends the code that initializes the rows of a single anchor position, hammers them, and reads the victims back to prog.
+// With multiple target_banks, the same rows are initialized in each bank, the aggressors are hammered in all banks concurrently, 
+// and the victims are read back bank by bank
+void appendAnchorHammer(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols,
+                    const std::vector<uint>& target_banks, const PhysicalRowID anchor_row, const std::string& row_layout, 
+                    const std::vector<uint>& num_hammers, const std::vector<LogicalRowID>& dummy_rows, const uint hammers_per_dummy, 
+                    const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint>& dummy_banks,
                     const uint num_refs, const uint refs_per_loop, const bool trrref_sync, const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, 
                     const bitset<512>& victim_data, const bitset<512>& aggr_data, 
                     const bool fake_hammer, const bool fake_dummy_hammer, const bool fake_ref) {
@@ -802,14 +1058,6 @@ void performHammer(SoftMCPlatform& platform, const uint target_bank, const Physi
     //     std::cout << a << " ";
     // std::cout << std::endl;
 
-    Program prog;
-    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
-
-    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
-    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
-    prog.add_inst(SMC_LI(target_bank, reg_bank_addr));
-    prog.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, reg_num_cols));
-
     add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
 
     std::vector<LogicalRowID> rows_to_init;
@@ -822,7 +1070,10 @@ void performHammer(SoftMCPlatform& platform, const uint target_bank, const Physi
     data_patts.insert(data_patts.end(), victim_ids.size(), victim_data);
     data_patts.insert(data_patts.end(), aggr_ids.size(), aggr_data);
 
-    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, rows_to_init, data_patts);
+    for(auto bank_id : target_banks) {
+        prog.add_li(bank_id, reg_bank_addr);
+        init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, rows_to_init, data_patts);
+    }
 
     // hammer the dummy rows while refreshing to kick out victims/aggressors from the counter table
     // const uint AFTER_INIT_DUMMY_HAMMER_REFS = 3758;
@@ -835,29 +1086,127 @@ void performHammer(SoftMCPlatform& platform, const uint target_bank, const Physi
 
 
     // perform the actual hammers
-    hammer_aggressors(prog, reg_alloc, reg_bank_addr, aggr_ids, num_hammers, target_bank, dummy_rows, hammers_per_dummy, 
+    hammer_aggressors(prog, reg_alloc, reg_bank_addr, aggr_ids, num_hammers, target_banks, dummy_rows, hammers_per_dummy, 
         hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks, num_refs, refs_per_loop, 
         trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy, fake_hammer, fake_dummy_hammer, fake_ref);
 
     // issue DRAM reads to read back the victim data
-    read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, victim_ids);
+    for(auto bank_id : target_banks) {
+        prog.add_li(bank_id, reg_bank_addr);
+        read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, victim_ids);
+    }
+}
+
+// a row layout tested at each anchor row, together with the hammer counts of its aggressors
+typedef struct LayoutConfig {
+    std::string row_layout;
+    std::vector<uint> num_hammers;
+    uint hammers_per_dummy;
+    ulong loop_acts; // the ACTs a refresh loop issues
+} LayoutConfig;
+
+// builds a single program that tests all anchor_rows one after another, each with all layouts back to back. 
+// The victim rows are read back in the same order, i.e., by anchor row, then by layout, then by bank
+SoftMCProgram buildHammerBatch(const std::vector<uint>& target_banks, const std::vector<PhysicalRowID>& anchor_rows, const std::vector<std::vector<LogicalRowID>>& anchor_dummy_rows,
+                    const std::vector<LayoutConfig>& layouts, 
+                    const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint>& dummy_banks,
+                    const uint num_refs, const uint refs_per_loop, const bool trrref_sync, const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, 
+                    const bitset<512>& victim_data, const bitset<512>& aggr_data, 
+                    const bool fake_hammer, const bool fake_dummy_hammer, const bool fake_ref) {
+
+    assert(anchor_rows.size() == anchor_dummy_rows.size());
+
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
+    prog.add_li(target_banks[0], reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
+
+    for(uint i = 0; i < anchor_rows.size(); i++) {
+        // a layout disturbs the rows the next layout uses, so each layout initializes its rows again
+        for(auto& layout : layouts) {
+            appendAnchorHammer(prog, reg_alloc, reg_bank_addr, reg_num_cols, target_banks, anchor_rows[i], layout.row_layout, layout.num_hammers, anchor_dummy_rows[i], 
+                layout.hammers_per_dummy, hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks, num_refs, refs_per_loop, 
+                trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy, victim_data, aggr_data, fake_hammer, fake_dummy_hammer, fake_ref);
+        }
+    }
 
     reg_alloc.free_SMC_REG(reg_bank_addr);
     reg_alloc.free_SMC_REG(reg_num_cols);
 
     prog.add_inst(SMC_END());
 
-    platform.execute(prog);
     #ifdef PRINT_SOFTMC_PROGS
     if(print_times > 0) {
         prog.pretty_print();
         print_times--;
     }
     #endif
+
+    return prog;
+}
+
+// upper bound on the number of instructions add_op_with_delay() emits for an op followed by 'delay' cycles
+uint insts_with_delay(const int delay) {
+    return 2 + std::max(delay, 0)/4;
+}
+
+// Conservative estimate of the number of instructions appendAnchorHammer() emits for a single anchor row.
+// It mirrors the code generators above and is used to fit as many anchors as possible into the instruction memory.
+uint estimateAnchorInsts(const std::string& row_layout, const std::vector<uint>& num_hammers, const uint num_dummies, const uint hammers_per_dummy, 
+                    const bool hammer_dummies_independently, const std::vector<uint>& dummy_banks, const uint refs_per_loop, const bool trrref_sync, 
+                    const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, const uint num_target_banks = 1) {
+
+    const uint BRANCH_INSTS = 2;
+    const uint WIDE_REG_INSTS = 2*(512/32); // an LI and an LDWD per 32-bit word
+
+    uint num_victims = std::count(row_layout.begin(), row_layout.end(), 'V');
+    uint num_aggrs = std::count(row_layout.begin(), row_layout.end(), 'A');
+
+    // the rows are initialized and read back in each target bank
+    uint init_insts = num_target_banks*(2 + (num_victims + num_aggrs)*(1 + WIDE_REG_INSTS + insts_with_delay(trcd_cycles) + insts_with_delay(0) 
+                        + 1 + BRANCH_INSTS + insts_with_delay(trp_cycles)));
+
+    // hammering a dummy row activates it in all dummy banks, and hammering an aggressor row activates it in all target banks
+    uint aggr_hammer_insts = insts_with_delay(tras_cycles) + insts_with_delay(trp_cycles);
+    if(num_target_banks > 1)
+        aggr_hammer_insts += num_target_banks*(1 + insts_with_delay(tfaw_cycles));
+
+    uint row_hammer_insts = 1 + std::max(aggr_hammer_insts, 
+                        (uint)dummy_banks.size()*(1 + insts_with_delay(5)) + 1 + insts_with_delay(tras_cycles));
+
+    uint num_rows = num_aggrs + num_dummies;
+
+    // perform_hammers() emits one hammer loop per row when hammering in cascaded manner. Otherwise, 
+    // it emits one loop per distinct hammer count, each loop hammering all rows
+    uint num_loops = num_rows;
+    if(!trrref_sync && !cascaded_hammer_aggr && !cascaded_hammer_dummy) {
+        std::vector<uint> hammer_counts(num_hammers);
+        if(num_dummies > 0)
+            hammer_counts.push_back(hammers_per_dummy);
+
+        std::sort(hammer_counts.begin(), hammer_counts.end());
+        num_loops = std::unique(hammer_counts.begin(), hammer_counts.end()) - hammer_counts.begin();
+    }
+    // plus the loads of the registers perform_hammers() may dedicate to the rows and the dummy banks
+    uint perform_hammers_insts = num_rows + dummy_banks.size() + num_loops*(4 + BRANCH_INSTS + num_rows*row_hammer_insts);
+
+    uint refresh_insts = 4 + 3*insts_with_delay(0) + BRANCH_INSTS;
+
+    // with --trrref_sync, hammering is split into refs_per_loop steps, each with up to three perform_hammers() calls
+    uint num_steps = trrref_sync ? refs_per_loop : 1;
+    uint hammer_calls = hammer_dummies_independently ? 3 : 1;
+    uint hammer_insts = 3 + BRANCH_INSTS + num_steps*(hammer_calls*perform_hammers_insts + refresh_insts);
+
+    uint read_insts = num_target_banks*(2 + num_victims*(1 + insts_with_delay(trcd_cycles) + 2 + BRANCH_INSTS + insts_with_delay(trp_cycles)));
+
+    return insts_with_delay(0) + init_insts + hammer_insts + read_insts;
 }
 
 //last_row_id is inclusive
-void readBankRegion(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols,
+void readBankRegion(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols,
                     const uint first_row_id, const uint last_row_id) {
 
     int remaining_cycs = 0;
@@ -866,22 +1215,22 @@ void readBankRegion(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG
     SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_last_row_addr = reg_alloc.allocate_SMC_REG();
 
-    prog.add_inst(SMC_LI(first_row_id, reg_row_addr));
-    prog.add_inst(SMC_LI(last_row_id + 1, reg_last_row_addr));
+    prog.add_li(first_row_id, reg_row_addr);
+    prog.add_li(last_row_id + 1, reg_last_row_addr);
 
-    prog.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
+    prog.add_li(1, RASR); // Load 1 into RASR
+    prog.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
     
     std::string lbl_read_row = createSMCLabel("READ_ROW");
     prog.add_label(lbl_read_row);
-        remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 1), remaining_cycs, trcd_cycles - 1);
+        remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 1), remaining_cycs, trcd_cycles - 1, {reg_row_addr});
 
-        prog.add_inst(SMC_LI(0, reg_col_addr));
+        prog.add_li(0, reg_col_addr);
         std::string lbl_read_cols = createSMCLabel("READ_COLS_OF_A_ROW");
         prog.add_label(lbl_read_cols);
             uint unroll_factor = 16;
             for(uint i_unroll = 0; i_unroll < unroll_factor; i_unroll++){
-                remaining_cycs = add_op_with_delay(prog, SMC_READ(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), remaining_cycs, 3);
+                remaining_cycs = add_op_with_delay(prog, SMC_READ(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), remaining_cycs, 3, {reg_col_addr});
             }
             remaining_cycs = 0;
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, lbl_read_cols);
@@ -909,35 +1258,40 @@ void pick_dummy_aggressors(vector<uint>& dummy_aggrs, const uint num_dummies, co
     }
 }
 
-// returns a vector of bitflips per the specified data chunk size
-std::vector<uint32_t> count_bitflips_in_chunks(const std::vector<uint32_t>& bitflips, const uint bitflip_counting_granularity){
+// the number of chunks count_bitflips_in_chunks() counts the bitflips of a row in
+uint num_bitflip_chunks(const uint bitflip_counting_granularity) {
+    return bitflip_counting_granularity == 0 ? 1 : ROW_SIZE/bitflip_counting_granularity;
+}
+
+// counts the bitflips per the specified data chunk size into chunk_counts, which must have room for num_bitflip_chunks() counts
+void count_bitflips_in_chunks(const std::vector<uint32_t>& bitflips, const uint bitflip_counting_granularity, uint32_t* chunk_counts){
 
-    if(bitflip_counting_granularity == 0)
-        return std::vector<uint32_t>{(uint32_t)bitflips.size()};
+    if(bitflip_counting_granularity == 0) {
+        chunk_counts[0] = bitflips.size();
+        return;
+    }
 
-    std::vector<uint32_t> cl_bitflips(ROW_SIZE/bitflip_counting_granularity, 0);
+    std::fill(chunk_counts, chunk_counts + num_bitflip_chunks(bitflip_counting_granularity), 0);
 
     for (auto bitflip_loc : bitflips){
         uint cl_ind = bitflip_loc/(bitflip_counting_granularity << 3); // bitflip_loc shows the bit location of the bit flip. This is why we multiply bitflip_counting_granularity by 8
-        cl_bitflips[cl_ind]++;
+        chunk_counts[cl_ind]++;
     }
 
-    assert(bitflips.size() == std::accumulate(cl_bitflips.begin(), cl_bitflips.end(), 0));
-
-    return cl_bitflips;
+    assert(bitflips.size() == std::accumulate(chunk_counts, chunk_counts + num_bitflip_chunks(bitflip_counting_granularity), 0u));
 }
 
 // returns true if 'hammer_count' causes bitflips
 bool testHammerCount(SoftMCPlatform& platform, const uint bank_id, const uint row_id, const uint hammer_count,
                         const bitset<512>& victim_data, const bitset<512>& aggr_data) {
 
-    Program prog;
+    SoftMCProgram prog;
     SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
 
     SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
-    prog.add_inst(SMC_LI(bank_id, reg_bank_addr));
-    prog.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, reg_num_cols));
+    prog.add_li(bank_id, reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
 
     add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
 
@@ -948,140 +1302,520 @@ bool testHammerCount(SoftMCPlatform& platform, const uint bank_id, const uint ro
 
     init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {row_id}, {victim_data});
     init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, aggr_ids, aggr_data_pattern);
-    perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, aggr_hammers, 1, bank_id, false, {1}, false, false);
+    perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, aggr_hammers, 1, {bank_id}, false, {1}, false, false);
     read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {row_id});
 
     prog.add_inst(SMC_END());
 
-    platform.execute(prog);
+    execute_program(platform, prog);
     // prog.pretty_print();
 
     reg_alloc.free_SMC_REG(reg_bank_addr);
     reg_alloc.free_SMC_REG(reg_num_cols);
 
-    char buf[ROW_SIZE*2];
-    platform.receiveData(buf, ROW_SIZE);
+    ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE);
+    receive_data(platform, buf.data(), buf.size());
 
     std::vector<uint> bitflips;
-    collect_bitflips(bitflips, buf, victim_data);
+    collect_bitflips(bitflips, buf.data(), victim_data);
 
     return bitflips.size() > 0;
 }
 
-uint findHCFirst(SoftMCPlatform& platform, const uint bank_id, const uint row_id, const bitset<512>& victim_data, const bitset<512>& aggr_data){
+// tests the victim rows one after another in a single program, each with its own hammer count (single-sided, the aggressor is the physically next row).
+// Returns whether each victim row experienced bitflips
+std::vector<bool> testHammerCounts(SoftMCPlatform& platform, const uint bank_id, const std::vector<PhysicalRowID>& row_ids, 
+                        const std::vector<uint>& hammer_counts, const bitset<512>& victim_data, const bitset<512>& aggr_data) {
 
-    const uint INIT_HAMMER_COUNT = 5000;
-    const uint MAX_HAMMER_COUNT = 1500000;
-    const uint HAMMER_COUNT_PRECISION = 500; // keep refining until the distance between the latest two tested hammer counts is less than or equal to this value
+    assert(row_ids.size() == hammer_counts.size());
 
-    uint hc_low = INIT_HAMMER_COUNT;
-    uint hc_high = MAX_HAMMER_COUNT;
-    uint t_hc = INIT_HAMMER_COUNT;
-    while (true) {
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
 
-        // std::cout << YELLOW_TXT << "[DEBUG] Testing hammer count: " << t_hc << NORMAL_TXT << std::endl;
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
+    prog.add_li(bank_id, reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
 
-        bool causes_bitflips = testHammerCount(platform, bank_id, row_id, t_hc, victim_data, aggr_data);
+    add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
 
-        if (causes_bitflips) {
-            
-            if (t_hc == INIT_HAMMER_COUNT)
-                return 0;
+    // each victim row is initialized, hammered, and read back before moving on to the next one so that 
+    // every row experiences the same timing as when tested alone with testHammerCount()
+    for(uint i = 0; i < row_ids.size(); i++) {
+        LogicalRowID victim_id = to_logical_row_id(row_ids[i]);
+        std::vector<uint> aggr_ids = {to_logical_row_id(row_ids[i] + 1)};
 
-            hc_high = t_hc;
-            t_hc = (hc_high + hc_low)/2;
+        init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {victim_id}, {victim_data});
+        init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, aggr_ids, {aggr_data});
+        perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, {hammer_counts[i]}, 1, {bank_id}, false, {1}, false, false);
+        read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {victim_id});
+    }
 
-            if (hc_high - t_hc <= HAMMER_COUNT_PRECISION)
-                return hc_high;
-        } else {
+    prog.add_inst(SMC_END());
+
+    execute_program(platform, prog);
+
+    reg_alloc.free_SMC_REG(reg_bank_addr);
+    reg_alloc.free_SMC_REG(reg_num_cols);
+
+    ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*row_ids.size());
+    receive_data(platform, buf.data(), buf.size());
+
+    std::vector<bool> causes_bitflips;
+    causes_bitflips.reserve(row_ids.size());
+
+    std::vector<uint> bitflips;
+    for(uint i = 0; i < row_ids.size(); i++) {
+        collect_bitflips(bitflips, buf.data() + i*ROW_SIZE, victim_data);
+        causes_bitflips.push_back(bitflips.size() > 0);
+    }
 
-            if ((MAX_HAMMER_COUNT - t_hc) <= HAMMER_COUNT_PRECISION*2)
-                return 0;
+    return causes_bitflips;
+}
+
+const uint HCFIRST_INIT_HAMMER_COUNT = 5000;
+const uint HCFIRST_MAX_HAMMER_COUNT = 1500000;
+const uint HCFIRST_HAMMER_COUNT_PRECISION = 500; // keep refining until the distance between the latest two tested hammer counts is less than or equal to this value
+
+// the state of the HC_first search of a single row
+typedef struct HCFirstSearch {
+    uint row_id;
+    uint hc_low;
+    uint hc_high;
+    uint t_hc; // the hammer count to test next
+    uint hc_first; // valid when the search is over. 0 if HC_first is outside of the search range
+} HCFirstSearch;
+
+HCFirstSearch start_hcfirst_search(const uint row_id) {
+    HCFirstSearch search;
+
+    search.row_id = row_id;
+    search.hc_low = HCFIRST_INIT_HAMMER_COUNT;
+    search.hc_high = HCFIRST_MAX_HAMMER_COUNT;
+    search.t_hc = HCFIRST_INIT_HAMMER_COUNT;
+    search.hc_first = 0;
+
+    return search;
+}
+
+// narrows down the search range based on whether testing search.t_hc caused bitflips. Returns true when the search is over
+bool step_hcfirst_search(HCFirstSearch& search, const bool causes_bitflips) {
+
+    if (causes_bitflips) {
+        
+        if (search.t_hc == HCFIRST_INIT_HAMMER_COUNT) {
+            search.hc_first = 0;
+            return true;
+        }
+
+        search.hc_high = search.t_hc;
+        search.t_hc = (search.hc_high + search.hc_low)/2;
 
-            hc_low = t_hc;
-            t_hc = (hc_high + hc_low)/2;
+        if (search.hc_high - search.t_hc <= HCFIRST_HAMMER_COUNT_PRECISION) {
+            search.hc_first = search.hc_high;
+            return true;
+        }
+    } else {
+
+        if ((HCFIRST_MAX_HAMMER_COUNT - search.t_hc) <= HCFIRST_HAMMER_COUNT_PRECISION*2) {
+            search.hc_first = 0;
+            return true;
+        }
 
-            if ((t_hc - hc_low) <= HAMMER_COUNT_PRECISION)
-                return hc_high;
+        search.hc_low = search.t_hc;
+        search.t_hc = (search.hc_high + search.hc_low)/2;
+
+        if ((search.t_hc - search.hc_low) <= HCFIRST_HAMMER_COUNT_PRECISION) {
+            search.hc_first = search.hc_high;
+            return true;
         }
     }
 
-    return 0; // not reachable
+    return false;
 }
 
-std::vector<uint> gatherRunsWithTRR(SoftMCPlatform& platform, const uint num_runs, 
-                const uint bank_id, const uint row_id, const uint hammer_count, 
-                const bitset<512>& victim_data, const bitset<512>& aggr_data) {
+uint findHCFirst(SoftMCPlatform& platform, const uint bank_id, const uint row_id, const bitset<512>& victim_data, const bitset<512>& aggr_data){
 
-    std::vector<uint> num_bitflips_per_run;
-    num_bitflips_per_run.reserve(num_runs);
-    int target_cell = -1;
+    HCFirstSearch search = start_hcfirst_search(row_id);
 
-    // std::vector<uint> aggr_ids = {row_id - 1, row_id + 1}; // double-sided does not work well with Micron's TRR
-    std::vector<uint> aggr_ids = {row_id + 1};
-    std::vector<uint> aggr_hammers = std::vector<uint>(aggr_ids.size(), hammer_count/2);
-    std::vector<bitset<512>> aggr_data_pattern = std::vector<bitset<512>>(aggr_ids.size(), aggr_data);
+    while (true) {
+
+        // std::cout << YELLOW_TXT << "[DEBUG] Testing hammer count: " << search.t_hc << NORMAL_TXT << std::endl;
+
+        bool causes_bitflips = testHammerCount(platform, bank_id, row_id, search.t_hc, victim_data, aggr_data);
 
+        if (step_hcfirst_search(search, causes_bitflips))
+            return search.hc_first;
+    }
 
-    progresscpp::ProgressBar progress_bar(num_runs, 70, '#', '-');
+    return 0; // not reachable
+}
 
-    char buf[ROW_SIZE*2];
-    for (uint run_id = 0; run_id < num_runs; run_id++) {
+// Finds HC_first of every row in [first_row_id, last_row_id] (inclusive, physical row IDs) and writes one "<row>: <HC_first>" line per row to out_file.
+// Up to 'parallel_rows' rows are searched at the same time, i.e., each probe program tests the next hammer count of each row under search.
+// Rows are picked in a strided order so that the rows searched at the same time are far apart from each other.
+// Returns false when the range has no row whose aggressor is in the bank
+bool mapHCFirst(SoftMCPlatform& platform, const uint bank_id, const PhysicalRowID first_row_id, PhysicalRowID last_row_id, uint parallel_rows,
+                const uint input_data_victims, const uint input_data_aggressors, boost::filesystem::ofstream& out_file) {
+
+    // the aggressor is the physically next row, so the last row of the bank cannot be tested
+    if(first_row_id > (uint)NUM_ROWS - 2) {
+        std::cerr << RED_TXT << "ERROR: The aggressor of row " << first_row_id << " is outside of the bank. --range must start before row " 
+            << NUM_ROWS - 1 << " with --hcfirst_map" << NORMAL_TXT << std::endl;
+        return false;
+    }
 
-        // Generating SoftMC program
-        Program prog;
-        SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+    if(last_row_id > (uint)NUM_ROWS - 2)
+        last_row_id = NUM_ROWS - 2;
 
-        SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
-        SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
-        prog.add_inst(SMC_LI(bank_id, reg_bank_addr));
-        prog.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, reg_num_cols));
+    bitset<512> victims_data = setup_data_pattern(input_data_victims);
+    bitset<512> aggrs_data = setup_data_pattern(input_data_aggressors);
 
-        add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
+    uint num_rows = last_row_id - first_row_id + 1;
 
-        uint aggr_id = row_id + 1;
+    if(parallel_rows == 0) {
+        uint pair_insts = estimateAnchorInsts("VA", {HCFIRST_MAX_HAMMER_COUNT}, 0, 0, false, {1}, 1, false, false, false);
+        parallel_rows = std::max((SOFTMC_MAX_PROG_INSTS - 4)/pair_insts, 1u);
+    }
+    parallel_rows = std::min(parallel_rows, num_rows);
 
-        init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {row_id}, {victim_data});
-        init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, aggr_ids, aggr_data_pattern);
+    std::cout << BLUE_TXT << "Finding HC_first of " << num_rows << " rows in bank " << bank_id << ", " << parallel_rows << " row(s) at a time..." << NORMAL_TXT << std::endl;
 
-        perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, aggr_hammers, 1, bank_id, false, {1}, false, false);
-        perform_refresh(prog, reg_alloc, 1, 0, false);
-        perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, aggr_hammers, 1, bank_id, false, {1}, false, false);
-        
-        read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {row_id});
+    uint stride = (num_rows + parallel_rows - 1)/parallel_rows;
+    std::vector<PhysicalRowID> rows_to_search;
+    rows_to_search.reserve(num_rows);
+    for(uint offset = 0; offset < stride; offset++)
+        for(PhysicalRowID row_id = first_row_id + offset; row_id <= last_row_id; row_id += stride)
+            rows_to_search.push_back(row_id);
 
-        prog.add_inst(SMC_END());
-        // END - generating SoftMC program
+    std::vector<uint> hc_first_map(num_rows, 0);
+    std::vector<HCFirstSearch> searches;
+    uint next_row = 0;
 
-        platform.execute(prog);
+    progresscpp::ProgressBar progress_bar(num_rows, 70, '#', '-');
 
-        platform.receiveData(buf, ROW_SIZE);
+    std::vector<PhysicalRowID> probe_rows;
+    std::vector<uint> probe_hcs;
+    while(true) {
+        while(searches.size() < parallel_rows && next_row < rows_to_search.size())
+            searches.push_back(start_hcfirst_search(rows_to_search[next_row++]));
 
-        std::vector<uint> bitflips;
-        collect_bitflips(bitflips, buf, victim_data);
+        if(searches.empty())
+            break;
 
-        if(target_cell == -1 && bitflips.size() > 0){
-            target_cell = bitflips[0];
+        probe_rows.clear();
+        probe_hcs.clear();
+        for(auto& search : searches) {
+            probe_rows.push_back(search.row_id);
+            probe_hcs.push_back(search.t_hc);
         }
 
-        if(find(bitflips.begin(), bitflips.end(), target_cell) != bitflips.end())
-            num_bitflips_per_run.push_back(1);
-        else
-            num_bitflips_per_run.push_back(0);
+        std::vector<bool> causes_bitflips = testHammerCounts(platform, bank_id, probe_rows, probe_hcs, victims_data, aggrs_data);
+
+        std::vector<HCFirstSearch> ongoing_searches;
+        ongoing_searches.reserve(searches.size());
+        for(uint i = 0; i < searches.size(); i++) {
+            if(step_hcfirst_search(searches[i], causes_bitflips[i])) {
+                hc_first_map[searches[i].row_id - first_row_id] = searches[i].hc_first;
+                ++progress_bar;
+            } else {
+                ongoing_searches.push_back(searches[i]);
+            }
+        }
+        searches.swap(ongoing_searches);
 
-        ++progress_bar;
         progress_bar.display();
     }
+
     progress_bar.done();
 
-    return num_bitflips_per_run;
+    for(uint i = 0; i < num_rows; i++)
+        out_file << std::setw(5) << first_row_id + i << ": " << hc_first_map[i] << std::endl;
+
+    std::vector<uint> found_hcs;
+    for(auto hc : hc_first_map)
+        if(hc != 0)
+            found_hcs.push_back(hc);
+
+    if(found_hcs.empty()) {
+        std::cout << YELLOW_TXT << "HC_first of all rows is outside of the search range [" << HCFIRST_INIT_HAMMER_COUNT << ", " << HCFIRST_MAX_HAMMER_COUNT << "]" << NORMAL_TXT << std::endl;
+        return true;
+    }
+
+    std::sort(found_hcs.begin(), found_hcs.end());
+    std::cout << YELLOW_TXT << "HC_first found for " << found_hcs.size() << " of " << num_rows << " rows. Min: " << found_hcs.front() 
+        << ", median: " << found_hcs[found_hcs.size()/2] << ", max: " << found_hcs.back() << NORMAL_TXT << std::endl;
+
+    return true;
 }
 
+const uint DISCOVER_MAPPING_BITS = 4; // the mapping is searched among the remappings of the low-order row address bits
+const uint DISCOVER_MAPPING_HAMMER_COUNT = 500000; // short enough to finish well within the refresh window
 
-// this program finds which REF commands perform TRR and synchronizes with TRR REFs such that the last REF issued
-// prior to the program finishes is a TRR REF
-// It is expected to use this with Samsung and Hynix modules where every 9th and 4th REF command, respectively, is a TRR REF
-// Method:
+// Hammers aggr_row single-sided once and returns the number of bitflips in each of the window_rows (all logical row IDs)
+std::vector<uint> probeRowNeighbours(SoftMCPlatform& platform, const uint bank_id, const LogicalRowID aggr_row, const std::vector<LogicalRowID>& window_rows,
+                        const bitset<512>& victim_data, const bitset<512>& aggr_data) {
+
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
+    prog.add_li(bank_id, reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
+
+    add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
+
+    std::vector<LogicalRowID> victim_rows;
+    for(auto row_id : window_rows)
+        if(row_id != aggr_row)
+            victim_rows.push_back(row_id);
+
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, victim_rows, std::vector<bitset<512>>(victim_rows.size(), victim_data));
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {aggr_row}, {aggr_data});
+    perform_hammers(prog, reg_alloc, reg_bank_addr, {aggr_row}, {DISCOVER_MAPPING_HAMMER_COUNT}, 1, {bank_id}, false, {1}, false, false);
+    read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, victim_rows);
+
+    prog.add_inst(SMC_END());
+
+    execute_program(platform, prog);
+
+    reg_alloc.free_SMC_REG(reg_bank_addr);
+    reg_alloc.free_SMC_REG(reg_num_cols);
+
+    ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*victim_rows.size());
+    receive_data(platform, buf.data(), buf.size());
+
+    std::vector<uint> num_bitflips;
+    num_bitflips.reserve(window_rows.size());
+
+    std::vector<uint> bitflips;
+    uint victim_ind = 0;
+    for(auto row_id : window_rows) {
+        if(row_id == aggr_row) {
+            num_bitflips.push_back(0);
+            continue;
+        }
+
+        collect_bitflips(bitflips, buf.data() + (victim_ind++)*ROW_SIZE, victim_data);
+        num_bitflips.push_back(bitflips.size());
+    }
+
+    return num_bitflips;
+}
+
+// Discovers the logical to physical row mapping of the module by hammering num_probes rows starting from first_row_id single-sided. 
+// The (up to) two rows around a probed row that experience the most bitflips are taken as its physical neighbours, and the mapping 
+// that places the most of these neighbours next to the probed rows is written to mapping_filename
+void discoverRowMapping(SoftMCPlatform& platform, const uint bank_id, const LogicalRowID first_row_id, const LogicalRowID last_row_id, const uint num_probes,
+                const uint input_data_victims, const uint input_data_aggressors, const std::string& mapping_filename) {
+
+    bitset<512> victims_data = setup_data_pattern(input_data_victims);
+    bitset<512> aggrs_data = setup_data_pattern(input_data_aggressors);
+
+    // the physical neighbours of a row are in its own or the adjacent groups of rows that share the high-order address bits
+    const uint group_size = 1 << DISCOVER_MAPPING_BITS;
+
+    std::vector<LogicalRowID> probe_rows;
+    for(LogicalRowID row_id = first_row_id; row_id <= last_row_id && probe_rows.size() < num_probes; row_id++)
+        probe_rows.push_back(row_id);
+
+    std::cout << BLUE_TXT << "Discovering the row mapping of bank " << bank_id << " by hammering " << probe_rows.size() << " rows single-sided..." << NORMAL_TXT << std::endl;
+
+    std::vector<std::pair<uint32_t, uint32_t>> neighbour_pairs;
+
+    progresscpp::ProgressBar progress_bar(probe_rows.size(), 70, '#', '-');
+
+    for(auto aggr_row : probe_rows) {
+        LogicalRowID group_start = aggr_row & ~(group_size - 1);
+        LogicalRowID window_start = group_start >= group_size ? group_start - group_size : 0;
+        LogicalRowID window_end = std::min(group_start + 2*group_size, (uint)NUM_ROWS); // exclusive
+
+        std::vector<LogicalRowID> window_rows;
+        for(LogicalRowID row_id = window_start; row_id < window_end; row_id++)
+            window_rows.push_back(row_id);
+
+        std::vector<uint> num_bitflips = probeRowNeighbours(platform, bank_id, aggr_row, window_rows, victims_data, aggrs_data);
+
+        std::vector<uint> order(window_rows.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint a, uint b) { return num_bitflips[a] > num_bitflips[b]; });
+
+        for(uint i = 0; i < 2 && num_bitflips[order[i]] > 0; i++)
+            neighbour_pairs.push_back({aggr_row, window_rows[order[i]]});
+
+        ++progress_bar;
+        progress_bar.display();
+    }
+
+    progress_bar.done();
+
+    if(neighbour_pairs.empty()) {
+        std::cout << RED_TXT << "ERROR: None of the probed rows caused bitflips with " << DISCOVER_MAPPING_HAMMER_COUNT << " hammers. Try different --input_victims and --input_aggressors or another --range" << NORMAL_TXT << std::endl;
+        return;
+    }
+
+    uint num_adjacent;
+    RowMapping mapping = fit_row_mapping(neighbour_pairs, DISCOVER_MAPPING_BITS, num_adjacent);
+
+    std::cout << YELLOW_TXT << "The discovered mapping places " << num_adjacent << " of " << neighbour_pairs.size() << " observed neighbour rows physically next to the hammered row:" << NORMAL_TXT << std::endl;
+    std::cout << row_mapping_to_string(mapping);
+
+    std::string error = save_row_mapping(mapping_filename, mapping);
+    if(error != "")
+        std::cerr << RED_TXT << "ERROR: " << error << NORMAL_TXT << std::endl;
+    else
+        std::cout << "The mapping is written to " << mapping_filename << ". Pass it to the tools with --row_mapping_file" << std::endl;
+}
+
+// Builds a program that performs num_runs runs back to back. Each run initializes the victim and the aggressor rows, 
+// hammers the aggressor hammer_count/2 times, issues a single REF, hammers the aggressor hammer_count/2 more times, and reads back the victim row
+SoftMCProgram buildRunsWithTRRProgram(const uint num_runs, const uint bank_id, const uint row_id, const uint hammer_count, 
+                const bitset<512>& victim_data, const bitset<512>& aggr_data) {
+
+    // std::vector<uint> aggr_ids = {row_id - 1, row_id + 1}; // double-sided does not work well with Micron's TRR
+    std::vector<uint> aggr_ids = {row_id + 1};
+    std::vector<uint> aggr_hammers = std::vector<uint>(aggr_ids.size(), hammer_count/2);
+    std::vector<bitset<512>> aggr_data_pattern = std::vector<bitset<512>>(aggr_ids.size(), aggr_data);
+
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
+    prog.add_li(bank_id, reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
+
+    add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
+
+    SMC_REG reg_run_it = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_runs = reg_alloc.allocate_SMC_REG();
+    prog.add_li(0, reg_run_it);
+    prog.add_li(num_runs, reg_num_runs);
+
+    std::string lbl_run = createSMCLabel("TRR_RUN");
+    prog.add_label(lbl_run);
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {row_id}, {victim_data});
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, aggr_ids, aggr_data_pattern);
+
+    perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, aggr_hammers, 1, {bank_id}, false, {1}, false, false);
+    perform_refresh(prog, reg_alloc, 1, 0, false);
+    perform_hammers(prog, reg_alloc, reg_bank_addr, aggr_ids, aggr_hammers, 1, {bank_id}, false, {1}, false, false);
+
+    read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, {row_id});
+
+    prog.add_addi(reg_run_it, 1, reg_run_it);
+    prog.add_branch(prog.BR_TYPE::BL, reg_run_it, reg_num_runs, lbl_run);
+
+    prog.add_inst(SMC_END());
+
+    reg_alloc.free_SMC_REG(reg_bank_addr);
+    reg_alloc.free_SMC_REG(reg_num_cols);
+    reg_alloc.free_SMC_REG(reg_run_it);
+    reg_alloc.free_SMC_REG(reg_num_runs);
+
+    return prog;
+}
+
+// The histogram of distances between the runs in which the target cell does not flip. It is updated as the runs complete
+typedef struct TRRREFHistogram {
+    int target_cell;
+    int last_no_bitflip_run;
+    uint num_runs;
+    std::vector<uint> hist_zero_bitflips;
+} TRRREFHistogram;
+
+void add_run_to_histogram(TRRREFHistogram& hist, const std::vector<uint>& bitflips) {
+
+    if(hist.target_cell == -1 && bitflips.size() > 0){
+        hist.target_cell = bitflips[0];
+    }
+
+    bool target_cell_flipped = find(bitflips.begin(), bitflips.end(), hist.target_cell) != bitflips.end();
+    uint run_id = hist.num_runs++;
+
+    if (target_cell_flipped)
+        return;
+
+    if (hist.last_no_bitflip_run != -1)
+        hist.hist_zero_bitflips[run_id - hist.last_no_bitflip_run]++;
+
+    hist.last_no_bitflip_run = run_id;
+}
+
+// returns 0 if no distance qualifies as the period of TRR REFs yet
+uint find_trrref_period(const TRRREFHistogram& hist) {
+
+    // instead of using the most frequent distance, implementing the following logic because Micron modules can take the other aggressor 
+    // that does not cause refresh on the target victim row (because Micron's TRR performs targeted refresh on one of the neighbors of an aggressor row but not both)
+    const float PASS_THRESHOLD = 0.15f;
+    for (uint i = 1; i < std::min((uint)hist.hist_zero_bitflips.size(), hist.num_runs); i++) {
+        if (hist.hist_zero_bitflips[i] >= ((hist.num_runs/i)*PASS_THRESHOLD)){
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+// Performs up to max_runs runs (see buildRunsWithTRRProgram()) in programs of RUNS_PER_PROG runs. The victim rows are received 
+// and added to the histogram as the FPGA executes the runs. Stops early once the same period is found after two consecutive programs 
+// and the period is backed by at least MIN_PERIOD_OBSERVATIONS runs
+TRRREFHistogram gatherRunsWithTRR(SoftMCPlatform& platform, const uint max_runs, 
+                const uint bank_id, const uint row_id, const uint hammer_count, 
+                const bitset<512>& victim_data, const bitset<512>& aggr_data) {
+
+    const uint RUNS_PER_PROG = 128;
+    const uint RUNS_PER_RECEIVE = 16;
+    const uint MIN_PERIOD_OBSERVATIONS = 16;
+
+    TRRREFHistogram hist;
+    hist.target_cell = -1;
+    hist.last_no_bitflip_run = -1;
+    hist.num_runs = 0;
+    hist.hist_zero_bitflips = std::vector<uint>(max_runs, 0);
+
+    progresscpp::ProgressBar progress_bar(max_runs, 70, '#', '-');
+
+    ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*RUNS_PER_RECEIVE);
+    std::vector<uint> bitflips;
+    uint last_period = 0;
+
+    while (hist.num_runs < max_runs) {
+        uint prog_runs = std::min(RUNS_PER_PROG, max_runs - hist.num_runs);
+
+        SoftMCProgram prog = buildRunsWithTRRProgram(prog_runs, bank_id, row_id, hammer_count, victim_data, aggr_data);
+        execute_program(platform, prog);
+
+        for (uint received_runs = 0; received_runs < prog_runs; received_runs += RUNS_PER_RECEIVE) {
+            uint chunk_runs = std::min(RUNS_PER_RECEIVE, prog_runs - received_runs);
+            receive_data(platform, buf.data(), ROW_SIZE*chunk_runs);
+
+            for (uint i = 0; i < chunk_runs; i++) {
+                collect_bitflips(bitflips, buf.data() + i*ROW_SIZE, victim_data);
+                add_run_to_histogram(hist, bitflips);
+                ++progress_bar;
+            }
+
+            progress_bar.display();
+        }
+
+        uint period = find_trrref_period(hist);
+        if (period != 0 && period == last_period && hist.hist_zero_bitflips[period] >= MIN_PERIOD_OBSERVATIONS)
+            break;
+
+        last_period = period;
+    }
+    progress_bar.done();
+
+    return hist;
+}
+
+
+// this program finds which REF commands perform TRR and synchronizes with TRR REFs such that the last REF issued
+// prior to the program finishes is a TRR REF
+// It is expected to use this with Samsung and Hynix modules where every 9th and 4th REF command, respectively, is a TRR REF
+// Method:
 //  1. Pick an arbitrary row and find its HC_first value. Assume the HC_first is N.
 //  2. Initialize the row and hammer it (N*1.2)/2 times
 //  3. Issue a REF command
@@ -1109,50 +1843,25 @@ uint syncTRRREF(SoftMCPlatform& platform, const uint input_data_victims, const u
     const float HC_MULT = 1.2f;
     uint test_hammers = hc_first * HC_MULT;
 
-    const uint NUM_RUNS = 1024;
+    const uint MAX_RUNS = 1024;
     std::cout << BLUE_TXT << "Gathering data to find TRR REFs..." << NORMAL_TXT << std::endl;
-    std:vector<uint> num_bitflips_per_run = gatherRunsWithTRR(platform, NUM_RUNS, TARGET_BANK, TARGET_ROW, test_hammers, victims_data, aggrs_data);
-
-    // for (uint i = 0; i < NUM_RUNS; i++) {
-    //     std::cout << "Run #" << i << ": " << num_bitflips_per_run[i] << std::endl;
-    // }
-
-    // build a histogram of distances between runs with 0 bitflips
-    int last_no_bitflip_run = -1;
-    std::vector<uint> hist_zero_bitflips = std::vector<uint>(NUM_RUNS, 0);
-    for (uint i = 0; i < NUM_RUNS; i++) {
-        if (last_no_bitflip_run == -1) {
-            if (num_bitflips_per_run[i] == 0)
-                last_no_bitflip_run = i;
-            continue;
-        }
-
-        if (num_bitflips_per_run[i] == 0) {
-            hist_zero_bitflips[i - last_no_bitflip_run]++;
-            last_no_bitflip_run = i;
-        }
-    }
+    TRRREFHistogram hist = gatherRunsWithTRR(platform, MAX_RUNS, TARGET_BANK, TARGET_ROW, test_hammers, victims_data, aggrs_data);
 
-    if (last_no_bitflip_run == -1) {
+    if (hist.last_no_bitflip_run == -1) {
         std::cout << RED_TXT << "ERROR: Could not find a run without bitflips." << NORMAL_TXT << std::endl;
         return 0;
     }
 
-    int most_frequent_distance = 0; // = std::max_element(hist_zero_bitflips.begin(), hist_zero_bitflips.end()) - hist_zero_bitflips.begin();
+    uint most_frequent_distance = find_trrref_period(hist);
 
-    // instead of using the most frequent distance, implementing the following logic because Micron modules can take the other aggressor 
-    // that does not cause refresh on the target victim row (because Micron's TRR performs targeted refresh on one of the neighbors of an aggressor row but not both)
-    const float PASS_THRESHOLD = 0.15f;
-    for (uint i = 1; i < hist_zero_bitflips.size(); i++) {
-        if (hist_zero_bitflips[i] >= ((NUM_RUNS/i)*PASS_THRESHOLD)){
-            most_frequent_distance = i;
-            break;
-        }
+    if (most_frequent_distance == 0) {
+        std::cout << RED_TXT << "ERROR: Could not find a distance between the runs without bitflips that repeats frequently enough." << NORMAL_TXT << std::endl;
+        return 0;
     }
 
-    std::cout << YELLOW_TXT << "The distance between TRR REFs: " << most_frequent_distance << NORMAL_TXT << std::endl;
+    std::cout << YELLOW_TXT << "The distance between TRR REFs: " << most_frequent_distance << " (found after " << hist.num_runs << " runs)" << NORMAL_TXT << std::endl;
 
-    uint num_last_regular_refs = NUM_RUNS - last_no_bitflip_run - 1;
+    uint num_last_regular_refs = hist.num_runs - hist.last_no_bitflip_run - 1;
     uint refs_to_sync = (most_frequent_distance - num_last_regular_refs) % most_frequent_distance;
     std::cout << BLUE_TXT << "Issuing " << refs_to_sync << " REFs so that the last REF is a TRR REF..." << NORMAL_TXT << std::endl;
 
@@ -1163,67 +1872,418 @@ uint syncTRRREF(SoftMCPlatform& platform, const uint input_data_victims, const u
     return most_frequent_distance;
 }
 
-// last_row_id is inclusive
-void hammerBank(SoftMCPlatform& platform, const uint target_bank, const PhysicalRowID first_row_id, const PhysicalRowID last_row_id, 
+// number of instructions perform_pattern_hammers() emits per slot. Every slot, idle or not, takes 4*pattern_slot_insts() cycles
+uint pattern_slot_insts() {
+    return 1 + (1 + std::max(tras_cycles - 1 - 3, 0)/4) + (1 + std::max(trp_cycles - 5 - 3, 0)/4);
+}
+
+// the number of slots that fit between two REF commands issued at the nominal refresh rate
+uint default_pattern_slots_per_ref() {
+    return std::max((trefi_cycles - trfc_cycles)/(int)(4*pattern_slot_insts()), 1);
+}
+
+uint estimatePatternInsts(const HammerPattern& pattern) {
+    const uint BRANCH_INSTS = 2;
+    const uint WIDE_REG_INSTS = 2*(512/32);
+
+    uint num_rows = pattern_victim_offsets(pattern).back() + 1;
+    uint num_victims = pattern_victim_offsets(pattern).size();
+
+    uint init_insts = 1 + num_rows*(1 + WIDE_REG_INSTS + insts_with_delay(trcd_cycles) + insts_with_delay(0) + 1 + BRANCH_INSTS + insts_with_delay(trp_cycles));
+    uint refresh_insts = 4 + 3*insts_with_delay(0) + BRANCH_INSTS;
+    uint hammer_insts = 4 + BRANCH_INSTS + num_pattern_slots(pattern)*pattern_slot_insts() + pattern.ref_intervals*refresh_insts;
+    uint read_insts = 1 + num_victims*(1 + insts_with_delay(trcd_cycles) + 2 + BRANCH_INSTS + insts_with_delay(trp_cycles));
+
+    return insts_with_delay(0) + init_insts + hammer_insts + read_insts + 4;
+}
+
+// Hammers the rows around anchor_row in the exact slot order of the schedule, issuing a REF after every schedule.slots_per_ref slots.
+// The schedule is repeated until num_refs REFs are issued (rounded up to a multiple of schedule.ref_intervals).
+// Idle slots spend the same time as an ACT-PRE pair so that the position of every ACT relative to the REFs is as specified
+void perform_pattern_hammers(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const PhysicalRowID anchor_row, 
+                        const HammerSchedule& schedule, const uint num_refs, const bool fake_ref) {
+
+    uint initial_free_regs = reg_alloc.num_free_regs();
+
+    SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_pattern_it = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_patterns = reg_alloc.allocate_SMC_REG();
+
+    uint num_patterns = (num_refs + schedule.ref_intervals - 1)/schedule.ref_intervals;
+    prog.add_li(0, reg_pattern_it);
+    prog.add_li(num_patterns, reg_num_patterns);
+
+    std::string lbl_pattern = createSMCLabel("HAMMER_PATTERN");
+    prog.add_label(lbl_pattern);
+        for (uint slot = 0; slot < schedule.slot_offsets.size(); slot++) {
+            int offset = schedule.slot_offsets[slot];
+            bool idle = offset == HAMMER_SLOT_IDLE;
+
+            prog.add_li(idle ? to_logical_row_id(anchor_row) : to_logical_row_id(anchor_row + offset), reg_row_addr);
+            add_op_with_delay(prog, idle ? SMC_NOP() : SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, tras_cycles - 1);
+            add_op_with_delay(prog, idle ? SMC_NOP() : SMC_PRE(reg_bank_addr, 0, 0), 0, trp_cycles - 5);
+
+            if ((slot + 1) % schedule.slots_per_ref == 0)
+                perform_refresh(prog, reg_alloc, 1, 0, fake_ref);
+        }
+
+        prog.add_addi(reg_pattern_it, 1, reg_pattern_it);
+    prog.add_branch(prog.BR_TYPE::BL, reg_pattern_it, reg_num_patterns, lbl_pattern);
+
+    reg_alloc.free_SMC_REG(reg_row_addr);
+    reg_alloc.free_SMC_REG(reg_pattern_it);
+    reg_alloc.free_SMC_REG(reg_num_patterns);
+
+    assert(reg_alloc.num_free_regs() == initial_free_regs);
+}
+
+// returns the number of bitflips in each victim row of the pattern (see pattern_victim_offsets()) after hammering the rows around anchor_row with the pattern
+std::vector<uint> testHammerPattern(SoftMCPlatform& platform, const uint target_bank, const PhysicalRowID anchor_row, const HammerPattern& pattern, 
+                        const uint num_refs, const bool fake_ref, const bitset<512>& victim_data, const bitset<512>& aggr_data) {
+
+    HammerSchedule schedule = compile_hammer_pattern(pattern);
+
+    std::vector<LogicalRowID> victim_ids, aggr_ids;
+    for (auto offset : pattern_victim_offsets(pattern))
+        victim_ids.push_back(to_logical_row_id(anchor_row + offset));
+    for (auto offset : pattern_aggressor_offsets(pattern))
+        aggr_ids.push_back(to_logical_row_id(anchor_row + offset));
+
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
+    prog.add_li(target_bank, reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
+
+    add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
+
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, victim_ids, std::vector<bitset<512>>(victim_ids.size(), victim_data));
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, aggr_ids, std::vector<bitset<512>>(aggr_ids.size(), aggr_data));
+
+    perform_pattern_hammers(prog, reg_alloc, reg_bank_addr, anchor_row, schedule, num_refs, fake_ref);
+
+    read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, victim_ids);
+
+    reg_alloc.free_SMC_REG(reg_bank_addr);
+    reg_alloc.free_SMC_REG(reg_num_cols);
+
+    prog.add_inst(SMC_END());
+
+    execute_program(platform, prog);
+    #ifdef PRINT_SOFTMC_PROGS
+    if(print_times > 0) {
+        prog.pretty_print();
+        print_times--;
+    }
+    #endif
+
+    ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*victim_ids.size());
+    receive_data(platform, buf.data(), buf.size());
+
+    std::vector<uint> num_bitflips_per_victim;
+    std::vector<uint> bitflips;
+    for (uint i_victim = 0; i_victim < victim_ids.size(); i_victim++) {
+        collect_bitflips(bitflips, buf.data() + i_victim*ROW_SIZE, victim_data);
+        num_bitflips_per_victim.push_back(bitflips.size());
+    }
+
+    return num_bitflips_per_victim;
+}
+
+// sets last_anchor to the last anchor row in [first_row_id, last_row_id] whose pattern rows all fit into the bank. Returns false
+// when the pattern rows of first_row_id already do not fit, i.e., the pattern cannot be tested in the range
+bool lastPatternAnchor(const HammerPattern& pattern, const PhysicalRowID first_row_id, const PhysicalRowID last_row_id, PhysicalRowID& last_anchor) {
+    uint pattern_rows = pattern_victim_offsets(pattern).back() + 1;
+
+    if (pattern_rows > (uint)NUM_ROWS || first_row_id > NUM_ROWS - pattern_rows)
+        return false;
+
+    last_anchor = std::min(last_row_id, NUM_ROWS - pattern_rows);
+    return true;
+}
+
+// hammers every anchor row in [first_row_id, last_row_id] with the pattern. The output has the same format as hammerBank()'s
+void hammerBankWithPattern(SoftMCPlatform& platform, const uint target_bank, const PhysicalRowID first_row_id, const PhysicalRowID last_row_id,
+                        const HammerPattern& pattern, const uint num_ref_loops, const bool fake_ref, 
+                        const uint input_data_victims, const uint input_data_aggressors, boost::filesystem::ofstream& out_file) {
+
+    bitset<512> victims_data = setup_data_pattern(input_data_victims);
+    bitset<512> aggrs_data = setup_data_pattern(input_data_aggressors);
+
+    std::cout << BLUE_TXT << "Hammering with pattern: " << hammer_pattern_to_string(pattern) << NORMAL_TXT << std::endl;
+
+    PhysicalRowID last_anchor;
+    if (!lastPatternAnchor(pattern, first_row_id, last_row_id, last_anchor)) {
+        std::cerr << RED_TXT << "ERROR: The " << pattern_victim_offsets(pattern).back() + 1 << " rows of the pattern do not fit into the bank after row "
+            << first_row_id << ". Skipping the pattern" << NORMAL_TXT << std::endl;
+        return;
+    }
+
+    std::cout << YELLOW_TXT << "There are " << pattern_victim_offsets(pattern).size() << " victim rows" << NORMAL_TXT << std::endl;
+
+    progresscpp::ProgressBar progress_bar(last_anchor - first_row_id + 1, 70, '#', '-');
+
+    for (PhysicalRowID anchor_row = first_row_id; anchor_row <= last_anchor; anchor_row++) {
+        auto num_bitflips_per_victim = testHammerPattern(platform, target_bank, anchor_row, pattern, num_ref_loops, fake_ref, victims_data, aggrs_data);
+
+        if (std::accumulate(num_bitflips_per_victim.begin(), num_bitflips_per_victim.end(), 0u) > 0) {
+            out_file << std::setw(5) << anchor_row << ": ";
+
+            for (auto num_bf : num_bitflips_per_victim)
+                out_file << num_bf << " ";
+
+            out_file << std::endl;
+        }
+
+        ++progress_bar;
+        progress_bar.display();
+    }
+
+    progress_bar.done();
+}
+
+// Samples num_patterns random patterns and tests each on fuzz_anchors random anchor rows in [first_row_id, last_row_id].
+// Writes a "<total bitflips> <pattern>" line per tested pattern to out_file. The pattern can be replayed with --pattern
+void fuzzHammerPatterns(SoftMCPlatform& platform, const uint target_bank, const PhysicalRowID first_row_id, const PhysicalRowID last_row_id,
+                        const uint num_patterns, const uint fuzz_anchors, const uint fuzz_seed, const uint num_ref_loops, const bool fake_ref, 
+                        const uint input_data_victims, const uint input_data_aggressors, boost::filesystem::ofstream& out_file) {
+
+    const uint FUZZ_MAX_PAIRS = 6;
+    const uint FUZZ_MAX_OFFSET = 16;
+    const uint FUZZ_MAX_AMPLITUDE = 4;
+    const uint FUZZ_MAX_REF_INTERVALS = 4;
+
+    bitset<512> victims_data = setup_data_pattern(input_data_victims);
+    bitset<512> aggrs_data = setup_data_pattern(input_data_aggressors);
+
+    std::mt19937 rng(fuzz_seed);
+    uint slots_per_ref = default_pattern_slots_per_ref();
+
+    // limit the number of REF intervals a pattern spans such that the largest possible pattern fits into the instruction memory
+    uint max_ref_intervals = FUZZ_MAX_REF_INTERVALS;
+    while (max_ref_intervals > 1) {
+        HammerPattern largest{slots_per_ref, max_ref_intervals, {HammerAggressor{(int)FUZZ_MAX_OFFSET, 1, 0, 1}}};
+        if (estimatePatternInsts(largest) <= SOFTMC_MAX_PROG_INSTS)
+            break;
+        max_ref_intervals--;
+    }
+
+    std::cout << BLUE_TXT << "Fuzzing " << num_patterns << " patterns with " << slots_per_ref << " ACT slots per REF interval, " 
+        << fuzz_anchors << " anchor row(s) per pattern" << NORMAL_TXT << std::endl;
+
+    progresscpp::ProgressBar progress_bar(num_patterns, 70, '#', '-');
+
+    uint num_effective_patterns = 0, num_skipped_patterns = 0;
+    for (uint i = 0; i < num_patterns; i++) {
+        HammerPattern pattern = sample_hammer_pattern(rng, slots_per_ref, max_ref_intervals, FUZZ_MAX_PAIRS, FUZZ_MAX_OFFSET, FUZZ_MAX_AMPLITUDE);
+
+        // the pattern is neither tested nor logged, as it cannot be placed at any anchor row of the range
+        PhysicalRowID last_anchor;
+        if (!lastPatternAnchor(pattern, first_row_id, last_row_id, last_anchor)) {
+            num_skipped_patterns++;
+            ++progress_bar;
+            progress_bar.display();
+            continue;
+        }
+
+        std::uniform_int_distribution<uint> anchor_dist(first_row_id, last_anchor);
+
+        ulong total_bitflips = 0;
+        for (uint i_anchor = 0; i_anchor < fuzz_anchors; i_anchor++) {
+            auto num_bitflips_per_victim = testHammerPattern(platform, target_bank, anchor_dist(rng), pattern, num_ref_loops, fake_ref, victims_data, aggrs_data);
+            total_bitflips += std::accumulate(num_bitflips_per_victim.begin(), num_bitflips_per_victim.end(), 0u);
+        }
+
+        out_file << total_bitflips << " " << hammer_pattern_to_string(pattern) << std::endl;
+
+        if (total_bitflips > 0)
+            num_effective_patterns++;
+
+        ++progress_bar;
+        progress_bar.display();
+    }
+
+    progress_bar.done();
+
+    std::cout << YELLOW_TXT << num_effective_patterns << " of " << num_patterns << " patterns caused bitflips" << NORMAL_TXT << std::endl;
+    if (num_skipped_patterns > 0)
+        std::cout << YELLOW_TXT << num_skipped_patterns << " patterns did not fit into the bank after row " << first_row_id << " and were skipped" 
+            << NORMAL_TXT << std::endl;
+}
+
+// Picks the largest hammers_per_dummy such that a refresh loop of row_layout still completes within refs_per_loop*tREFI. The cycles of a refresh loop are
+// calculated exactly from the code hammer_aggressors() emits, i.e., including the row address LIs, the multi-bank dummy ACTs, and the loop overheads.
+// loop_acts is set to the number of ACTs a refresh loop issues with the returned hammers_per_dummy
+uint fitDummyHammers(const std::vector<uint>& target_banks, const std::string& row_layout, const PhysicalRowID anchor_row, const std::vector<uint>& num_hammers, 
+        const std::vector<LogicalRowID>& dummy_rows, const uint refs_per_loop, const bool trrref_sync, 
+        const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint>& dummy_banks,
+        const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, ulong& loop_acts) {
+
+    uint hammers_per_dummy = 0;
+    uint num_dummies = dummy_rows.size();
+
+    uint dummy_hammer_phases = (hammer_dummies_after & hammer_dummies_before) ? 2 : 
+                                    (hammer_dummies_after | hammer_dummies_before) ? 1 : 0;
+
+    std::vector<LogicalRowID> aggr_ids = getRowIDsOfType(row_layout, anchor_row, 'A');
+    toLogicalRowIDs(aggr_ids);
+
+    auto plan_loop = [&](const uint t_hammers_per_dummy) {
+        return planRefreshLoop(aggr_ids, num_hammers, dummy_rows, t_hammers_per_dummy, hammer_dummies_independently, 
+            hammer_dummies_before, hammer_dummies_after, refs_per_loop, trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy);
+    };
+
+    const ulong loop_budget = (ulong)refs_per_loop*trefi_cycles;
+
+    if(refreshLoopCycles(plan_loop(0), target_banks, dummy_banks.size()) > loop_budget){
+        std::cerr << YELLOW_TXT << "Warning: Activating more than the time between two REF commands permit under default refresh" << NORMAL_TXT << std::endl;
+    } else if (num_dummies > 0 && dummy_hammer_phases > 0) {
+        auto fits = [&](const uint t_hammers_per_dummy) {
+            return refreshLoopCycles(plan_loop(t_hammers_per_dummy), target_banks, dummy_banks.size()) <= loop_budget;
+        };
+
+        // the loop cycles grow with hammers_per_dummy. Find an upper bound and then binary search for the largest hammers_per_dummy that fits
+        uint hpd_high = 1;
+        while(fits(hpd_high))
+            hpd_high *= 2;
+
+        uint hpd_low = hpd_high/2; // fits, or 0
+        while(hpd_high - hpd_low > 1) {
+            uint hpd_mid = (hpd_low + hpd_high)/2;
+            if(fits(hpd_mid))
+                hpd_low = hpd_mid;
+            else
+                hpd_high = hpd_mid;
+        }
+
+        hammers_per_dummy = hpd_low;
+    }
+
+    auto loop_plan = plan_loop(hammers_per_dummy);
+    ulong loop_cycles = refreshLoopCycles(loop_plan, target_banks, dummy_banks.size());
+    loop_acts = refreshLoopACTs(loop_plan, target_banks.size(), dummy_banks.size());
+
+    // the ACTs that could be issued to the target banks back to back (i.e., every tRC, and at most four per tFAW) in the time left after the REFs
+    ulong refresh_cycles = 0;
+    for (auto& step : loop_plan)
+        refresh_cycles += perform_refresh_cycles(step.num_refs, 0);
+    ulong hammer_cycles = loop_budget - std::min(loop_budget, refresh_cycles);
+    ulong max_loop_acts = target_banks.size()*(hammer_cycles/(tras_cycles + trp_cycles));
+    if(target_banks.size() > 1)
+        max_loop_acts = std::min(max_loop_acts, 4*(hammer_cycles/tfaw_cycles));
+
+    auto default_precision = std::cout.precision();
+    std::cout << BLUE_TXT << "A refresh loop takes " << loop_cycles << " of " << loop_budget << " cycles (" 
+        << std::fixed << std::setprecision(1) << (100.0*loop_cycles/loop_budget) << "% of " << refs_per_loop << " tREFI) and issues " 
+        << loop_acts << " ACTs (" << (max_loop_acts ? 100.0*loop_acts/max_loop_acts : 0.0) << "% of the tRC-bound ACT rate)" << NORMAL_TXT << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout.precision(default_precision);
+
+    std::cout << BLUE_TXT << "Hammering the dummy rows as many times as possible given the ACT count for the aggressors." << NORMAL_TXT << std::endl;
+    std::cout << BLUE_TXT << "Number of dummies: " << num_dummies << NORMAL_TXT << std::endl;
+    std::cout << BLUE_TXT << "Hammers per dummy (per bank): " << hammers_per_dummy << NORMAL_TXT << std::endl;
+    std::cout << BLUE_TXT << "Total dummy hammers: " << hammers_per_dummy*num_dummies*dummy_banks.size() << NORMAL_TXT << std::endl;
+
+    return hammers_per_dummy;
+}
+
+// The hammer counts of the aggressors of row_layout. --hammers_per_ref_loop specifies a count per aggressor. When testing multiple 
+// layouts with different numbers of aggressors, the layouts whose aggressor count does not match use the first count for all aggressors
+std::vector<uint> layoutHammerCounts(const std::string& row_layout, const std::vector<uint>& num_hammers) {
+    uint num_aggrs = std::count(row_layout.begin(), row_layout.end(), 'A');
+
+    if(num_hammers.size() == num_aggrs || num_hammers.empty())
+        return num_hammers;
+
+    return std::vector<uint>(num_aggrs, num_hammers[0]);
+}
+
+// last_row_id is inclusive. With multiple target_banks, the same anchor rows are attacked in all banks concurrently.
+// With multiple row_layouts, each anchor row is tested with all layouts back to back, and the bitflips of layout i are written to out_files[i]
+void hammerBank(SoftMCPlatform& platform, const std::vector<uint>& target_banks, const PhysicalRowID first_row_id, const PhysicalRowID last_row_id, 
         const std::vector<uint>& num_hammers, const uint num_ref_loops, const uint refs_per_loop, const bool trrref_sync, 
         const uint num_dummies, const bool hammer_dummies_independently, const bool hammer_dummies_before, const bool hammer_dummies_after, const std::vector<uint>& dummy_banks,
         const bool cascaded_hammer_aggr, const bool cascaded_hammer_dummy, const bool fake_hammer, const bool fake_dummy_hammer, const bool fake_ref,
-        const std::string& row_layout, const uint input_data_victims, const uint input_data_aggressors, 
-        const uint bitflip_counting_granularity,
-        boost::filesystem::ofstream& out_file){
-
-    std::vector<uint> victims_pos;
-    for (uint i = 0; i < row_layout.size(); i++) {
-        if (row_layout[i] == 'V')
-            victims_pos.push_back(i);
+        const std::vector<std::string>& row_layouts, const uint input_data_victims, const uint input_data_aggressors, 
+        const uint bitflip_counting_granularity, uint batch_size,
+        std::vector<boost::filesystem::ofstream*>& out_files, std::vector<BitflipMapWriter>& bitflip_maps){
+
+    // the number of victims of each layout and where their data starts within the data read back for an anchor row
+    std::vector<uint> layout_victims;
+    std::vector<uint> layout_data_offset;
+    uint anchor_data_size = 0;
+    for (auto& row_layout : row_layouts) {
+        layout_victims.push_back(std::count(row_layout.begin(), row_layout.end(), 'V'));
+        layout_data_offset.push_back(anchor_data_size);
+
+        // the victims of a layout are read back bank by bank
+        anchor_data_size += ROW_SIZE*layout_victims.back()*target_banks.size();
     }
 
-    char buf[ROW_SIZE*victims_pos.size()*2];
     bitset<512> victims_data = setup_data_pattern(input_data_victims);
     bitset<512> aggrs_data = setup_data_pattern(input_data_aggressors);
 
     std::map<uint, std::vector<uint>> num_bitflips_data;
 
-    std::cout << YELLOW_TXT << "There are " << victims_pos.size() << " victim rows" << NORMAL_TXT << std::endl;
+    for (uint i = 0; i < row_layouts.size(); i++)
+        std::cout << YELLOW_TXT << "There are " << layout_victims[i] << " victim rows" << (row_layouts.size() > 1 ? " in " + row_layouts[i] : "") << NORMAL_TXT << std::endl;
+    if(target_banks.size() > 1)
+        std::cout << YELLOW_TXT << "Attacking " << target_banks.size() << " banks concurrently" << NORMAL_TXT << std::endl;
 
     // Setting up a progress bar
     uint total_iterations = last_row_id - first_row_id + 1;
     progresscpp::ProgressBar progress_bar(total_iterations, 70, '#', '-');
 
     std::vector<uint32_t> bitflips;
-    std::vector<uint> num_bitflips_per_victim;
-    num_bitflips_per_victim.reserve(victims_pos.size());
+
+    // the bitflip counts of all victims of an anchor row, reused for every anchor row
+    uint chunks_per_victim = num_bitflip_chunks(bitflip_counting_granularity);
+    std::vector<std::vector<uint32_t>> layout_chunk_counts;
+    for (auto num_victims : layout_victims)
+        layout_chunk_counts.push_back(std::vector<uint32_t>(num_victims*chunks_per_victim));
 
     std::vector<LogicalRowID> dummy_rows;
     LogicalRowID dummy_row_region_start = 3*NUM_ROWS/4;
     pick_dummy_aggressors(dummy_rows, num_dummies, dummy_row_region_start);
 
-    // calculate the maximum ammount of hammers_per_dummy based on remaining ACTs after hammering the aggressor rows
-    // For example, assuming we can perform 150 ACTs between two REFs with nominal refresh rate,
-        // hammering two aggressors 20 times each would leave floor(110/16) ACTs for each of the 16 dummy rows
-    uint hammers_per_dummy = 0;
+    std::vector<LayoutConfig> layouts;
+    for(auto& row_layout : row_layouts) {
+        LayoutConfig layout;
+        layout.row_layout = row_layout;
+        layout.num_hammers = layoutHammerCounts(row_layout, num_hammers);
 
-    const uint TREFI = 7800; // assume tREFI = 7800ns
-    const uint TRC = 50; // assume activate-precharge complete in 50ns
-    const uint MAX_ACTS_PER_REF = (TREFI/TRC)*refs_per_loop; 
+        if(row_layouts.size() > 1)
+            std::cout << YELLOW_TXT << "Row layout " << row_layout << ":" << NORMAL_TXT << std::endl;
 
-    uint dummy_hammer_phases = (hammer_dummies_after & hammer_dummies_before) ? 2 : 
-                                    (hammer_dummies_after | hammer_dummies_before) ? 1 : 0;
-    
-    uint total_aggressor_ACTs = std::accumulate(num_hammers.begin(), num_hammers.end(), 0);
-    if(total_aggressor_ACTs >= MAX_ACTS_PER_REF){
-        std::cerr << YELLOW_TXT << "Warning: Activating more than the time between two REF commands permit under default refresh" << NORMAL_TXT << std::endl;
-    } else {
-        if (dummy_hammer_phases == 0)
-            hammers_per_dummy = 0;
-        else
-            hammers_per_dummy = std::floor((MAX_ACTS_PER_REF-total_aggressor_ACTs)/(float)(num_dummies*dummy_hammer_phases));
+        layout.hammers_per_dummy = fitDummyHammers(target_banks, row_layout, first_row_id, layout.num_hammers, dummy_rows, refs_per_loop, trrref_sync, 
+            hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks, cascaded_hammer_aggr, cascaded_hammer_dummy, layout.loop_acts);
+
+        layouts.push_back(layout);
     }
 
-    std::cout << BLUE_TXT << "Hammering the dummy rows as many times as possible given the ACT count for the aggressors." << NORMAL_TXT << std::endl;
-    std::cout << BLUE_TXT << "Number of dummies: " << num_dummies << NORMAL_TXT << std::endl;
-    std::cout << BLUE_TXT << "Hammers per dummy (per bank): " << hammers_per_dummy << NORMAL_TXT << std::endl;
-    std::cout << BLUE_TXT << "Total dummy hammers: " << hammers_per_dummy*num_dummies*dummy_banks.size() << NORMAL_TXT << std::endl;
+    // Testing one anchor row per program makes the sweep bound by program generation and PCIe round trips when hammer counts are small.
+    // Instead, we test up to 'batch_size' anchor rows in a single program and generate the next program while the FPGA executes the current one.
+    // All layouts of an anchor row go into the same program
+    uint anchor_insts = 0;
+    for(auto& layout : layouts)
+        anchor_insts += estimateAnchorInsts(layout.row_layout, layout.num_hammers, num_dummies, layout.hammers_per_dummy, hammer_dummies_independently, dummy_banks, 
+            refs_per_loop, trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy, target_banks.size());
+
+    if(batch_size == 0) {
+        const uint BATCH_PROLOGUE_INSTS = 4; // the LIs at the beginning and the END at the end of the program
+        batch_size = std::max((SOFTMC_MAX_PROG_INSTS - BATCH_PROLOGUE_INSTS)/anchor_insts, 1u);
+    }
+    batch_size = std::min(batch_size, total_iterations);
+
+    std::cout << BLUE_TXT << "Testing " << batch_size << " anchor row(s) per SoftMC program (estimated " << anchor_insts << " instructions per anchor row)" << NORMAL_TXT << std::endl;
+
+    // pick the dummy rows of each anchor row upfront so that the programs can be generated independently of each other
+    std::vector<PhysicalRowID> anchor_rows;
+    std::vector<std::vector<LogicalRowID>> anchor_dummy_rows;
+    anchor_rows.reserve(total_iterations);
+    anchor_dummy_rows.reserve(total_iterations);
 
     for(PhysicalRowID anchor_row = first_row_id; anchor_row <= last_row_id; anchor_row++){
 
@@ -1234,36 +2294,103 @@ void hammerBank(SoftMCPlatform& platform, const uint target_bank, const Physical
             pick_dummy_aggressors(dummy_rows, num_dummies, dummy_row_region_start);
         }
 
-        performHammer(platform, target_bank, anchor_row, row_layout, num_hammers, dummy_rows, hammers_per_dummy, hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks,
-            num_ref_loops, refs_per_loop, trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy, victims_data, aggrs_data, fake_hammer, fake_dummy_hammer, fake_ref);
+        anchor_rows.push_back(anchor_row);
+        anchor_dummy_rows.push_back(dummy_rows);
+    }
 
-        platform.receiveData(buf, ROW_SIZE*victims_pos.size());
-        // std::cout << "Succesffuly received the row data!" << std::endl; // DEBUG
+    auto build_batch = [&](const uint first_anchor) {
+        trace_set_thread_name("batch builder"); // each batch is built on a new thread
+        TraceSpan span("generate");
 
-        ulong total_bitflips = 0;
-        num_bitflips_per_victim.clear();
+        uint batch_end = std::min(first_anchor + batch_size, total_iterations);
+
+        std::vector<PhysicalRowID> batch_anchor_rows(anchor_rows.begin() + first_anchor, anchor_rows.begin() + batch_end);
+        std::vector<std::vector<LogicalRowID>> batch_dummy_rows(anchor_dummy_rows.begin() + first_anchor, anchor_dummy_rows.begin() + batch_end);
+
+        SoftMCProgram prog = buildHammerBatch(target_banks, batch_anchor_rows, batch_dummy_rows, layouts, 
+            hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks, num_ref_loops, refs_per_loop, 
+            trrref_sync, cascaded_hammer_aggr, cascaded_hammer_dummy, victims_data, aggrs_data, fake_hammer, fake_dummy_hammer, fake_ref);
+
+        // lowering in the background as well keeps it off the critical path
+        prog.lower();
+        return prog;
+    };
 
-        for (uint i_victim = 0; i_victim < victims_pos.size(); i_victim++) {
-            // check for bitflips
-            collect_bitflips(bitflips, buf + i_victim*ROW_SIZE, victims_data);
+    ulong anchor_acts = 0;
+    for(auto& layout : layouts)
+        anchor_acts += fake_hammer ? 0 : layout.loop_acts*num_ref_loops;
 
-            total_bitflips += bitflips.size();
+    ArenaBuffer buf = receive_buffers.acquire(anchor_data_size*batch_size);
 
-            auto bitflips_per_cl = count_bitflips_in_chunks(bitflips, bitflip_counting_granularity);
-            num_bitflips_per_victim.insert(num_bitflips_per_victim.end(), bitflips_per_cl.begin(), bitflips_per_cl.end());
+    std::future<SoftMCProgram> next_prog = std::async(std::launch::async, build_batch, 0);
 
+    for(uint first_anchor = 0; first_anchor < total_iterations; first_anchor += batch_size){
+        uint cur_batch_size = std::min(batch_size, total_iterations - first_anchor);
+
+        SoftMCProgram prog;
+        {
+            TraceSpan span("wait_for_program"); // the program of the next batch is generated in the background
+            prog = next_prog.get();
         }
+        execute_program(platform, prog);
 
-        if(total_bitflips > 0) {
-            out_file << std::setw(5) << anchor_row << ": ";
+        // generate the next program while the FPGA is busy with the current one
+        if(first_anchor + batch_size < total_iterations)
+            next_prog = std::async(std::launch::async, build_batch, first_anchor + batch_size);
 
-            for(auto num_bf : num_bitflips_per_victim)
-                out_file << num_bf << " ";
+        receive_data(platform, buf.data(), anchor_data_size*cur_batch_size);
+        // std::cout << "Succesffuly received the row data!" << std::endl; // DEBUG
 
-            out_file << std::endl;
+        tool_metrics.rows_tested += cur_batch_size*(anchor_data_size/ROW_SIZE); // the victim rows of all layouts and banks
+        tool_metrics.acts_issued += cur_batch_size*anchor_acts;
+
+        TraceSpan span("analyze");
+
+        for(uint i_anchor = 0; i_anchor < cur_batch_size; i_anchor++) {
+            PhysicalRowID anchor_row = anchor_rows[first_anchor + i_anchor];
+
+            for (uint i_layout = 0; i_layout < row_layouts.size(); i_layout++) {
+                uint num_victims = layout_victims[i_layout];
+                std::vector<uint32_t>& chunk_counts = layout_chunk_counts[i_layout];
+                boost::filesystem::ofstream& out_file = *out_files[i_layout];
+
+                for (uint i_bank = 0; i_bank < target_banks.size(); i_bank++) {
+                    const char* bank_data = buf.data() + i_anchor*anchor_data_size + layout_data_offset[i_layout] + i_bank*ROW_SIZE*num_victims;
+
+                    ulong total_bitflips = 0;
+
+                    for (uint i_victim = 0; i_victim < num_victims; i_victim++) {
+                        // check for bitflips
+                        collect_bitflips(bitflips, bank_data + i_victim*ROW_SIZE, victims_data);
+
+                        total_bitflips += bitflips.size();
+
+                        count_bitflips_in_chunks(bitflips, bitflip_counting_granularity, chunk_counts.data() + i_victim*chunks_per_victim);
+                    }
+
+                    if(total_bitflips == 0)
+                        continue;
+
+                    if(!bitflip_maps.empty()) {
+                        bitflip_maps[i_layout*target_banks.size() + i_bank].add_row(anchor_row, chunk_counts.data());
+                    } else {
+                        // the bank is printed only when attacking multiple banks to keep the single-bank output format unchanged
+                        if(target_banks.size() > 1)
+                            out_file << std::setw(2) << target_banks[i_bank] << " ";
+
+                        out_file << std::setw(5) << anchor_row << ": ";
+
+                        for(auto num_bf : chunk_counts)
+                            out_file << num_bf << " ";
+
+                        out_file << std::endl;
+                    }
+                }
+            }
+
+            ++progress_bar;
         }
 
-        ++progress_bar;
         progress_bar.display();
         
     }
@@ -1272,13 +2399,15 @@ void hammerBank(SoftMCPlatform& platform, const uint target_bank, const Physical
 }
 
 
-int main(int argc, char** argv)
+int rowhammerattacker_main(SoftMCPlatform* shared_platform, int argc, char** argv)
 {
     /* Program options */
     string out_filename = "./out.txt";
     bool append_output = false;
+    std::string output_format = "text";
 
     uint target_bank = 1;
+    std::vector<uint> attack_banks;
     vector<int> row_range{-1, -1};
     std::vector<uint> num_hammers = {70, 70};
     uint num_ref_loops = 8192;
@@ -1296,12 +2425,30 @@ int main(int argc, char** argv)
     bool fake_ref = false;
     bool shift_refs = false;
     std::string row_layout = "VAVAV";
+    std::vector<std::string> row_layouts;
     uint input_data_victims = 2;
     uint input_data_aggressors = 1;
 
     uint bitflip_counting_granularity = 0; // When 0, counts and outputs the bitflips for each row. Otherwise based on the byte granularity provided with this parameter. E.g., 8 would report bitflips in every 8-byte chunk in the tested memory region.
 
     uint arg_log_phys_conv_scheme = 0;
+    std::string row_mapping_filename = "";
+
+    uint batch_size = 0; // When 0, as many anchor rows as fit into the instruction memory are tested in a single SoftMC program
+
+    bool hcfirst_map = false;
+    uint hcfirst_parallel_rows = 0;
+
+    std::string hammer_pattern = "";
+    uint fuzz_patterns = 0;
+    uint fuzz_anchors = 4;
+    uint fuzz_seed = 0;
+
+    std::string trace_filename = "";
+    std::string metrics_filename = "";
+
+    std::string discover_mapping_filename = "";
+    uint discover_probes = 64;
 
     // try{
     options_description desc("RowHammerAttacker Options");
@@ -1309,8 +2456,10 @@ int main(int argc, char** argv)
         ("help,h", "Prints this usage statement.")
         ("out,o", value(&out_filename)->default_value(out_filename), "Specifies a path for the output file.")
         ("bank,b", value(&target_bank)->default_value(target_bank), "Specifies the address of the bank to perform the RowHammer attack on.")
+        ("attack_banks", value<vector<uint>>(&attack_banks)->multitoken(), "Specifies multiple banks to perform the RowHammer attack on concurrently (overrides --bank). The same anchor rows are attacked in all banks by interleaving their ACTs at the tightest tRRD_S, tRRD_L, and tFAW spacing, so a sweep over N banks takes about as long as a sweep over a single bank. Only the RowHammer attack with --row_layout supports multiple banks.")
         ("range", value<vector<int>>(&row_range)->multitoken(), "Specifies a range of row addresses (start and end values are both inclusive) to perform the RowHammer attack on. The range is set to cover the entire bank when --range is not provided.")
         ("row_layout", value(&row_layout)->default_value(row_layout), "The layout of victim (V) and aggressor (A) rows. E.g., VAV, VVVAVVV.")
+        ("row_layouts", value<vector<string>>(&row_layouts)->multitoken(), "Specifies multiple row layouts to test in a single sweep (overrides --row_layout). Each anchor row is tested with all layouts back to back in the same SoftMC program, and the bitflips of each layout are written to <out>.<layout>. Layouts whose number of aggressors differs from the number of --hammers_per_ref_loop values hammer all aggressors with the first value.")
         
         ("hammers_per_ref_loop", value<vector<uint>>(&num_hammers)->multitoken(), "Number of ACTs (hammers) to perform per aggressor row before each REF command, i.e., per refresh loop.")
         ("cascaded_hammer_aggr", bool_switch(&cascaded_hammer_aggr)->default_value(cascaded_hammer_aggr), "When specified, the aggressor rows are hammered in non-interleaved manner, e.g., one row is hammered N times and then the next row is hammered. Otherwise, the aggressor rows get activated only once, one after another N times.")
@@ -1333,9 +2482,26 @@ int main(int argc, char** argv)
         ("input_victims", value(&input_data_victims)->default_value(input_data_victims), "Input data pattern for victim rows. 0: random, 1: all ones, 2: all zeros, 3: colstripe (0101), 4: inverse colstripe (1010), 5: checkered (0101, 1010), 6: inverse checkered (1010, 0101)")
         ("input_aggressors", value(&input_data_aggressors)->default_value(input_data_aggressors), "Input data pattern for aggressor rows. 0: random, 1: all ones, 2: all zeros, 3: colstripe (0101), 4: inverse colstripe (1010), 5: checkered (0101, 1010), 6: inverse checkered (1010, 0101)")
         ("log_phys_scheme", value(&arg_log_phys_conv_scheme)->default_value(arg_log_phys_conv_scheme), "Specifies how to convert logical row IDs to physical row ids and the other way around. Pass 0 (default) for sequential mapping, 1 for the mapping scheme typically used in Samsung chips.")
+        ("row_mapping_file", value(&row_mapping_filename), "Specifies a file that describes how to convert logical row IDs to physical row IDs (overrides --log_phys_scheme). Each line remaps a physical row address bit to the XOR of logical bits, e.g., \"p1 = l1 ^ l3\" (see tools/row_mapping.h). --discover_mapping produces such files.")
         ("bitflip_counting_granularity", value(&bitflip_counting_granularity)->default_value(bitflip_counting_granularity), "When 0, counts and outputs the bitflips for each row. Otherwise based on the byte granularity provided with this parameter. E.g., 8 would report bitflips in every 8-byte chunk in the tested memory region.")
         
+        ("batch_size", value(&batch_size)->default_value(batch_size), "Specifies the number of anchor rows to test in a single SoftMC program. When 0 (default), the number is picked based on the size of the instruction memory (SOFTMC_MAX_PROG_INSTS).")
+        
+        ("hcfirst_map", bool_switch(&hcfirst_map)->default_value(hcfirst_map), "When specified, instead of performing the RowHammer attack, finds the HC_first (i.e., the minimum single-sided hammer count that causes a bitflip) of every row in --range and writes an \"<row>: <HC_first>\" line per row to the --out file. HC_first is 0 when it is outside of the search range.")
+        ("hcfirst_parallel_rows", value(&hcfirst_parallel_rows)->default_value(hcfirst_parallel_rows), "Specifies the number of rows to search for HC_first at the same time with --hcfirst_map. When 0 (default), the number is picked based on the size of the instruction memory (SOFTMC_MAX_PROG_INSTS).")
+        
+        ("pattern", value(&hammer_pattern), "When specified, hammers the rows around each anchor row in --range with the given non-uniform hammer pattern instead of --row_layout and --hammers_per_ref_loop. Format: <slots_per_ref>:<ref_intervals>|<offset>,<frequency>,<phase>,<amplitude>;... (see tools/hammer_pattern.h). The patterns logged by --fuzz can be passed as is.")
+        ("fuzz", value(&fuzz_patterns)->default_value(fuzz_patterns), "When non-zero, samples and tests the specified number of random non-uniform hammer patterns and writes a \"<total bitflips> <pattern>\" line per pattern to the --out file.")
+        ("fuzz_anchors", value(&fuzz_anchors)->default_value(fuzz_anchors), "Specifies the number of random anchor rows within --range to test each pattern on with --fuzz.")
+        ("fuzz_seed", value(&fuzz_seed)->default_value(fuzz_seed), "Specifies the seed for sampling the patterns and the anchor rows with --fuzz.")
+        
+        ("discover_mapping", value(&discover_mapping_filename), "When specified, instead of performing the RowHammer attack, discovers how the module maps logical row IDs to physical row IDs by hammering rows in --range single-sided and observing which rows experience bitflips. The mapping is written to the specified file, which can be passed to all tools with --row_mapping_file.")
+        ("discover_probes", value(&discover_probes)->default_value(discover_probes), "Specifies the number of rows, starting from the beginning of --range, to hammer with --discover_mapping.")
+        
+        ("output_format", value(&output_format)->default_value(output_format), "Specifies the format of the --out file: 'text' writes a line per anchor row with bitflips, 'binary' writes a compressed bitflip map that can be inspected with BitflipMapQuery (build it with 'make query'). Only the RowHammer attack with --row_layout supports 'binary'.")
         ("append", bool_switch(&append_output)->default_value(append_output), "When specified, the output is appended to the --out file (if it exists). Otherwise the --out file is cleared.")
+        ("trace", value(&trace_filename), "When specified, records how long each phase (program generation and lowering, execution, receiving data, and bitflip analysis and output) takes and writes the recorded spans to the specified file as Chrome trace-event JSON, which can be opened in chrome://tracing or ui.perfetto.dev. A histogram of each phase is printed at exit.")
+        ("metrics_out", value(&metrics_filename), "When specified, periodically (every 5 seconds) writes live metrics (rows tested (i.e., victim rows checked for bitflips), ACTs issued to hammer rows, bytes received over PCIe, programs executed, time spent generating programs, and the progress and ETA of the test) to the specified file in the Prometheus text format, e.g., for the textfile collector of node_exporter, and as JSON to the same path with a .json extension (replacing .prom, if any).")
         ;
 
     variables_map vm;
@@ -1363,14 +2529,36 @@ int main(int argc, char** argv)
         row_range[1] = NUM_ROWS - 1;
     }
 
-    // make sure row_pattern contains only V(v) or A(a)
-    if(!std::regex_match(row_layout, std::regex("^[VvAa]+$"))) {
-        std::cerr << RED_TXT << "ERROR: --row_layout should contain only 'V' and 'A' characters. Provided: " << row_layout << NORMAL_TXT << std::endl;
-        exit(-3);
+    if(row_layouts.empty())
+        row_layouts.push_back(row_layout);
+
+    for(auto& layout : row_layouts) {
+        // make sure row_pattern contains only V(v) or A(a)
+        if(!std::regex_match(layout, std::regex("^[VvAa]+$"))) {
+            std::cerr << RED_TXT << "ERROR: --row_layout should contain only 'V' and 'A' characters. Provided: " << layout << NORMAL_TXT << std::endl;
+            return -3;
+        }
+
+        // make sure row_layout is uppercase
+        for (auto& c : layout) c = toupper(c);
+    }
+
+    for(auto& layout : row_layouts) {
+        if(std::count(row_layouts.begin(), row_layouts.end(), layout) > 1) {
+            std::cerr << RED_TXT << "ERROR: --row_layouts contains " << layout << " more than once" << NORMAL_TXT << std::endl;
+            return -3;
+        }
     }
 
-    // make sure row_layout is uppercase
-    for (auto& c : row_layout) c = toupper(c);
+    if(row_layouts.size() > 1 && (hcfirst_map || hammer_pattern != "" || fuzz_patterns > 0)) {
+        std::cerr << RED_TXT << "ERROR: --row_layouts cannot be combined with --hcfirst_map, --pattern, or --fuzz" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    // with multiple layouts, the output of each layout goes to a separate file
+    auto layout_filename = [&](const std::string& filename, const std::string& layout) {
+        return row_layouts.size() > 1 ? filename + "." + layout : filename;
+    };
 
     if(out_filename != "") {
         path out_dir(out_filename);
@@ -1383,8 +2571,83 @@ int main(int argc, char** argv)
         }
     }
 
+    if(output_format != "text" && output_format != "binary") {
+        std::cerr << RED_TXT << "ERROR: --output_format should be either 'text' or 'binary'. Provided: " << output_format << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    bool binary_output = output_format == "binary";
+    if(binary_output && (out_filename == "" || append_output || hcfirst_map || hammer_pattern != "" || fuzz_patterns > 0 || discover_mapping_filename != "")) {
+        std::cerr << RED_TXT << "ERROR: --output_format binary requires an --out file and cannot be combined with --append, --hcfirst_map, --pattern, --fuzz, or --discover_mapping" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    if(attack_banks.empty())
+        attack_banks.push_back(target_bank);
+
+    for(uint i = 0; i < attack_banks.size(); i++) {
+        if(attack_banks[i] >= (uint)NUM_BANKS || std::count(attack_banks.begin(), attack_banks.end(), attack_banks[i]) > 1) {
+            std::cerr << RED_TXT << "ERROR: --attack_banks should contain distinct bank IDs smaller than " << NUM_BANKS << NORMAL_TXT << std::endl;
+            return -3;
+        }
+    }
+
+    if(attack_banks.size() > 1 && (hcfirst_map || hammer_pattern != "" || fuzz_patterns > 0 || trrref_sync || discover_mapping_filename != "")) {
+        std::cerr << RED_TXT << "ERROR: --attack_banks cannot be combined with --hcfirst_map, --pattern, --fuzz, --trrref_sync, or --discover_mapping" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    std::string mapping_error = init_row_mapping(arg_log_phys_conv_scheme, row_mapping_filename, NUM_ROWS);
+    if(mapping_error != "") {
+        std::cerr << RED_TXT << "ERROR: Invalid row mapping: " << mapping_error << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    HammerPattern parsed_pattern;
+    if (hammer_pattern != "") {
+        std::string error = parse_hammer_pattern(hammer_pattern, parsed_pattern);
+
+        if (error == "" && estimatePatternInsts(parsed_pattern) > SOFTMC_MAX_PROG_INSTS)
+            error = "the pattern does not fit into the instruction memory (SOFTMC_MAX_PROG_INSTS). Use fewer slots or REF intervals";
+
+        if (error != "") {
+            std::cerr << RED_TXT << "ERROR: Invalid --pattern: " << error << NORMAL_TXT << std::endl;
+            return -3;
+        }
+    }
+
+    // a bitflip map per layout and attacked bank. With multiple banks, the map of bank N is written to <out>.bankN
+    std::vector<BitflipMapWriter> bitflip_maps(binary_output ? row_layouts.size()*attack_banks.size() : 0);
+    for(uint i = 0; i < bitflip_maps.size(); i++) {
+        const std::string& layout = row_layouts[i/attack_banks.size()];
+        uint bank_id = attack_banks[i % attack_banks.size()];
+
+        std::string map_filename = layout_filename(out_filename, layout);
+        if(attack_banks.size() > 1)
+            map_filename += ".bank" + std::to_string(bank_id);
+
+        BitflipMapHeader map_header;
+        map_header.bank = bank_id;
+        map_header.first_row = row_range[0];
+        map_header.last_row = row_range[1];
+        map_header.num_victims = std::count(layout.begin(), layout.end(), 'V');
+        map_header.chunks_per_victim = num_bitflip_chunks(bitflip_counting_granularity);
+        map_header.chunk_bytes = bitflip_counting_granularity;
+        map_header.row_layout = layout;
+
+        for(int i = 0; i < argc; i++)
+            map_header.config += (i > 0 ? " " : "") + std::string(argv[i]);
+
+        if(!bitflip_maps[i].open(map_filename, map_header)) {
+            cerr << RED_TXT << "ERROR: Cannot open " << map_filename << " for writing" << NORMAL_TXT << endl;
+            return -1;
+        }
+    }
+
     boost::filesystem::ofstream out_file;
-    if(out_filename != "") {
+    if(binary_output || row_layouts.size() > 1) {
+        out_file.open("/dev/null"); // the bitflips are written to bitflip_maps or to the per-layout files
+    } else if(out_filename != "") {
         if(append_output)
             out_file.open(out_filename, boost::filesystem::ofstream::app);
         else
@@ -1392,27 +2655,79 @@ int main(int argc, char** argv)
     } else {
         out_file.open("/dev/null");
     }
-    
-    SoftMCPlatform platform;
-    int err;
 
-    if((err = platform.init()) != SOFTMC_SUCCESS){
-        cerr << "Could not initialize SoftMC Platform: " << err << endl;
-        return err;
+    std::vector<boost::filesystem::ofstream> layout_out_files(row_layouts.size());
+    std::vector<boost::filesystem::ofstream*> out_files;
+    for(uint i = 0; i < row_layouts.size(); i++) {
+        if(row_layouts.size() == 1 || binary_output || out_filename == "") {
+            out_files.push_back(&out_file);
+            continue;
+        }
+
+        layout_out_files[i].open(layout_filename(out_filename, row_layouts[i]), append_output ? boost::filesystem::ofstream::app : boost::filesystem::ofstream::trunc);
+        out_files.push_back(&layout_out_files[i]);
+    }
+    
+    // writes the final values when the test returns
+    MetricsExporter metrics_exporter;
+    if(metrics_filename != "") {
+        std::string metrics_error = metrics_exporter.start(metrics_filename, "RowHammerAttacker");
+        if(metrics_error != "") {
+            std::cerr << RED_TXT << "ERROR: Could not write the metrics: " << metrics_error << NORMAL_TXT << std::endl;
+            return -3;
+        }
     }
 
-    platform.reset_fpga();  
-    platform.set_aref(false); // disable refresh
+    if(trace_filename != "")
+        start_tracing();
+
+    receive_buffers.reset_stats();
+
+    // the trace is written when the test finishes, whichever mode it runs in
+    auto finish_test = [&]() {
+        print_softmc_program_stats();
+        print_receive_buffer_stats();
+        print_capture_stats();
+        receive_buffers.trim();
+
+        std::string trace_error = stop_tracing(trace_filename);
+        if(trace_error != "")
+            std::cerr << RED_TXT << "ERROR: Could not write the trace: " << trace_error << NORMAL_TXT << std::endl;
+
+        std::cout << "The test has finished!" << endl;
+    };
 
-    assert(arg_log_phys_conv_scheme < uint(LogPhysRowIDScheme::MAX));
-    logical_physical_conversion_scheme = (LogPhysRowIDScheme) arg_log_phys_conv_scheme;
+    // when running as an ExperimentServer job, the platform is already initialized
+    SoftMCPlatform own_platform;
+    SoftMCPlatform& platform = (shared_platform != nullptr) ? *shared_platform : own_platform;
+
+    if(shared_platform == nullptr) {
+        int err;
+        if((err = init_softmc_platform(platform)) != SOFTMC_SUCCESS)
+            return err;
+    }
 
     // init random data generator
     srand(0);
   
     auto t_prog_started = chrono::high_resolution_clock::now();
     chrono::duration<double> elapsed;
-    bool check_time;
+
+    if (discover_mapping_filename != "") {
+        discoverRowMapping(platform, target_bank, row_range[0], row_range[1], discover_probes, input_data_victims, input_data_aggressors, discover_mapping_filename);
+
+        finish_test();
+        out_file.close();
+        return 0;
+    }
+
+    if (hcfirst_map) {
+        bool mapped = mapHCFirst(platform, target_bank, row_range[0], row_range[1], hcfirst_parallel_rows, input_data_victims, input_data_aggressors, out_file);
+
+        finish_test();
+        out_file.close();
+        return mapped ? 0 : -3;
+    }
 
     if (trrref_sync) {
         uint trrref_dist = syncTRRREF(platform, input_data_victims, input_data_aggressors);
@@ -1427,15 +2742,27 @@ int main(int argc, char** argv)
     if(shift_refs)
         issue_REFs(platform, 1);
 
-    hammerBank(platform, target_bank, row_range[0], row_range[1], num_hammers, num_ref_loops, refs_per_loop, trrref_sync, 
-        num_dummy_rows, hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks,
-        cascaded_hammer_aggr, cascaded_hammer_dummy, fake_hammer, fake_dummy_hammer, fake_ref, row_layout, input_data_victims, input_data_aggressors, 
-        bitflip_counting_granularity, out_file);
+    if (fuzz_patterns > 0) {
+        fuzzHammerPatterns(platform, target_bank, row_range[0], row_range[1], fuzz_patterns, fuzz_anchors, fuzz_seed, num_ref_loops, fake_ref, 
+            input_data_victims, input_data_aggressors, out_file);
+    } else if (hammer_pattern != "") {
+        hammerBankWithPattern(platform, target_bank, row_range[0], row_range[1], parsed_pattern, num_ref_loops, fake_ref, 
+            input_data_victims, input_data_aggressors, out_file);
+    } else {
+        hammerBank(platform, attack_banks, row_range[0], row_range[1], num_hammers, num_ref_loops, refs_per_loop, trrref_sync, 
+            num_dummy_rows, hammer_dummies_independently, hammer_dummies_before, hammer_dummies_after, dummy_banks,
+            cascaded_hammer_aggr, cascaded_hammer_dummy, fake_hammer, fake_dummy_hammer, fake_ref, row_layouts, input_data_victims, input_data_aggressors, 
+            bitflip_counting_granularity, batch_size, out_files, bitflip_maps);
+    }
 
 
-    std::cout << "The test has finished!" << endl;
+    finish_test();
 
     out_file.close();
+    for(auto& bitflip_map : bitflip_maps)
+        bitflip_map.close();
 
     return 0;
 }
+
+UTRR_TOOL_MAIN(rowhammerattacker_main)
@@ -0,0 +1,196 @@
+// Offline microbenchmarks of the host-side code of RowHammerAttacker (run with 'make bench'). The benchmarks use synthetic row data
+// and do not need a board. RowHammerAttacker.cpp is compiled into this file as a library (i.e., without its main function), so the
+// benchmarks run exactly the code that the tool runs.
+
+#define UTRR_TOOL_LIBRARY
+#include "RowHammerAttacker.cpp"
+
+#include "tools/bench.h"
+
+#define BENCH_BITFLIPS_PER_ROW 32
+#define BENCH_HAMMERS_PER_AGGR 50 // fits into a refresh loop of VAVAV with the default timings, unlike the default --hammers_per_ref_loop 70
+#define BENCH_HAMMERS_PER_AGGR_W_DUMMIES 20
+
+// a row that holds data_pattern except for num_bitflips evenly spaced bits
+void make_row(vector<char>& row, const bitset<512>& data_pattern, const uint num_bitflips) {
+    row.resize(ROW_SIZE);
+
+    uint32_t* irow = (uint32_t*) row.data();
+    for(int cl = 0; cl < ROW_SIZE/64; cl++)
+        for(int i = 0; i < 512/32; i++)
+            irow[cl*(512/32) + i] = ((data_pattern >> i*32) & bitset<512>(0xFFFFFFFF)).to_ulong();
+
+    for(uint i = 0; i < num_bitflips; i++) {
+        uint bit = i*(ROW_SIZE*8/num_bitflips) + (i % 8);
+        row[bit/8] ^= (1 << (bit % 8));
+    }
+}
+
+// a batch of anchor rows as hammerBank() tests it with the default options, and num_dummies dummy rows hammered after the aggressors
+typedef struct HammerBatchConfig {
+    std::vector<uint> target_banks{1};
+    std::vector<uint> dummy_banks{1};
+    uint num_ref_loops = 8192;
+    uint refs_per_loop = 1;
+    bool hammer_dummies_after;
+    LayoutConfig layout;
+    std::vector<PhysicalRowID> anchor_rows;
+    std::vector<std::vector<LogicalRowID>> anchor_dummy_rows;
+} HammerBatchConfig;
+
+// Returns an empty string on success, and a description of the problem if a refresh loop of the batch does not fit into tREFI, i.e.,
+// the batch is not one that the tool would run
+std::string make_hammer_batch_config(const std::vector<uint>& num_hammers, const uint num_dummies, HammerBatchConfig& config) {
+    config.hammer_dummies_after = num_dummies > 0;
+
+    std::vector<LogicalRowID> dummy_rows;
+    pick_dummy_aggressors(dummy_rows, num_dummies, 3*NUM_ROWS/4);
+
+    config.layout.row_layout = "VAVAV";
+    config.layout.num_hammers = layoutHammerCounts(config.layout.row_layout, num_hammers);
+
+    // fitDummyHammers() reports the refresh loop on stdout, which would end up in the results table
+    std::streambuf* cout_buf = std::cout.rdbuf(nullptr);
+    config.layout.hammers_per_dummy = fitDummyHammers(config.target_banks, config.layout.row_layout, 0, config.layout.num_hammers, dummy_rows, 
+        config.refs_per_loop, false, false, false, config.hammer_dummies_after, config.dummy_banks, false, false, config.layout.loop_acts);
+    std::cout.rdbuf(cout_buf);
+    std::cout.clear();
+
+    std::vector<LogicalRowID> aggr_ids = getRowIDsOfType(config.layout.row_layout, 0, 'A');
+    toLogicalRowIDs(aggr_ids);
+    ulong loop_cycles = refreshLoopCycles(planRefreshLoop(aggr_ids, config.layout.num_hammers, dummy_rows, config.layout.hammers_per_dummy, false, false, 
+        config.hammer_dummies_after, config.refs_per_loop, false, false, false), config.target_banks, config.dummy_banks.size());
+    if(loop_cycles > (ulong)config.refs_per_loop*trefi_cycles)
+        return "a refresh loop takes " + to_string(loop_cycles) + " cycles, longer than " + to_string(config.refs_per_loop) + " tREFI";
+
+    if(num_dummies > 0 && config.layout.hammers_per_dummy == 0)
+        return "the dummies do not fit into a refresh loop";
+
+    uint anchor_insts = estimateAnchorInsts(config.layout.row_layout, config.layout.num_hammers, num_dummies, config.layout.hammers_per_dummy, false, 
+        config.dummy_banks, config.refs_per_loop, false, false, false, config.target_banks.size());
+    uint batch_size = std::max((SOFTMC_MAX_PROG_INSTS - 4)/anchor_insts, 1u);
+
+    for(uint i = 0; i < batch_size; i++) {
+        config.anchor_rows.push_back(i);
+        config.anchor_dummy_rows.push_back(dummy_rows);
+    }
+
+    return "";
+}
+
+void generate_hammer_batch(const HammerBatchConfig& config) {
+    SoftMCProgram prog = buildHammerBatch(config.target_banks, config.anchor_rows, config.anchor_dummy_rows, {config.layout}, false, false, 
+        config.hammer_dummies_after, config.dummy_banks, config.num_ref_loops, config.refs_per_loop, false, false, false, 
+        setup_data_pattern(2), setup_data_pattern(1), false, false, false);
+
+    bench_keep(prog.lower());
+}
+
+int main(int argc, char** argv)
+{
+    string out_filename = "RowHammerAttackerBench.json";
+    string filter = "";
+    string baseline_filename = "";
+
+    options_description desc("RowHammerAttacker Benchmark Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("out,o", value(&out_filename)->default_value(out_filename), "Specifies the file to save the results to.")
+        ("filter", value(&filter), "Runs only the benchmarks whose names contain the specified string.")
+        ("baseline", value(&baseline_filename), "Specifies the results of an earlier run to compare to.")
+        ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+
+    notify(vm);
+
+    std::string mapping_error = init_row_mapping(0, "", NUM_ROWS);
+    if(!mapping_error.empty()) {
+        cerr << RED_TXT << "ERROR: " << mapping_error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    BenchSuite suite("RowHammerAttacker", filter);
+    suite.print_header();
+
+    bitset<512> data_pattern = setup_data_pattern(2);
+    vector<char> row;
+    make_row(row, data_pattern, BENCH_BITFLIPS_PER_ROW);
+
+    vector<uint> bitflips;
+    bitflips.reserve(ROW_SIZE*8);
+    suite.run("collect_bitflips/full_row", ROW_SIZE, [&]() {
+        collect_bitflips(bitflips, row.data(), data_pattern);
+        bench_keep(bitflips);
+    });
+
+    collect_bitflips(bitflips, row.data(), data_pattern);
+    const uint granularity = 8;
+    vector<uint32_t> chunk_counts(num_bitflip_chunks(granularity));
+    suite.run("count_bitflips_in_chunks/8B", ROW_SIZE, [&]() {
+        std::fill(chunk_counts.begin(), chunk_counts.end(), 0);
+        count_bitflips_in_chunks(bitflips, granularity, chunk_counts.data());
+        bench_keep(chunk_counts);
+    });
+
+    suite.run("bin_to_hex/cache_line", 512, [&]() {
+        bench_keep(bin_to_hex(row.data(), 512));
+    });
+
+    HammerBatchConfig batch, batch_dummies;
+    for(auto error : {make_hammer_batch_config({BENCH_HAMMERS_PER_AGGR, BENCH_HAMMERS_PER_AGGR}, 0, batch), 
+                        make_hammer_batch_config({BENCH_HAMMERS_PER_AGGR_W_DUMMIES, BENCH_HAMMERS_PER_AGGR_W_DUMMIES}, 16, batch_dummies)}) {
+        if(!error.empty()) {
+            cerr << RED_TXT << "ERROR: Invalid hammer batch: " << error << NORMAL_TXT << endl;
+            return -1;
+        }
+    }
+
+    suite.run("program/hammer_batch_" + to_string(batch.anchor_rows.size()) + "_anchors", 0, [&]() {
+        generate_hammer_batch(batch);
+    });
+
+    suite.run("program/hammer_batch_16_dummies_" + to_string(batch_dummies.anchor_rows.size()) + "_anchors", 0, [&]() {
+        generate_hammer_batch(batch_dummies);
+    });
+
+    // the registers are freed in a fixed random order, which is not the order they were allocated in
+    uint num_regs = SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs).num_free_regs();
+    vector<uint> free_order(num_regs);
+    std::iota(free_order.begin(), free_order.end(), 0);
+    std::shuffle(free_order.begin(), free_order.end(), std::mt19937(0));
+
+    suite.run("reg_alloc/allocate_free", 0, [&]() {
+        SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+        SMC_REG regs[NUM_SOFTMC_REGS];
+
+        for(uint i = 0; i < num_regs; i++)
+            regs[i] = reg_alloc.allocate_SMC_REG();
+        for(uint i = 0; i < num_regs; i++)
+            reg_alloc.free_SMC_REG(regs[free_order[i]]);
+
+        bench_keep(reg_alloc);
+    });
+
+    string error = suite.save(out_filename);
+    if(!error.empty()) {
+        cerr << RED_TXT << "ERROR: Could not save the results: " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    if(!baseline_filename.empty()) {
+        error = suite.compare(baseline_filename);
+        if(!error.empty()) {
+            cerr << RED_TXT << "ERROR: Could not compare to the baseline: " << error << NORMAL_TXT << endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,430 @@
+// Tests of the host-side code of RowHammerAttacker (run with 'make test'). The tests check the SoftMC programs the tool generates
+// and do not need a board. RowHammerAttacker.cpp is compiled into this file as a library (i.e., without its main function), so the
+// tests check exactly the code that the tool runs.
+
+#define UTRR_TOOL_LIBRARY
+#include "RowHammerAttacker.cpp"
+
+#include <cstring>
+#include <sstream>
+
+uint num_checks = 0, num_failed = 0;
+
+void check(const bool cond, const std::string& what) {
+    num_checks++;
+    if(cond)
+        return;
+
+    num_failed++;
+    std::cerr << RED_TXT << "FAILED: " << what << NORMAL_TXT << std::endl;
+}
+
+std::string to_str(const std::vector<uint>& v) {
+    std::string s;
+    for(auto x : v)
+        s += (s.empty() ? "" : ",") + std::to_string(x);
+    return "{" + s + "}";
+}
+
+std::string to_str(const std::vector<int>& v) {
+    std::vector<uint> u(v.begin(), v.end());
+    return to_str(u);
+}
+
+bool same_inst(const Inst& a, const Inst& b) {
+    return memcmp(&a, &b, sizeof(Inst)) == 0;
+}
+
+// The DRAM cycle of each ACT in 'nodes' (in straight-line order) and the bank it activates, i.e., the value its bank register was
+// loaded with. The ACTs are recognized by comparing each instruction to an ACT with each pair of registers in each slot
+void find_ACTs(const std::vector<SoftMCNode>& nodes, std::vector<int>& act_times, std::vector<uint>& act_banks) {
+    std::vector<std::pair<Inst, std::pair<int, int>>> acts; // an instruction with an ACT -> the slot and the bank register of the ACT
+    for(int reg_bank = 0; reg_bank < NUM_SOFTMC_REGS; reg_bank++) {
+        for(int reg_row = 0; reg_row < NUM_SOFTMC_REGS; reg_row++) {
+            Mininst act = SMC_ACT(reg_bank, 0, reg_row, 0);
+            acts.push_back({__pack_mininsts(act, SMC_NOP(), SMC_NOP(), SMC_NOP()), {0, reg_bank}});
+            acts.push_back({__pack_mininsts(SMC_NOP(), act, SMC_NOP(), SMC_NOP()), {1, reg_bank}});
+            acts.push_back({__pack_mininsts(SMC_NOP(), SMC_NOP(), act, SMC_NOP()), {2, reg_bank}});
+            acts.push_back({__pack_mininsts(SMC_NOP(), SMC_NOP(), SMC_NOP(), act), {3, reg_bank}});
+        }
+    }
+
+    std::map<int, uint32_t> reg_values;
+    int cycle = 0;
+
+    for(auto& node : nodes) {
+        if(node.type == SMC_NODE_LI)
+            reg_values[node.rd] = node.imm;
+
+        if(node.type == SMC_NODE_INST) {
+            for(auto& act : acts) {
+                if(!same_inst(node.inst, act.first))
+                    continue;
+
+                int reg_bank = act.second.second;
+                act_times.push_back(cycle + act.second.first);
+                act_banks.push_back(reg_values.count(reg_bank) ? reg_values[reg_bank] : UINT32_MAX);
+                break;
+            }
+        }
+
+        cycle += SOFTMC_INST_CYCLES*softmc_node_fpga_cycles(node);
+    }
+}
+
+// the ACTs in act_times are at least tRRD_S apart, at least tRRD_L apart within a bank group, and at most four of them are within tFAW
+void check_ACT_timing(const std::vector<int>& act_times, const std::vector<uint>& banks, const std::string& what) {
+    for(uint i = 1; i < act_times.size(); i++) {
+        int rrd = in_same_bg(banks[i - 1], banks[i]) ? trrdl_cycles : trrds_cycles;
+        check(act_times[i] - act_times[i - 1] >= rrd, what + ": ACT " + std::to_string(i) + " violates tRRD");
+
+        if(i >= 4)
+            check(act_times[i] - act_times[i - 4] >= tfaw_cycles, what + ": ACT " + std::to_string(i) + " violates tFAW");
+    }
+}
+
+void test_bank_groups() {
+    // with 8 banks in 4 bank groups, the bank group is in the low two bits of the bank address
+    for(int bank = 0; bank < NUM_BANKS; bank++) {
+        check(bank_group(bank) == bank % 4, "bank " + std::to_string(bank) + " is in bank group " + std::to_string(bank % 4));
+        check(in_same_bg(bank, (bank + 4) % NUM_BANKS), "banks " + std::to_string(bank) + " and " + std::to_string((bank + 4) % NUM_BANKS) + " share a bank group");
+        check(!in_same_bg(bank, (bank + 1) % NUM_BANKS), "banks " + std::to_string(bank) + " and " + std::to_string((bank + 1) % NUM_BANKS) + " are in different bank groups");
+    }
+}
+
+// the timing of DDR4 chips with 2KB pages at 1.5 ns cycles: tRRD_L > tRRD_S, and tFAW is longer than four ACTs at tRRD_S
+void set_multi_bank_timing() {
+    trrds_cycles = 4;   // 5.3 ns
+    trrdl_cycles = 5;   // 6.4 ns
+    tfaw_cycles = 20;   // 30 ns
+}
+
+void test_ACT_gaps() {
+    set_multi_bank_timing();
+
+    struct { std::vector<uint> banks; bool dedicated; std::vector<int> gaps; } cases[] = {
+        {{0, 4}, true, {0, 5}},                  // same bank group: tRRD_L
+        {{0, 1}, true, {0, 4}},                  // different bank groups: tRRD_S
+        {{0, 4, 1, 5}, true, {0, 5, 4, 5}},
+        {{0, 1, 2, 3, 4}, true, {0, 4, 4, 4, 8}},        // the fifth ACT waits for tFAW
+        {{0, 1, 2, 3, 4, 5}, true, {0, 4, 4, 4, 8, 4}},
+        {{0, 4, 1, 5, 2}, true, {0, 5, 4, 5, 6}},        // tFAW after tRRD_L gaps
+        {{0, 1, 2, 3, 4}, false, {0, 8, 8, 8, 8}},       // an LI before each ACT: tFAW does not bind
+    };
+
+    for(auto& c : cases) {
+        auto gaps = multiBankACTGaps(c.banks, c.dedicated);
+        check(gaps == c.gaps, "ACT gaps of banks " + to_str(c.banks) + (c.dedicated ? "" : " (without dedicated registers)") + ": expected "
+            + to_str(c.gaps) + ", got " + to_str(gaps));
+    }
+}
+
+// activates a row in several banks as perform_hammers() does and checks the cycles the emitted ACTs are at
+void test_activate_in_banks() {
+    set_multi_bank_timing();
+
+    std::vector<std::vector<uint>> bank_sets = {{0, 4}, {0, 1, 2, 3}, {0, 1, 2, 3, 4}, {0, 4, 1, 5, 2, 6}, {3, 2, 1, 0, 7, 6, 5, 4}};
+
+    for(auto& banks : bank_sets) {
+        for(bool dedicated : {true, false}) {
+            for(int before = 0; before < 4; before++) {
+                SoftMCProgram prog;
+                SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+                SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+                SMC_REG reg_row = reg_alloc.allocate_SMC_REG();
+
+                std::vector<SMC_REG> reg_banks;
+                if(dedicated) {
+                    for(auto bank : banks) {
+                        reg_banks.push_back(reg_alloc.allocate_SMC_REG());
+                        prog.add_li(bank, reg_banks.back());
+                    }
+                }
+
+                prog.add_li(42, reg_row);
+                activate_in_banks(prog, reg_bank_addr, reg_banks, reg_row, banks, before, tras_cycles - 1, false);
+
+                std::vector<int> act_times;
+                std::vector<uint> act_banks;
+                find_ACTs(prog.get_nodes(), act_times, act_banks);
+
+                std::string what = "activating banks " + to_str(banks) + (dedicated ? "" : " without dedicated registers") + " after " + std::to_string(before) + " cycles";
+                check(act_banks == banks, what + ": activated banks " + to_str(act_banks));
+                if(act_banks != banks)
+                    continue;
+
+                check_ACT_timing(act_times, banks, what);
+
+                // the ACTs are exactly at the tightest schedule
+                auto gaps = multiBankACTGaps(banks, dedicated);
+                for(uint i = 1; i < act_times.size(); i++)
+                    check(act_times[i] - act_times[i - 1] == gaps[i], what + ": ACT " + std::to_string(i) + " is " + std::to_string(act_times[i] - act_times[i - 1])
+                        + " cycles after the previous one instead of " + std::to_string(gaps[i]));
+            }
+        }
+    }
+}
+
+// perform_hammers() dedicates registers to the attack banks when they fit, and hammers each aggressor in all banks
+void test_multi_bank_hammers() {
+    set_multi_bank_timing();
+
+    std::vector<uint> aggr_banks = {0, 1, 2, 3, 4};
+    check(dedicatedBankRegs(aggr_banks.size(), hammerCallFreeRegs()) == aggr_banks.size(), "five attack banks get dedicated registers");
+    check(dedicatedBankRegs(1, hammerCallFreeRegs()) == 0, "a single attack bank does not get a dedicated register");
+
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    reg_alloc.allocate_SMC_REG(); // reg_num_cols of buildHammerBatch()
+    reg_alloc.allocate_SMC_REG(); // the two registers of hammer_aggressors()
+    reg_alloc.allocate_SMC_REG();
+
+    perform_hammers(prog, reg_alloc, reg_bank_addr, {100}, {3}, 1, aggr_banks, false, {}, false, false);
+
+    std::vector<int> act_times;
+    std::vector<uint> act_banks;
+    find_ACTs(prog.get_nodes(), act_times, act_banks);
+
+    check(act_banks == aggr_banks, "perform_hammers() activates the aggressor in banks " + to_str(aggr_banks) + ", got " + to_str(act_banks));
+    if(act_banks == aggr_banks)
+        check_ACT_timing(act_times, aggr_banks, "perform_hammers()");
+}
+
+SoftMCNode delay_node(const SoftMCNodeType type, const uint64_t count) {
+    SoftMCNode node = SoftMCNode();
+    node.type = type;
+    node.count = count;
+    return node;
+}
+
+SoftMCNode inst_node() {
+    SoftMCNode node = SoftMCNode();
+    node.type = SMC_NODE_INST;
+    node.inst = SMC_END();
+    return node;
+}
+
+// e.g., "I N3 S10 I" for an instruction, 3 NOP instructions, SLEEP(10), and another instruction
+std::string nodes_str(const std::vector<SoftMCNode>& nodes) {
+    std::string s;
+    for(auto& node : nodes) {
+        s += s.empty() ? "" : " ";
+        switch(node.type) {
+            case SMC_NODE_NOPS: s += "N" + std::to_string(node.count); break;
+            case SMC_NODE_SLEEP: s += "S" + std::to_string(node.count); break;
+            case SMC_NODE_LABEL: s += "L"; break;
+            case SMC_NODE_BRANCH: s += "B"; break;
+            case SMC_NODE_LI: s += "LI"; break;
+            case SMC_NODE_ADDI: s += "ADDI"; break;
+            default: s += "I"; break;
+        }
+    }
+    return s;
+}
+
+std::vector<SoftMCNode> parse_nodes(const std::string& str) {
+    std::vector<SoftMCNode> nodes;
+    std::istringstream in(str);
+    std::string tok;
+    while(in >> tok) {
+        if(tok == "I")
+            nodes.push_back(inst_node());
+        else
+            nodes.push_back(delay_node(tok[0] == 'N' ? SMC_NODE_NOPS : SMC_NODE_SLEEP, std::stoull(tok.substr(1))));
+    }
+    return nodes;
+}
+
+// lowered delays written out by hand, for SLEEP(n) taking n FPGA cycles
+void test_compress_delays() {
+    std::string max = std::to_string(SOFTMC_MAX_SLEEP);
+
+    std::vector<std::pair<std::string, std::string>> cases = {
+        {"I N3 I", "I N3 I"},
+        {"I N1 N14 I", "I N15 I"},                   // short pads stay NOPs
+        {"I N16 I", "I S16 I"},
+        {"I N2 S10 N1 I", "I S13 I"},                // NOPs are merged into the SLEEP of their run
+        {"I S5 N1 S7 I", "I S6 S7 I"},               // a run keeps its SLEEPs
+        {"I N3", "I N3"},
+        {"I N" + std::to_string(SOFTMC_MAX_SLEEP + 5) + " I", "I S" + max + " S5 I"},
+        {"I S" + std::to_string(2*SOFTMC_MAX_SLEEP + 2), "I S" + max + " S" + max + " S2"},
+    };
+
+    for(auto& c : cases) {
+        std::string lowered = nodes_str(softmc_compress_delays(parse_nodes(c.first)));
+        check(lowered == c.second, "lowering " + c.first + ": expected " + c.second + ", got " + lowered);
+    }
+}
+
+// The commands the lowered program issues are at the same cycles as in the recorded program, and no delay of a hammer loop is
+// turned into a SLEEP, whatever a SLEEP costs on top of its argument
+void test_hammer_loop_lowering() {
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    prog.add_li(1, reg_bank_addr);
+
+    perform_hammers(prog, reg_alloc, reg_bank_addr, {100, 102, 3000}, {20, 20, 10}, 2, {1}, false, {1}, false, false);
+    perform_hammers(prog, reg_alloc, reg_bank_addr, {100, 102}, {20, 20}, 2, {1}, true, {}, false, false);
+    prog.lower();
+
+    for(auto& node : prog.get_lowered_nodes())
+        check(node.type != SMC_NODE_SLEEP, "lowering a hammer loop emits no SLEEP");
+
+    std::vector<int> act_times, lowered_act_times;
+    std::vector<uint> act_banks, lowered_act_banks;
+    find_ACTs(prog.get_nodes(), act_times, act_banks);
+    find_ACTs(prog.get_lowered_nodes(), lowered_act_times, lowered_act_banks);
+
+    check(!act_times.empty() && act_times == lowered_act_times, "lowering a hammer loop keeps its ACTs at the same cycles");
+}
+
+// the tRFC delay of a refresh loop is the SLEEP its generator emits
+void test_refresh_loop_lowering() {
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+    perform_refresh(prog, reg_alloc, 8, 0, false);
+    prog.lower();
+
+    std::string sleep = "S" + std::to_string((int) ceil((trfc_cycles - 1 - 24 - 4)/4.0f));
+    std::string expected = "LI LI L I " + sleep + " ADDI B";
+    check(nodes_str(prog.get_lowered_nodes()) == expected, "lowering a refresh loop: expected " + expected + ", got " + nodes_str(prog.get_lowered_nodes()));
+}
+
+void test_hammer_patterns() {
+    HammerPattern pattern;
+    check(parse_hammer_pattern("10:1|1,4,0,2;3,2,2,1", pattern).empty(), "a pattern with 10 ACTs in 10 slots is valid");
+    check(!parse_hammer_pattern("10:1|1,4,0,2;3,3,2,1", pattern).empty(), "a pattern with 11 ACTs in 10 slots is rejected");
+    check(parse_hammer_pattern("10:2|1,4,0,4;3,2,2,2", pattern).empty(), "a pattern with 20 ACTs in 2 REF intervals of 10 slots is valid");
+
+    // the sampled patterns always get all their ACTs into the slots
+    std::mt19937 rng(1);
+    for(uint slots_per_ref : {2u, 7u, 16u, default_pattern_slots_per_ref()}) {
+        uint num_invalid = 0, num_dropped = 0;
+
+        for(uint i = 0; i < 1000; i++) {
+            HammerPattern sampled = sample_hammer_pattern(rng, slots_per_ref, 4, 6, 16, 4);
+            if(!validate_hammer_pattern(sampled).empty())
+                num_invalid++;
+
+            uint num_acts = 0;
+            for(auto& aggr : sampled.aggressors)
+                num_acts += aggr.frequency*aggr.amplitude;
+
+            HammerSchedule schedule = compile_hammer_pattern(sampled);
+            if(num_acts != num_pattern_slots(sampled) - std::count(schedule.slot_offsets.begin(), schedule.slot_offsets.end(), HAMMER_SLOT_IDLE))
+                num_dropped++;
+        }
+
+        check(num_invalid == 0 && num_dropped == 0, "the patterns sampled with " + std::to_string(slots_per_ref) + " slots per REF interval are valid, got " +
+                std::to_string(num_invalid) + " invalid and " + std::to_string(num_dropped) + " with dropped ACTs");
+    }
+
+    // the pattern spans rows anchor..anchor+4
+    parse_hammer_pattern("10:1|1,2,0,1;3,2,1,1", pattern);
+    PhysicalRowID last_anchor = 0;
+    check(lastPatternAnchor(pattern, 0, 100, last_anchor) && last_anchor == 100, "the whole range fits the pattern");
+    check(lastPatternAnchor(pattern, NUM_ROWS - 10, NUM_ROWS - 1, last_anchor) && last_anchor == (PhysicalRowID)NUM_ROWS - 5, 
+            "the anchor rows stop where the pattern reaches the end of the bank");
+    check(lastPatternAnchor(pattern, NUM_ROWS - 5, NUM_ROWS - 1, last_anchor) && last_anchor == (PhysicalRowID)NUM_ROWS - 5, "the pattern fits the last anchor row");
+    check(!lastPatternAnchor(pattern, NUM_ROWS - 4, NUM_ROWS - 1, last_anchor), "the pattern does not fit after the last anchor row");
+}
+
+// writes a map of num_rows rows, each with one bitflip in chunk (row % 4), and returns its path. The map is not closed when
+// close_map is false, as when RowHammerAttacker is killed
+std::string write_bitflip_map(const uint32_t num_rows, const bool close_map) {
+    std::string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("utrr_bitflip_map_%%%%%%%%")).string();
+
+    BitflipMapHeader header{0, 0, num_rows - 1, 2, 2, 4096, "VAV", "test"};
+    BitflipMapWriter* writer = new BitflipMapWriter();
+    writer->open(path, header);
+    for(uint32_t row = 0; row < num_rows; row++) {
+        uint32_t chunk_counts[4] = {0, 0, 0, 0};
+        chunk_counts[row % 4] = 1;
+        writer->add_row(row, chunk_counts);
+    }
+
+    // a writer that is never destroyed keeps its last, partial block in memory
+    if(close_map)
+        delete writer;
+
+    return path;
+}
+
+void test_bitflip_map() {
+    const uint32_t num_rows = 2*BITFLIP_MAP_BLOCK_ROWS + 100;
+
+    std::string path = write_bitflip_map(num_rows, true);
+    BitflipMapReader reader;
+    check(reader.open(path).empty() && !reader.is_recovered() && reader.get_blocks().size() == 3, "a closed map has an index of 3 blocks");
+
+    uint64_t total;
+    check(reader.total_bitflips(0, num_rows - 1, total) && total == num_rows, "a closed map has all its bitflips");
+
+    // a map without a footer has the blocks that were flushed before the run was killed
+    std::string killed_path = write_bitflip_map(num_rows, false);
+    BitflipMapReader killed_reader;
+    check(killed_reader.open(killed_path).empty() && killed_reader.is_recovered(), "the index of a map without a footer is recovered");
+    check(killed_reader.get_blocks().size() == 2 && killed_reader.get_blocks().back().last_anchor == 2*BITFLIP_MAP_BLOCK_ROWS - 1,
+            "the flushed blocks of a map without a footer are recovered");
+
+    uint32_t num_read = 0;
+    bool rows_ok = true;
+    check(killed_reader.for_each_row(0, num_rows - 1, [&](uint32_t anchor_row, const uint32_t* chunk_counts) {
+        rows_ok &= anchor_row == num_read++ && chunk_counts[anchor_row % 4] == 1;
+    }) && rows_ok && num_read == 2*BITFLIP_MAP_BLOCK_ROWS, "the recovered rows are read back, got " + std::to_string(num_read));
+
+    // a record cut in the middle ends the recovered map
+    boost::filesystem::resize_file(killed_path, boost::filesystem::file_size(killed_path) - 1);
+    BitflipMapReader cut_reader;
+    check(cut_reader.open(killed_path).empty() && cut_reader.get_blocks().back().num_rows == BITFLIP_MAP_BLOCK_ROWS - 1,
+            "the record cut in the middle is not recovered");
+
+    // an index that claims more blocks than it holds is rejected before the blocks are allocated
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekg(-16, std::ios::end);
+    char index_offset[8];
+    f.read(index_offset, 8);
+    uint64_t offset = 0;
+    for(int i = 0; i < 8; i++)
+        offset |= (uint64_t)(uint8_t)index_offset[i] << (8*i);
+    f.seekp(offset);
+    f.write("\xff\xff\xff\xff", 4);
+    f.close();
+
+    BitflipMapReader corrupt_reader;
+    check(corrupt_reader.open(path) == "malformed index", "an index with too many blocks is rejected");
+
+    boost::filesystem::remove(path);
+    boost::filesystem::remove(killed_path);
+}
+
+int main()
+{
+    std::string mapping_error = init_row_mapping(0, "", NUM_ROWS);
+    if(!mapping_error.empty()) {
+        cerr << RED_TXT << "ERROR: " << mapping_error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    test_compress_delays();
+    test_hammer_loop_lowering();
+    test_refresh_loop_lowering();
+
+    test_bank_groups();
+    test_ACT_gaps();
+    test_activate_in_banks();
+    test_multi_bank_hammers();
+
+    test_hammer_patterns();
+    test_bitflip_map();
+
+    if(num_failed > 0) {
+        std::cerr << RED_TXT << num_failed << " of " << num_checks << " checks failed" << NORMAL_TXT << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN_TXT << "All " << num_checks << " checks passed" << NORMAL_TXT << std::endl;
+    return 0;
+}
@@ -4,7 +4,12 @@
 #include "tools/perfect_hash.h"
 #include "tools/json_struct.h"
 #include "tools/softmc_utils.h"
+#include "tools/softmc_session.h"
 #include "tools/ProgressBar.hpp"
+#include "tools/metrics.h"
+#include "tools/buffer_arena.h"
+#include "tools/chunked_receive.h"
+#include "tools/row_group_pipeline.h"
 
 #include <fstream>
 #include <iostream>
@@ -34,6 +39,7 @@ using namespace std;
 #define RASR 2
 
 #define NUM_SOFTMC_REGS 16
+#define DEFAULT_RECEIVE_CHUNK_ROWS 128 // 1 MiB chunks with 8 KiB rows
 #define FPGA_PERIOD 1.5015f // ns
 
 #define RED_TXT "\033[31m"
@@ -215,7 +221,7 @@ bool in_same_bg(int bank1, int bank2) {
     return bg1 == bg2;
 }
 
-void activateBanks(Program& program, const vector<int>& target_banks, int BANK_ADDR_REG, int ROW_ADDR_REG,
+void activateBanks(SoftMCProgram& program, const vector<int>& target_banks, int BANK_ADDR_REG, int ROW_ADDR_REG,
         bool is_fake_hammering = false) {
 
     // activate rows in the target banks
@@ -223,7 +229,7 @@ void activateBanks(Program& program, const vector<int>& target_banks, int BANK_A
     int total_act_cycles = 0;
     for (int ind = 0; ind < target_banks.size(); ind++) {
       int bank_id = target_banks[ind];
-      program.add_inst(SMC_LI(bank_id, BANK_ADDR_REG));
+      program.add_li(bank_id, BANK_ADDR_REG);
       total_act_cycles += 4;
 
       int cur_rrd = 0;
@@ -247,7 +253,7 @@ void activateBanks(Program& program, const vector<int>& target_banks, int BANK_A
       add_op_with_delay(program, SMC_NOP(), remaining_cycs, 0);
 }
 
-void writeToDRAM(Program& program, const uint target_bank, const uint start_row, 
+void writeToDRAM(SoftMCProgram& program, const uint target_bank, const uint start_row, 
         const uint row_batch_size, const vector<RowData>& rows_data) {
 
     const int REG_TMP_WRDATA = 15;
@@ -260,51 +266,66 @@ void writeToDRAM(Program& program, const uint target_bank, const uint start_row,
     const int REG_BATCH_SIZE = 5;
 
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
     int remaining_cycs = 0;
 
     // ===== BEGIN SoftMC Program =====
   
-    program.add_inst(SMC_LI(start_row, REG_ROW_ADDR));
-    program.add_inst(SMC_LI(target_bank, REG_BANK_ADDR));
+    program.add_li(start_row, REG_ROW_ADDR);
+    program.add_li(target_bank, REG_BANK_ADDR);
 
     add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 1), 0, 0); // precharge all banks
     
-    program.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, REG_NUM_COLS));
+    program.add_li(NUM_COLS_PER_ROW*8, REG_NUM_COLS);
 
-    program.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    program.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    program.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    program.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    program.add_li(1, BASR); // Load 1 into BASR
+    program.add_li(1, RASR); // Load 1 into RASR
 
 
     /* ==== Initialize data of rows in the batch ==== */
-    program.add_inst(SMC_LI(0, REG_BATCH_IT));
-    program.add_inst(SMC_LI(row_batch_size, REG_BATCH_SIZE));
+    program.add_li(0, REG_BATCH_IT);
+    program.add_li(row_batch_size, REG_BATCH_SIZE);
 
     assert(row_batch_size % rows_data.size() == 0 && "Data patterns to initialize consecutive rows with must be multiple of the batch of row to initialize at once.");
 
+    // Consecutive rows with the same data pattern share a load of the wide register. The rows are still initialized in 
+    // address order, so a row loads its pattern only if the previous row (cyclically, as the first row of an iteration follows 
+    // the last row of the previous one) uses a different pattern. If the first row does not load it, it is loaded before the loop
+    const uint num_patts = rows_data.size();
+    auto same_as_prev = [&](const uint i) {
+        return rows_data[i].input_data_pattern == rows_data[(i + num_patts - 1) % num_patts].input_data_pattern;
+    };
+
+    uint loop_loads = 0;
+    for(uint i = 0; i < num_patts; i++)
+        loop_loads += same_as_prev(i) ? 0 : 1;
+
+    if(same_as_prev(0))
+        load_wide_data(program, REG_TMP_WRDATA, rows_data[0].input_data_pattern);
+
+    uint pre_loop_loads = same_as_prev(0) ? 1 : 0;
+    program.count_avoided_wide_loads(num_patts - loop_loads - pre_loop_loads, (num_patts - loop_loads)*(row_batch_size/num_patts) - pre_loop_loads);
+
     program.add_label("INIT_BATCH");
 
-        int row_it = 0;
-        for(auto& row_data : rows_data) {
-            // set up the input data in the wide register
-    	    for (int pos = 0; pos < 16; pos++) {
-              program.add_inst(SMC_LI((((row_data.input_data_pattern >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), REG_TMP_WRDATA));
-      	      program.add_inst(SMC_LDWD(REG_TMP_WRDATA, pos));
-      	    }
+        for(uint row_it = 0; row_it < num_patts; row_it++) {
+            if(!same_as_prev(row_it)) {
+                // set up the input data in the wide register
+                load_wide_data(program, REG_TMP_WRDATA, rows_data[row_it].input_data_pattern);
 
-            remaining_cycs -= (16*4*2 + 4);
-            assert(remaining_cycs <= 0 && "I should add some delay here");
+                remaining_cycs -= (SOFTMC_WIDE_LOAD_INSTS*SOFTMC_INST_CYCLES + 4);
+                assert(remaining_cycs <= 0 && "I should add some delay here");
+            }
 
             // activate the next row and increment the row address register
-            add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1);
+            add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), remaining_cycs, trcd_cycles - 1, {REG_ROW_ADDR});
             
             // write data to the row and precharge
-      	    program.add_inst(SMC_LI(0, REG_COL_ADDR));
+      	    program.add_li(0, REG_COL_ADDR);
 
-            string new_lbl = "INIT_ROW" + to_string(row_it++);
+            string new_lbl = "INIT_ROW" + to_string(row_it);
       	    program.add_label(new_lbl);
-            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0);
+            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0, {REG_COL_ADDR});
             remaining_cycs = 0;
       	    program.add_branch(program.BR_TYPE::BL, REG_COL_ADDR, REG_NUM_COLS, new_lbl);
 
@@ -313,14 +334,14 @@ void writeToDRAM(Program& program, const uint target_bank, const uint start_row,
             remaining_cycs = add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 0), 0, trp_cycles);
         }
 
-    program.add_inst(SMC_ADDI(REG_BATCH_IT, rows_data.size(), REG_BATCH_IT));
+    program.add_addi(REG_BATCH_IT, rows_data.size(), REG_BATCH_IT);
     program.add_branch(program.BR_TYPE::BL, REG_BATCH_IT, REG_BATCH_SIZE, "INIT_BATCH");
 
     program.add_inst(SMC_END());
 }
 
 
-void writeToDRAM(Program& program, SoftMCRegAllocator& reg_alloc, const uint target_bank, const WeakRowSet& wrs, const vector<RowData>& rows_data) {
+void writeToDRAM(SoftMCProgram& program, SoftMCRegAllocator& reg_alloc, const uint target_bank, const WeakRowSet& wrs, const vector<RowData>& rows_data) {
 
     SMC_REG REG_TMP_WRDATA = reg_alloc.allocate_SMC_REG();
     SMC_REG REG_BANK_ADDR = reg_alloc.allocate_SMC_REG();
@@ -328,17 +349,15 @@ void writeToDRAM(Program& program, SoftMCRegAllocator& reg_alloc, const uint tar
     SMC_REG REG_COL_ADDR = reg_alloc.allocate_SMC_REG();
     SMC_REG REG_NUM_COLS = reg_alloc.allocate_SMC_REG();
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
-
     // ===== BEGIN SoftMC Program =====
   
-    program.add_inst(SMC_LI(target_bank, REG_BANK_ADDR));
+    program.add_li(target_bank, REG_BANK_ADDR);
     add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 1), 0, 0); // precharge all banks
-    program.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, REG_NUM_COLS));
+    program.add_li(NUM_COLS_PER_ROW*8, REG_NUM_COLS);
 
-    program.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    program.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    program.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    program.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    program.add_li(1, BASR); // Load 1 into BASR
+    program.add_li(1, RASR); // Load 1 into RASR
 
     /* ==== Initialize data of rows in the row group ==== */
 
@@ -356,25 +375,22 @@ void writeToDRAM(Program& program, SoftMCRegAllocator& reg_alloc, const uint tar
 
 
     // set up the input data in the wide register
-    for (int pos = 0; pos < 16; pos++) {
-        program.add_inst(SMC_LI((((rows_data[wrs.rowdata_ind].input_data_pattern >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), REG_TMP_WRDATA));
-        program.add_inst(SMC_LDWD(REG_TMP_WRDATA, pos));
-    }
+    load_wide_data(program, REG_TMP_WRDATA, rows_data[wrs.rowdata_ind].input_data_pattern);
 
     for(uint row_id : rows_to_init){
-        program.add_inst(SMC_LI(row_id, REG_ROW_ADDR));
+        program.add_li(row_id, REG_ROW_ADDR);
         // activate the next row and increment the row address register
-        add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1);
+        add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1, {REG_ROW_ADDR});
         
         // write data to the row and precharge
-        program.add_inst(SMC_LI(0, REG_COL_ADDR));
+        program.add_li(0, REG_COL_ADDR);
 
         string new_lbl = createSMCLabel("INIT_ROW_DATA");
         program.add_label(new_lbl);
-            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0);
-            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0);
-            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0);
-            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0);
+            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0, {REG_COL_ADDR});
+            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0, {REG_COL_ADDR});
+            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0, {REG_COL_ADDR});
+            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0, {REG_COL_ADDR});
         program.add_branch(program.BR_TYPE::BL, REG_COL_ADDR, REG_NUM_COLS, new_lbl);
 
         // Wait for t(write-precharge)
@@ -392,7 +408,7 @@ void writeToDRAM(Program& program, SoftMCRegAllocator& reg_alloc, const uint tar
     reg_alloc.free_SMC_REG(REG_NUM_COLS);
 }
 
-void readFromDRAM(Program& program, const uint target_bank, const uint start_row, const uint row_batch_size) {
+void readFromDRAM(SoftMCProgram& program, const uint target_bank, const uint start_row, const uint row_batch_size) {
 
     const int REG_BANK_ADDR = 12;
     const int REG_ROW_ADDR = 13;
@@ -406,33 +422,33 @@ void readFromDRAM(Program& program, const uint target_bank, const uint start_row
 
     // ===== BEGIN SoftMC Program =====
   
-    program.add_inst(SMC_LI(start_row, REG_ROW_ADDR));
-    program.add_inst(SMC_LI(target_bank, REG_BANK_ADDR));
+    program.add_li(start_row, REG_ROW_ADDR);
+    program.add_li(target_bank, REG_BANK_ADDR);
 
     add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 1), 0, 0); // precharge all banks
     
-    //program.add_inst(SMC_LI(NUM_ROWS, REG_NUM_ROWS));
-    program.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, REG_NUM_COLS));
+    //program.add_li(NUM_ROWS, REG_NUM_ROWS);
+    program.add_li(NUM_COLS_PER_ROW*8, REG_NUM_COLS);
 
-    program.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    program.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    program.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    program.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    program.add_li(1, BASR); // Load 1 into BASR
+    program.add_li(1, RASR); // Load 1 into RASR
 
     /* ==== Read the data of rows in the batch ==== */
-    program.add_inst(SMC_LI(0, REG_BATCH_IT));
-    program.add_inst(SMC_LI(row_batch_size, REG_BATCH_SIZE));
+    program.add_li(0, REG_BATCH_IT);
+    program.add_li(row_batch_size, REG_BATCH_SIZE);
 
     program.add_label("READ_BATCH");
 
     // activate the next row and increment the row address register
-    add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1);
+    add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1, {REG_ROW_ADDR});
     
     // issue read cmds to read out the entire row and precharge
-    program.add_inst(SMC_LI(0, REG_COL_ADDR));
+    program.add_li(0, REG_COL_ADDR);
 
     string new_lbl = "READ_ROW";
     program.add_label(new_lbl);
-    add_op_with_delay(program, SMC_READ(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), remaining_cycs, 4);
+    add_op_with_delay(program, SMC_READ(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), remaining_cycs, 4, {REG_COL_ADDR});
     remaining_cycs = 0;
     program.add_branch(program.BR_TYPE::BL, REG_COL_ADDR, REG_NUM_COLS, new_lbl);
 
@@ -440,13 +456,13 @@ void readFromDRAM(Program& program, const uint target_bank, const uint start_row
     // & precharge the open bank
     remaining_cycs = add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 0), 0, trp_cycles);
 
-    program.add_inst(SMC_ADDI(REG_BATCH_IT, 1, REG_BATCH_IT));
+    program.add_addi(REG_BATCH_IT, 1, REG_BATCH_IT);
     program.add_branch(program.BR_TYPE::BL, REG_BATCH_IT, REG_BATCH_SIZE, "READ_BATCH");
 
     program.add_inst(SMC_END());
 }
 
-void readFromDRAM(Program& program, const uint target_bank, const WeakRowSet& wrs) {
+void readFromDRAM(SoftMCProgram& program, const uint target_bank, const WeakRowSet& wrs) {
 
     const int REG_BANK_ADDR = 12;
     const int REG_ROW_ADDR = 13;
@@ -457,31 +473,31 @@ void readFromDRAM(Program& program, const uint target_bank, const WeakRowSet& wr
 
     // ===== BEGIN SoftMC Program =====
   
-    program.add_inst(SMC_LI(target_bank, REG_BANK_ADDR));
+    program.add_li(target_bank, REG_BANK_ADDR);
 
     add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 1), 0, 0); // precharge all banks
     
-    //program.add_inst(SMC_LI(NUM_ROWS, REG_NUM_ROWS));
-    program.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, REG_NUM_COLS));
+    //program.add_li(NUM_ROWS, REG_NUM_ROWS);
+    program.add_li(NUM_COLS_PER_ROW*8, REG_NUM_COLS);
 
-    program.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    program.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    program.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    program.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    program.add_li(1, BASR); // Load 1 into BASR
+    program.add_li(1, RASR); // Load 1 into RASR
 
     /* ==== Read the data of rows in the row group ==== */
 
     for (auto& wr : wrs.row_group) {
-        program.add_inst(SMC_LI(wr.row_id, REG_ROW_ADDR));
+        program.add_li(wr.row_id, REG_ROW_ADDR);
     
         // activate the next row and increment the row address register
         add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 0), 0, trcd_cycles - 1);
         
         // issue read cmds to read out the entire row and precharge
-        program.add_inst(SMC_LI(0, REG_COL_ADDR));
+        program.add_li(0, REG_COL_ADDR);
 
         string new_lbl = createSMCLabel("READ_ROW");
         program.add_label(new_lbl);
-        add_op_with_delay(program, SMC_READ(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), remaining_cycs, 4);
+        add_op_with_delay(program, SMC_READ(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), remaining_cycs, 4, {REG_COL_ADDR});
         remaining_cycs = 0;
         program.add_branch(program.BR_TYPE::BL, REG_COL_ADDR, REG_NUM_COLS, new_lbl);
 
@@ -529,14 +545,12 @@ void checkForLeftoverPCIeData(SoftMCPlatform& platform) {
     // checking if there is more data to receive
     uint additional_bytes = 0;
 
-    char* buf = new char[4];
+    ArenaBuffer buf = receive_buffers.acquire(4);
 
-    while (additional_bytes += platform.receiveData(buf, 4)) { // try to receive 4 bytes
+    while (additional_bytes += drain_data(platform, buf.data(), 4)) { // try to receive 4 bytes
         cout << "Received total of " << additional_bytes << " additional bytes" << endl;
-        cout << "Data: " << *(int*)buf << endl;
+        cout << "Data: " << *(int*)buf.data() << endl;
     }
-
-    delete[] buf;
 }
 
 // pairs of row_id and number of bitflips
@@ -598,125 +612,116 @@ void build_WeakRowSet(vector<WeakRowSet>& wrs, const std::string& row_group_patt
     clear_bitflip_history();
 }
 
+// The rows of the batch are received in chunks of receive_chunk_rows rows (all at once when 0) and their bitflips are collected as soon
+// as a chunk arrives. The rows arrive in the order of their logical IDs, but must be fit into row_group_pattern in the order of their
+// physical IDs, so a row is fit once it and all physically preceding rows arrived
 void test_retention(SoftMCPlatform& platform, const uint retention_ms, const uint target_bank, const uint first_row_id, 
-                    const uint row_batch_size, const vector<RowData>& rows_data, const std::string& row_group_pattern, char* buf, vector<WeakRowSet>& row_group) {
+                    const uint row_batch_size, const vector<RowData>& rows_data, const std::string& row_group_pattern, const uint receive_chunk_rows,
+                    vector<WeakRowSet>& row_group) {
     
-    Program writeProg;
-    writeToDRAM(writeProg, target_bank, first_row_id, row_batch_size, rows_data);
+    SoftMCProgram writeProg;
+    {
+        TraceSpan span("generate");
+        writeToDRAM(writeProg, target_bank, first_row_id, row_batch_size, rows_data);
+    }
 
     // execute the program
     auto t_start_issue_prog = chrono::high_resolution_clock::now();
-    platform.execute(writeProg);
+    execute_program(platform, writeProg);
     auto t_end_issue_prog = chrono::high_resolution_clock::now();
 
     chrono::duration<double, milli> prog_issue_duration(t_end_issue_prog - t_start_issue_prog);
 
-    // cout << "Issuing the DRAM write program took: " << prog_issue_duration.count() << " ms." << endl; 
     waitMS(retention_ms - prog_issue_duration.count());
 
-    // at this point we expect writing data to DRAM to be finished
-    auto t_end_ret_wait = chrono::high_resolution_clock::now();
-
-    chrono::duration<double, milli> write_ret_duration(t_end_ret_wait - t_start_issue_prog);
-    // cout << "Writing to DRAM + waiting for the target " << retention_ms << " ms retention time took: " << write_ret_duration.count() << endl;
-
-    
     // READ DATA BACK AND CHECK ERRORS 
-    auto t_prog_started = chrono::high_resolution_clock::now();
-    Program readProg;
-    readFromDRAM(readProg, target_bank, first_row_id, row_batch_size);
-    platform.execute(readProg);
-    //checkForLeftoverPCIeData(platform);
-    platform.receiveData(buf, ROW_SIZE*row_batch_size); // reading all RH_NUM_ROWS at once
-    //t_two_rows_recvd = chrono::high_resolution_clock::now();
-    //elapsed = t_two_rows_recvd - t_prog_started;
-    //cout << "Time for reading two rows: " << elapsed.count()*1000 << "ms" << endl;
-
-    bool check_time = false;
-    if(check_time) {
-        check_time = false;
-        auto t_two_rows_recvd = chrono::high_resolution_clock::now();
-
-        auto elapsed = t_two_rows_recvd - t_prog_started;
-        cout << "Time interval for reading back " << row_batch_size << "rows: " << elapsed.count()*1000.0f << "ms" << endl;
+    SoftMCProgram readProg;
+    {
+        TraceSpan span("generate");
+        readFromDRAM(readProg, target_bank, first_row_id, row_batch_size);
     }
+    execute_program(platform, readProg);
+    //checkForLeftoverPCIeData(platform);
 
-    //t_prog_started = chrono::high_resolution_clock::now();
-    
-    // go over physical row IDs in order
-    for (int i = 0; i < row_batch_size; i++) {
-        PhysicalRowID phys_row_id = first_row_id + i;
-        LogicalRowID log_row_id = to_logical_row_id(phys_row_id);
-
-        // std::cout << "first_row_id: " << first_row_id << std::endl;
-        // std::cout << "row_batch_size: " << row_batch_size << std::endl;
-        // std::cout << "log_row_id: " << log_row_id << std::endl;
-        assert(log_row_id < (first_row_id + row_batch_size) && log_row_id >= first_row_id &&
-                "ERROR: The used Logical to Physical row address mapping results in logical address out of bounds of the row_batch size. Consider revising the code.");
-
-        vector<uint> bitflips; 
-        collect_bitflips(bitflips, buf + (log_row_id - first_row_id)*ROW_SIZE, rows_data[(log_row_id - first_row_id) % rows_data.size()]);
-
-        if (fits_into_row_pattern(bitflips, phys_row_id)) {
-            build_WeakRowSet(row_group, row_group_pattern, rows_data, target_bank, i, first_row_id, retention_ms);
+    uint chunk_rows = (receive_chunk_rows == 0) ? row_batch_size : std::min(receive_chunk_rows, row_batch_size);
+    ChunkedReceive rx(platform, (uint64_t)ROW_SIZE*row_batch_size, ROW_SIZE*chunk_rows);
+
+    // the bitflips of the rows that arrived but are not fit yet, by logical row ID - first_row_id
+    vector<vector<uint>> row_bitflips(row_batch_size);
+    vector<bool> row_received(row_batch_size, false);
+    uint next_phys_ind = 0; // the next row to fit, by physical row ID - first_row_id
+
+    const char* chunk;
+    uint64_t chunk_offset;
+    uint32_t chunk_size;
+    while(rx.next(chunk, chunk_offset, chunk_size)) {
+        tool_metrics.rows_tested += chunk_size/ROW_SIZE;
+
+        TraceSpan span("analyze");
+
+        uint first_ind = chunk_offset/ROW_SIZE;
+        for(uint i = 0; i < chunk_size/ROW_SIZE; i++) {
+            uint log_ind = first_ind + i;
+            collect_bitflips(row_bitflips[log_ind], chunk + i*ROW_SIZE, rows_data[log_ind % rows_data.size()]);
+            row_received[log_ind] = true;
         }
-    }
 
-    //t_two_rows_recvd = chrono::high_resolution_clock::now();
+        // go over physical row IDs in order
+        while(next_phys_ind < row_batch_size) {
+            PhysicalRowID phys_row_id = first_row_id + next_phys_ind;
+            LogicalRowID log_row_id = to_logical_row_id(phys_row_id);
+
+            assert(log_row_id < (first_row_id + row_batch_size) && log_row_id >= first_row_id &&
+                    "ERROR: The used Logical to Physical row address mapping results in logical address out of bounds of the row_batch size. Consider revising the code.");
+
+            uint log_ind = log_row_id - first_row_id;
+            if(!row_received[log_ind])
+                break;
 
-    //elapsed = t_two_rows_recvd - t_prog_started;
-    //cout << "Error checking time: " << elapsed.count()*1000.0f << "ms" << endl;
+            if (fits_into_row_pattern(row_bitflips[log_ind], phys_row_id)) {
+                build_WeakRowSet(row_group, row_group_pattern, rows_data, target_bank, next_phys_ind, first_row_id, retention_ms);
+            }
+
+            vector<uint>().swap(row_bitflips[log_ind]);
+            next_phys_ind++;
+        }
+    }
 
-    //cout << "Finished testing rows " << start_row << "-" << start_row + row_batch_size - 1 << endl;
+    assert(next_phys_ind == row_batch_size);
 }
 
 // return true if the same bit locations in WeakRowSet wrs experience bitflips
 bool check_retention_failute_repeatability(SoftMCPlatform& platform, const uint retention_ms, const uint target_bank, WeakRowSet& wrs, 
                     const vector<RowData>& rows_data, char* buf, bool filter_out_failures = false) {
     
-    Program writeProg;
+    SoftMCProgram writeProg;
     SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
-    writeToDRAM(writeProg, reg_alloc, target_bank, wrs, rows_data);
+    {
+        TraceSpan span("generate");
+        writeToDRAM(writeProg, reg_alloc, target_bank, wrs, rows_data);
+    }
 
     // execute the program
     auto t_start_issue_prog = chrono::high_resolution_clock::now();
-    platform.execute(writeProg);
+    execute_program(platform, writeProg);
     auto t_end_issue_prog = chrono::high_resolution_clock::now();
 
     chrono::duration<double, milli> prog_issue_duration(t_end_issue_prog - t_start_issue_prog);
 
-    // cout << "Issuing the DRAM write program took: " << prog_issue_duration.count() << " ms." << endl; 
     waitMS(retention_ms - prog_issue_duration.count());
 
-    // at this point we expect writing data to DRAM to be finished
-    auto t_end_ret_wait = chrono::high_resolution_clock::now();
-
-    chrono::duration<double, milli> write_ret_duration(t_end_ret_wait - t_start_issue_prog);
-    // cout << "Writing to DRAM + waiting for the target " << retention_ms << " ms retention time took: " << write_ret_duration.count() << endl;
-
-    
     // READ DATA BACK AND CHECK ERRORS 
-    auto t_prog_started = chrono::high_resolution_clock::now();
-    Program readProg;
-    readFromDRAM(readProg, target_bank, wrs);
-    platform.execute(readProg);
-    //checkForLeftoverPCIeData(platform);
-    platform.receiveData(buf, ROW_SIZE*wrs.row_group.size()); // reading all RH_NUM_ROWS at once
-    //t_two_rows_recvd = chrono::high_resolution_clock::now();
-    //elapsed = t_two_rows_recvd - t_prog_started;
-    //cout << "Time for reading two rows: " << elapsed.count()*1000 << "ms" << endl;
-
-    bool check_time = false;
-    if(check_time) {
-        check_time = false;
-        auto t_two_rows_recvd = chrono::high_resolution_clock::now();
-
-        auto elapsed = t_two_rows_recvd - t_prog_started;
-        cout << "Time interval for reading back " << wrs.row_group.size() << "rows: " << elapsed.count()*1000.0f << "ms" << endl;
+    SoftMCProgram readProg;
+    {
+        TraceSpan span("generate");
+        readFromDRAM(readProg, target_bank, wrs);
     }
+    execute_program(platform, readProg);
+    //checkForLeftoverPCIeData(platform);
+    receive_data(platform, buf, ROW_SIZE*wrs.row_group.size()); // reading all RH_NUM_ROWS at once
+
+    TraceSpan span("analyze");
 
-    //t_prog_started = chrono::high_resolution_clock::now();
-    
     for (int i = 0; i < wrs.row_group.size(); i++) {
         vector<uint> bitflips;
         collect_bitflips(bitflips, buf + i*ROW_SIZE, rows_data[wrs.rowdata_ind]);
@@ -742,13 +747,6 @@ bool check_retention_failute_repeatability(SoftMCPlatform& platform, const uint
     }
 
     return true;
-
-    //t_two_rows_recvd = chrono::high_resolution_clock::now();
-
-    //elapsed = t_two_rows_recvd - t_prog_started;
-    //cout << "Error checking time: " << elapsed.count()*1000.0f << "ms" << endl;
-
-    //cout << "Finished testing rows " << start_row << "-" << start_row + row_batch_size - 1 << endl;
 }
 
 // check if the candicate row groups have repeatable retention bitflips according to the RETPROF configuration parameters
@@ -760,7 +758,7 @@ void analyze_weaks(SoftMCPlatform& platform, const vector<RowData>& rows_data,
 
     for(auto& wr : candidate_weaks) {
         std::cout << BLUE_TXT << "Checking retention time consistency of row(s) " << wr.rows_as_str() << NORMAL_TXT << std::endl;
-        char buf[ROW_SIZE*wr.row_group.size()];
+        ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*wr.row_group.size());
         
         // Setting up a progress bar
         progresscpp::ProgressBar progress_bar(RETPROF_NUM_ITS, 70, '#', '-');
@@ -772,7 +770,7 @@ void analyze_weaks(SoftMCPlatform& platform, const vector<RowData>& rows_data,
             // std::cout << "Iteration: " << i + 1 << "/" << RETPROF_NUM_ITS << endl;
 
             // test whether the row experiences bitflips with RETPROF_RETTIME_MULT_H higher retention time
-            if(!check_retention_failute_repeatability(platform, (int)wr.ret_ms*RETPROF_RETTIME_MULT_H, wr.bank_id, wr, rows_data, buf)) {
+            if(!check_retention_failute_repeatability(platform, (int)wr.ret_ms*RETPROF_RETTIME_MULT_H, wr.bank_id, wr, rows_data, buf.data())) {
                 progress_bar.done();
                 std::cout << RED_TXT << "HIGH RETENTION CHECK FAILED" << NORMAL_TXT << std::endl;
                 success = false;
@@ -782,7 +780,7 @@ void analyze_weaks(SoftMCPlatform& platform, const vector<RowData>& rows_data,
             // std::cout << YELLOW_TXT << "HIGH RETENTION CHECK SUCCEEDED" << NORMAL_TXT << std::endl;
 
             // test whether the row never experiences bitflips with RETPROF_RETTIME_MULT_L lower retention time
-            if(!check_retention_failute_repeatability(platform, (int)wr.ret_ms*RETPROF_RETTIME_MULT_H*0.5f, wr.bank_id, wr, rows_data, buf, true)){
+            if(!check_retention_failute_repeatability(platform, (int)wr.ret_ms*RETPROF_RETTIME_MULT_H*0.5f, wr.bank_id, wr, rows_data, buf.data(), true)){
                 progress_bar.done();
                 std::cout << RED_TXT << "LOW RETENTION CHECK FAILED" << NORMAL_TXT << std::endl;
                 success = false;
@@ -823,7 +821,7 @@ std::string wrs_to_string(const WeakRowSet& wrs) {
     return JS::serializeStruct(wrs);
 }
 
-int main(int argc, char** argv)
+int rowscout_main(SoftMCPlatform* shared_platform, int argc, char** argv)
 {
 
     string out_filename = "./out.txt";
@@ -841,8 +839,12 @@ int main(int argc, char** argv)
     vector<int> row_range{-1, -1};
 
     uint arg_log_phys_conv_scheme = 0;
+    std::string row_mapping_filename = "";
 
     bool append_output = false;
+    std::string trace_filename = "";
+    std::string metrics_filename = "";
+    uint receive_chunk_rows = DEFAULT_RECEIVE_CHUNK_ROWS;
 
     // try{
     options_description desc("RowScout Options");
@@ -855,8 +857,12 @@ int main(int argc, char** argv)
         ("row_group_pattern", value(&row_group_pattern)->default_value(row_group_pattern), "Specifies the distances among rows in a row group that RowScout must find. Must include only 'R' and '-'. Example values: R-R (two one-row-address-apart rows with similar retention times) , RR (two consecutively-addressed rows with similar retention times).")
         ("num_row_groups,w", value(&num_row_groups)->default_value(num_row_groups), "Specifies the number of row groups that RowScout must find.")
         ("log_phys_scheme", value(&arg_log_phys_conv_scheme)->default_value(arg_log_phys_conv_scheme), "Specifies how to convert logical row IDs to physical row ids and the other way around. Pass 0 (default) for sequential mapping, 1 for the mapping scheme typically used in Samsung chips.")
+        ("row_mapping_file", value(&row_mapping_filename), "Specifies a file that describes how to convert logical row IDs to physical row IDs (overrides --log_phys_scheme). Each line remaps a physical row address bit to the XOR of logical bits, e.g., \"p1 = l1 ^ l3\" (see tools/row_mapping.h). RowHammerAttacker --discover_mapping produces such files.")
         ("input_data,i", value(&input_data_pattern)->default_value(input_data_pattern), "Specifies the data pattern to initialize rows with for profiling. Defined value are 0: random, 1: all ones, 2: all zeros, 3: colstripe (0101), 4: inverse colstripe (1010), 5: checkered (0101, 1010), 6: inverse checkered (1010, 0101)")
         ("append", bool_switch(&append_output), "When specified, the output is appended to the --out file (if it exists). Otherwise the --out file is cleared.")
+        ("receive_chunk_rows", value(&receive_chunk_rows)->default_value(receive_chunk_rows), "Specifies the number of rows to receive from the board at once. The rows of a chunk are checked for bitflips while the next chunks are received, which bounds the memory used for receiving to a few chunks regardless of the row batch size. Pass 0 to receive each row batch at once.")
+        ("trace", value(&trace_filename), "When specified, records how long each phase (program generation and lowering, execution, retention waits, receiving data, bitflip analysis, and output) takes and writes the recorded spans to the specified file as Chrome trace-event JSON, which can be opened in chrome://tracing or ui.perfetto.dev. A histogram of each phase is printed at exit.")
+        ("metrics_out", value(&metrics_filename), "When specified, periodically (every 5 seconds) writes live metrics (rows tested for retention failures, bytes received over PCIe, programs executed, time spent generating programs, and the progress and ETA of the test) to the specified file in the Prometheus text format, e.g., for the textfile collector of node_exporter, and as JSON to the same path with a .json extension (replacing .prom, if any).")
         ;
 
     variables_map vm;
@@ -916,35 +922,47 @@ int main(int argc, char** argv)
         out_file.open(out_filename);
 
     vector<RowData> rows_data;
-    
-    SoftMCPlatform platform;
-    int err;
 
-    if((err = platform.init()) != SOFTMC_SUCCESS){
-        cerr << "Could not initialize SoftMC Platform: " << err << endl;
-        return err;
+    // writes the final values when the test returns
+    MetricsExporter metrics_exporter;
+    if(metrics_filename != "") {
+        std::string metrics_error = metrics_exporter.start(metrics_filename, "RowScout");
+        if(metrics_error != "") {
+            std::cerr << RED_TXT << "ERROR: Could not write the metrics: " << metrics_error << NORMAL_TXT << std::endl;
+            exit(-3);
+        }
     }
 
-    platform.reset_fpga();
-    // sleep(1);
-  
-    // disable refresh
-    platform.set_aref(false);
+    if(trace_filename != "")
+        start_tracing();
+
+    receive_buffers.reset_stats();
+    
+    // when running as an ExperimentServer job, the platform is already initialized
+    SoftMCPlatform own_platform;
+    SoftMCPlatform& platform = (shared_platform != nullptr) ? *shared_platform : own_platform;
+
+    if(shared_platform == nullptr) {
+        int err;
+        if((err = init_softmc_platform(platform)) != SOFTMC_SUCCESS)
+            return err;
+    }
 
     // init random data generator
     srand(0);
 
 
-    assert(arg_log_phys_conv_scheme < uint(LogPhysRowIDScheme::MAX));
-    logical_physical_conversion_scheme = (LogPhysRowIDScheme) arg_log_phys_conv_scheme;
+    std::string mapping_error = init_row_mapping(arg_log_phys_conv_scheme, row_mapping_filename, NUM_ROWS);
+    if(mapping_error != "") {
+        std::cerr << RED_TXT << "ERROR: Invalid row mapping: " << mapping_error << NORMAL_TXT << std::endl;
+        exit(-3);
+    }
 
   
     bitset<512> bitset_int_mask(0xFFFFFFFF);
 
     auto t_prog_started = chrono::high_resolution_clock::now();
-    auto t_two_rows_recvd = chrono::high_resolution_clock::now();
     chrono::duration<double> elapsed;
-    bool check_time;
 
     target_row = 0;
 
@@ -992,8 +1010,6 @@ int main(int argc, char** argv)
     }
 
     int retention_ms = starting_ret_time;
-    uint64_t buf_size = 0;
-    char* buf = nullptr;
     vector<WeakRowSet> candidate_weaks;
     vector<WeakRowSet> row_group;
 
@@ -1016,20 +1032,14 @@ int main(int argc, char** argv)
         uint target_region_size = row_range[1] - row_range[0] + 1;
         uint row_batch_size = min(max_row_batch_size, target_region_size);
 
-        // check the size of the buffer to read the data to and increase its size if needed
-        if(buf_size < row_batch_size*ROW_SIZE) {
-            if(buf != nullptr)
-                delete[] buf;
-
-            buf = new char[row_batch_size*ROW_SIZE];
-            buf_size = row_batch_size*ROW_SIZE;
-        }
-
         // apply the retention time to the corresponding row region
         uint num_profiled_rows = 0;
         while(num_profiled_rows < target_region_size) {
+            // in pipeline mode, TRR Analyzer uses the board between row batches
+            std::unique_lock<std::mutex> board_lock = pipeline_board_lock();
+
             clear_bitflip_history();
-            test_retention(platform, retention_ms, target_bank, row_range[0], row_batch_size, rows_data, row_group_pattern, buf, candidate_weaks);
+            test_retention(platform, retention_ms, target_bank, row_range[0], row_batch_size, rows_data, row_group_pattern, receive_chunk_rows, candidate_weaks);
 
             if(candidate_weaks.size() > 0) {
                 // remove rows already identified as weak from candidate_weaks
@@ -1047,11 +1057,18 @@ int main(int argc, char** argv)
                 analyze_weaks(platform, rows_data, candidate_weaks, row_group, num_row_groups);
             }
 
-            while (num_wrs_written_out < row_group.size()) {
-                out_file << wrs_to_string(row_group[num_wrs_written_out++]) << std::endl;
+            {
+                TraceSpan span("output");
+                while (num_wrs_written_out < row_group.size()) {
+                    std::string s_wrs = wrs_to_string(row_group[num_wrs_written_out++]);
+                    out_file << s_wrs << std::endl;
+
+                    if(row_group_queue != nullptr)
+                        row_group_queue->push(s_wrs);
+                }
             }
 
-            if(row_group.size() >= num_row_groups)
+            if(row_group.size() >= num_row_groups || (row_group_queue != nullptr && row_group_queue->stopped()))
                 break;
 
             num_profiled_rows += row_batch_size;
@@ -1064,7 +1081,7 @@ int main(int argc, char** argv)
             row_group.size() << " total) row groups" << NORMAL_TXT << std::endl;
         last_num_weak_rows = row_group.size();
 
-        if(row_group.size() >= num_row_groups)
+        if(row_group.size() >= num_row_groups || (row_group_queue != nullptr && row_group_queue->stopped()))
             break;
 
         retention_ms += (int)(starting_ret_time*RETPROF_RETTIME_STEP); 
@@ -1073,9 +1090,21 @@ int main(int argc, char** argv)
     // checkForLeftoverPCIeData(platform);
     out_file.close();
 
+    print_softmc_program_stats();
+    print_receive_buffer_stats();
+    print_capture_stats();
+    receive_buffers.trim();
+
+    std::string trace_error = stop_tracing(trace_filename);
+    if(trace_error != "")
+        std::cerr << RED_TXT << "ERROR: Could not write the trace: " << trace_error << NORMAL_TXT << std::endl;
+
     std::cout << "The test has finished!" << endl;
 
     
 
     return 0;
 }
+
+UTRR_TOOL_MAIN(rowscout_main)
+UTRR_ROW_GROUP_QUEUE_HOOK()
@@ -3,8 +3,14 @@
 #include "platform.h"
 #include "tools/perfect_hash.h"
 #include "tools/json_struct.h"
+#include "tools/json_object_file.h"
 #include "tools/softmc_utils.h"
+#include "tools/softmc_session.h"
 #include "tools/ProgressBar.hpp"
+#include "tools/metrics.h"
+#include "tools/buffer_arena.h"
+#include "tools/row_group_pipeline.h"
+#include "tools/retention_mux.h"
 
 #include <string>
 #include <fstream>
@@ -13,6 +19,8 @@
 #include <cassert>
 #include <bitset>
 #include <chrono>
+#include <thread>
+#include <mutex>
 
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
@@ -156,6 +164,39 @@ JS_OBJECT_EXTERNAL(WeakRowSet,
                 JS_MEMBER(ret_ms),
                 JS_MEMBER(data_pattern_type));
 
+// The fully resolved setup of an experiment and its progress. TRR Analyzer keeps it up to date in <out>.ckpt
+// so that an interrupted run can be continued with --resume using exactly the same row groups, dummy rows, and hammer counts
+typedef struct TRRCheckpoint {
+    std::vector<std::string> args; // command line arguments of the run, except --resume and --append
+    std::vector<WeakRowSet> row_groups;
+    std::vector<uint> row_group_indices; // index_in_file of each row group
+    std::vector<std::string> data_patterns; // data pattern of each hammerable row set (matters for the random data pattern)
+    std::vector<uint> dummy_aggr_ids;
+    std::vector<uint> after_init_dummies;
+    int dummy_aggrs_bank;
+    std::vector<uint> aggr_hammers_per_ref; // hammers_per_round as specified by the user
+    std::vector<uint> hammers_per_round; // after adjust_hammers_per_ref()
+    std::vector<uint> hammers_before_wait; // after adjust_hammers_per_ref()
+    std::vector<uint> total_bitflips;
+    uint next_iteration;
+    uint64_t out_file_size; // size of the output file after the last completed iteration
+} TRRCheckpoint;
+
+JS_OBJECT_EXTERNAL(TRRCheckpoint,
+                JS_MEMBER(args),
+                JS_MEMBER(row_groups),
+                JS_MEMBER(row_group_indices),
+                JS_MEMBER(data_patterns),
+                JS_MEMBER(dummy_aggr_ids),
+                JS_MEMBER(after_init_dummies),
+                JS_MEMBER(dummy_aggrs_bank),
+                JS_MEMBER(aggr_hammers_per_ref),
+                JS_MEMBER(hammers_per_round),
+                JS_MEMBER(hammers_before_wait),
+                JS_MEMBER(total_bitflips),
+                JS_MEMBER(next_iteration),
+                JS_MEMBER(out_file_size));
+
 
 // returns a vector of bit positions that experienced bitflips
 void collect_bitflips(vector<uint>& bitflips, const char* read_data, const bitset<512>& input_data_pattern, const vector<uint> bitflips_loc) {
@@ -210,7 +251,7 @@ void collect_bitflips(vector<uint>& bitflips, const char* read_data, const bitse
     }
 }
 
-void writeToDRAM(Program& program, const uint target_bank, const uint start_row, 
+void writeToDRAM(SoftMCProgram& program, const uint target_bank, const uint start_row, 
         const uint row_batch_size, const vector<RowData>& rows_data) {
 
     const int REG_TMP_WRDATA = 15;
@@ -222,51 +263,66 @@ void writeToDRAM(Program& program, const uint target_bank, const uint start_row,
     const int REG_BATCH_IT = 6;
     const int REG_BATCH_SIZE = 5;
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
     int remaining_cycs = 0;
 
     // ===== BEGIN SoftMC Program =====
   
-    program.add_inst(SMC_LI(start_row, REG_ROW_ADDR));
-    program.add_inst(SMC_LI(target_bank, REG_BANK_ADDR));
+    program.add_li(start_row, REG_ROW_ADDR);
+    program.add_li(target_bank, REG_BANK_ADDR);
 
     add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 1), 0, 0); // precharge all banks
     
-    program.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, REG_NUM_COLS));
+    program.add_li(NUM_COLS_PER_ROW*8, REG_NUM_COLS);
 
-    program.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    program.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    program.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    program.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    program.add_li(1, BASR); // Load 1 into BASR
+    program.add_li(1, RASR); // Load 1 into RASR
 
 
     /* ==== Initialize data of rows in the batch ==== */
-    program.add_inst(SMC_LI(0, REG_BATCH_IT));
-    program.add_inst(SMC_LI(row_batch_size, REG_BATCH_SIZE));
+    program.add_li(0, REG_BATCH_IT);
+    program.add_li(row_batch_size, REG_BATCH_SIZE);
 
     assert(row_batch_size % rows_data.size() == 0 && "Data patterns to initialize consecutive rows with must be multiple of the batch of row to initialize at once.");
 
+    // Consecutive rows with the same data pattern share a load of the wide register. The rows are still initialized in 
+    // address order, so a row loads its pattern only if the previous row (cyclically, as the first row of an iteration follows 
+    // the last row of the previous one) uses a different pattern. If the first row does not load it, it is loaded before the loop
+    const uint num_patts = rows_data.size();
+    auto same_as_prev = [&](const uint i) {
+        return rows_data[i].input_data_pattern == rows_data[(i + num_patts - 1) % num_patts].input_data_pattern;
+    };
+
+    uint loop_loads = 0;
+    for(uint i = 0; i < num_patts; i++)
+        loop_loads += same_as_prev(i) ? 0 : 1;
+
+    if(same_as_prev(0))
+        load_wide_data(program, REG_TMP_WRDATA, rows_data[0].input_data_pattern);
+
+    uint pre_loop_loads = same_as_prev(0) ? 1 : 0;
+    program.count_avoided_wide_loads(num_patts - loop_loads - pre_loop_loads, (num_patts - loop_loads)*(row_batch_size/num_patts) - pre_loop_loads);
+
     program.add_label("INIT_BATCH");
 
-        int row_it = 0;
-        for(auto& row_data : rows_data) {
-            // set up the input data in the wide register
-    	    for (int pos = 0; pos < 16; pos++) {
-              program.add_inst(SMC_LI((((row_data.input_data_pattern >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), REG_TMP_WRDATA));
-      	      program.add_inst(SMC_LDWD(REG_TMP_WRDATA, pos));
-      	    }
+        for(uint row_it = 0; row_it < num_patts; row_it++) {
+            if(!same_as_prev(row_it)) {
+                // set up the input data in the wide register
+                load_wide_data(program, REG_TMP_WRDATA, rows_data[row_it].input_data_pattern);
 
-            remaining_cycs -= (16*4*2 + 4);
-            assert(remaining_cycs <= 0 && "I should add some delay here");
+                remaining_cycs -= (SOFTMC_WIDE_LOAD_INSTS*SOFTMC_INST_CYCLES + 4);
+                assert(remaining_cycs <= 0 && "I should add some delay here");
+            }
 
             // activate the next row and increment the row address register
-            add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1);
+            add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), remaining_cycs, trcd_cycles - 1, {REG_ROW_ADDR});
             
             // write data to the row and precharge
-      	    program.add_inst(SMC_LI(0, REG_COL_ADDR));
+      	    program.add_li(0, REG_COL_ADDR);
 
-            string new_lbl = "INIT_ROW" + to_string(row_it++);
+            string new_lbl = "INIT_ROW" + to_string(row_it);
       	    program.add_label(new_lbl);
-            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0);
+            add_op_with_delay(program, SMC_WRITE(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), 0, 0, {REG_COL_ADDR});
             remaining_cycs = 0;
       	    program.add_branch(program.BR_TYPE::BL, REG_COL_ADDR, REG_NUM_COLS, new_lbl);
 
@@ -275,7 +331,7 @@ void writeToDRAM(Program& program, const uint target_bank, const uint start_row,
             remaining_cycs = add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 0), 0, trp_cycles);
         }
 
-    program.add_inst(SMC_ADDI(REG_BATCH_IT, rows_data.size(), REG_BATCH_IT));
+    program.add_addi(REG_BATCH_IT, rows_data.size(), REG_BATCH_IT);
     program.add_branch(program.BR_TYPE::BL, REG_BATCH_IT, REG_BATCH_SIZE, "INIT_BATCH");
 
     program.add_inst(SMC_END());
@@ -290,7 +346,7 @@ void waitForRetentionTime(const uint ret_time_ms) {
     }
 }
 
-void readFromDRAM(Program& program, const uint target_bank, const uint start_row, const uint row_batch_size) {
+void readFromDRAM(SoftMCProgram& program, const uint target_bank, const uint start_row, const uint row_batch_size) {
 
     // const int REG_TMP_WRDATA = 15;
     const int REG_BANK_ADDR = 12;
@@ -305,33 +361,33 @@ void readFromDRAM(Program& program, const uint target_bank, const uint start_row
 
     // ===== BEGIN SoftMC Program =====
   
-    program.add_inst(SMC_LI(start_row, REG_ROW_ADDR));
-    program.add_inst(SMC_LI(target_bank, REG_BANK_ADDR));
+    program.add_li(start_row, REG_ROW_ADDR);
+    program.add_li(target_bank, REG_BANK_ADDR);
 
     add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 1), 0, 0); // precharge all banks
     
-    //program.add_inst(SMC_LI(NUM_ROWS, REG_NUM_ROWS));
-    program.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, REG_NUM_COLS));
+    //program.add_li(NUM_ROWS, REG_NUM_ROWS);
+    program.add_li(NUM_COLS_PER_ROW*8, REG_NUM_COLS);
 
-    program.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    program.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    program.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    program.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    program.add_li(1, BASR); // Load 1 into BASR
+    program.add_li(1, RASR); // Load 1 into RASR
 
     /* ==== Read the data of rows in the batch ==== */
-    program.add_inst(SMC_LI(0, REG_BATCH_IT));
-    program.add_inst(SMC_LI(row_batch_size, REG_BATCH_SIZE));
+    program.add_li(0, REG_BATCH_IT);
+    program.add_li(row_batch_size, REG_BATCH_SIZE);
 
     program.add_label("READ_BATCH");
 
     // activate the next row and increment the row address register
-    add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1);
+    add_op_with_delay(program, SMC_ACT(REG_BANK_ADDR, 0, REG_ROW_ADDR, 1), 0, trcd_cycles - 1, {REG_ROW_ADDR});
     
     // issue read cmds to read out the entire row and precharge
-    program.add_inst(SMC_LI(0, REG_COL_ADDR));
+    program.add_li(0, REG_COL_ADDR);
 
     string new_lbl = "READ_ROW";
     program.add_label(new_lbl);
-    add_op_with_delay(program, SMC_READ(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), remaining_cycs, 4);
+    add_op_with_delay(program, SMC_READ(REG_BANK_ADDR, 0, REG_COL_ADDR, 1, 0, 0), remaining_cycs, 4, {REG_COL_ADDR});
     remaining_cycs = 0;
     program.add_branch(program.BR_TYPE::BL, REG_COL_ADDR, REG_NUM_COLS, new_lbl);
 
@@ -339,7 +395,7 @@ void readFromDRAM(Program& program, const uint target_bank, const uint start_row
     // & precharge the open bank
     remaining_cycs = add_op_with_delay(program, SMC_PRE(REG_BANK_ADDR, 0, 0), 0, trp_cycles);
 
-    program.add_inst(SMC_ADDI(REG_BATCH_IT, 1, REG_BATCH_IT));
+    program.add_addi(REG_BATCH_IT, 1, REG_BATCH_IT);
     program.add_branch(program.BR_TYPE::BL, REG_BATCH_IT, REG_BATCH_SIZE, "READ_BATCH");
 
     program.add_inst(SMC_END());
@@ -381,52 +437,69 @@ void checkForLeftoverPCIeData(SoftMCPlatform& platform) {
     // checking if there is more data to receive
     uint additional_bytes = 0;
 
-    char* buf = new char[4];
+    ArenaBuffer buf = receive_buffers.acquire(4);
 
-    while (additional_bytes += platform.receiveData(buf, 4)) { // try to receive 4 bytes
+    while (additional_bytes += drain_data(platform, buf.data(), 4)) { // try to receive 4 bytes
         cout << "Received total of " << additional_bytes << " additional bytes" << endl;
-        cout << "Data: " << *(int*)buf << endl;
+        cout << "Data: " << *(int*)buf.data() << endl;
     }
-
-    delete[] buf;
 }
 
 std::string wrs_to_string(const WeakRowSet& wrs) { 
     return JS::serializeStruct(wrs);
 }
 
-bool getNextJSONObj(boost::filesystem::ifstream& f_row_groups, string& s_weak) {
-    
-    std::string cur_line;
-    std::getline(f_row_groups, cur_line);
+// writes the checkpoint to a temporary file first so that an interruption never leaves a truncated checkpoint behind
+void save_checkpoint(const std::string& ckpt_filename, const TRRCheckpoint& ckpt) {
+    std::string tmp_filename = ckpt_filename + ".tmp";
 
-    s_weak = "";
-    while (cur_line != "}") {
-        if(f_row_groups.eof())
-            return false;
+    boost::filesystem::ofstream f_ckpt(tmp_filename);
+    f_ckpt << JS::serializeStruct(ckpt) << std::endl;
+    f_ckpt.close();
 
-        s_weak += cur_line;
-        std::getline(f_row_groups, cur_line);
+    boost::filesystem::rename(tmp_filename, ckpt_filename);
+}
+
+bool load_checkpoint(const std::string& ckpt_filename, TRRCheckpoint& ckpt) {
+    boost::filesystem::ifstream f_ckpt(ckpt_filename);
+    if(!f_ckpt.is_open())
+        return false;
+
+    std::string s_ckpt((std::istreambuf_iterator<char>(f_ckpt)), std::istreambuf_iterator<char>());
+
+    JS::ParseContext context(s_ckpt);
+    if(context.parseTo(ckpt) != JS::Error::NoError) {
+        std::cerr << RED_TXT << "ERROR: Could not parse the checkpoint file " << ckpt_filename << ": " << context.makeErrorString() << NORMAL_TXT << std::endl;
+        return false;
     }
-    s_weak += cur_line;
+
+    for(uint i = 0; i < ckpt.row_groups.size(); i++)
+        ckpt.row_groups[i].index_in_file = ckpt.row_group_indices[i];
 
     return true;
 }
 
-void parse_all_weaks(boost::filesystem::ifstream& f_row_groups, vector<WeakRowSet>& row_groups) {
-    string s_weak;
+// parses the row groups at 'indices' of a RowScout file. An object that fails to parse is kept (with the members that were parsed) as
+// reading the file object by object always did, but is reported
+void parse_weaks(const JSONObjectFile& f_row_groups, const vector<size_t>& indices, vector<WeakRowSet>& row_groups) {
+    TraceSpan span("parse_row_groups");
 
-    uint i = 0;
-    while(getNextJSONObj(f_row_groups, s_weak)) {
-        JS::ParseContext context(s_weak);
-        WeakRowSet wr;
-        context.parseTo(wr);
-        wr.index_in_file = i++;
-        row_groups.push_back(wr);
-    }
+    std::string error = f_row_groups.parse_objects(indices, row_groups);
+    if(error != "")
+        std::cerr << YELLOW_TXT << "Warning: Could not parse all row groups in the RowScout file: " << error << NORMAL_TXT << std::endl;
+
+    for(uint i = 0; i < indices.size(); i++)
+        row_groups[i].index_in_file = indices[i];
+}
+
+void parse_all_weaks(const JSONObjectFile& f_row_groups, vector<WeakRowSet>& row_groups) {
+    vector<size_t> indices(f_row_groups.num_objects());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    parse_weaks(f_row_groups, indices, row_groups);
 }
 
-void pick_weaks(boost::filesystem::ifstream& f_row_groups, vector<WeakRowSet>& all_weak_rows, vector<WeakRowSet>& picked_weak_rows, const uint num_row_groups) {
+void pick_weaks(vector<WeakRowSet>& all_weak_rows, vector<WeakRowSet>& picked_weak_rows, const uint num_row_groups) {
 
     for(uint i = picked_weak_rows.size(); i < num_row_groups; i++){
 
@@ -453,14 +526,12 @@ void pick_weaks(boost::filesystem::ifstream& f_row_groups, vector<WeakRowSet>& a
     }
 }
 
-void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void init_row_data(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
     const vector<uint>& rows_to_init, const vector<bitset<512>>& data_patts) {
 
     uint initial_free_regs = reg_alloc.num_free_regs();
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
-
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each WRITE writes 8 columns
+    prog.add_li(8, CASR); // Load 8 into CASR since each WRITE writes 8 columns
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
 
@@ -468,15 +539,12 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
     for(uint i = 0; i < rows_to_init.size(); i++){
         uint target_row = rows_to_init[i];
 
-        prog.add_inst(SMC_LI(target_row, reg_row_addr));
+        prog.add_li(target_row, reg_row_addr);
 
         if(i == 0 || data_patts[i-1] != data_patts[i]) {
             // set up the input data in the wide register
             SMC_REG reg_wrdata = reg_alloc.allocate_SMC_REG();
-            for (int pos = 0; pos < 16; pos++) {
-                prog.add_inst(SMC_LI((((data_patts[i] >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), reg_wrdata));
-                prog.add_inst(SMC_LDWD(reg_wrdata, pos));
-            }
+            load_wide_data(prog, reg_wrdata, data_patts[i]);
             reg_alloc.free_SMC_REG(reg_wrdata);
         }
 
@@ -484,11 +552,11 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
         uint remaining = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, trcd_cycles - 5);
 
         // write data to the row and precharge
-        add_op_with_delay(prog, SMC_LI(0, reg_col_addr), remaining, 0);
+        add_li_with_delay(prog, 0, reg_col_addr, remaining, 0);
 
         string new_lbl = createSMCLabel("INIT_ROW");
         prog.add_label(new_lbl);
-        add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0);
+        add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0, {reg_col_addr});
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, new_lbl);
         
         // precharge the open bank
@@ -501,39 +569,34 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
     assert(reg_alloc.num_free_regs() == initial_free_regs);
 }
 
-void init_data_row_range(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void init_data_row_range(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
     const uint first_row_id, const uint last_row_id, const bitset<512>& data_patt) {
 
     uint initial_free_regs = reg_alloc.num_free_regs();
 
-    bitset<512> bitset_int_mask(0xFFFFFFFF);
-
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each WRITE writes 8 columns
+    prog.add_li(8, CASR); // Load 8 into CASR since each WRITE writes 8 columns
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
 
     SMC_REG reg_last_row_id = reg_alloc.allocate_SMC_REG();
-    prog.add_inst(SMC_LI(first_row_id, reg_row_addr));
-    prog.add_inst(SMC_LI(last_row_id + 1, reg_last_row_id)); // +1 because we don't have BL_TYPE::BLE
+    prog.add_li(first_row_id, reg_row_addr);
+    prog.add_li(last_row_id + 1, reg_last_row_id); // +1 because we don't have BL_TYPE::BLE
 
     // initialize the wide register that contains data to write to DRAM
     SMC_REG reg_wrdata = reg_alloc.allocate_SMC_REG();
-    for (int pos = 0; pos < 16; pos++) {
-        prog.add_inst(SMC_LI((((data_patt >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), reg_wrdata));
-        prog.add_inst(SMC_LDWD(reg_wrdata, pos));
-    }
+    load_wide_data(prog, reg_wrdata, data_patt);
 
     std::string lbl_init_row_it = createSMCLabel("INIT_ROW_IT");
     prog.add_label(lbl_init_row_it);
         // activate the target row
-        uint remaining = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 1), 0, trcd_cycles - 5);
+        uint remaining = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 1), 0, trcd_cycles - 5, {reg_row_addr});
 
         // write data to the row and precharge
-        add_op_with_delay(prog, SMC_LI(0, reg_col_addr), remaining, 0);
+        add_li_with_delay(prog, 0, reg_col_addr, remaining, 0);
 
         string new_lbl = createSMCLabel("INIT_ROW");
         prog.add_label(new_lbl);
-        add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0);
+        add_op_with_delay(prog, SMC_WRITE(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0, {reg_col_addr});
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, new_lbl);
         
         // precharge the open bank
@@ -548,7 +611,7 @@ void init_data_row_range(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC
     assert(reg_alloc.num_free_regs() == initial_free_regs);
 }
 
-void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void init_row_data(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
     const uint target_row, const bitset<512>& data_pattern) {
 
     vector<uint> rows_to_init{target_row};
@@ -556,26 +619,27 @@ void init_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
     init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, rows_to_init, data_patts);
 }
 
-void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const vector<uint>& rows_to_hammer,
+void hammer_aggressors(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const vector<uint>& rows_to_hammer,
                         const std::vector<uint>& num_hammers, const bool cascaded_hammer, const uint hammer_duration);
 
-void init_hammerable_row_set(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
-        const HammerableRowSet& hr, const bool init_aggrs_first, const bool ignore_aggrs, const bool init_only_victims){
-    vector<uint> rows_to_init;
-    vector<bitset<512>> data_patts;
+// Appends the rows of 'hr' to initialize. The rows in phase 0 are initialized before the rows in phase 1, i.e., 
+// the victims before the aggressors, or the other way around with init_aggrs_first. Initializing the aggressors last makes them the 
+// last rows activated prior to a refresh when no rows are hammered, which is useful for analyzing the sampling method of Hynix modules
+void collect_hammerable_row_set_rows(const HammerableRowSet& hr, const bool init_aggrs_first, const bool ignore_aggrs, const bool init_only_victims,
+        vector<uint>& rows_to_init, vector<bitset<512>>& data_patts, vector<uint>& phases) {
 
-    uint total_rows = hr.victim_ids.size() + hr.aggr_ids.size() + hr.uni_ids.size();
-    rows_to_init.reserve(total_rows);
-    data_patts.reserve(total_rows);
+    const uint victim_phase = init_aggrs_first ? 1 : 0;
 
     for(auto& vict : hr.victim_ids) {
         rows_to_init.push_back(vict);
         data_patts.push_back(hr.data_pattern);
+        phases.push_back(victim_phase);
     }
 
     for(auto& uni : hr.uni_ids) {
         rows_to_init.push_back(uni);
         data_patts.push_back(hr.data_pattern);
+        phases.push_back(victim_phase);
     }
 
     bitset<512> aggr_data_patt = hr.data_pattern;
@@ -583,44 +647,49 @@ void init_hammerable_row_set(Program& prog, SoftMCRegAllocator& reg_alloc, const
     assert(aggr_data_patt != hr.data_pattern);
 
     if(!ignore_aggrs && !init_only_victims) {
-        for(auto& aggr : hr.aggr_ids) {
-            if(init_aggrs_first) {
-                rows_to_init.insert(rows_to_init.begin(), aggr);
-                data_patts.insert(data_patts.begin(), aggr_data_patt);
-            } else {
-                rows_to_init.push_back(aggr);
-                data_patts.push_back(aggr_data_patt);
-            }
+        // with init_aggrs_first, the aggressors are initialized in reverse order as they used to be inserted at the front one by one
+        for(uint i = 0; i < hr.aggr_ids.size(); i++) {
+            rows_to_init.push_back(init_aggrs_first ? hr.aggr_ids[hr.aggr_ids.size() - 1 - i] : hr.aggr_ids[i]);
+            data_patts.push_back(aggr_data_patt);
+            phases.push_back(1 - victim_phase);
         }
     }
-
-    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, rows_to_init, data_patts);
 }
 
+// initializes the rows phase by phase, grouping the rows of each phase by data pattern so that each pattern is loaded to the wide register once per phase
+void init_row_data_grouped(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+        const vector<uint>& rows_to_init, const vector<bitset<512>>& data_patts, const vector<uint>& phases) {
 
-void init_HRS_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, const HammerableRowSet& hr,
-                    const bool init_aggrs_first, const bool ignore_aggrs, const bool init_only_victims) {
+    vector<uint> order = group_by_data_pattern(data_patts, phases);
 
-    // // initialize data of the two rows on the sides as well (if they are not out of bounds)
-    // // we do this because these rows can be aggressor rows in the TRRAnalyzer experiments and
-    // // they may affect the retention of the first and last rows. Since we collect the first retention failures
-    // // using a big batch of rows (where these side rows are likely to be initialized), we should do the same here
+    vector<uint> grouped_rows;
+    vector<bitset<512>> grouped_patts;
+    grouped_rows.reserve(order.size());
+    grouped_patts.reserve(order.size());
 
-    // // As a slight change to the note above, let's not initialize the aggressors on the sides (unless the rh_type forces that)
-    // // to make it easier to find which ACTs are sampling in Hynix modules 
+    for(auto i : order) {
+        grouped_rows.push_back(rows_to_init[i]);
+        grouped_patts.push_back(data_patts[i]);
+    }
 
-    // init_data_row_range(prog, reg_alloc, reg_bank_addr, reg_num_cols, first_row_id, last_row_id, hr.data_pattern);
+    uint avoided = num_wide_loads(data_patts) - num_wide_loads(grouped_patts);
+    prog.count_avoided_wide_loads(avoided, avoided);
 
-    // UPDATE 09.12.2020 - Instead of initializing a range of rows, now we initilize the victims first and then the aggressors one by one.
-    // This is to make aggressors the last row activated prior to a refresh when no rows are hammering during the hammering phase. 
-    // This change is useful for analyzing the sampling method of Hynix modules
-    init_hammerable_row_set(prog, reg_alloc, reg_bank_addr, reg_num_cols, hr, init_aggrs_first, ignore_aggrs, init_only_victims);
+    init_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, grouped_rows, grouped_patts);
+}
 
-    
+void init_hammerable_row_set(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+        const HammerableRowSet& hr, const bool init_aggrs_first, const bool ignore_aggrs, const bool init_only_victims){
+    vector<uint> rows_to_init;
+    vector<bitset<512>> data_patts;
+    vector<uint> phases;
+
+    collect_hammerable_row_set_rows(hr, init_aggrs_first, ignore_aggrs, init_only_victims, rows_to_init, data_patts, phases);
+    init_row_data_grouped(prog, reg_alloc, reg_bank_addr, reg_num_cols, rows_to_init, data_patts, phases);
 }
 
 
-void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const vector<uint>& rows_to_hammer,
+void hammer_aggressors(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const vector<uint>& rows_to_hammer,
                         const std::vector<uint>& num_hammers, const bool cascaded_hammer, const uint hammer_duration) {
 
     if(rows_to_hammer.size() < 1)
@@ -656,8 +725,8 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
             uint min_elem = *min_non_zero;
 
             // perform hammering
-            prog.add_inst(SMC_LI(min_elem, reg_num_hammers));
-            prog.add_inst(SMC_LI(0, reg_cur_hammers));
+            prog.add_li(min_elem, reg_num_hammers);
+            prog.add_li(0, reg_cur_hammers);
             std::string lbl_rh = createSMCLabel("ROWHAMMERING");
             prog.add_label(lbl_rh);
             for (int ind_row = 0; ind_row < rows_to_hammer.size(); ind_row++) {
@@ -665,19 +734,19 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
                     continue;
 
                 int row_id = rows_to_hammer[ind_row];
-                prog.add_inst(SMC_LI(row_id, reg_row_addr));
+                prog.add_li(row_id, reg_row_addr);
 
                 if(hammer_duration < 20)
                     remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, tras_cycles + hammer_duration - 1);
                 else {
                     remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, hammer_duration % 4);
-                    remaining_cycs = add_op_with_delay(prog, SMC_SLEEP(std::floor(hammer_duration/4.0f)), remaining_cycs, tras_cycles - 1);
+                    remaining_cycs = add_sleep_with_delay(prog, std::floor(hammer_duration/4.0f), remaining_cycs, tras_cycles - 1);
                 }
                     
                 remaining_cycs = add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 0), 0, trp_cycles - 5);
             }
 
-            prog.add_inst(SMC_ADDI(reg_cur_hammers, 1, reg_cur_hammers));
+            prog.add_addi(reg_cur_hammers, 1, reg_cur_hammers);
             prog.add_branch(Program::BR_TYPE::BL, reg_cur_hammers, reg_num_hammers, lbl_rh);
 
 
@@ -693,9 +762,9 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
             if(num_hammers[ind_row] == 0) // do not hammer rows with 0 hammer count
                 continue;
 
-            prog.add_inst(SMC_LI(row_id, reg_row_addr));
-            prog.add_inst(SMC_LI(num_hammers[ind_row], reg_num_hammers));
-            prog.add_inst(SMC_LI(0, reg_cur_hammers));
+            prog.add_li(row_id, reg_row_addr);
+            prog.add_li(num_hammers[ind_row], reg_num_hammers);
+            prog.add_li(0, reg_cur_hammers);
 
             string lbl_rh = createSMCLabel("ROWHAMMERING");
             prog.add_label(lbl_rh);
@@ -704,12 +773,12 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
                 remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, tras_cycles + hammer_duration - 1);
             else {
                 remaining_cycs = add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, 0);
-                remaining_cycs = add_op_with_delay(prog, SMC_SLEEP(std::ceil(hammer_duration/4.0f)), 0, tras_cycles - 5);
+                remaining_cycs = add_sleep_with_delay(prog, std::ceil(hammer_duration/4.0f), 0, tras_cycles - 5);
             }
 
             remaining_cycs = add_op_with_delay(prog, SMC_PRE(reg_bank_addr, 0, 0), 0, 0);
             remaining_cycs = 0;
-            prog.add_inst(SMC_ADDI(reg_cur_hammers, 1, reg_cur_hammers));
+            prog.add_addi(reg_cur_hammers, 1, reg_cur_hammers);
             prog.add_branch(Program::BR_TYPE::BL, reg_cur_hammers, reg_num_hammers, lbl_rh);
         }
     }
@@ -725,11 +794,13 @@ void hammer_aggressors(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_R
 void init_HRS_data(SoftMCPlatform& platform, const std::vector<HammerableRowSet>& vec_hr,
                     const bool init_aggrs_first, const bool ignore_aggrs, const bool init_only_victims,
                     const uint num_pre_init_bank0_hammers, const uint pre_init_nops,
-                    Program* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
+                    SoftMCProgram* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
+
+    TraceSpan span("init");
 
     bool exec_prog_and_clean = false;
     if (prog == nullptr) {
-        prog = new Program();
+        prog = new SoftMCProgram();
         reg_alloc = new SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
         exec_prog_and_clean = true;
     }
@@ -741,7 +812,7 @@ void init_HRS_data(SoftMCPlatform& platform, const std::vector<HammerableRowSet>
     SMC_REG reg_num_cols = reg_alloc->allocate_SMC_REG();
 
     if(num_pre_init_bank0_hammers > 0) {
-        prog->add_inst(SMC_LI(0, reg_bank_addr));
+        prog->add_li(0, reg_bank_addr);
         std::vector<uint> rows_to_hammer = std::vector<uint>{0};
         std::vector<uint> bank0_hammers_per_ref = std::vector<uint>{num_pre_init_bank0_hammers};
         hammer_aggressors(*prog, *reg_alloc, reg_bank_addr, rows_to_hammer, bank0_hammers_per_ref, true, 0);
@@ -750,17 +821,31 @@ void init_HRS_data(SoftMCPlatform& platform, const std::vector<HammerableRowSet>
     if(pre_init_nops > 0) {
         if(pre_init_nops < 3) {
             for(uint i = 0; i < pre_init_nops; i++)
-                prog->add_inst(__pack_mininsts(SMC_NOP(), SMC_NOP(), SMC_NOP(), SMC_NOP()));
+                prog->add_nops(1);
         } else {
-            prog->add_inst(SMC_SLEEP(pre_init_nops));
+            prog->add_sleep(pre_init_nops);
         }
     }
 
-    prog->add_inst(SMC_LI(NUM_COLS_PER_ROW*8, reg_num_cols));
+    prog->add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
+
+    // the row sets in the same bank are initialized together so that the rows of all sets can be grouped by data pattern.
+    // E.g., the victims of all sets are initialized before the aggressors of all sets
+    for(uint first = 0; first < vec_hr.size();) {
+        uint last = first;
+        while(last + 1 < vec_hr.size() && vec_hr[last + 1].bank_id == vec_hr[first].bank_id)
+            last++;
+
+        vector<uint> rows_to_init;
+        vector<bitset<512>> data_patts;
+        vector<uint> phases;
+        for(uint i = first; i <= last; i++)
+            collect_hammerable_row_set_rows(vec_hr[i], init_aggrs_first, ignore_aggrs, init_only_victims, rows_to_init, data_patts, phases);
 
-    for(const auto& hrs : vec_hr) {
-        prog->add_inst(SMC_LI(hrs.bank_id, reg_bank_addr));
-        init_HRS_data(*prog, *reg_alloc, reg_bank_addr, reg_num_cols, hrs, init_aggrs_first, ignore_aggrs, init_only_victims);
+        prog->add_li(vec_hr[first].bank_id, reg_bank_addr);
+        init_row_data_grouped(*prog, *reg_alloc, reg_bank_addr, reg_num_cols, rows_to_init, data_patts, phases);
+
+        first = last + 1;
     }
 
     reg_alloc->free_SMC_REG(reg_bank_addr);
@@ -768,7 +853,7 @@ void init_HRS_data(SoftMCPlatform& platform, const std::vector<HammerableRowSet>
 
     if(exec_prog_and_clean) {
         prog->add_inst(SMC_END());
-        platform.execute(*prog);
+        execute_program(platform, *prog);
         #ifdef PRINT_SOFTMC_PROGS
         std::cout << "--- SoftMCProg: Initializing Victims and Aggressors ---" << std::endl;
         prog->pretty_print();
@@ -779,27 +864,27 @@ void init_HRS_data(SoftMCPlatform& platform, const std::vector<HammerableRowSet>
     }
 }
 
-void read_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void read_row_data(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
                     const vector<uint>& rows_to_read) {
 
     uint initial_free_regs = reg_alloc.num_free_regs();
 
-    prog.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
+    prog.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
     SMC_REG reg_row_addr = reg_alloc.allocate_SMC_REG();
 
     for(auto target_row : rows_to_read) {
-        prog.add_inst(SMC_LI(target_row, reg_row_addr));
+        prog.add_li(target_row, reg_row_addr);
 
         // activate the victim row
         add_op_with_delay(prog, SMC_ACT(reg_bank_addr, 0, reg_row_addr, 0), 0, trcd_cycles - 1);
         
         // read data from the row and precharge
         SMC_REG reg_col_addr = reg_alloc.allocate_SMC_REG();
-        prog.add_inst(SMC_LI(0, reg_col_addr));
+        prog.add_li(0, reg_col_addr);
 
         string new_lbl = createSMCLabel("READ_ROW");
         prog.add_label(new_lbl);
-        add_op_with_delay(prog, SMC_READ(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0);
+        add_op_with_delay(prog, SMC_READ(reg_bank_addr, 0, reg_col_addr, 1, 0, 0), 0, 0, {reg_col_addr});
         prog.add_branch(prog.BR_TYPE::BL, reg_col_addr, reg_num_cols, new_lbl);
         reg_alloc.free_SMC_REG(reg_col_addr);
 
@@ -811,7 +896,7 @@ void read_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG r
     assert(reg_alloc.num_free_regs() == initial_free_regs);
 }
 
-void read_row_data(Program& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
+void read_row_data(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const SMC_REG reg_bank_addr, const SMC_REG reg_num_cols, 
                     const WeakRowSet wrs) {
 
     vector<uint> rows_to_read;
@@ -911,7 +996,9 @@ HammerableRowSet toHammerableRowSet(const WeakRowSet& wrs, const std::string row
 // If the aggressor rows are physically close to the weak rows, then we should observe RowHammer bitflips.
 bool is_hammerable(SoftMCPlatform& platform, const WeakRowSet& wrs, const std::string row_layout, const bool cascaded_hammer) {
     
-    Program p_testRH;
+    TraceSpan span("hammerability_check");
+
+    SoftMCProgram p_testRH;
     uint target_bank = wrs.bank_id;
 
     /****************************/
@@ -923,16 +1010,16 @@ bool is_hammerable(SoftMCPlatform& platform, const WeakRowSet& wrs, const std::s
     SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
 
     SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
-    p_testRH.add_inst(SMC_LI(target_bank, reg_bank_addr));
+    p_testRH.add_li(target_bank, reg_bank_addr);
 
     add_op_with_delay(p_testRH, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
     
     SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
-    p_testRH.add_inst(SMC_LI(NUM_COLS_PER_ROW*8, reg_num_cols));
+    p_testRH.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
 
-    p_testRH.add_inst(SMC_LI(8, CASR)); // Load 8 into CASR since each READ reads 8 columns
-    p_testRH.add_inst(SMC_LI(1, BASR)); // Load 1 into BASR
-    p_testRH.add_inst(SMC_LI(1, RASR)); // Load 1 into RASR
+    p_testRH.add_li(8, CASR); // Load 8 into CASR since each READ reads 8 columns
+    p_testRH.add_li(1, BASR); // Load 1 into BASR
+    p_testRH.add_li(1, RASR); // Load 1 into RASR
 
     HammerableRowSet hr = toHammerableRowSet(wrs, row_layout);
 
@@ -960,7 +1047,7 @@ bool is_hammerable(SoftMCPlatform& platform, const WeakRowSet& wrs, const std::s
     read_row_data(p_testRH, reg_alloc, reg_bank_addr, reg_num_cols, hr.victim_ids);
     p_testRH.add_inst(SMC_END());
 
-    platform.execute(p_testRH);
+    execute_program(platform, p_testRH);
     #ifdef PRINT_SOFTMC_PROGS
     std::cout << "--- SoftMCProg: Checking if the victims are hammerable ---" << std::endl;
     p_testRH.pretty_print();
@@ -969,15 +1056,15 @@ bool is_hammerable(SoftMCPlatform& platform, const WeakRowSet& wrs, const std::s
     /*********************************************/
     /*** read PCIe data and check for bitflips ***/
     /*********************************************/
-    char buf[ROW_SIZE*hr.victim_ids.size()];
-    platform.receiveData(buf, ROW_SIZE*hr.victim_ids.size());
+    ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*hr.victim_ids.size());
+    receive_data(platform, buf.data(), buf.size());
     vector<uint> bitflips;
 
     // we expect all victim rows to be hammerable
     bool all_victims_have_bitflips = true;
     for(uint i = 0; i < hr.victim_ids.size(); i++) {
         bitflips.clear();
-        collect_bitflips(bitflips, buf + ROW_SIZE*i, hr.data_pattern, vector<uint> {});
+        collect_bitflips(bitflips, buf.data() + ROW_SIZE*i, hr.data_pattern, vector<uint> {});
 
         if(bitflips.size() == 0) {
             all_victims_have_bitflips = false;
@@ -1023,24 +1110,24 @@ void pick_dummy_aggressors(vector<uint>& dummy_aggrs, const uint dummy_aggrs_ban
     }
 }
 
-void perform_refresh(Program& prog, SoftMCRegAllocator& reg_alloc, const uint num_refs_per_round,
+void perform_refresh(SoftMCProgram& prog, SoftMCRegAllocator& reg_alloc, const uint num_refs_per_round,
                         const uint pre_ref_delay) {
 
     SMC_REG reg_num_refs_per_cycle = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_it_refs_per_cycle = reg_alloc.allocate_SMC_REG();
 
-    prog.add_inst(SMC_LI(num_refs_per_round, reg_num_refs_per_cycle));
-    prog.add_inst(SMC_LI(0, reg_it_refs_per_cycle));
+    prog.add_li(num_refs_per_round, reg_num_refs_per_cycle);
+    prog.add_li(0, reg_it_refs_per_cycle);
 
     if (pre_ref_delay >= 8) {
-        prog.add_inst(SMC_SLEEP(std::ceil(pre_ref_delay/4.0f)));
+        prog.add_sleep(std::ceil(pre_ref_delay/4.0f));
     }
 
     std::string lbl_issue_per_cycle_refs = createSMCLabel("PER_CYCLE_REFS");
     prog.add_label(lbl_issue_per_cycle_refs);    
         add_op_with_delay(prog, SMC_REF(), 0, 0);
-        add_op_with_delay(prog, SMC_SLEEP(ceil((trfc_cycles - 1 - 24 - 4)/4.0f)), 0, 0);
-        add_op_with_delay(prog, SMC_ADDI(reg_it_refs_per_cycle, 1, reg_it_refs_per_cycle), 0, 0);
+        add_sleep_with_delay(prog, ceil((trfc_cycles - 1 - 24 - 4)/4.0f), 0, 0);
+        prog.add_addi(reg_it_refs_per_cycle, 1, reg_it_refs_per_cycle);
     prog.add_branch(prog.BR_TYPE::BL, reg_it_refs_per_cycle, reg_num_refs_per_cycle, lbl_issue_per_cycle_refs);
 
     reg_alloc.free_SMC_REG(reg_num_refs_per_cycle);
@@ -1048,11 +1135,11 @@ void perform_refresh(Program& prog, SoftMCRegAllocator& reg_alloc, const uint nu
 }
 
 void issue_REFs(SoftMCPlatform& platform, const uint num_refs,
-                Program* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
+                SoftMCProgram* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
 
     bool exec_prog_and_clean = false;
     if (prog == nullptr) {
-        prog = new Program();
+        prog = new SoftMCProgram();
         reg_alloc = new SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
         exec_prog_and_clean = true;
     }
@@ -1060,8 +1147,8 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs,
     SMC_REG reg_num_refs = reg_alloc->allocate_SMC_REG();
     SMC_REG reg_issued_refs = reg_alloc->allocate_SMC_REG();
   
-    prog->add_inst(SMC_LI(num_refs, reg_num_refs));
-    prog->add_inst(SMC_LI(0, reg_issued_refs));
+    prog->add_li(num_refs, reg_num_refs);
+    prog->add_li(0, reg_issued_refs);
 
     int remaining_cycs = 0;
     if(exec_prog_and_clean)
@@ -1077,9 +1164,9 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs,
     add_op_with_delay(*prog, SMC_REF(), 0, 0);
 
     // the SLEEP function waits for 1 SoftMC frontend logic cycle (4 * FPGA_PERIOD). Therefore, we divide by 4
-    add_op_with_delay(*prog, SMC_SLEEP(ceil((trefi_cycles - 4 - 24 - 3)/4.0f)), 0, 0);
+    add_sleep_with_delay(*prog, ceil((trefi_cycles - 4 - 24 - 3)/4.0f), 0, 0);
 
-    prog->add_inst(SMC_ADDI(reg_issued_refs, 1, reg_issued_refs));
+    prog->add_addi(reg_issued_refs, 1, reg_issued_refs);
     prog->add_branch(prog->BR_TYPE::BL, reg_issued_refs, reg_num_refs, lbl_issue_refs);
 
     if(exec_prog_and_clean) {
@@ -1088,16 +1175,16 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs,
         SMC_REG reg_bank_id = reg_alloc->allocate_SMC_REG();
         SMC_REG reg_row_id = reg_alloc->allocate_SMC_REG();
         SMC_REG reg_col_id = reg_alloc->allocate_SMC_REG();
-        add_op_with_delay(*prog, SMC_LI(0, reg_bank_id), 0, 0);
-        add_op_with_delay(*prog, SMC_LI(0, reg_row_id), 0, 0);
-        add_op_with_delay(*prog, SMC_LI(0, reg_col_id), 0, 0);
+        prog->add_li(0, reg_bank_id);
+        prog->add_li(0, reg_row_id);
+        prog->add_li(0, reg_col_id);
 
         add_op_with_delay(*prog, SMC_ACT(reg_bank_id, 0, reg_row_id, 0), 0, trcd_cycles);
         add_op_with_delay(*prog, SMC_READ(reg_bank_id, 0, reg_col_id, 0, 0, 0), 0, tras_cycles - trcd_cycles);
         add_op_with_delay(*prog, SMC_PRE(reg_bank_id, 0, 0), 0, trp_cycles);
 
         prog->add_inst(SMC_END());
-        platform.execute(*prog);
+        execute_program(platform, *prog);
         #ifdef PRINT_SOFTMC_PROGS
         std::cout << "--- SoftMCProg: Issuing REFs ---" << std::endl;
         prog->pretty_print();
@@ -1107,8 +1194,8 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs,
         reg_alloc->free_SMC_REG(reg_row_id);
         reg_alloc->free_SMC_REG(reg_col_id);
 
-        char cl[64];
-        platform.receiveData(cl, 64);
+        ArenaBuffer cl = receive_buffers.acquire(64);
+        receive_data(platform, cl.data(), cl.size());
     }    
 
     reg_alloc->free_SMC_REG(reg_num_refs);
@@ -1123,11 +1210,11 @@ void issue_REFs(SoftMCPlatform& platform, const uint num_refs,
 // performing REF at nominal rate, i.e., a REF cmd is issued once every 7.8us
 // dummy rows are hammered between the REF cmds
 void hammer_dummies(SoftMCPlatform& platform, const uint bank_id, const vector<uint>& dummy_aggrs, const uint num_refs,
-                    Program* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
+                    SoftMCProgram* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
 
     bool exec_prog_and_clean = false;
     if (prog == nullptr) {
-        prog = new Program();
+        prog = new SoftMCProgram();
         reg_alloc = new SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
         exec_prog_and_clean = true;
     }
@@ -1137,10 +1224,10 @@ void hammer_dummies(SoftMCPlatform& platform, const uint bank_id, const vector<u
 
     SMC_REG reg_row_id = reg_alloc->allocate_SMC_REG();
     SMC_REG reg_bank_id = reg_alloc->allocate_SMC_REG();
-    prog->add_inst(SMC_LI(bank_id, reg_bank_id));
+    prog->add_li(bank_id, reg_bank_id);
   
-    prog->add_inst(SMC_LI(num_refs, reg_num_refs));
-    prog->add_inst(SMC_LI(0, reg_issued_refs));
+    prog->add_li(num_refs, reg_num_refs);
+    prog->add_li(0, reg_issued_refs);
 
     int remaining_cycs = 0;
     if(exec_prog_and_clean)
@@ -1162,40 +1249,40 @@ void hammer_dummies(SoftMCPlatform& platform, const uint bank_id, const vector<u
         // hammer the dummy rows
         SMC_REG reg_hammer_it = reg_alloc->allocate_SMC_REG();
         SMC_REG reg_hammers_per_ref = reg_alloc->allocate_SMC_REG();
-        prog->add_inst(SMC_LI(0, reg_hammer_it));
-        prog->add_inst(SMC_LI(hammers_per_round, reg_hammers_per_ref));
+        prog->add_li(0, reg_hammer_it);
+        prog->add_li(hammers_per_round, reg_hammers_per_ref);
 
         std::string lbl_hammer = createSMCLabel("AFTER_INIT_DUMMY_HAMMERING");
         prog->add_label(lbl_hammer);
             remaining_cycs = 0;
             for (uint dummy_row_id : dummy_aggrs) {
-                prog->add_inst(SMC_LI(dummy_row_id, reg_row_id));
+                prog->add_li(dummy_row_id, reg_row_id);
 
                 remaining_cycs = add_op_with_delay(*prog, SMC_ACT(reg_bank_id, 0, reg_row_id, 0), remaining_cycs, tras_cycles - 1);
                 remaining_cycs = add_op_with_delay(*prog, SMC_PRE(reg_bank_id, 0, 0), remaining_cycs, trp_cycles - 1);
             }
 
-            add_op_with_delay(*prog, SMC_ADDI(reg_hammer_it, 1, reg_hammer_it), 0, 0);
+            prog->add_addi(reg_hammer_it, 1, reg_hammer_it);
         prog->add_branch(prog->BR_TYPE::BL, reg_hammer_it, reg_hammers_per_ref, lbl_hammer);
 
 
-    prog->add_inst(SMC_ADDI(reg_issued_refs, 1, reg_issued_refs));
+    prog->add_addi(reg_issued_refs, 1, reg_issued_refs);
     prog->add_branch(prog->BR_TYPE::BL, reg_issued_refs, reg_num_refs, lbl_issue_refs);
 
     if(exec_prog_and_clean) {
         // perform a dummy read to signal the end of a program
     
         SMC_REG reg_col_id = reg_alloc->allocate_SMC_REG();
-        add_op_with_delay(*prog, SMC_LI(0, reg_bank_id), 0, 0);
-        add_op_with_delay(*prog, SMC_LI(0, reg_row_id), 0, 0);
-        add_op_with_delay(*prog, SMC_LI(0, reg_col_id), 0, 0);
+        prog->add_li(0, reg_bank_id);
+        prog->add_li(0, reg_row_id);
+        prog->add_li(0, reg_col_id);
 
         add_op_with_delay(*prog, SMC_ACT(reg_bank_id, 0, reg_row_id, 0), 0, trcd_cycles);
         add_op_with_delay(*prog, SMC_READ(reg_bank_id, 0, reg_col_id, 0, 0, 0), 0, tras_cycles - trcd_cycles);
         add_op_with_delay(*prog, SMC_PRE(reg_bank_id, 0, 0), 0, trp_cycles);
 
         prog->add_inst(SMC_END());
-        platform.execute(*prog);
+        execute_program(platform, *prog);
         #ifdef PRINT_SOFTMC_PROGS
         std::cout << "--- SoftMCProg: Hammering Dummy Aggressors ---" << std::endl;
         prog->pretty_print();
@@ -1203,8 +1290,8 @@ void hammer_dummies(SoftMCPlatform& platform, const uint bank_id, const vector<u
 
         reg_alloc->free_SMC_REG(reg_col_id);
 
-        char cl[64];
-        platform.receiveData(cl, 64);
+        ArenaBuffer cl = receive_buffers.acquire(64);
+        receive_data(platform, cl.data(), cl.size());
     }
 
     reg_alloc->free_SMC_REG(reg_num_refs);
@@ -1226,17 +1313,19 @@ void hammer_hrs(SoftMCPlatform& platform,
                 const uint num_rounds, const bool skip_hammering_aggr, const bool ignore_dummy_hammers, 
                 const uint hammer_duration, const uint num_refs_per_round, const uint pre_ref_delay,
                 const vector<uint>& dummy_aggrs, const uint dummy_aggrs_bank, const bool hammer_dummies_first, const bool hammer_dummies_independently,
-                const uint num_bank0_hammers = 0, Program* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
+                const uint num_bank0_hammers = 0, SoftMCProgram* prog = nullptr, SoftMCRegAllocator* reg_alloc = nullptr) {
+
+    TraceSpan span("hammer");
 
     bool exec_prog_and_clean = false;
     if (prog == nullptr) {
-        prog = new Program();
+        prog = new SoftMCProgram();
         reg_alloc = new SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
         exec_prog_and_clean = true;
     }
 
     SMC_REG reg_bank_addr = reg_alloc->allocate_SMC_REG();
-    prog->add_inst(SMC_LI(hammerable_rows[0].bank_id, reg_bank_addr));
+    prog->add_li(hammerable_rows[0].bank_id, reg_bank_addr);
 
     if(exec_prog_and_clean)
         add_op_with_delay(*prog, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
@@ -1244,8 +1333,8 @@ void hammer_hrs(SoftMCPlatform& platform,
 
     SMC_REG reg_cur_its = reg_alloc->allocate_SMC_REG();
     SMC_REG reg_refresh_cycles = reg_alloc->allocate_SMC_REG();
-    prog->add_inst(SMC_LI(0, reg_cur_its));
-    prog->add_inst(SMC_LI(num_rounds, reg_refresh_cycles));
+    prog->add_li(0, reg_cur_its);
+    prog->add_li(num_rounds, reg_refresh_cycles);
 
     string lbl_hammer_loop = createSMCLabel("HAMMER_MAIN_LOOP");
     prog->add_label(lbl_hammer_loop);
@@ -1308,7 +1397,7 @@ void hammer_hrs(SoftMCPlatform& platform,
 
 
     if(hammer_dummies_independently && hammer_dummies_first && !ignore_dummy_hammers){
-        prog->add_inst(SMC_LI(dummy_aggrs_bank, reg_bank_addr));
+        prog->add_li(dummy_aggrs_bank, reg_bank_addr);
 
         std::vector<uint32_t> dummy_hammers_per_round;
         
@@ -1326,13 +1415,13 @@ void hammer_hrs(SoftMCPlatform& platform,
             assert(cascaded_hammer && "ERROR: Dummy aggressors can be in a different bank only when using cascaded hammering. This feature is not yet implemented for sequential hammering.");
 
             if(hammer_dummies_first && !hammer_dummies_independently && !ignore_dummy_hammers){
-                prog->add_inst(SMC_LI(dummy_aggrs_bank, reg_bank_addr));
+                prog->add_li(dummy_aggrs_bank, reg_bank_addr);
                 auto dummy_hammers_per_round = std::vector<uint32_t>(hammers_per_round.begin(), hammers_per_round.begin() + dummy_aggrs.size());
                 hammer_aggressors(*prog, *reg_alloc, reg_bank_addr, dummy_aggrs, dummy_hammers_per_round, cascaded_hammer, 0);
             }
 
             if(!skip_hammering_aggr) {
-                prog->add_inst(SMC_LI(hammerable_rows[0].bank_id, reg_bank_addr));
+                prog->add_li(hammerable_rows[0].bank_id, reg_bank_addr);
                 
                 auto weak_rows_hammers_per_ref = std::vector<uint32_t>(
                     (hammer_dummies_first & !hammer_dummies_independently) ? hammers_per_round.begin() + dummy_aggrs.size() : hammers_per_round.begin(),
@@ -1341,7 +1430,7 @@ void hammer_hrs(SoftMCPlatform& platform,
             }
 
             if(!hammer_dummies_first && !hammer_dummies_independently && !ignore_dummy_hammers){
-                prog->add_inst(SMC_LI(dummy_aggrs_bank, reg_bank_addr));
+                prog->add_li(dummy_aggrs_bank, reg_bank_addr);
                 auto dummy_hammers_per_round = std::vector<uint32_t>(hammers_per_round.begin() + weak_rows_to_hammer.size(), hammers_per_round.end());
                 hammer_aggressors(*prog, *reg_alloc, reg_bank_addr, dummy_aggrs, dummy_hammers_per_round, cascaded_hammer, 0);
             }
@@ -1352,7 +1441,7 @@ void hammer_hrs(SoftMCPlatform& platform,
     }
 
     if(hammer_dummies_independently && !hammer_dummies_first && !ignore_dummy_hammers){
-        prog->add_inst(SMC_LI(dummy_aggrs_bank, reg_bank_addr));
+        prog->add_li(dummy_aggrs_bank, reg_bank_addr);
 
         std::vector<uint32_t> dummy_hammers_per_round;
         
@@ -1366,7 +1455,7 @@ void hammer_hrs(SoftMCPlatform& platform,
 
     
     if (num_bank0_hammers > 0) {
-        prog->add_inst(SMC_LI(0, reg_bank_addr));
+        prog->add_li(0, reg_bank_addr);
         all_rows_to_hammer = std::vector<uint>{0};
         std::vector<uint> bank0_hammers_per_ref = std::vector<uint>{num_bank0_hammers};
         hammer_aggressors(*prog, *reg_alloc, reg_bank_addr, all_rows_to_hammer, bank0_hammers_per_ref, cascaded_hammer, hammer_duration);
@@ -1376,13 +1465,21 @@ void hammer_hrs(SoftMCPlatform& platform,
     if(num_rounds > 0 && num_refs_per_round > 0) {
         perform_refresh(*prog, *reg_alloc, num_refs_per_round, pre_ref_delay);
 
-        prog->add_inst(SMC_ADDI(reg_cur_its, 1, reg_cur_its));
+        prog->add_addi(reg_cur_its, 1, reg_cur_its);
         prog->add_branch(Program::BR_TYPE::BL, reg_cur_its, reg_refresh_cycles, lbl_hammer_loop); // 5) repeat hammering + REF num_rounds times
     }
 
     if(exec_prog_and_clean) {
         prog->add_inst(SMC_END());
-        platform.execute(*prog);
+        execute_program(platform, *prog);
+
+        // the ACTs of a single SoftMC program (use_single_softmc_prog) are not counted since the program repeats this code an unknown number of times
+        ulong acts_per_round = total_hammers_per_ref + num_bank0_hammers;
+        if(hammer_dummies_independently && !ignore_dummy_hammers)
+            for(auto dummy_hammers : t_dummy_hammers_per_ref)
+                acts_per_round += dummy_hammers;
+        tool_metrics.acts_issued += acts_per_round*std::max(num_rounds, 1u);
+
         #ifdef PRINT_SOFTMC_PROGS
         std::cout << "--- SoftMCProg: Hammering the Aggressor Rows ---" << std::endl;
         prog->pretty_print();
@@ -1401,7 +1498,7 @@ void hammer_hrs(SoftMCPlatform& platform,
 
 void perform_dummy_read(SoftMCPlatform& platform) {
 
-    Program prog;
+    SoftMCProgram prog;
     SoftMCRegAllocator reg_alloc = SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
 
     
@@ -1409,16 +1506,16 @@ void perform_dummy_read(SoftMCPlatform& platform) {
     SMC_REG reg_row_id = reg_alloc.allocate_SMC_REG();
     SMC_REG reg_col_id = reg_alloc.allocate_SMC_REG();
 
-    add_op_with_delay(prog, SMC_LI(0, reg_bank_id), 0, 0);
-    add_op_with_delay(prog, SMC_LI(0, reg_row_id), 0, 0);
-    add_op_with_delay(prog, SMC_LI(0, reg_col_id), 0, 0);
+    prog.add_li(0, reg_bank_id);
+    prog.add_li(0, reg_row_id);
+    prog.add_li(0, reg_col_id);
 
     add_op_with_delay(prog, SMC_ACT(reg_bank_id, 0, reg_row_id, 0), 0, trcd_cycles);
     add_op_with_delay(prog, SMC_READ(reg_bank_id, 0, reg_col_id, 0, 0, 0), 0, tras_cycles - trcd_cycles);
     add_op_with_delay(prog, SMC_PRE(reg_bank_id, 0, 0), 0, trp_cycles);
 
     prog.add_inst(SMC_END());
-    platform.execute(prog);
+    execute_program(platform, prog);
     #ifdef PRINT_SOFTMC_PROGS
     std::cout << "--- SoftMCProg: Performing a dummy read ---" << std::endl;
     prog.pretty_print();
@@ -1426,11 +1523,11 @@ void perform_dummy_read(SoftMCPlatform& platform) {
 
 
     // we put 64 bytes to the PCie bus. We need to clear this data
-    char cl[64];
-    platform.receiveData(cl, 64);
+    ArenaBuffer cl = receive_buffers.acquire(64);
+    receive_data(platform, cl.data(), cl.size());
 }
 
-void waitMS_softmc(const uint ret_time_ms, Program* prog) {
+void waitMS_softmc(const uint ret_time_ms, SoftMCProgram* prog) {
     // convert milliseconds to SoftMC cycles
 
     ulong cycs = std::ceil((ret_time_ms*1000000)/FPGA_PERIOD);
@@ -1438,7 +1535,7 @@ void waitMS_softmc(const uint ret_time_ms, Program* prog) {
     // cycs is the number of DDR cycles now, convert it to FPGA cycles by dividing it by 4
     cycs = std::ceil(cycs/4.0f);
 
-    prog->add_inst(SMC_SLEEP(cycs));
+    prog->add_sleep(cycs);
 }
 
 vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<HammerableRowSet>& hammerable_rows, const vector<uint>& dummy_aggrs, 
@@ -1449,10 +1546,19 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
                     const bool refs_after_init_no_dummy_hammer, const uint num_refs_per_round, const uint pre_ref_delay, const std::vector<uint>& hammers_before_wait,
                     const float init_to_hammerbw_delay, const uint num_bank0_hammers, const uint num_pre_init_bank0_hammers,
                     const uint pre_init_nops,
-                    const bool use_single_softmc_prog, const uint num_iterations, const bool verbose) {
+                    const bool use_single_softmc_prog, const uint num_iterations, const bool verbose,
+                    RetentionMux* mux = nullptr, const uint mux_exp = 0) {
+
+    // with retention-wait multiplexing, the other experiments use the board while this one waits
+    auto host_wait = [&](const uint ms) {
+        if(mux != nullptr)
+            mux->wait(mux_exp, ms);
+        else
+            waitMS(ms);
+    };
 
 
-    Program single_prog;
+    SoftMCProgram single_prog;
     SoftMCRegAllocator single_prog_reg_alloc = SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
 
     // create the iteration loop
@@ -1460,8 +1566,8 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
     SMC_REG reg_num_iters = single_prog_reg_alloc.allocate_SMC_REG();
 
     add_op_with_delay(single_prog, SMC_PRE(reg_iter_counter, 0, 1), 0, 0); // precharge all banks
-    single_prog.add_inst(SMC_LI(0, reg_iter_counter));
-    single_prog.add_inst(SMC_LI(num_iterations, reg_num_iters));
+    single_prog.add_li(0, reg_iter_counter);
+    single_prog.add_li(num_iterations, reg_num_iters);
 
     std::string lbl_iter_loop = createSMCLabel("MAIN_ITERATION_LOOP");
     single_prog.add_label(lbl_iter_loop);
@@ -1479,7 +1585,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
 
             if (first_it_aggr_init_and_hammer) {
                 SMC_REG reg_zero = single_prog_reg_alloc.allocate_SMC_REG();
-                single_prog.add_inst(SMC_LI(0, reg_zero));
+                single_prog.add_li(0, reg_zero);
                 single_prog.add_branch(Program::BR_TYPE::BEQ, reg_iter_counter, reg_zero, lbl_init_all);
                 single_prog_reg_alloc.free_SMC_REG(reg_zero);
 
@@ -1575,7 +1681,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
         wait_interval_ms -= wait_ms;
 
         if(!use_single_softmc_prog)
-            waitMS(wait_ms);
+            host_wait(wait_ms);
         else
             waitMS_softmc(wait_ms, &single_prog);
     }
@@ -1591,7 +1697,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
     
     if(!skip_hammering_aggr) {
         if(!use_single_softmc_prog)
-            waitMS(wait_interval_ms/* - prog_issue_duration.count()*/);
+            host_wait(wait_interval_ms/* - prog_issue_duration.count()*/);
         else
             waitMS_softmc(wait_interval_ms, &single_prog);
     }
@@ -1608,7 +1714,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
         std::string lbl_hammer_end = createSMCLabel("HAMMER_END");
         if (first_it_aggr_init_and_hammer) {
             SMC_REG reg_zero = single_prog_reg_alloc.allocate_SMC_REG();
-            single_prog.add_inst(SMC_LI(0, reg_zero));
+            single_prog.add_li(0, reg_zero);
             
             single_prog.add_branch(Program::BR_TYPE::BEQ, reg_iter_counter, reg_zero, lbl_hammer_all);
             single_prog_reg_alloc.free_SMC_REG(reg_zero);
@@ -1645,7 +1751,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
 
     // std::cout << YELLOW_TXT << "(2nd Wait) Waiting for (ms): " << hammerable_rows[0].ret_ms*TRR_RETTIME_MULT - dur_from_start.count() << NORMAL_TXT << std::endl;
     if(!use_single_softmc_prog)
-        waitMS(hammerable_rows[0].ret_ms*TRR_RETTIME_MULT - dur_from_start.count());
+        host_wait(hammerable_rows[0].ret_ms*TRR_RETTIME_MULT - dur_from_start.count());
     else
         // we cannot use the measured time interval 'dur_from_start' when executing the experiment as a single program
         // Therefore, we use the calculated time here
@@ -1653,12 +1759,13 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
     
 
     // 6) read back the weak rows and check for bitflips
-    Program* prog_read = nullptr;
+    TraceSpan read_span("read_back");
+    SoftMCProgram* prog_read = nullptr;
     SoftMCRegAllocator* reg_alloc = nullptr;
 
     bool exec_prog_and_clean = false;
     if (!use_single_softmc_prog) {
-        prog_read = new Program();
+        prog_read = new SoftMCProgram();
         reg_alloc = new SoftMCRegAllocator(NUM_SOFTMC_REGS, reserved_regs);
         exec_prog_and_clean = true;
     } else
@@ -1673,11 +1780,11 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
     if(exec_prog_and_clean)
         add_op_with_delay(*prog_read, SMC_PRE(reg_bank_addr, 0, 1), 0, 0); // precharge all banks
     
-    prog_read->add_inst(SMC_LI(NUM_COLS_PER_ROW*8, reg_num_cols));
+    prog_read->add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
 
     ulong total_victim_rows = 0;
     for(auto& hrs : hammerable_rows) {
-        prog_read->add_inst(SMC_LI(hrs.bank_id, reg_bank_addr));
+        prog_read->add_li(hrs.bank_id, reg_bank_addr);
         auto rows_to_read = hrs.victim_ids;
         rows_to_read.insert(rows_to_read.end(), hrs.uni_ids.begin(), hrs.uni_ids.end());
 
@@ -1687,7 +1794,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
 
     if(exec_prog_and_clean) {
         prog_read->add_inst(SMC_END());
-        platform.execute(*prog_read);
+        execute_program(platform, *prog_read);
         #ifdef PRINT_SOFTMC_PROGS
         std::cout << "--- SoftMCProg: Reading the Victim rows ---" << std::endl;
         prog_read->pretty_print();
@@ -1699,11 +1806,11 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
         assert(prog_read == &single_prog);
 
         // close the iteration loop
-        single_prog.add_inst(SMC_ADDI(reg_iter_counter, 1, reg_iter_counter));
+        single_prog.add_addi(reg_iter_counter, 1, reg_iter_counter);
         single_prog.add_branch(single_prog.BR_TYPE::BL, reg_iter_counter, reg_num_iters, lbl_iter_loop);
 
         single_prog.add_inst(SMC_END());
-        platform.execute(single_prog);
+        execute_program(platform, single_prog);
         #ifdef PRINT_SOFTMC_PROGS
         std::cout << "--- SoftMCProg: Running the experiments as a single SoftMC program ---" << std::endl;
         single_prog.pretty_print();
@@ -1717,9 +1824,12 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
     if(!use_single_softmc_prog) {
         // get data from PCIe
         ulong read_data_size = ROW_SIZE*total_victim_rows;
-        char buf[read_data_size*2];
-        platform.receiveData(buf, read_data_size);
+        ArenaBuffer buf = receive_buffers.acquire(read_data_size);
+        receive_data(platform, buf.data(), read_data_size);
         // std::cout << BLUE_TXT << "Successfully read all the data!" << NORMAL_TXT << std::endl;
+        tool_metrics.rows_tested += total_victim_rows;
+
+        TraceSpan span("analyze");
 
         vector<uint> bitflips;
         loc_bitflips.reserve(total_victim_rows);
@@ -1728,7 +1838,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
         for (auto& hrs : hammerable_rows) {
             for(uint vict_ind = 0; vict_ind < hrs.victim_ids.size(); vict_ind++) {
                 bitflips.clear();
-                collect_bitflips(bitflips, buf + row_it*ROW_SIZE, hrs.data_pattern, hrs.vict_bitflip_locs[vict_ind]);
+                collect_bitflips(bitflips, buf.data() + row_it*ROW_SIZE, hrs.data_pattern, hrs.vict_bitflip_locs[vict_ind]);
                 row_it++;
 
                 loc_bitflips.push_back(bitflips);
@@ -1741,7 +1851,7 @@ vector<vector<uint>> analyzeTRR(SoftMCPlatform& platform, const vector<Hammerabl
 
             for(uint uni_ind = 0; uni_ind < hrs.uni_ids.size(); uni_ind++) {
                 bitflips.clear();
-                collect_bitflips(bitflips, buf + row_it*ROW_SIZE, hrs.data_pattern, hrs.uni_bitflip_locs[uni_ind]);
+                collect_bitflips(bitflips, buf.data() + row_it*ROW_SIZE, hrs.data_pattern, hrs.uni_bitflip_locs[uni_ind]);
                 row_it++;
 
                 loc_bitflips.push_back(bitflips);
@@ -1881,16 +1991,15 @@ WeakRowSet adjust_wrs(const WeakRowSet& wrs, const std::string& row_layout){
     return new_wrs;
 }
 
-void pick_hammerable_row_groups_from_file(SoftMCPlatform& platform, boost::filesystem::ifstream& f_row_groups, vector<WeakRowSet>& row_groups, const uint num_row_groups,
+void pick_hammerable_row_groups_from_file(SoftMCPlatform& platform, const JSONObjectFile& f_row_groups, vector<WeakRowSet>& row_groups, const uint num_row_groups,
                                         const bool cascaded_hammer, const std::string row_layout) {
 
     vector<WeakRowSet> all_weaks;
-    all_weaks.reserve(100);
     parse_all_weaks(f_row_groups, all_weaks);
 
     while(row_groups.size() != num_row_groups) {
         // 1) Pick (in order) 'num_weaks' weak rows from 'file_weak_rows' that have the same retention time.
-        pick_weaks(f_row_groups, all_weaks, row_groups, num_row_groups);
+        pick_weaks(all_weaks, row_groups, num_row_groups);
         
         // cout << "Num picked weak rows: " << row_groups.size() << std::endl;
         // for(auto& wr : row_groups) {
@@ -1912,23 +2021,136 @@ void pick_hammerable_row_groups_from_file(SoftMCPlatform& platform, boost::files
     }
 }
 
-void get_row_groups_by_index(boost::filesystem::ifstream& f_row_groups, vector<WeakRowSet>& row_groups, const vector<uint>& ind_weak_rows, const std::string& row_layout) {
-    vector<WeakRowSet> all_weaks;
-    all_weaks.reserve(100);
-    parse_all_weaks(f_row_groups, all_weaks);
+// Pipeline mode: picks row groups as RowScout finds them, with the same rules as pick_hammerable_row_groups_from_file(). Each row group is
+// checked for hammerability as soon as it arrives. Returns false if RowScout finishes before enough row groups are found
+bool pick_hammerable_row_groups_from_queue(SoftMCPlatform& platform, RowGroupQueue& queue, vector<WeakRowSet>& row_groups, const uint num_row_groups,
+                                        const bool cascaded_hammer, const std::string row_layout) {
+
+    std::string s_wrs;
+    uint index;
+    while(row_groups.size() != num_row_groups) {
+        if(!queue.pop(s_wrs, index)) {
+            std::cerr << RED_TXT << "ERROR: RowScout finished without finding a sufficient number of hammerable weak rows" << NORMAL_TXT << std::endl;
+            std::cerr << RED_TXT << "Needed: " << num_row_groups << ", found: " << row_groups.size() << NORMAL_TXT << std::endl;
+            return false;
+        }
+
+        WeakRowSet wrs;
+        JS::ParseContext context(s_wrs);
+        context.parseTo(wrs);
+        wrs.index_in_file = index;
+
+        // remove picked rows that have different retention times
+        for(auto it_picked = row_groups.begin(); it_picked != row_groups.end(); it_picked++) {
+            if(std::abs((int)it_picked->ret_ms - (int)wrs.ret_ms) > TRR_ALLOWED_RET_TIME_DIFF)
+                row_groups.erase(it_picked--);
+        }
+
+        bool hammerable;
+        {
+            std::unique_lock<std::mutex> board_lock(queue.board_mutex());
+            hammerable = is_hammerable(platform, wrs, row_layout, cascaded_hammer);
+        }
+
+        if(!hammerable) {
+            std::cout << RED_TXT << "Candidate victim row set " << wrs.rows_as_str() << " is not hammerable" << NORMAL_TXT << std::endl;
+            continue;
+        }
+
+        std::cout << GREEN_TXT << "Candidate victim row " << wrs.rows_as_str() << " is hammerable" << NORMAL_TXT << std::endl;
+        row_groups.push_back(adjust_wrs(wrs, row_layout));
+    }
+
+    return true;
+}
 
+// parses only the requested row groups
+void get_row_groups_by_index(const JSONObjectFile& f_row_groups, vector<WeakRowSet>& row_groups, const vector<uint>& ind_weak_rows, const std::string& row_layout) {
     for(uint ind : ind_weak_rows) {
-        if(all_weaks.size() <= ind) {
+        if(f_row_groups.num_objects() <= ind) {
             std::cerr << RED_TXT << "ERROR: The weaks rows file does not contain a sufficient number of hammerable weak rows" << NORMAL_TXT << std::endl;
-            std::cerr << RED_TXT << "Needed the weak row at index: " << ind << " but the file contains " << all_weaks.size() << " row_groups" << NORMAL_TXT << std::endl;
+            std::cerr << RED_TXT << "Needed the weak row at index: " << ind << " but the file contains " << f_row_groups.num_objects() << " row_groups" << NORMAL_TXT << std::endl;
             exit(-1);
         }
+    }
+
+    vector<WeakRowSet> picked_weaks;
+    parse_weaks(f_row_groups, vector<size_t>(ind_weak_rows.begin(), ind_weak_rows.end()), picked_weaks);
 
-        WeakRowSet adjusted_wrs = adjust_wrs(all_weaks[ind], row_layout);
+    for(auto& wrs : picked_weaks) {
+        WeakRowSet adjusted_wrs = adjust_wrs(wrs, row_layout);
         row_groups.push_back(adjusted_wrs);
     }
 }
 
+// writes the bitflips of an iteration, in the order of the physical row IDs of each row group, and adds them to total_bitflips
+void write_iteration_bitflips(std::ostream& out, const vector<HammerableRowSet>& hrs, const vector<vector<uint>>& loc_bitflips,
+                                vector<uint>& total_bitflips, const bool location_out) {
+    uint bitflips_ind = 0;
+
+    for(auto& hr : hrs) {
+        uint total_rows = hr.victim_ids.size() + hr.uni_ids.size();
+
+        std::vector<std::string> output_strs_vict, output_strs_uni;
+
+        for(uint vict : hr.victim_ids) {
+            // out << "Victim row " << vict << ": " << num_bitflips[it_vict] << std::endl;
+            string output_str_vict;
+            output_str_vict = "Victim row " + to_string(vict) + ": " + to_string(loc_bitflips[bitflips_ind].size());
+            if(location_out){
+                output_str_vict += ": ";
+                for(auto loc: loc_bitflips[bitflips_ind])
+                    output_str_vict += to_string(loc) + ", ";
+            }
+            output_strs_vict.push_back(output_str_vict);
+            total_bitflips[bitflips_ind] += loc_bitflips[bitflips_ind].size();
+            bitflips_ind++;
+        }
+
+        for(uint uni : hr.uni_ids) {
+            // out << "Victim row(U) " << uni << ": " << num_bitflips[it_vict] << std::endl;
+            string output_str_uni;
+            output_str_uni = "Victim row(U) " + to_string(uni) + ": " + to_string(loc_bitflips[bitflips_ind].size());
+            if(location_out){
+                output_str_uni += ": ";
+                for(auto loc: loc_bitflips[bitflips_ind])
+                    output_str_uni += to_string(loc) + ", ";
+            }
+            output_strs_uni.push_back(output_str_uni);
+            total_bitflips[bitflips_ind] += loc_bitflips[bitflips_ind].size();
+            bitflips_ind++;
+        }
+
+        // reordering rows based on their physical row IDs
+        uint uni_ind = 0;
+        for(uint vict_ind = 0; vict_ind < hr.victim_ids.size(); vict_ind++){
+            if(uni_ind != hr.uni_ids.size() && to_physical_row_id(hr.uni_ids[uni_ind]) < to_physical_row_id(hr.victim_ids[vict_ind])){
+                out << output_strs_uni[uni_ind++] << std::endl;
+                vict_ind--;
+            } else {
+                out << output_strs_vict[vict_ind] << std::endl;
+            }
+        }
+
+        for(; uni_ind < hr.uni_ids.size(); uni_ind++)
+            out << output_strs_uni[uni_ind] << std::endl;
+    }
+}
+
+void write_total_bitflips(std::ostream& out, const vector<HammerableRowSet>& hrs, const vector<uint>& total_bitflips) {
+    out << "Total bitflips:" << std::endl;
+    uint it_vict = 0;
+    for(auto& hr : hrs) {
+        for(uint vict : hr.victim_ids) {
+            out << "Victim row " << vict << ": " << total_bitflips[it_vict++] << std::endl;
+        }
+
+        for(uint uni : hr.uni_ids) {
+            out << "Victim row(U) " << uni << ": " << total_bitflips[it_vict++] << std::endl;
+        }
+    }
+}
+
 bool check_dummy_vs_rg_collision(const std::vector<uint>& dummy_aggrs, const std::vector<WeakRowSet>& vec_wrs) {
     for(uint dummy : dummy_aggrs) {
         for(const auto& wrs : vec_wrs) {
@@ -1976,12 +2198,13 @@ void adjust_hammers_per_ref(std::vector<uint>& hammers_per_round, const uint num
     }
 }
 
-int main(int argc, char** argv)
+int trranalyzer_main(SoftMCPlatform* shared_platform, int argc, char** argv)
 {
     /* Program options */
     std::string out_filename = "./out.txt";
     uint num_row_groups = 1;
     std::string row_scout_file = "";
+    bool no_row_scout_index = false;
     std::string row_layout = "RAR";
     std::vector<uint> hammers_per_round;
     std::vector<uint> hammers_before_wait;
@@ -2008,6 +2231,7 @@ int main(int argc, char** argv)
     float hammer_cycle_time = 0.0f; // as nanosec
     uint hammer_duration = 0; // as DDR cycles (1.5ns)
     bool append_output = false;
+    bool resume = false;
 
     vector<uint> row_group_indices;
     bool skip_hammering_aggr = false;
@@ -2021,9 +2245,16 @@ int main(int argc, char** argv)
     bool init_only_victims = false;
 
     bool use_single_softmc_prog = false;
+    uint num_experiments = 1;
+    double mux_margin_ms = DEFAULT_MUX_MARGIN_MS;
+    double mux_late_tolerance_ms = DEFAULT_MUX_LATE_TOLERANCE_MS;
+    uint mux_retries = 2;
     bool location_out = false;
+    std::string trace_filename = "";
+    std::string metrics_filename = "";
 
     uint arg_log_phys_conv_scheme = 0;
+    std::string row_mapping_filename = "";
 
     // try{
     options_description desc("TRR Analyzer Options");
@@ -2031,6 +2262,7 @@ int main(int argc, char** argv)
         ("help,h", "Prints this usage statement.")
         ("out,o", value(&out_filename)->default_value(out_filename), "Specifies a path for the output file.")
         ("row_scout_file,f", value(&row_scout_file)->required(), "A file containing a list of row groups and their retentions times, i.e., the output of RowScout.")
+        ("no_row_scout_index", bool_switch(&no_row_scout_index), "When specified, TRR Analyzer neither reads nor writes the index of the objects in --row_scout_file (<row_scout_file>.idx), which otherwise lets later runs skip scanning the file.")
         ("num_row_groups,w", value(&num_row_groups)->default_value(num_row_groups), "The number of row groups to work with. Row groups are parsed in order from the 'row_scout_file'.")
         ("row_layout", value(&row_layout)->default_value(row_layout), "Specifies how the aggressor rows should be positioned inside a row group. Allowed characters are 'R', 'A', 'U', and '-'. For example, 'RAR' places an aggressor row between two adjacent (victim) rows, as is single-sided RowHammer attacks. 'RARAR' places two aggressor rows to perform double-sided RowHammer attack. '-' specifies a row that is not to be hammered or checked for bit flips. 'U' specifies a (unified) row that will be both hammered and checked for bit flips.")
         ("row_group_indices", value<vector<uint>>(&row_group_indices)->multitoken(), "An optional argument used select which exact row groups in the --row_scout_file to use. When this argument is not provided, TRR Analyzer selects --num_row_groups from the file in order.")
@@ -2046,7 +2278,7 @@ int main(int argc, char** argv)
         ("hammer_duration", value(&hammer_duration)->default_value(hammer_duration), "Specifies the number of additional cycles to wait in row active state while hammering (tRAS + hammer_duration). The default is 0, i.e., tRAS)")
         ("hammer_cycle_time", value(&hammer_cycle_time)->default_value(hammer_cycle_time), "Specifies the time interval between two consecutive activations (the default and the minimum is tRAS + tRP).")
         ("init_aggrs_first", bool_switch(&init_aggrs_first), "When specified, the aggressor rows are initialized with a data pattern before the victim rows.")
-        ("first_it_aggr_init_and_hammer", bool_switch(&first_it_aggr_init_and_hammer), "When specified, the aggressor rows are initialized and hammered only during the first iteration.")
+        ("first_it_aggr_init_and_hammer", bool_switch(&first_it_aggr_init_and_hammer), "When specified, the aggressor rows are initialized and hammered only during the first iteration (with --resume, during the first iteration that runs).")
         ("init_only_victims", bool_switch(&init_only_victims), "When specified, only the victim rows are initialized at the beginning of an iteration but not the aggressors.")
 
         // refresh related args
@@ -2063,7 +2295,7 @@ int main(int argc, char** argv)
         ("hammer_dummies_independently", bool_switch(&hammer_dummies_independently), "When specified, the dummy rows are hammered after the aggressor rows to matter whether --cascaded is used or not. The dummy rows are simply treated as a separate group of rows to hammer after hammering the aggressor rows in interleaved or cascaded way.")
         ("num_dummy_after_init", value(&num_dummy_after_init)->default_value(num_dummy_after_init), "Specifies the number of dummy rows to hammer right after initializing the victim and aggressor rows. These dummy row hammers happen concurrently with --refs_after_init refreshes. Each dummy is hammered as much as possible based on the refresh interval and --refs_after_init.")
         ("refs_after_init_no_dummy_hammer", bool_switch(&refs_after_init_no_dummy_hammer), "When specified, after hammering dummy rows as specified by --num_dummy_after_init, TRR Analyzer also performs another set of refreshes but this time without hammering dummy rows.")
-        ("first_it_dummy_hammer", bool_switch(&first_it_dummy_hammer), "When specified, the dummy rows are hammered only during the first iteration.")
+        ("first_it_dummy_hammer", bool_switch(&first_it_dummy_hammer), "When specified, the dummy rows are hammered only during the first iteration (with --resume, during the first iteration that runs).")
 
         // other. args
         ("init_to_hammerbw_delay", value(&init_to_hammerbw_delay)->default_value(init_to_hammerbw_delay), "A float in range [0,1] that specifies the ratio of time to wait before performing --hammers_before_wait. The default value (0) means all the delay is inserted after performing --hammers_before_wait (if specified)")
@@ -2073,9 +2305,17 @@ int main(int argc, char** argv)
         ("pre_ref_delay", value(&pre_ref_delay)->default_value(pre_ref_delay), "Specifies the number of cycles to wait before performing REFs specified by --refs_per_round. Must be 8 or larger if not 0 for this arg to take an effect.")
         ("only_pick_rgs", bool_switch(&only_pick_rgs), "When specified, the test finds hammerable row groups rows in --row_scout_file, but it does not run the TRR analysis.")
         ("log_phys_scheme", value(&arg_log_phys_conv_scheme)->default_value(arg_log_phys_conv_scheme), "Specifies how to convert logical row IDs to physical row ids and the other way around. Pass 0 (default) for sequential mapping, 1 for the mapping scheme typically used in Samsung chips.")
+        ("row_mapping_file", value(&row_mapping_filename), "Specifies a file that describes how to convert logical row IDs to physical row IDs (overrides --log_phys_scheme). Each line remaps a physical row address bit to the XOR of logical bits, e.g., \"p1 = l1 ^ l3\" (see tools/row_mapping.h). RowHammerAttacker --discover_mapping produces such files.")
         ("use_single_softmc_prog", bool_switch(&use_single_softmc_prog), "When specified, the entire experiment executes as a single SoftMC program. This is to prevent SoftMC maintenance operations to kick in between multiple SoftMC programs. However, using this option may result in a very large program that may exceed the instruction limit.")
+        ("num_experiments", value(&num_experiments)->default_value(num_experiments), "Runs this many independent experiments, each on its own --num_row_groups row groups (or an equal share of --row_group_indices), on the same board. While an experiment waits for the retention time of its rows, the board initializes and reads the rows of the other experiments, with the start of each experiment staggered such that its waits take as long as when it runs alone. The experiments must neither hammer nor issue REFs (a REF refreshes all banks, and REFs and hammers drive the TRR mechanism shared by all banks), so this only speeds up retention experiments. The output of experiment i is written to <--out>.<i>. The row groups of different experiments must not interfere, e.g., they should be far apart in the bank.")
+        ("mux_margin_ms", value(&mux_margin_ms)->default_value(mux_margin_ms), "With --num_experiments, the minimum time (in ms) kept between the board phases of different experiments to absorb variations in how long a phase takes.")
+        ("mux_late_tolerance_ms", value(&mux_late_tolerance_ms)->default_value(mux_late_tolerance_ms), "With --num_experiments, an iteration is late when one of its retention waits ends more than this many ms later than requested because another experiment holds the board. A late iteration is run again (see --mux_retries).")
+        ("mux_retries", value(&mux_retries)->default_value(mux_retries), "With --num_experiments, how many times a late iteration is run again. If the last run is late as well, its results are written with the overrun, e.g., \"Iteration 5 bitflips (retention wait 12.5 ms late):\".")
         ("append", bool_switch(&append_output), "When specified, the output of TRR Analyzer is appended to the --out file. Otherwise the --out file is cleared.")
         ("location_out", bool_switch(&location_out), "When specified, the bit flip locations are written to the --out file.")
+        ("trace", value(&trace_filename), "When specified, records how long each phase (picking row groups, data initialization, hammering, waits, program lowering and execution, receiving data, bitflip analysis, and output) takes and writes the recorded spans to the specified file as Chrome trace-event JSON, which can be opened in chrome://tracing or ui.perfetto.dev. A histogram of each phase is printed at exit.")
+        ("metrics_out", value(&metrics_filename), "When specified, periodically (every 5 seconds) writes live metrics (rows tested (i.e., victim rows checked for bitflips), ACTs issued to hammer rows, bytes received over PCIe, programs executed, time spent generating programs, and the progress and ETA of the test) to the specified file in the Prometheus text format, e.g., for the textfile collector of node_exporter, and as JSON to the same path with a .json extension (replacing .prom, if any).")
+        ("resume", bool_switch(&resume), "When specified, continues an interrupted experiment from the checkpoint file (<--out>.ckpt) that TRR Analyzer updates after every iteration. The experiment continues from the next iteration with the same row groups, dummy rows, and hammer counts. All other arguments must be the same as in the interrupted run.")
         ;
 
 
@@ -2088,8 +2328,43 @@ int main(int argc, char** argv)
 
     notify(vm);
 
-    if(row_group_indices.size() > 0)
-        num_row_groups = row_group_indices.size();
+    if(num_experiments == 0) {
+        std::cerr << RED_TXT << "ERROR: --num_experiments must be at least 1" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    if(num_experiments > 1 && (use_single_softmc_prog || skip_hammering_aggr || resume)) {
+        std::cerr << RED_TXT << "ERROR: --num_experiments cannot be used with --use_single_softmc_prog, --skip_hammering_aggr, or --resume since the experiments share the board only while they wait on the host" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    // The commands of an experiment reach the DRAM while the others wait for the retention time of their rows. A REF refreshes
+    // the rows of all banks, and REFs and hammers (of aggressors, dummies, or bank 0 rows) drive the TRR mechanism of the chip,
+    // which would refresh the victims of the other experiments
+    auto any_nonzero = [](const std::vector<uint>& v) { return std::any_of(v.begin(), v.end(), [](const uint x) { return x > 0; }); };
+    bool round_hammers = any_nonzero(hammers_per_round) || (dummy_hammers_per_round > 0 && (num_dummy_aggressors > 0 || !arg_dummy_aggr_ids.empty()));
+    bool issues_refs_or_hammers = (num_rounds > 0 && (num_refs_per_round > 0 || round_hammers || num_bank0_hammers > 0)) ||
+            refs_after_init > 0 || num_dummy_after_init > 0 || any_nonzero(hammers_before_wait) || num_pre_init_bank0_hammers > 0;
+
+    if(num_experiments > 1 && issues_refs_or_hammers) {
+        std::cerr << RED_TXT << "ERROR: --num_experiments can only be used when the experiments neither hammer nor issue REFs (e.g., --num_rounds 0 and no --refs_after_init), since these reach the rows of the other experiments during their retention wait" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    // the order in which the experiments use the board depends on the timing of the host, so a capture could not be replayed
+    if(num_experiments > 1 && softmc_capture_mode() != SOFTMC_CAPTURE_OFF) {
+        std::cerr << RED_TXT << "ERROR: --num_experiments cannot be used when capturing (UTRR_CAPTURE) or replaying (UTRR_REPLAY) a run" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    if(row_group_indices.size() > 0) {
+        if(row_group_indices.size() % num_experiments != 0) {
+            std::cerr << RED_TXT << "ERROR: The " << row_group_indices.size() << " --row_group_indices cannot be split evenly into " << num_experiments << " experiments" << NORMAL_TXT << std::endl;
+            return -3;
+        }
+
+        num_row_groups = row_group_indices.size()/num_experiments;
+    }
 
     if(arg_dummy_aggr_ids.size() > 0) {
         num_dummy_aggressors = arg_dummy_aggr_ids.size();
@@ -2101,13 +2376,13 @@ int main(int argc, char** argv)
             row_layout = row_scout_file.substr(dot_pos + 1);
         else {
             std::cerr << RED_TXT << "ERROR: Could not find '.' in the provided --row_scout_file\n" << std::endl;
-            exit(-5);
+            return -5;
         }
     }
 
     if(!std::regex_match(row_layout, std::regex("^[RrAaUu-]+$"))) {
         std::cerr << RED_TXT << "ERROR: --row_layout should contain only 'R', 'A', 'U', and '-' characters. Provided: " << row_layout << NORMAL_TXT << std::endl;
-        exit(-3);
+        return -3;
     }
 
     if(out_filename != "") {
@@ -2121,8 +2396,52 @@ int main(int argc, char** argv)
         }
     }
 
+    // the experiment is checkpointed next to the output file after every iteration
+    std::string ckpt_filename = out_filename + ".ckpt";
+    bool write_checkpoints = (out_filename != "") && !use_single_softmc_prog && (num_experiments == 1);
+
+    std::vector<std::string> run_args;
+    for(int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if(arg != "--resume" && arg != "--append")
+            run_args.push_back(arg);
+    }
+
+    TRRCheckpoint ckpt;
+    if(resume) {
+        if(!write_checkpoints) {
+            std::cerr << RED_TXT << "ERROR: --resume requires an --out file and cannot be used with --use_single_softmc_prog" << NORMAL_TXT << std::endl;
+            return -1;
+        }
+
+        if(!load_checkpoint(ckpt_filename, ckpt)) {
+            std::cerr << RED_TXT << "ERROR: Could not load the checkpoint file: " << ckpt_filename << NORMAL_TXT << std::endl;
+            return -1;
+        }
+
+        if(ckpt.args != run_args) {
+            std::cerr << RED_TXT << "ERROR: The arguments differ from the arguments of the checkpointed run. Checkpointed run:" << NORMAL_TXT << std::endl;
+            for(auto& arg : ckpt.args)
+                std::cerr << arg << " ";
+            std::cerr << std::endl;
+            return -1;
+        }
+
+        if(ckpt.next_iteration >= num_iterations) {
+            std::cout << GREEN_TXT << "The checkpointed experiment has already finished all " << num_iterations << " iterations." << NORMAL_TXT << std::endl;
+            return 0;
+        }
+
+        // discard the partial output of the interrupted iteration
+        boost::filesystem::resize_file(out_filename, ckpt.out_file_size);
+        append_output = true;
+
+        std::cout << YELLOW_TXT << "Resuming the experiment from iteration " << ckpt.next_iteration << NORMAL_TXT << std::endl;
+    }
+
+    // with multiple experiments, each experiment writes to its own file
     boost::filesystem::ofstream out_file;
-    if(out_filename != "") {
+    if(out_filename != "" && (num_experiments == 1 || only_pick_rgs)) {
         if(append_output)
             out_file.open(out_filename, boost::filesystem::ofstream::app);
         else
@@ -2130,20 +2449,37 @@ int main(int argc, char** argv)
     } else {
         out_file.open("/dev/null");
     }
-    
-    SoftMCPlatform platform;
-    int err;
 
-    if((err = platform.init()) != SOFTMC_SUCCESS){
-        cerr << "Could not initialize SoftMC Platform: " << err << endl;
-        return err;
+    // writes the final values when the test returns
+    MetricsExporter metrics_exporter;
+    if(metrics_filename != "") {
+        std::string metrics_error = metrics_exporter.start(metrics_filename, "TRRAnalyzer");
+        if(metrics_error != "") {
+            std::cerr << RED_TXT << "ERROR: Could not write the metrics: " << metrics_error << NORMAL_TXT << std::endl;
+            return -3;
+        }
     }
 
-    platform.reset_fpga();  
-    platform.set_aref(false); // disable refresh
+    if(trace_filename != "")
+        start_tracing();
 
-    assert(arg_log_phys_conv_scheme < uint(LogPhysRowIDScheme::MAX));
-    logical_physical_conversion_scheme = (LogPhysRowIDScheme) arg_log_phys_conv_scheme;
+    receive_buffers.reset_stats();
+    
+    // when running as an ExperimentServer job, the platform is already initialized
+    SoftMCPlatform own_platform;
+    SoftMCPlatform& platform = (shared_platform != nullptr) ? *shared_platform : own_platform;
+
+    if(shared_platform == nullptr) {
+        int err;
+        if((err = init_softmc_platform(platform)) != SOFTMC_SUCCESS)
+            return err;
+    }
+
+    std::string mapping_error = init_row_mapping(arg_log_phys_conv_scheme, row_mapping_filename, NUM_ROWS);
+    if(mapping_error != "") {
+        std::cerr << RED_TXT << "ERROR: Invalid row mapping: " << mapping_error << NORMAL_TXT << std::endl;
+        return -3;
+    }
 
     // init random data generator
     std::srand(0);
@@ -2152,43 +2488,88 @@ int main(int argc, char** argv)
 
     auto t_prog_started = chrono::high_resolution_clock::now();
     chrono::duration<double> elapsed;
-    bool check_time;
 
 
+    // the row groups of experiment i are row_groups[i*num_row_groups, (i + 1)*num_row_groups)
+    uint num_picked_row_groups = num_row_groups*num_experiments;
     vector<WeakRowSet> row_groups;
     vector<uint> picked_weak_indices;
-    row_groups.reserve(num_row_groups);
-    picked_weak_indices.reserve(num_row_groups);
+    row_groups.reserve(num_picked_row_groups);
+    picked_weak_indices.reserve(num_picked_row_groups);
+
+    // in pipeline mode, the row groups come from RowScout as it writes the RowScout file
+    bool from_pipeline = (row_group_queue != nullptr) && !resume && (num_row_groups > 0);
+    if(from_pipeline && row_group_indices.size() > 0) {
+        std::cerr << RED_TXT << "ERROR: --row_group_indices cannot be used in pipeline mode since the RowScout file is not complete yet" << NORMAL_TXT << std::endl;
+        return -3;
+    }
+
+    JSONObjectFile f_row_groups;
+    if(!from_pipeline) {
+        boost::filesystem::path p_row_scout_file(row_scout_file);
+        if(!boost::filesystem::exists(p_row_scout_file)) {
+            std::cerr << RED_TXT << "ERROR: RowScout file not found: " << row_scout_file << NORMAL_TXT << std::endl;
+            return -1;
+        }
 
-    boost::filesystem::ifstream f_row_groups;
-    boost::filesystem::path p_row_scout_file(row_scout_file);
-    if(!boost::filesystem::exists(p_row_scout_file)) {
-        std::cerr << RED_TXT << "ERROR: RowScout file not found: " << row_scout_file << NORMAL_TXT << std::endl;
-        exit(-1);
+        std::string row_scout_error = f_row_groups.open(row_scout_file, !no_row_scout_index);
+        if(row_scout_error != "") {
+            std::cerr << RED_TXT << "ERROR: Could not read the RowScout file: " << row_scout_error << NORMAL_TXT << std::endl;
+            return -1;
+        }
     }
-    f_row_groups.open(p_row_scout_file);
     
-    if(row_group_indices.size() > 0) {
-        get_row_groups_by_index(f_row_groups, row_groups, row_group_indices, row_layout);
-    }
-    else if (num_row_groups > 0) {
-        pick_hammerable_row_groups_from_file(platform, f_row_groups, row_groups, num_row_groups, cascaded_hammer, row_layout);
+    bool picked_row_groups = true;
+    {
+        TraceSpan span("pick_row_groups");
+
+        if(resume) { // the row groups were picked by the interrupted run
+            row_groups = ckpt.row_groups;
+        }
+        else if(from_pipeline) {
+            picked_row_groups = pick_hammerable_row_groups_from_queue(platform, *row_group_queue, row_groups, num_picked_row_groups, cascaded_hammer, row_layout);
+        }
+        else if(row_group_indices.size() > 0) {
+            get_row_groups_by_index(f_row_groups, row_groups, row_group_indices, row_layout);
+        }
+        else if (num_row_groups > 0) {
+            pick_hammerable_row_groups_from_file(platform, f_row_groups, row_groups, num_picked_row_groups, cascaded_hammer, row_layout);
+        }
     }
     
     f_row_groups.close();
 
+    // returns instead of exiting so that the Pipeline that runs TRR Analyzer in its process can report the error
+    if(!picked_row_groups) {
+        stop_tracing(trace_filename);
+        return -1;
+    }
+
+    // RowScout is not needed anymore. In pipeline mode, the board is ours from now on
+    if(row_group_queue != nullptr)
+        row_group_queue->stop();
+    std::unique_lock<std::mutex> board_lock = pipeline_board_lock();
+
     if(only_pick_rgs) { // write the picked weak row indices to the output file and exit
         for(auto& rg : row_groups)
             out_file << rg.index_in_file << " ";
 
+        std::string trace_error = stop_tracing(trace_filename);
+        if(trace_error != "")
+            std::cerr << RED_TXT << "ERROR: Could not write the trace: " << trace_error << NORMAL_TXT << std::endl;
+
         return 0;
     }
 
-    if(dummy_aggrs_bank == -1)
+    if(resume)
+        dummy_aggrs_bank = ckpt.dummy_aggrs_bank;
+    else if(dummy_aggrs_bank == -1)
         dummy_aggrs_bank = row_groups[0].bank_id;
 
     // 3) Pick dummy aggressors rows
-    if((num_dummy_aggressors > 0) && arg_dummy_aggr_ids.size() == 0) {
+    if(resume) {
+        arg_dummy_aggr_ids = ckpt.dummy_aggr_ids;
+    } else if((num_dummy_aggressors > 0) && arg_dummy_aggr_ids.size() == 0) {
         uint max_dummy_aggrs = num_dummy_aggressors;
         arg_dummy_aggr_ids.reserve(max_dummy_aggrs);
         pick_dummy_aggressors(arg_dummy_aggr_ids, dummy_aggrs_bank, max_dummy_aggrs, row_groups, dummy_ids_offset);
@@ -2208,7 +2589,9 @@ int main(int argc, char** argv)
 
     // pick dummy rows that are hammered right after initializing data while performing refresh operations
     std::vector<uint> after_init_dummies;
-    if(num_dummy_after_init > 0) {
+    if(resume) {
+        after_init_dummies = ckpt.after_init_dummies;
+    } else if(num_dummy_after_init > 0) {
         std::vector<WeakRowSet> cur_rgs_and_dummies = row_groups;
         WeakRowSet cur_dummies;
 
@@ -2241,25 +2624,46 @@ int main(int argc, char** argv)
     }
 
     auto aggr_hammers_per_ref = hammers_per_round;
+    vector<uint> total_bitflips(total_victims, 0);
+    uint first_iteration = 0;
 
-    if(total_aggrs > 0)
-        adjust_hammers_per_ref(hammers_per_round, hrs[0].aggr_ids.size(), hammer_rgs_individually, skip_hammering_aggr,
-                            row_groups.size(), total_aggrs, arg_dummy_aggr_ids, dummy_hammers_per_round, hammer_dummies_first);
+    if(resume) {
+        for(uint i = 0; i < hrs.size(); i++)
+            hrs[i].data_pattern = bitset<512>(ckpt.data_patterns[i]);
 
-    if(hammers_before_wait.size() > 0)
-        adjust_hammers_per_ref(hammers_before_wait, hrs[0].aggr_ids.size(), hammer_rgs_individually, skip_hammering_aggr,
-                            row_groups.size(), total_aggrs, arg_dummy_aggr_ids, 0, hammer_dummies_first);
+        aggr_hammers_per_ref = ckpt.aggr_hammers_per_ref;
+        hammers_per_round = ckpt.hammers_per_round;
+        hammers_before_wait = ckpt.hammers_before_wait;
+        total_bitflips = ckpt.total_bitflips;
+        first_iteration = ckpt.next_iteration;
+    } else {
+        // the experiments hammer their row groups the same way
+        uint exp_aggrs = total_aggrs/num_experiments;
 
-    vector<uint> total_bitflips(total_victims, 0);
+        if(total_aggrs > 0)
+            adjust_hammers_per_ref(hammers_per_round, hrs[0].aggr_ids.size(), hammer_rgs_individually, skip_hammering_aggr,
+                                num_row_groups, exp_aggrs, arg_dummy_aggr_ids, dummy_hammers_per_round, hammer_dummies_first);
+
+        if(hammers_before_wait.size() > 0)
+            adjust_hammers_per_ref(hammers_before_wait, hrs[0].aggr_ids.size(), hammer_rgs_individually, skip_hammering_aggr,
+                                num_row_groups, exp_aggrs, arg_dummy_aggr_ids, 0, hammer_dummies_first);
+    }
 
     // Setting up a progress bar
-    progresscpp::ProgressBar progress_bar(num_iterations, 70, '#', '-');
+    progresscpp::ProgressBar progress_bar(num_iterations*num_experiments, 70, '#', '-');
+    for(uint i = 0; i < first_iteration; i++)
+        ++progress_bar;
 
 
     std::cout << BLUE_TXT << "Num hammerable row sets: " << hrs.size() << NORMAL_TXT << std::endl;
     uint hr_ind = 0;
     uint hammers_ind = 0;
     for(auto hr : hrs) {
+        if(num_experiments > 1 && hr_ind % num_row_groups == 0) {
+            std::cout << BLUE_TXT << "Experiment " << hr_ind/num_row_groups << NORMAL_TXT << std::endl;
+            hammers_ind = 0;
+        }
+
         std::cout << BLUE_TXT << "Hammerable row set " << hr_ind << NORMAL_TXT << std::endl;
 
         std::cout << BLUE_TXT << "Victims: ";
@@ -2287,80 +2691,135 @@ int main(int argc, char** argv)
 
     std::cout << BLUE_TXT << "tRAS: " << tras_cycles << " cycles" << NORMAL_TXT << std::endl;
 
-    // printing experiment parameters
-    out_file << "row_layout=" << row_layout << std::endl;
-    out_file << "--- END OF HEADER ---" << std::endl;
+    if(!resume && num_experiments == 1) {
+        // printing experiment parameters
+        out_file << "row_layout=" << row_layout << std::endl;
+        out_file << "--- END OF HEADER ---" << std::endl;
+    }
 
+    if(write_checkpoints && !resume) {
+        ckpt.args = run_args;
+        ckpt.row_groups = row_groups;
+        for(auto& rg : row_groups)
+            ckpt.row_group_indices.push_back(rg.index_in_file);
+        for(auto& hr : hrs)
+            ckpt.data_patterns.push_back(hr.data_pattern.to_string());
+        ckpt.dummy_aggr_ids = arg_dummy_aggr_ids;
+        ckpt.after_init_dummies = after_init_dummies;
+        ckpt.dummy_aggrs_bank = dummy_aggrs_bank;
+        ckpt.aggr_hammers_per_ref = aggr_hammers_per_ref;
+        ckpt.hammers_per_round = hammers_per_round;
+        ckpt.hammers_before_wait = hammers_before_wait;
+        ckpt.total_bitflips = total_bitflips;
+        ckpt.next_iteration = 0;
+
+        out_file.flush();
+        ckpt.out_file_size = boost::filesystem::file_size(out_filename);
+        save_checkpoint(ckpt_filename, ckpt);
+    }
+
+    // runs iteration i of the experiment on exp_hrs as a separate SoftMC program for each phase
+    auto analyze_iteration = [&](const vector<HammerableRowSet>& exp_hrs, const uint i, const bool verbose, RetentionMux* mux, const uint mux_exp) {
+        // the first iteration of a resumed run initializes and hammers the aggressors and dummies again, since the interrupted run
+        // left them in a state the board (e.g., after a reset) no longer has
+        bool ignore_aggrs = first_it_aggr_init_and_hammer ? i != first_iteration : false;
+        bool ignore_dummy_hammers = first_it_dummy_hammer ? i != first_iteration : false;
+        return analyzeTRR(platform, exp_hrs, arg_dummy_aggr_ids, dummy_aggrs_bank, dummy_hammers_per_round, hammer_dummies_first, hammer_dummies_independently, cascaded_hammer, 
+                                                hammers_per_round, hammer_cycle_time, hammer_duration, num_rounds, skip_hammering_aggr, refs_after_init, after_init_dummies,
+                                                init_aggrs_first, ignore_aggrs, init_only_victims, ignore_dummy_hammers, first_it_aggr_init_and_hammer,
+                                                refs_after_init_no_dummy_hammer, num_refs_per_round, pre_ref_delay, hammers_before_wait, init_to_hammerbw_delay,
+                                                num_bank0_hammers, num_pre_init_bank0_hammers, pre_init_nops, false, 0, verbose, mux, mux_exp);
+    };
+
+    if(!use_single_softmc_prog && num_experiments > 1) {
+        // retention-wait multiplexing: an experiment per thread, the board is shared by RetentionMux
+        RetentionMux mux(num_experiments, mux_margin_ms, mux_late_tolerance_ms);
+        std::mutex progress_mutex;
+
+        std::vector<std::thread> experiment_threads;
+        for(uint exp = 0; exp < num_experiments; exp++) {
+            experiment_threads.emplace_back([&, exp]() {
+                vector<HammerableRowSet> exp_hrs(hrs.begin() + exp*num_row_groups, hrs.begin() + (exp + 1)*num_row_groups);
+
+                uint exp_victims = 0;
+                for(auto& hr : exp_hrs)
+                    exp_victims += hr.victim_ids.size() + hr.uni_ids.size();
+                vector<uint> exp_total_bitflips(exp_victims, 0);
+
+                boost::filesystem::ofstream exp_out_file;
+                if(out_filename != "") {
+                    std::string exp_out_filename = out_filename + "." + to_string(exp);
+                    if(append_output)
+                        exp_out_file.open(exp_out_filename, boost::filesystem::ofstream::app);
+                    else
+                        exp_out_file.open(exp_out_filename);
+                } else {
+                    exp_out_file.open("/dev/null");
+                }
 
-    if(!use_single_softmc_prog) {
-        for (uint i = 0; i < num_iterations; i++) {
+                exp_out_file << "row_layout=" << row_layout << std::endl;
+                exp_out_file << "--- END OF HEADER ---" << std::endl;
+
+                for(uint i = 0; i < num_iterations; i++) {
+                    // an iteration whose retention waits took longer than requested does not have the timing of the experiment
+                    // running alone, so it is run again
+                    vector<vector<uint>> loc_bitflips;
+                    double late_ms = 0;
+                    for(uint attempt = 0; attempt <= mux_retries; attempt++) {
+                        mux.begin_iteration(exp);
+                        loc_bitflips = analyze_iteration(exp_hrs, i, i == 0 && exp == 0 && attempt == 0, &mux, exp);
+                        late_ms = mux.end_iteration(exp);
+
+                        if(late_ms == 0)
+                            break;
+
+                        std::lock_guard<std::mutex> lock(progress_mutex);
+                        std::cerr << YELLOW_TXT << "Warning: A retention wait of experiment " << exp << " iteration " << i << " ended "
+                            << late_ms << " ms late" << (attempt < mux_retries ? ", running the iteration again" : "") << NORMAL_TXT << std::endl;
+                    }
 
-            bool ignore_aggrs = first_it_aggr_init_and_hammer ? i != 0 : false;
-            bool ignore_dummy_hammers = first_it_dummy_hammer ? i != 0 : false;
-            bool verbose = (i == 0);
-            auto loc_bitflips = analyzeTRR(platform, hrs, arg_dummy_aggr_ids, dummy_aggrs_bank, dummy_hammers_per_round, hammer_dummies_first, hammer_dummies_independently, cascaded_hammer, 
-                                                    hammers_per_round, hammer_cycle_time, hammer_duration, num_rounds, skip_hammering_aggr, refs_after_init, after_init_dummies,
-                                                    init_aggrs_first, ignore_aggrs, init_only_victims, ignore_dummy_hammers, first_it_aggr_init_and_hammer,
-                                                    refs_after_init_no_dummy_hammer, num_refs_per_round, pre_ref_delay, hammers_before_wait, init_to_hammerbw_delay,
-                                                    num_bank0_hammers, num_pre_init_bank0_hammers, pre_init_nops, false, 0, verbose);
+                    {
+                        std::lock_guard<std::mutex> lock(progress_mutex);
+                        ++progress_bar;
+                        progress_bar.display();
+                    }
 
-            ++progress_bar;
-            progress_bar.display();
-            
-            out_file << "Iteration " << i << " bitflips:" << std::endl;
+                    TraceSpan output_span("output");
+                    exp_out_file << "Iteration " << i << " bitflips";
+                    if(late_ms > 0)
+                        exp_out_file << " (retention wait " << late_ms << " ms late)";
+                    exp_out_file << ":" << std::endl;
+                    write_iteration_bitflips(exp_out_file, exp_hrs, loc_bitflips, exp_total_bitflips, location_out);
+                }
 
-            if(!skip_hammering_aggr) {
-                uint bitflips_ind = 0;
+                write_total_bitflips(exp_out_file, exp_hrs, exp_total_bitflips);
+            });
+        }
 
-                for(auto& hr : hrs) {
-                    uint total_rows = hr.victim_ids.size() + hr.uni_ids.size();
+        for(auto& t : experiment_threads)
+            t.join();
 
-                    std::vector<std::string> output_strs_vict, output_strs_uni;
+        mux.print_stats();
+    } else if(!use_single_softmc_prog) {
+        for (uint i = first_iteration; i < num_iterations; i++) {
 
-                    for(uint vict : hr.victim_ids) {
-                        // out_file << "Victim row " << vict << ": " << num_bitflips[it_vict] << std::endl;
-                        string output_str_vict;
-                        output_str_vict = "Victim row " + to_string(vict) + ": " + to_string(loc_bitflips[bitflips_ind].size());
-                        if(location_out){
-                            output_str_vict += ": ";
-                            for(auto loc: loc_bitflips[bitflips_ind])
-                                output_str_vict += to_string(loc) + ", ";
-                        }
-                        output_strs_vict.push_back(output_str_vict);
-                        total_bitflips[bitflips_ind] += loc_bitflips[bitflips_ind].size();
-                        bitflips_ind++;
-                    }
-
-                    for(uint uni : hr.uni_ids) {
-                        // out_file << "Victim row(U) " << uni << ": " << num_bitflips[it_vict] << std::endl;
-                        string output_str_uni;
-                        output_str_uni = "Victim row(U) " + to_string(uni) + ": " + to_string(loc_bitflips[bitflips_ind].size());
-                        if(location_out){
-                            output_str_uni += ": ";
-                            for(auto loc: loc_bitflips[bitflips_ind])
-                                output_str_uni += to_string(loc) + ", ";
-                        }
-                        output_strs_uni.push_back(output_str_uni);
-                        total_bitflips[bitflips_ind] += loc_bitflips[bitflips_ind].size();
-                        bitflips_ind++;
-                    }
-
-                    // reordering rows based on their physical row IDs
-                    uint uni_ind = 0;
-                    for(uint vict_ind = 0; vict_ind < hr.victim_ids.size(); vict_ind++){
-                        if(uni_ind != hr.uni_ids.size() && to_physical_row_id(hr.uni_ids[uni_ind]) < to_physical_row_id(hr.victim_ids[vict_ind])){
-                            out_file << output_strs_uni[uni_ind++] << std::endl;
-                            vict_ind--;
-                        } else {
-                            out_file << output_strs_vict[vict_ind] << std::endl;
-                        }
-                    }
+            auto loc_bitflips = analyze_iteration(hrs, i, i == first_iteration, nullptr, 0);
 
-                    for(; uni_ind < hr.uni_ids.size(); uni_ind++)
-                        out_file << output_strs_uni[uni_ind] << std::endl;
-                }
+            ++progress_bar;
+            progress_bar.display();
+            
+            TraceSpan output_span("output");
+            out_file << "Iteration " << i << " bitflips:" << std::endl;
 
+            if(!skip_hammering_aggr)
+                write_iteration_bitflips(out_file, hrs, loc_bitflips, total_bitflips, location_out);
 
+            if(write_checkpoints) {
+                out_file.flush();
+                ckpt.next_iteration = i + 1;
+                ckpt.total_bitflips = total_bitflips;
+                ckpt.out_file_size = boost::filesystem::file_size(out_filename);
+                save_checkpoint(ckpt_filename, ckpt);
             }
         }
     } else {
@@ -2376,21 +2835,23 @@ int main(int argc, char** argv)
         // receive PCIe data iteration by iteration and keep the out_file format the same
 
         ulong read_data_size = ROW_SIZE*total_victims;
-        char* buf = new char[read_data_size];
+        ArenaBuffer buf = receive_buffers.acquire(read_data_size);
         vector<uint> bitflips;
 
         
         for (uint i = 0; i < num_iterations; i++) {
             if(!skip_hammering_aggr) {
-                platform.receiveData(buf, read_data_size);
+                receive_data(platform, buf.data(), read_data_size);
+                tool_metrics.rows_tested += total_victims;
 
+                TraceSpan span("analyze");
                 out_file << "Iteration " << i << " bitflips:" << std::endl;
                 
                 uint row_it = 0;
                 for (auto& hr : hrs) {
                     for(uint vict_ind = 0; vict_ind < hr.victim_ids.size(); vict_ind++) {
                         bitflips.clear();
-                        collect_bitflips(bitflips, buf + row_it*ROW_SIZE, hr.data_pattern, hr.vict_bitflip_locs[vict_ind]);
+                        collect_bitflips(bitflips, buf.data() + row_it*ROW_SIZE, hr.data_pattern, hr.vict_bitflip_locs[vict_ind]);
                         row_it++;
 
 
@@ -2413,7 +2874,7 @@ int main(int argc, char** argv)
                     aggr_data_pattern.flip();
                     for(uint uni_ind = 0; uni_ind < hr.uni_ids.size(); uni_ind++) {
                         bitflips.clear();
-                        collect_bitflips(bitflips, buf + row_it*ROW_SIZE, aggr_data_pattern, hr.uni_bitflip_locs[uni_ind]);
+                        collect_bitflips(bitflips, buf.data() + row_it*ROW_SIZE, aggr_data_pattern, hr.uni_bitflip_locs[uni_ind]);
                         row_it++;
 
 
@@ -2433,30 +2894,29 @@ int main(int argc, char** argv)
             ++progress_bar;
             progress_bar.display(); // the progress bar is probably not that useful here
         }
-
-        delete[] buf;
     }
 
-    if(!skip_hammering_aggr) {
-        out_file << "Total bitflips:" << std::endl;
-        uint it_vict = 0;
-        for(auto& hr : hrs) {
-            for(uint vict : hr.victim_ids) {
-                out_file << "Victim row " << vict << ": " << total_bitflips[it_vict++] << std::endl;
-            }
-
-            for(uint uni : hr.uni_ids) {
-                out_file << "Victim row(U) " << uni << ": " << total_bitflips[it_vict++] << std::endl;
-            }
-        }
-    }
+    if(!skip_hammering_aggr && num_experiments == 1)
+        write_total_bitflips(out_file, hrs, total_bitflips);
 
     progress_bar.done();
 
 
+    print_softmc_program_stats();
+    print_receive_buffer_stats();
+    print_capture_stats();
+    receive_buffers.trim();
+
+    std::string trace_error = stop_tracing(trace_filename);
+    if(trace_error != "")
+        std::cerr << RED_TXT << "ERROR: Could not write the trace: " << trace_error << NORMAL_TXT << std::endl;
+
     std::cout << "The test has finished!" << endl;
 
     out_file.close();
 
     return 0;
-}
\ No newline at end of file
+}
+
+UTRR_TOOL_MAIN(trranalyzer_main)
+UTRR_ROW_GROUP_QUEUE_HOOK()
@@ -0,0 +1,258 @@
+// Offline microbenchmarks of the host-side code of TRR Analyzer (run with 'make bench'). The benchmarks use synthetic row data and
+// row groups and do not need a board. TRRAnalyzer.cpp is compiled into this file as a library (i.e., without its main function),
+// so the benchmarks run exactly the code that the tool runs.
+
+#define UTRR_TOOL_LIBRARY
+#include "TRRAnalyzer.cpp"
+
+#include "tools/bench.h"
+
+#define BENCH_NUM_ROW_GROUPS 4
+#define BENCH_NUM_DUMMIES 16
+#define BENCH_BITFLIPS_PER_ROW 32
+
+// a row that holds data_pattern except for num_bitflips evenly spaced bits
+void make_row(vector<char>& row, const bitset<512>& data_pattern, const uint num_bitflips, vector<uint>& bitflip_locs) {
+    row.resize(ROW_SIZE);
+
+    uint32_t* irow = (uint32_t*) row.data();
+    for(int cl = 0; cl < ROW_SIZE/64; cl++)
+        for(int i = 0; i < 512/32; i++)
+            irow[cl*(512/32) + i] = ((data_pattern >> i*32) & bitset<512>(0xFFFFFFFF)).to_ulong();
+
+    bitflip_locs.clear();
+    for(uint i = 0; i < num_bitflips; i++) {
+        uint bit = i*(ROW_SIZE*8/num_bitflips) + (i % 8);
+        row[bit/8] ^= (1 << (bit % 8));
+        bitflip_locs.push_back(bit);
+    }
+}
+
+// row groups as RowScout reports them for the R-R pattern, spread over the bank
+vector<WeakRowSet> make_row_groups(const uint num_row_groups) {
+    vector<WeakRowSet> row_groups;
+
+    for(uint i = 0; i < num_row_groups; i++) {
+        uint first_row = 100 + i*(NUM_ROWS/num_row_groups);
+
+        vector<uint> bitflip_locs;
+        for(uint j = 0; j < 8; j++)
+            bitflip_locs.push_back(j*4099 % (ROW_SIZE*8));
+
+        vector<WeakRow> weak_rows{WeakRow(first_row, bitflip_locs), WeakRow(first_row + 2, bitflip_locs)};
+        row_groups.emplace_back(weak_rows, 1, 1024, 1, 0);
+        row_groups.back().index_in_file = i;
+    }
+
+    return row_groups;
+}
+
+// the program of an iteration of analyzeTRR() with the default options and use_single_softmc_prog: initialize the row groups,
+// hammer the aggressors and the dummy rows, refresh, and read the victims
+void generate_iteration_program(SoftMCPlatform& platform, const vector<HammerableRowSet>& hrs, const vector<uint>& dummy_aggrs,
+                                const vector<uint>& hammers_per_round) {
+    SoftMCProgram prog;
+    SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+
+    init_HRS_data(platform, hrs, false, false, false, 0, 0, &prog, &reg_alloc);
+
+    hammer_hrs(platform, hrs, hammers_per_round, true, 1, false, false, 0, 1, 0, dummy_aggrs, hrs[0].bank_id, false, false, 0, &prog, &reg_alloc);
+
+    SMC_REG reg_bank_addr = reg_alloc.allocate_SMC_REG();
+    SMC_REG reg_num_cols = reg_alloc.allocate_SMC_REG();
+    prog.add_li(hrs[0].bank_id, reg_bank_addr);
+    prog.add_li(NUM_COLS_PER_ROW*8, reg_num_cols);
+    for(auto& hr : hrs)
+        read_row_data(prog, reg_alloc, reg_bank_addr, reg_num_cols, hr.victim_ids);
+    reg_alloc.free_SMC_REG(reg_bank_addr);
+    reg_alloc.free_SMC_REG(reg_num_cols);
+
+    prog.add_inst(SMC_END());
+    bench_keep(prog.lower());
+}
+
+int main(int argc, char** argv)
+{
+    string out_filename = "TRRAnalyzerBench.json";
+    string filter = "";
+    string baseline_filename = "";
+
+    options_description desc("TRR Analyzer Benchmark Options");
+    desc.add_options()
+        ("help,h", "Prints this usage statement.")
+        ("out,o", value(&out_filename)->default_value(out_filename), "Specifies the file to save the results to.")
+        ("filter", value(&filter), "Runs only the benchmarks whose names contain the specified string.")
+        ("baseline", value(&baseline_filename), "Specifies the results of an earlier run to compare to.")
+        ;
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+
+    notify(vm);
+
+    std::string mapping_error = init_row_mapping(0, "", NUM_ROWS);
+    if(!mapping_error.empty()) {
+        cerr << RED_TXT << "ERROR: " << mapping_error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    BenchSuite suite("TRRAnalyzer", filter);
+    suite.print_header();
+
+    // collect_bitflips
+    bitset<512> data_pattern = setup_data_pattern(1);
+    vector<char> row;
+    vector<uint> bitflip_locs;
+    make_row(row, data_pattern, BENCH_BITFLIPS_PER_ROW, bitflip_locs);
+
+    vector<uint> bitflips;
+    bitflips.reserve(ROW_SIZE*8);
+    suite.run("collect_bitflips/full_row", ROW_SIZE, [&]() {
+        bitflips.clear();
+        collect_bitflips(bitflips, row.data(), data_pattern, vector<uint>());
+        bench_keep(bitflips);
+    });
+
+    suite.run("collect_bitflips/known_locations", ROW_SIZE, [&]() {
+        bitflips.clear();
+        collect_bitflips(bitflips, row.data(), data_pattern, bitflip_locs);
+        bench_keep(bitflips);
+    });
+
+    suite.run("bin_to_hex/cache_line", 512, [&]() {
+        bench_keep(bin_to_hex(row.data(), 512));
+    });
+
+    // program generation
+    vector<WeakRowSet> row_groups = make_row_groups(BENCH_NUM_ROW_GROUPS);
+    vector<HammerableRowSet> hrs;
+    for(auto& wrs : row_groups)
+        hrs.push_back(toHammerableRowSet(wrs, "RAR"));
+
+    vector<uint> dummy_aggrs;
+    for(uint i = 0; i < BENCH_NUM_DUMMIES; i++)
+        dummy_aggrs.push_back(NUM_ROWS - 1000 + i*2);
+
+    vector<uint> hammers_per_round(BENCH_NUM_ROW_GROUPS, 24);
+    hammers_per_round.insert(hammers_per_round.end(), BENCH_NUM_DUMMIES, 8);
+
+    SoftMCPlatform platform; // not initialized, the programs are generated but not executed
+    suite.run("program/analyze_trr_iteration", 0, [&]() {
+        generate_iteration_program(platform, hrs, dummy_aggrs, hammers_per_round);
+    });
+
+    suite.run("program/hammer", 0, [&]() {
+        SoftMCProgram prog;
+        SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+        hammer_hrs(platform, hrs, hammers_per_round, true, 1, false, false, 0, 1, 0, dummy_aggrs, hrs[0].bank_id, false, false, 0, &prog, &reg_alloc);
+        prog.add_inst(SMC_END());
+        bench_keep(prog.lower());
+    });
+
+    suite.run("reg_alloc/allocate_free", 0, [&]() {
+        SoftMCRegAllocator reg_alloc(NUM_SOFTMC_REGS, reserved_regs);
+        SMC_REG regs[NUM_SOFTMC_REGS];
+
+        uint num_regs = reg_alloc.num_free_regs();
+        for(uint i = 0; i < num_regs; i++)
+            regs[i] = reg_alloc.allocate_SMC_REG();
+        for(uint i = 0; i < num_regs; i++)
+            reg_alloc.free_SMC_REG(regs[(i*5) % num_regs]);
+
+        bench_keep(reg_alloc);
+    });
+
+    // RowScout output
+    string s_wrs = wrs_to_string(row_groups[0]);
+    suite.run("row_group/serialize", s_wrs.size(), [&]() {
+        bench_keep(wrs_to_string(row_groups[0]));
+    });
+
+    suite.run("row_group/parse", s_wrs.size(), [&]() {
+        WeakRowSet wrs;
+        JS::ParseContext context(s_wrs);
+        context.parseTo(wrs);
+        bench_keep(wrs);
+    });
+
+    char tmp_filename[] = "/tmp/TRRAnalyzerBench.XXXXXX";
+    int tmp_fd = mkstemp(tmp_filename);
+    if(tmp_fd < 0) {
+        cerr << RED_TXT << "ERROR: Could not create a temporary file" << NORMAL_TXT << endl;
+        return -1;
+    }
+    close(tmp_fd);
+
+    const uint num_file_row_groups = 4096;
+    {
+        std::ofstream f_row_groups(tmp_filename);
+        vector<WeakRowSet> file_row_groups = make_row_groups(num_file_row_groups);
+        for(auto& wrs : file_row_groups)
+            f_row_groups << wrs_to_string(wrs) << endl;
+    }
+
+    {
+        JSONObjectFile f_row_groups;
+        string error = f_row_groups.open(tmp_filename, false);
+        if(!error.empty()) {
+            cerr << RED_TXT << "ERROR: " << error << NORMAL_TXT << endl;
+            unlink(tmp_filename);
+            return -1;
+        }
+
+        vector<size_t> indices(f_row_groups.num_objects());
+        std::iota(indices.begin(), indices.end(), 0);
+        vector<WeakRowSet> parsed;
+        suite.run("row_scout_file/parse_4096_groups", num_file_row_groups*s_wrs.size(), [&]() {
+            f_row_groups.parse_objects(indices, parsed);
+            bench_keep(parsed);
+        });
+
+        suite.run("row_scout_file/scan_4096_groups", num_file_row_groups*s_wrs.size(), [&]() {
+            JSONObjectFile f;
+            f.open(tmp_filename, false);
+            bench_keep(f.num_objects());
+        });
+    }
+    unlink(tmp_filename);
+
+    // output of an iteration
+    vector<vector<uint>> loc_bitflips;
+    for(auto& hr : hrs)
+        loc_bitflips.insert(loc_bitflips.end(), hr.victim_ids.size(), bitflip_locs);
+
+    vector<uint> total_bitflips(loc_bitflips.size(), 0);
+    ostringstream out;
+    suite.run("output/iteration_bitflips", 0, [&]() {
+        out.str("");
+        write_iteration_bitflips(out, hrs, loc_bitflips, total_bitflips, false);
+        bench_keep(out);
+    });
+
+    suite.run("output/iteration_bitflip_locations", 0, [&]() {
+        out.str("");
+        write_iteration_bitflips(out, hrs, loc_bitflips, total_bitflips, true);
+        bench_keep(out);
+    });
+
+    string error = suite.save(out_filename);
+    if(!error.empty()) {
+        cerr << RED_TXT << "ERROR: Could not save the results: " << error << NORMAL_TXT << endl;
+        return -1;
+    }
+
+    if(!baseline_filename.empty()) {
+        error = suite.compare(baseline_filename);
+        if(!error.empty()) {
+            cerr << RED_TXT << "ERROR: Could not compare to the baseline: " << error << NORMAL_TXT << endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -2,6 +2,12 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+
+#include "metrics.h"
+
+// the bar is redrawn at most this often, so that ticking it in a tight loop costs (almost) nothing
+#define PROGRESS_REDRAW_INTERVAL_MS 100
 
 namespace progresscpp {
 class ProgressBar {
@@ -13,6 +19,8 @@ private:
     const char complete_char = '=';
     const char incomplete_char = ' ';
     const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    mutable std::chrono::steady_clock::time_point last_draw_time;
+    mutable bool drawn = false;
 
 public:
     ProgressBar(unsigned int total, unsigned int width, char complete, char incomplete) :
@@ -23,27 +31,45 @@ public:
     unsigned int operator++() { return ++ticks; }
 
     void display() const {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        metrics_progress(ticks, total_ticks, start_time);
+
+        // the last tick is always drawn so that the bar does not stop short of 100%
+        if (drawn && ticks < total_ticks &&
+            now - last_draw_time < std::chrono::milliseconds(PROGRESS_REDRAW_INTERVAL_MS))
+            return;
+
+        draw(now);
+    }
+
+    void done() const {
+        draw(std::chrono::steady_clock::now());
+        std::cout << std::endl;
+    }
+
+private:
+    void draw(const std::chrono::steady_clock::time_point now) const {
         float progress = (float) ticks / total_ticks;
         int pos = (int) (bar_width * progress);
 
-        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
         auto time_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count();
 
-        std::cout << "[";
-
+        // the whole line is written at once
+        std::string line;
+        line.reserve(bar_width + 32);
+        line += "[";
         for (int i = 0; i < bar_width; ++i) {
-            if (i < pos) std::cout << complete_char;
-            else if (i == pos) std::cout << ">";
-            else std::cout << incomplete_char;
+            if (i < pos) line += complete_char;
+            else if (i == pos) line += ">";
+            else line += incomplete_char;
         }
-        std::cout << "] " << int(progress * 100.0) << "% "
-                  << float(time_elapsed) / 1000.0 << "s\r";
+        line += "] " + std::to_string(int(progress * 100.0)) + "% ";
+
+        std::cout << line << float(time_elapsed) / 1000.0 << "s\r";
         std::cout.flush();
-    }
 
-    void done() const {
-        display();
-        std::cout << std::endl;
+        last_draw_time = now;
+        drawn = true;
     }
 };
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <new>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "tools/json_struct.h"
+
+// Offline microbenchmarks of the host-side code of the tools (see 'make bench'). A benchmark runs a function on synthetic data, i.e.,
+// without a board, repeatedly until it has run for at least BENCH_MIN_TIME_MS, and reports the time, the throughput, and the heap
+// allocations per call. Results are saved as JSON so that runs on the same machine can be compared across commits (--baseline).
+//
+// This header replaces the global operator new and delete, all of their forms, to count allocations. Include it only into the
+// benchmark binaries.
+
+#define BENCH_MIN_TIME_MS 200
+
+std::atomic<uint64_t> bench_num_allocs(0);
+
+// The replacements are kept out of line: when GCC inlines a replaced operator delete into a caller, it warns that the pointer
+// returned by operator new is passed to free()
+#define BENCH_ALLOC_FN __attribute__((noinline))
+
+BENCH_ALLOC_FN void* bench_alloc(size_t size, size_t alignment, const bool nothrow) {
+    bench_num_allocs.fetch_add(1, std::memory_order_relaxed);
+
+    if(size == 0)
+        size = 1;
+
+    void* p = nullptr;
+    if(alignment <= alignof(std::max_align_t))
+        p = std::malloc(size);
+    else if(posix_memalign(&p, alignment, size) != 0)
+        p = nullptr;
+
+    if(p == nullptr && !nothrow)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+BENCH_ALLOC_FN void bench_free(void* p) noexcept {
+    std::free(p);
+}
+
+BENCH_ALLOC_FN void* operator new(size_t size) { return bench_alloc(size, 0, false); }
+BENCH_ALLOC_FN void* operator new[](size_t size) { return bench_alloc(size, 0, false); }
+BENCH_ALLOC_FN void* operator new(size_t size, const std::nothrow_t&) noexcept { return bench_alloc(size, 0, true); }
+BENCH_ALLOC_FN void* operator new[](size_t size, const std::nothrow_t&) noexcept { return bench_alloc(size, 0, true); }
+
+BENCH_ALLOC_FN void operator delete(void* p) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete[](void* p) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete(void* p, const std::nothrow_t&) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete[](void* p, const std::nothrow_t&) noexcept { bench_free(p); }
+
+#ifdef __cpp_sized_deallocation
+BENCH_ALLOC_FN void operator delete(void* p, size_t) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete[](void* p, size_t) noexcept { bench_free(p); }
+#endif
+
+#ifdef __cpp_aligned_new
+BENCH_ALLOC_FN void* operator new(size_t size, std::align_val_t al) { return bench_alloc(size, (size_t)al, false); }
+BENCH_ALLOC_FN void* operator new[](size_t size, std::align_val_t al) { return bench_alloc(size, (size_t)al, false); }
+BENCH_ALLOC_FN void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return bench_alloc(size, (size_t)al, true); }
+BENCH_ALLOC_FN void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return bench_alloc(size, (size_t)al, true); }
+
+BENCH_ALLOC_FN void operator delete(void* p, std::align_val_t) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete[](void* p, std::align_val_t) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete(void* p, size_t, std::align_val_t) noexcept { bench_free(p); }
+BENCH_ALLOC_FN void operator delete[](void* p, size_t, std::align_val_t) noexcept { bench_free(p); }
+#endif
+
+typedef struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double bytes_per_s; // 0 for benchmarks without a meaningful amount of processed data
+    double allocs_per_op;
+} BenchResult;
+
+JS_OBJECT_EXTERNAL(BenchResult,
+                JS_MEMBER(name),
+                JS_MEMBER(iterations),
+                JS_MEMBER(ns_per_op),
+                JS_MEMBER(bytes_per_s),
+                JS_MEMBER(allocs_per_op));
+
+typedef struct BenchReport {
+    std::string suite;
+    std::string host;
+    std::string date;
+    std::vector<BenchResult> results;
+} BenchReport;
+
+JS_OBJECT_EXTERNAL(BenchReport,
+                JS_MEMBER(suite),
+                JS_MEMBER(host),
+                JS_MEMBER(date),
+                JS_MEMBER(results));
+
+// keeps the compiler from optimizing away the result of a benchmarked computation
+template<typename T>
+void bench_keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+class BenchSuite {
+
+public:
+    // runs only the benchmarks whose names contain filter
+    BenchSuite(const std::string& suite_name, const std::string& filter = "") : filter(filter) {
+        report.suite = suite_name;
+
+        char hostname[256] = {0};
+        gethostname(hostname, sizeof(hostname) - 1);
+        report.host = hostname;
+
+        char date[64];
+        time_t now = time(nullptr);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        report.date = date;
+    }
+
+    // bytes_per_op is the amount of data a call of fn processes, e.g., the size of a row for a bitflip check
+    void run(const std::string& name, const uint64_t bytes_per_op, const std::function<void()>& fn) {
+        if(name.find(filter) == std::string::npos)
+            return;
+
+        fn(); // warm up
+
+        uint64_t iterations = 1;
+        double elapsed_ns;
+        uint64_t allocs;
+        while(true) {
+            uint64_t allocs_before = bench_num_allocs;
+            auto t_start = std::chrono::steady_clock::now();
+
+            for(uint64_t i = 0; i < iterations; i++)
+                fn();
+
+            elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t_start).count();
+            allocs = bench_num_allocs - allocs_before;
+
+            if(elapsed_ns >= BENCH_MIN_TIME_MS*1e6)
+                break;
+
+            // aim for 1.5x the minimum time with the next run
+            double scale = elapsed_ns > 0 ? (BENCH_MIN_TIME_MS*1.5e6)/elapsed_ns : 100;
+            iterations = std::max(iterations + 1, (uint64_t)(iterations*std::min(scale, 100.0)));
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.iterations = iterations;
+        result.ns_per_op = elapsed_ns/iterations;
+        result.bytes_per_s = bytes_per_op*iterations/(elapsed_ns/1e9);
+        result.allocs_per_op = (double)allocs/iterations;
+
+        print(result);
+        report.results.push_back(result);
+    }
+
+    // Returns an empty string on success, and a description of the problem otherwise
+    std::string save(const std::string& filename) const {
+        std::ofstream out(filename);
+        if(!out.is_open())
+            return "cannot open " + filename;
+
+        out << JS::serializeStruct(report) << std::endl;
+        return out.good() ? "" : "cannot write to " + filename;
+    }
+
+    // prints the change of each benchmark relative to a previously saved run.
+    // Returns an empty string on success, and a description of the problem otherwise
+    std::string compare(const std::string& baseline_filename) const {
+        std::ifstream in(baseline_filename);
+        if(!in.is_open())
+            return "cannot open " + baseline_filename;
+
+        std::string s_baseline((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        BenchReport baseline;
+        JS::ParseContext context(s_baseline);
+        if(context.parseTo(baseline) != JS::Error::NoError)
+            return "cannot parse " + baseline_filename + ": " + context.makeErrorString();
+
+        std::cout << std::endl << "Compared to " << baseline_filename << " (" << baseline.host << ", " << baseline.date << "):" << std::endl;
+        for(auto& result : report.results) {
+            auto it = std::find_if(baseline.results.begin(), baseline.results.end(), [&](const BenchResult& r) { return r.name == result.name; });
+            if(it == baseline.results.end() || it->ns_per_op <= 0)
+                continue;
+
+            double change = 100.0*(result.ns_per_op - it->ns_per_op)/it->ns_per_op;
+            std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+                << std::setw(9) << it->ns_per_op << " -> " << std::setw(9) << result.ns_per_op << " ns/op (" << std::showpos << change << std::noshowpos << "%)"
+                << std::endl;
+        }
+        std::cout.unsetf(std::ios_base::floatfield);
+
+        if(baseline.host != report.host)
+            std::cout << "Warning: the baseline was measured on a different machine" << std::endl;
+
+        return "";
+    }
+
+    void print_header() const {
+        std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(14) << "ns/op" << std::setw(14) << "MB/s"
+            << std::setw(14) << "allocs/op" << std::setw(12) << "iterations" << std::endl;
+    }
+
+private:
+    std::string filter;
+    BenchReport report;
+
+    void print(const BenchResult& result) const {
+        std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << result.ns_per_op << std::setw(14) << result.bytes_per_s/1e6
+            << std::setprecision(2) << std::setw(14) << result.allocs_per_op << std::setw(12) << result.iterations << std::endl;
+        std::cout.unsetf(std::ios_base::floatfield);
+        std::cout << std::setprecision(6);
+    }
+};
+
+#endif // BENCH_H
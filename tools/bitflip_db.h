@@ -0,0 +1,610 @@
+#ifndef BITFLIP_DB_H
+#define BITFLIP_DB_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "tools/bitflip_map.h"
+
+// Cross-run database of bitflip locations, built with BitflipDB/BitflipDBIngest and queried with BitflipDB/BitflipDBQuery.
+//
+// A cell is identified by (module, bank, row, bit) and holds how many times it flipped in each run (i.e., each ingested output
+// file) that flipped it. A run also records how many trials it had (e.g., the iterations of a TRR Analyzer experiment) and which rows
+// it tested, so that the flip rate of a cell is computed over all runs that tested its row, including the ones that did not flip it.
+//
+// Layout (integers in host byte order as in the sidecar index of tools/json_object_file.h, so that the row index is used in place
+// when the file is memory-mapped):
+//   BitflipDBHeader
+//   meta:    u32 number of modules, the module names (bfm_put_string()), u32 number of runs, then per run: source, tool, u32 module,
+//            u32 number of trials, u32 granularity_bits
+//   rows:    num_rows BitflipDBRow entries sorted by (module, bank, row), at an 8-byte aligned offset
+//   columns: a block of varints per row, at its data_offset:
+//              the number of runs that tested the row, then their IDs (delta-coded)
+//              bit column:   the bit of each cell, delta-coded, in ascending order
+//              runs column:  the number of runs that flipped each cell
+//              run column:   the IDs of the runs that flipped each cell, delta-coded within the cell
+//              count column: the number of flips of each (cell, run) pair
+//
+// Row-range and cell lookups binary search the row index and decode only the blocks of the matching rows. Per-row totals are in
+// the index, so queries on them do not decode any block. RowHammerAttacker counts bitflips per row or per chunk of a row instead of
+// recording their bits, so the cells of its runs stand for their whole chunk and are stored at the first bit of the chunk
+// (see BitflipDBRun::granularity_bits). Such a cell shares its key with the first bit of the chunk, so queries must not count runs of
+// different granularities together (see BitflipDBQuery --granularity).
+
+#define BITFLIP_DB_MAGIC "UTRRBDB1"
+#define BITFLIP_DB_MAGIC_SIZE 8
+
+typedef struct BitflipDBHeader {
+    char magic[BITFLIP_DB_MAGIC_SIZE];
+    uint32_t num_modules;
+    uint32_t num_runs;
+    uint64_t num_rows;
+    uint64_t num_cells;
+    uint64_t num_observations; // (cell, run) pairs
+    uint64_t meta_offset;
+    uint64_t rows_offset;
+    uint64_t columns_offset;
+    uint64_t file_size;
+} BitflipDBHeader;
+
+typedef struct BitflipDBRow {
+    uint16_t module;
+    uint16_t bank;
+    uint32_t row;
+    uint32_t num_cells;
+    uint32_t num_tested_runs;
+    uint64_t total_flips; // of all cells in all runs
+    uint64_t data_offset;
+} BitflipDBRow;
+
+typedef struct BitflipDBRun {
+    std::string source; // the file the run was ingested from
+    std::string tool;
+    uint32_t module;
+    uint32_t num_trials;
+    uint32_t granularity_bits; // the bits a cell of the run stands for, 1 when the run records the bit of each bitflip
+} BitflipDBRun;
+
+// the decoded block of a row. The runs and counts of cell i are at [obs_begin[i], obs_begin[i + 1])
+typedef struct BitflipDBRowData {
+    std::vector<uint32_t> tested_runs;
+    std::vector<uint32_t> bits;
+    std::vector<uint32_t> obs_begin;
+    std::vector<uint32_t> runs;
+    std::vector<uint64_t> counts;
+} BitflipDBRowData;
+
+// reads a varint written with bfm_put_varint(). Returns false at the end of the block or on a malformed varint
+bool bdb_get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& val) {
+    val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end)
+            return false;
+
+        uint8_t byte = *p++;
+        val |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+// as above, for the columns that hold 32-bit values. Returns false if the value does not fit
+bool bdb_get_varint(const uint8_t*& p, const uint8_t* end, uint32_t& val) {
+    uint64_t val64;
+    if (!bdb_get_varint(p, end, val64) || val64 > UINT32_MAX)
+        return false;
+
+    val = val64;
+    return true;
+}
+
+// Takes an exclusive lock on the database at path, waiting for other processes that hold it, so that processes that read, merge,
+// and replace the database do not drop each other's runs. The lock is on a separate lock file since replacing the database changes
+// its inode. Returns the file descriptor that holds the lock, which is released when it is closed or the process exits, or -1 if
+// the lock file cannot be opened
+int lock_bitflip_db(const std::string& path) {
+    std::string lock_path = path + ".lock";
+    int fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return -1;
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        std::cout << "Waiting for another process to finish updating " << path << std::endl;
+        if (flock(fd, LOCK_EX) != 0) {
+            ::close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+typedef struct BitflipDBObservation {
+    uint32_t module;
+    uint32_t bank;
+    uint32_t row;
+    uint32_t bit;
+    uint32_t run;
+    uint64_t count;
+} BitflipDBObservation;
+
+typedef struct BitflipDBTestedRow {
+    uint32_t module;
+    uint32_t bank;
+    uint32_t row;
+    uint32_t run;
+} BitflipDBTestedRow;
+
+class BitflipDB;
+
+// Collects runs and writes them to a new database. A database is never modified in place: adding runs to it writes a new file
+// with its contents and the new runs, which then replaces it
+class BitflipDBBuilder {
+
+public:
+    uint32_t add_module(const std::string& name) {
+        auto it = std::find(modules.begin(), modules.end(), name);
+        if (it != modules.end())
+            return it - modules.begin();
+
+        modules.push_back(name);
+        return modules.size() - 1;
+    }
+
+    uint32_t add_run(const BitflipDBRun& run) {
+        runs.push_back(run);
+        return runs.size() - 1;
+    }
+
+    const std::vector<BitflipDBRun>& get_runs() const {
+        return runs;
+    }
+
+    // the same cell may be added more than once for a run, e.g., once per iteration, and its counts are summed
+    void add_flips(const uint32_t module, const uint32_t bank, const uint32_t row, const uint32_t bit, const uint32_t run, const uint64_t count) {
+        observations.push_back(BitflipDBObservation{module, bank, row, bit, run, count});
+    }
+
+    void add_tested_row(const uint32_t module, const uint32_t bank, const uint32_t row, const uint32_t run) {
+        tested_rows.push_back(BitflipDBTestedRow{module, bank, row, run});
+    }
+
+    // adds all modules, runs, and cells of db
+    std::string add_db(const BitflipDB& db);
+
+    // Writes the database to path, through a temporary file that replaces path when complete, so that readers never see a partially
+    // written database. Returns an empty string on success, and a description of the problem otherwise
+    std::string write(const std::string& path) {
+        if (modules.size() > UINT16_MAX)
+            return "too many modules";
+
+        auto row_less = [](const BitflipDBTestedRow& a, const BitflipDBTestedRow& b) {
+            return std::tie(a.module, a.bank, a.row, a.run) < std::tie(b.module, b.bank, b.row, b.run);
+        };
+        auto obs_less = [](const BitflipDBObservation& a, const BitflipDBObservation& b) {
+            return std::tie(a.module, a.bank, a.row, a.bit, a.run) < std::tie(b.module, b.bank, b.row, b.bit, b.run);
+        };
+
+        // every row a run flipped a cell of was tested by it
+        for (auto& obs : observations)
+            tested_rows.push_back(BitflipDBTestedRow{obs.module, obs.bank, obs.row, obs.run});
+
+        std::sort(tested_rows.begin(), tested_rows.end(), row_less);
+        tested_rows.erase(std::unique(tested_rows.begin(), tested_rows.end(), [](const BitflipDBTestedRow& a, const BitflipDBTestedRow& b) {
+            return a.module == b.module && a.bank == b.bank && a.row == b.row && a.run == b.run; }), tested_rows.end());
+
+        std::sort(observations.begin(), observations.end(), obs_less);
+
+        for (auto& tested : tested_rows) {
+            if (tested.bank > UINT16_MAX)
+                return "bank " + std::to_string(tested.bank) + " is out of range";
+        }
+
+        std::string meta;
+        bfm_put_u32(meta, modules.size());
+        for (auto& module : modules)
+            bfm_put_string(meta, module);
+        bfm_put_u32(meta, runs.size());
+        for (auto& run : runs) {
+            bfm_put_string(meta, run.source);
+            bfm_put_string(meta, run.tool);
+            bfm_put_u32(meta, run.module);
+            bfm_put_u32(meta, run.num_trials);
+            bfm_put_u32(meta, run.granularity_bits);
+        }
+
+        BitflipDBHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BITFLIP_DB_MAGIC, BITFLIP_DB_MAGIC_SIZE);
+        header.num_modules = modules.size();
+        header.num_runs = runs.size();
+        header.meta_offset = sizeof(header);
+        header.rows_offset = (header.meta_offset + meta.size() + 7)/8*8;
+
+        std::vector<BitflipDBRow> rows;
+        std::string columns, bit_col, nruns_col, run_col, count_col;
+
+        size_t t = 0, o = 0;
+        while (t < tested_rows.size()) {
+            BitflipDBRow row;
+            row.module = tested_rows[t].module;
+            row.bank = tested_rows[t].bank;
+            row.row = tested_rows[t].row;
+            row.num_cells = 0;
+            row.num_tested_runs = 0;
+            row.total_flips = 0;
+            row.data_offset = columns.size();
+
+            auto same_row = [&](uint32_t module, uint32_t bank, uint32_t r) { return module == row.module && bank == row.bank && r == row.row; };
+
+            size_t first_tested = t;
+            while (t < tested_rows.size() && same_row(tested_rows[t].module, tested_rows[t].bank, tested_rows[t].row))
+                t++;
+
+            row.num_tested_runs = t - first_tested;
+            bfm_put_varint(columns, row.num_tested_runs);
+            uint32_t prev_run = 0;
+            for (size_t i = first_tested; i < t; i++) {
+                bfm_put_varint(columns, tested_rows[i].run - prev_run);
+                prev_run = tested_rows[i].run;
+            }
+
+            bit_col.clear();
+            nruns_col.clear();
+            run_col.clear();
+            count_col.clear();
+
+            uint32_t prev_bit = 0;
+            while (o < observations.size() && same_row(observations[o].module, observations[o].bank, observations[o].row)) {
+                uint32_t bit = observations[o].bit;
+                bfm_put_varint(bit_col, bit - prev_bit);
+                prev_bit = bit;
+
+                uint32_t cell_runs = 0;
+                prev_run = 0;
+                while (o < observations.size() && same_row(observations[o].module, observations[o].bank, observations[o].row) && observations[o].bit == bit) {
+                    uint32_t run = observations[o].run;
+                    uint64_t count = 0;
+                    while (o < observations.size() && same_row(observations[o].module, observations[o].bank, observations[o].row) &&
+                            observations[o].bit == bit && observations[o].run == run)
+                        count += observations[o++].count;
+
+                    bfm_put_varint(run_col, run - prev_run);
+                    bfm_put_varint(count_col, count);
+                    prev_run = run;
+                    cell_runs++;
+                    row.total_flips += count;
+                }
+
+                bfm_put_varint(nruns_col, cell_runs);
+                header.num_observations += cell_runs;
+                row.num_cells++;
+            }
+
+            columns.append(bit_col);
+            columns.append(nruns_col);
+            columns.append(run_col);
+            columns.append(count_col);
+
+            header.num_cells += row.num_cells;
+            rows.push_back(row);
+        }
+
+        header.num_rows = rows.size();
+        header.columns_offset = header.rows_offset + rows.size()*sizeof(BitflipDBRow);
+        header.file_size = header.columns_offset + columns.size();
+
+        std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out.is_open())
+                return "could not create " + tmp_path;
+
+            std::string padding(header.rows_offset - header.meta_offset - meta.size(), '\0');
+
+            out.write((const char*) &header, sizeof(header));
+            out.write(meta.data(), meta.size());
+            out.write(padding.data(), padding.size());
+            out.write((const char*) rows.data(), rows.size()*sizeof(BitflipDBRow));
+            out.write(columns.data(), columns.size());
+
+            if (!out.good()) {
+                out.close();
+                unlink(tmp_path.c_str());
+                return "could not write " + tmp_path;
+            }
+        }
+
+        if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+            unlink(tmp_path.c_str());
+            return "could not replace " + path;
+        }
+
+        return "";
+    }
+
+private:
+    std::vector<std::string> modules;
+    std::vector<BitflipDBRun> runs;
+    std::vector<BitflipDBObservation> observations;
+    std::vector<BitflipDBTestedRow> tested_rows;
+};
+
+// A memory-mapped database. The rows are used in place, and the block of a row is decoded only when asked for
+class BitflipDB {
+
+public:
+    BitflipDB() : fd(-1), data(nullptr), size(0), rows(nullptr) {}
+
+    ~BitflipDB() {
+        close();
+    }
+
+    BitflipDB(const BitflipDB&) = delete;
+    BitflipDB& operator=(const BitflipDB&) = delete;
+
+    // Returns an empty string on success, and a description of the problem otherwise. The database is closed on failure
+    std::string open(const std::string& path) {
+        close();
+
+        std::string error = map(path);
+        if (!error.empty())
+            close();
+
+        return error;
+    }
+
+    void close() {
+        if (data != nullptr)
+            munmap((void*) data, size);
+        if (fd >= 0)
+            ::close(fd);
+
+        fd = -1;
+        data = nullptr;
+        size = 0;
+        rows = nullptr;
+        modules.clear();
+        runs.clear();
+    }
+
+    const BitflipDBHeader& get_header() const {
+        return header;
+    }
+
+    const std::vector<std::string>& get_modules() const {
+        return modules;
+    }
+
+    const std::vector<BitflipDBRun>& get_runs() const {
+        return runs;
+    }
+
+    // the ID of the module, or -1 if the database has no such module
+    int find_module(const std::string& name) const {
+        auto it = std::find(modules.begin(), modules.end(), name);
+        return it == modules.end() ? -1 : it - modules.begin();
+    }
+
+    const BitflipDBRow* rows_begin() const {
+        return rows;
+    }
+
+    const BitflipDBRow* rows_end() const {
+        return rows + header.num_rows;
+    }
+
+    // the rows of a bank of a module in [first_row, last_row]
+    std::pair<const BitflipDBRow*, const BitflipDBRow*> find_rows(const uint32_t module, const uint32_t bank, const uint32_t first_row,
+            const uint32_t last_row) const {
+
+        const BitflipDBRow* first = lower_bound(module, bank, first_row);
+        const BitflipDBRow* last = (last_row == UINT32_MAX) ? lower_bound(module, bank + 1, 0) : lower_bound(module, bank, last_row + 1);
+
+        return std::make_pair(first, std::max(first, last));
+    }
+
+    // the banks of a module that have at least one row
+    std::vector<uint32_t> banks_of(const uint32_t module) const {
+        std::vector<uint32_t> banks;
+
+        const BitflipDBRow* it = lower_bound(module, 0, 0);
+        while (it != rows_end() && it->module == module) {
+            banks.push_back(it->bank);
+            it = lower_bound(module, it->bank + 1, 0);
+        }
+
+        return banks;
+    }
+
+    // decodes the block of row into out. Returns false on a malformed block
+    bool decode_row(const BitflipDBRow& row, BitflipDBRowData& out) const {
+        const uint8_t* p = data + header.columns_offset;
+        const uint8_t* end = data + size;
+
+        // the block must start within the columns, and each tested run and cell takes at least a byte of it
+        if (row.data_offset >= (uint64_t)(end - p))
+            return false;
+        p += row.data_offset;
+
+        if ((uint64_t) row.num_tested_runs + row.num_cells > (uint64_t)(end - p))
+            return false;
+
+        out.tested_runs.resize(row.num_tested_runs);
+        out.bits.resize(row.num_cells);
+        out.obs_begin.resize(row.num_cells + 1);
+
+        uint32_t val, prev = 0;
+        if (!bdb_get_varint(p, end, val) || val != row.num_tested_runs)
+            return false;
+
+        for (auto& run : out.tested_runs) {
+            if (!bdb_get_varint(p, end, val))
+                return false;
+            run = prev += val;
+        }
+
+        prev = 0;
+        for (auto& bit : out.bits) {
+            if (!bdb_get_varint(p, end, val))
+                return false;
+            bit = prev += val;
+        }
+
+        uint32_t num_obs = 0;
+        for (uint32_t i = 0; i < row.num_cells; i++) {
+            out.obs_begin[i] = num_obs;
+            if (!bdb_get_varint(p, end, val) || (uint64_t) num_obs + val > (uint64_t)(end - p))
+                return false;
+            num_obs += val;
+        }
+        out.obs_begin[row.num_cells] = num_obs;
+
+        out.runs.resize(num_obs);
+        out.counts.resize(num_obs);
+        for (uint32_t i = 0; i < row.num_cells; i++) {
+            prev = 0;
+            for (uint32_t j = out.obs_begin[i]; j < out.obs_begin[i + 1]; j++) {
+                if (!bdb_get_varint(p, end, val))
+                    return false;
+                out.runs[j] = prev += val;
+            }
+        }
+
+        for (auto& count : out.counts)
+            if (!bdb_get_varint(p, end, count))
+                return false;
+
+        return true;
+    }
+
+private:
+    int fd;
+    const uint8_t* data;
+    size_t size;
+    BitflipDBHeader header;
+    const BitflipDBRow* rows;
+    std::vector<std::string> modules;
+    std::vector<BitflipDBRun> runs;
+
+    // maps the database and reads its metadata. Leaves the database partially open on failure
+    std::string map(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return "could not open " + path;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            return "could not stat " + path;
+
+        size = st.st_size;
+        if (size < sizeof(BitflipDBHeader))
+            return path + " is not a bitflip database";
+
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            size = 0;
+            return "could not map " + path;
+        }
+        data = (const uint8_t*) mapped;
+
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, BITFLIP_DB_MAGIC, BITFLIP_DB_MAGIC_SIZE) != 0)
+            return path + " is not a bitflip database";
+
+        // checked so that the offsets cannot overflow
+        if (header.file_size != size || header.meta_offset < sizeof(header) || header.rows_offset % 8 != 0 || header.meta_offset > header.rows_offset ||
+                header.rows_offset > size || header.num_rows > (size - header.rows_offset)/sizeof(BitflipDBRow) ||
+                header.rows_offset + header.num_rows*sizeof(BitflipDBRow) != header.columns_offset)
+            return path + " is truncated or corrupted";
+
+        std::string meta((const char*) data + header.meta_offset, header.rows_offset - header.meta_offset);
+        size_t pos = 0;
+        uint32_t num_modules, num_runs;
+        if (!bfm_get_u32(meta, pos, num_modules))
+            return "malformed metadata";
+
+        modules.resize(num_modules);
+        for (auto& module : modules)
+            if (!bfm_get_string(meta, pos, module))
+                return "malformed metadata";
+
+        if (!bfm_get_u32(meta, pos, num_runs))
+            return "malformed metadata";
+
+        runs.resize(num_runs);
+        for (auto& run : runs) {
+            if (!(bfm_get_string(meta, pos, run.source) && bfm_get_string(meta, pos, run.tool) && bfm_get_u32(meta, pos, run.module) &&
+                  bfm_get_u32(meta, pos, run.num_trials) && bfm_get_u32(meta, pos, run.granularity_bits)))
+                return "malformed metadata";
+        }
+
+        rows = (const BitflipDBRow*) (data + header.rows_offset);
+        madvise((void*) data, size, MADV_WILLNEED);
+
+        return "";
+    }
+
+    // the first row at or after (module, bank, row)
+    const BitflipDBRow* lower_bound(const uint32_t module, const uint32_t bank, const uint32_t row) const {
+        return std::lower_bound(rows_begin(), rows_end(), std::make_tuple(module, bank, row),
+                [](const BitflipDBRow& r, const std::tuple<uint32_t, uint32_t, uint32_t>& key) {
+                    return std::make_tuple((uint32_t) r.module, (uint32_t) r.bank, r.row) < key;
+                });
+    }
+};
+
+std::string BitflipDBBuilder::add_db(const BitflipDB& db) {
+    std::vector<uint32_t> module_ids, run_ids;
+    for (auto& module : db.get_modules())
+        module_ids.push_back(add_module(module));
+
+    for (auto run : db.get_runs()) {
+        if (run.module >= module_ids.size())
+            return "malformed run " + run.source;
+
+        run.module = module_ids[run.module];
+        run_ids.push_back(add_run(run));
+    }
+
+    BitflipDBRowData row_data;
+    for (const BitflipDBRow* row = db.rows_begin(); row != db.rows_end(); row++) {
+        if (!db.decode_row(*row, row_data) || row->module >= module_ids.size())
+            return "malformed block of row " + std::to_string(row->row);
+
+        uint32_t module = module_ids[row->module];
+        for (auto run : row_data.tested_runs) {
+            if (run >= run_ids.size())
+                return "malformed block of row " + std::to_string(row->row);
+            add_tested_row(module, row->bank, row->row, run_ids[run]);
+        }
+
+        for (uint32_t i = 0; i < row_data.bits.size(); i++) {
+            for (uint32_t j = row_data.obs_begin[i]; j < row_data.obs_begin[i + 1]; j++) {
+                if (row_data.runs[j] >= run_ids.size())
+                    return "malformed block of row " + std::to_string(row->row);
+                add_flips(module, row->bank, row->row, row_data.bits[i], run_ids[row_data.runs[j]], row_data.counts[j]);
+            }
+        }
+    }
+
+    return "";
+}
+
+#endif // BITFLIP_DB_H
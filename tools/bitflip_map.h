@@ -0,0 +1,453 @@
+#ifndef BITFLIP_MAP_H
+#define BITFLIP_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+
+// Compact binary bitflip map written by RowHammerAttacker with --output_format binary.
+//
+// Layout (all integers little-endian):
+//   header:  magic "UTRRBFM1", u32 header size, then the BitflipMapHeader fields (see write_header())
+//   blocks:  up to BITFLIP_MAP_BLOCK_ROWS row records each. A row record is
+//              varint anchor_row, varint total bitflips, varint payload size, payload
+//            where the payload run-length encodes the num_victims*chunks_per_victim chunk counts of the row
+//            as (varint number of zero chunks, varint non-zero count) pairs. Trailing zero chunks are omitted.
+//   index:   u32 number of blocks, then per block: u32 first anchor, u32 last anchor, u32 number of rows, u64 file offset, u64 total bitflips
+//   footer:  u64 file offset of the index, magic "UTRRBFM1"
+//
+// Only the rows with at least one bitflip are stored. The block index allows reading a row range or
+// summing the bitflips of a row range without decoding the rest of the file. The writer flushes each block
+// to the file as it fills up, so the map of a run that was killed before writing the index still has its
+// complete blocks, and the reader rebuilds their index by scanning the records.
+
+#define BITFLIP_MAP_MAGIC "UTRRBFM1"
+#define BITFLIP_MAP_MAGIC_SIZE 8
+#define BITFLIP_MAP_BLOCK_ROWS 1024
+#define BITFLIP_MAP_INDEX_ENTRY_SIZE (3*4 + 2*8)
+
+typedef struct BitflipMapHeader {
+    uint32_t bank;
+    uint32_t first_row; // the anchor row range that was tested (inclusive)
+    uint32_t last_row;
+    uint32_t num_victims; // victim rows per anchor row
+    uint32_t chunks_per_victim; // 1 when the bitflips are counted per row
+    uint32_t chunk_bytes; // --bitflip_counting_granularity, 0 when the bitflips are counted per row
+    std::string row_layout;
+    std::string config; // the command line that produced the map
+} BitflipMapHeader;
+
+typedef struct BitflipMapBlock {
+    uint32_t first_anchor;
+    uint32_t last_anchor;
+    uint32_t num_rows;
+    uint64_t offset;
+    uint64_t total_bitflips;
+} BitflipMapBlock;
+
+void bfm_put_u32(std::string& buf, const uint32_t val) {
+    for (int i = 0; i < 4; i++)
+        buf.push_back((char)((val >> (8*i)) & 0xFF));
+}
+
+void bfm_put_u64(std::string& buf, const uint64_t val) {
+    for (int i = 0; i < 8; i++)
+        buf.push_back((char)((val >> (8*i)) & 0xFF));
+}
+
+void bfm_put_varint(std::string& buf, uint64_t val) {
+    while (val >= 0x80) {
+        buf.push_back((char)((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+    buf.push_back((char)val);
+}
+
+void bfm_put_string(std::string& buf, const std::string& s) {
+    bfm_put_u32(buf, s.size());
+    buf.append(s);
+}
+
+// bounds-checked reads from a byte buffer. Each function advances pos and returns false when the buffer is too short
+bool bfm_get_u32(const std::string& buf, size_t& pos, uint32_t& val) {
+    if (pos + 4 > buf.size())
+        return false;
+
+    val = 0;
+    for (int i = 0; i < 4; i++)
+        val |= (uint32_t)(uint8_t)buf[pos + i] << (8*i);
+    pos += 4;
+
+    return true;
+}
+
+bool bfm_get_u64(const std::string& buf, size_t& pos, uint64_t& val) {
+    if (pos + 8 > buf.size())
+        return false;
+
+    val = 0;
+    for (int i = 0; i < 8; i++)
+        val |= (uint64_t)(uint8_t)buf[pos + i] << (8*i);
+    pos += 8;
+
+    return true;
+}
+
+bool bfm_get_varint(const std::string& buf, size_t& pos, uint64_t& val) {
+    val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= buf.size())
+            return false;
+
+        uint8_t byte = buf[pos++];
+        val |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+bool bfm_get_string(const std::string& buf, size_t& pos, std::string& s) {
+    uint32_t size;
+    if (!bfm_get_u32(buf, pos, size) || pos + size > buf.size())
+        return false;
+
+    s = buf.substr(pos, size);
+    pos += size;
+
+    return true;
+}
+
+class BitflipMapWriter {
+
+public:
+    bool open(const std::string& path, const BitflipMapHeader& header) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+
+        num_chunks = header.num_victims*header.chunks_per_victim;
+        blocks.clear();
+        block_buf.clear();
+
+        std::string header_buf;
+        bfm_put_u32(header_buf, header.bank);
+        bfm_put_u32(header_buf, header.first_row);
+        bfm_put_u32(header_buf, header.last_row);
+        bfm_put_u32(header_buf, header.num_victims);
+        bfm_put_u32(header_buf, header.chunks_per_victim);
+        bfm_put_u32(header_buf, header.chunk_bytes);
+        bfm_put_string(header_buf, header.row_layout);
+        bfm_put_string(header_buf, header.config);
+
+        std::string prefix(BITFLIP_MAP_MAGIC);
+        bfm_put_u32(prefix, header_buf.size());
+
+        out.write(prefix.data(), prefix.size());
+        out.write(header_buf.data(), header_buf.size());
+        file_offset = prefix.size() + header_buf.size();
+
+        return out.good();
+    }
+
+    // chunk_counts holds num_victims*chunks_per_victim counts. Rows without bitflips are not stored
+    void add_row(const uint32_t anchor_row, const uint32_t* chunk_counts) {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < num_chunks; i++)
+            total += chunk_counts[i];
+
+        if (total == 0)
+            return;
+
+        payload.clear();
+        uint64_t zero_run = 0;
+        for (uint32_t i = 0; i < num_chunks; i++) {
+            if (chunk_counts[i] == 0) {
+                zero_run++;
+                continue;
+            }
+
+            bfm_put_varint(payload, zero_run);
+            bfm_put_varint(payload, chunk_counts[i]);
+            zero_run = 0;
+        }
+
+        if (block_buf.empty()) {
+            BitflipMapBlock block;
+            block.first_anchor = anchor_row;
+            block.num_rows = 0;
+            block.offset = file_offset;
+            block.total_bitflips = 0;
+            blocks.push_back(block);
+        }
+
+        bfm_put_varint(block_buf, anchor_row);
+        bfm_put_varint(block_buf, total);
+        bfm_put_varint(block_buf, payload.size());
+        block_buf.append(payload);
+
+        BitflipMapBlock& block = blocks.back();
+        block.last_anchor = anchor_row;
+        block.num_rows++;
+        block.total_bitflips += total;
+
+        if (block.num_rows == BITFLIP_MAP_BLOCK_ROWS)
+            flush_block();
+    }
+
+    // writes the index and the footer. Until then, a reader can only recover the blocks that were flushed
+    void close() {
+        if (!out.is_open())
+            return;
+
+        flush_block();
+
+        std::string index_buf;
+        bfm_put_u32(index_buf, blocks.size());
+        for (auto& block : blocks) {
+            bfm_put_u32(index_buf, block.first_anchor);
+            bfm_put_u32(index_buf, block.last_anchor);
+            bfm_put_u32(index_buf, block.num_rows);
+            bfm_put_u64(index_buf, block.offset);
+            bfm_put_u64(index_buf, block.total_bitflips);
+        }
+
+        bfm_put_u64(index_buf, file_offset);
+        index_buf.append(BITFLIP_MAP_MAGIC);
+
+        out.write(index_buf.data(), index_buf.size());
+        out.close();
+    }
+
+    ~BitflipMapWriter() {
+        close();
+    }
+
+private:
+    void flush_block() {
+        if (block_buf.empty())
+            return;
+
+        out.write(block_buf.data(), block_buf.size());
+        out.flush();
+        file_offset += block_buf.size();
+        block_buf.clear();
+    }
+
+    std::ofstream out;
+    uint32_t num_chunks = 0;
+    uint64_t file_offset = 0;
+    std::vector<BitflipMapBlock> blocks;
+    std::string block_buf;
+    std::string payload;
+};
+
+class BitflipMapReader {
+
+public:
+    // reads the header and the block index, or rebuilds the index when the map has no footer (see is_recovered()). Returns an empty
+    // string on success, and a description of the problem otherwise
+    std::string open(const std::string& path) {
+        in.open(path, std::ios::binary);
+        if (!in.is_open())
+            return "could not open " + path;
+
+        in.seekg(0, std::ios::end);
+        uint64_t file_size = in.tellg();
+
+        std::string buf;
+        if (!read_at(0, BITFLIP_MAP_MAGIC_SIZE + 4, buf) || buf.compare(0, BITFLIP_MAP_MAGIC_SIZE, BITFLIP_MAP_MAGIC) != 0)
+            return path + " is not a bitflip map";
+
+        size_t pos = BITFLIP_MAP_MAGIC_SIZE;
+        uint32_t header_size;
+        if (!bfm_get_u32(buf, pos, header_size) || header_size > file_size - pos || !read_at(pos, header_size, buf))
+            return "truncated header";
+
+        const uint64_t data_offset = pos + header_size;
+
+        pos = 0;
+        if (!(bfm_get_u32(buf, pos, header.bank) && bfm_get_u32(buf, pos, header.first_row) && bfm_get_u32(buf, pos, header.last_row) &&
+              bfm_get_u32(buf, pos, header.num_victims) && bfm_get_u32(buf, pos, header.chunks_per_victim) && bfm_get_u32(buf, pos, header.chunk_bytes) &&
+              bfm_get_string(buf, pos, header.row_layout) && bfm_get_string(buf, pos, header.config)))
+            return "malformed header";
+
+        const uint64_t FOOTER_SIZE = 8 + BITFLIP_MAP_MAGIC_SIZE;
+        if (file_size < data_offset + FOOTER_SIZE || !read_at(file_size - FOOTER_SIZE, FOOTER_SIZE, buf) ||
+                buf.compare(8, BITFLIP_MAP_MAGIC_SIZE, BITFLIP_MAP_MAGIC) != 0)
+            return recover_index(data_offset, file_size);
+
+        pos = 0;
+        if (!bfm_get_u64(buf, pos, index_offset) || index_offset < data_offset || index_offset > file_size - FOOTER_SIZE ||
+                !read_at(index_offset, file_size - FOOTER_SIZE - index_offset, buf))
+            return "malformed index";
+
+        // the number of blocks is only trusted as far as the index has room for their entries
+        pos = 0;
+        uint32_t num_blocks;
+        if (!bfm_get_u32(buf, pos, num_blocks) || num_blocks > (buf.size() - pos)/BITFLIP_MAP_INDEX_ENTRY_SIZE)
+            return "malformed index";
+
+        blocks.resize(num_blocks);
+        for (auto& block : blocks) {
+            if (!(bfm_get_u32(buf, pos, block.first_anchor) && bfm_get_u32(buf, pos, block.last_anchor) && bfm_get_u32(buf, pos, block.num_rows) &&
+                  bfm_get_u64(buf, pos, block.offset) && bfm_get_u64(buf, pos, block.total_bitflips)))
+                return "malformed index";
+        }
+
+        return "";
+    }
+
+    // true when the map has no footer, i.e., the run that wrote it did not finish. The rows after the last recovered one may have
+    // been tested without being written
+    bool is_recovered() const {
+        return recovered;
+    }
+
+    const BitflipMapHeader& get_header() const {
+        return header;
+    }
+
+    const std::vector<BitflipMapBlock>& get_blocks() const {
+        return blocks;
+    }
+
+    uint32_t num_chunks() const {
+        return header.num_victims*header.chunks_per_victim;
+    }
+
+    // Calls fn(anchor_row, chunk_counts) for each stored row in [first_row, last_row] in ascending order. Only the blocks that
+    // overlap the range are read. chunk_counts holds num_chunks() counts and is only valid during the call. Returns false on a malformed block
+    bool for_each_row(const uint32_t first_row, const uint32_t last_row, const std::function<void(uint32_t, const uint32_t*)>& fn) {
+        std::vector<uint32_t> chunk_counts(num_chunks());
+
+        return for_each_record(first_row, last_row, [&](uint32_t anchor_row, uint64_t, const std::string& buf, size_t pos, size_t payload_end) {
+            std::fill(chunk_counts.begin(), chunk_counts.end(), 0);
+
+            uint64_t chunk = 0, zero_run, count;
+            while (pos < payload_end) {
+                if (!bfm_get_varint(buf, pos, zero_run) || !bfm_get_varint(buf, pos, count))
+                    return false;
+
+                chunk += zero_run;
+                if (chunk >= chunk_counts.size())
+                    return false;
+
+                chunk_counts[chunk++] = count;
+            }
+
+            fn(anchor_row, chunk_counts.data());
+            return true;
+        });
+    }
+
+    // the total number of bitflips in [first_row, last_row]. Uses the block totals for the blocks that are fully within the range
+    bool total_bitflips(const uint32_t first_row, const uint32_t last_row, uint64_t& total) {
+        total = 0;
+
+        for (auto& block : blocks) {
+            if (block.first_anchor >= first_row && block.last_anchor <= last_row)
+                total += block.total_bitflips;
+        }
+
+        // only the partially covered blocks at the edges are read
+        return for_each_record(first_row, last_row, [&](uint32_t, uint64_t row_total, const std::string&, size_t, size_t) {
+            total += row_total;
+            return true;
+        }, true);
+    }
+
+private:
+    bool read_at(const uint64_t offset, const uint64_t size, std::string& buf) {
+        buf.resize(size);
+        in.clear();
+        in.seekg(offset);
+        in.read(&buf[0], size);
+
+        return (uint64_t)in.gcount() == size;
+    }
+
+    // rebuilds the block index from the records that follow the header, up to the last complete one. The blocks are regrouped
+    // into BITFLIP_MAP_BLOCK_ROWS records, as the writer would have done
+    std::string recover_index(const uint64_t data_offset, const uint64_t file_size) {
+        std::string buf;
+        if (file_size < data_offset || !read_at(data_offset, file_size - data_offset, buf))
+            return "truncated header";
+
+        blocks.clear();
+        recovered = true;
+
+        size_t pos = 0;
+        while (pos < buf.size()) {
+            size_t record_pos = pos;
+            uint64_t anchor_row, total, payload_size;
+            if (!bfm_get_varint(buf, pos, anchor_row) || !bfm_get_varint(buf, pos, total) || !bfm_get_varint(buf, pos, payload_size) ||
+                    payload_size > buf.size() - pos || anchor_row < header.first_row || anchor_row > header.last_row ||
+                    (!blocks.empty() && anchor_row <= blocks.back().last_anchor)) {
+                pos = record_pos;
+                break;
+            }
+
+            pos += payload_size;
+
+            if (blocks.empty() || blocks.back().num_rows == BITFLIP_MAP_BLOCK_ROWS)
+                blocks.push_back(BitflipMapBlock{(uint32_t)anchor_row, (uint32_t)anchor_row, 0, data_offset + record_pos, 0});
+
+            BitflipMapBlock& block = blocks.back();
+            block.last_anchor = anchor_row;
+            block.num_rows++;
+            block.total_bitflips += total;
+        }
+
+        index_offset = data_offset + pos;
+        return "";
+    }
+
+    // decodes the record headers of the blocks that overlap [first_row, last_row] and calls fn for the records within the range
+    bool for_each_record(const uint32_t first_row, const uint32_t last_row,
+            const std::function<bool(uint32_t, uint64_t, const std::string&, size_t, size_t)>& fn, const bool partial_blocks_only = false) {
+
+        std::string buf;
+        for (uint i = 0; i < blocks.size(); i++) {
+            const BitflipMapBlock& block = blocks[i];
+
+            if (block.last_anchor < first_row || block.first_anchor > last_row)
+                continue;
+
+            if (partial_blocks_only && block.first_anchor >= first_row && block.last_anchor <= last_row)
+                continue;
+
+            uint64_t block_end = (i + 1 < blocks.size()) ? blocks[i + 1].offset : index_offset;
+            if (block_end < block.offset || block_end > index_offset || !read_at(block.offset, block_end - block.offset, buf))
+                return false;
+
+            size_t pos = 0;
+            for (uint32_t r = 0; r < block.num_rows; r++) {
+                uint64_t anchor_row, total, payload_size;
+                if (!bfm_get_varint(buf, pos, anchor_row) || !bfm_get_varint(buf, pos, total) || !bfm_get_varint(buf, pos, payload_size)
+                    || pos + payload_size > buf.size())
+                    return false;
+
+                if (anchor_row >= first_row && anchor_row <= last_row && !fn(anchor_row, total, buf, pos, pos + payload_size))
+                    return false;
+
+                pos += payload_size;
+            }
+        }
+
+        return true;
+    }
+
+    std::ifstream in;
+    BitflipMapHeader header;
+    uint64_t index_offset = 0;
+    bool recovered = false;
+    std::vector<BitflipMapBlock> blocks;
+};
+
+#endif // BITFLIP_MAP_H
@@ -0,0 +1,231 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include <sys/mman.h>
+
+// A pool of the buffers the tools receive row data from the board into. Instead of a stack array or a new[] per receive, a
+// receive path takes a buffer from receive_buffers, e.g.,
+//   ArenaBuffer buf = receive_buffers.acquire(ROW_SIZE*num_rows);
+//   receive_data(platform, buf.data(), buf.size());
+// and the buffer returns to the pool when buf goes out of scope, so the next iteration gets the same memory back.
+//
+// Buffers are handed out by size class, i.e., the requested size rounded up to a power of two, so that a buffer can serve every
+// request of its class. Buffers are aligned to cache lines, and buffers of at least a huge page to huge pages (with transparent
+// huge pages requested for them), which keeps the TLB misses of scanning large row batches for bitflips low.
+
+#define BUFFER_ARENA_ALIGNMENT 64
+#define BUFFER_ARENA_HUGE_PAGE_SIZE (2ul << 20)
+#define BUFFER_ARENA_MIN_CLASS 6 // 64 bytes
+#define BUFFER_ARENA_NUM_CLASSES 40
+
+typedef struct BufferArenaStats {
+    uint64_t num_acquired = 0;
+    uint64_t num_reused = 0; // acquisitions served from the pool
+    uint64_t reused_bytes = 0;
+    uint64_t allocated_bytes = 0; // obtained from the system, whether in use or in the pool
+    uint64_t in_use_bytes = 0;
+    uint64_t peak_in_use_bytes = 0;
+} BufferArenaStats;
+
+class BufferArena;
+
+// a buffer of a BufferArena. Returns to the arena when destroyed
+class ArenaBuffer {
+
+public:
+    ArenaBuffer() : arena(nullptr), buf(nullptr), buf_size(0), size_class(0) {}
+
+    ArenaBuffer(ArenaBuffer&& other) : arena(other.arena), buf(other.buf), buf_size(other.buf_size), size_class(other.size_class) {
+        other.buf = nullptr;
+    }
+
+    ArenaBuffer& operator=(ArenaBuffer&& other);
+
+    ArenaBuffer(const ArenaBuffer&) = delete;
+    ArenaBuffer& operator=(const ArenaBuffer&) = delete;
+
+    ~ArenaBuffer() {
+        release();
+    }
+
+    char* data() const {
+        return buf;
+    }
+
+    // the requested size. The buffer may be larger
+    size_t size() const {
+        return buf_size;
+    }
+
+    void release();
+
+private:
+    friend class BufferArena;
+
+    BufferArena* arena;
+    char* buf;
+    size_t buf_size;
+    uint size_class;
+
+    ArenaBuffer(BufferArena* arena, char* buf, const size_t buf_size, const uint size_class) :
+        arena(arena), buf(buf), buf_size(buf_size), size_class(size_class) {}
+};
+
+class BufferArena {
+
+public:
+    BufferArena() : free_lists(BUFFER_ARENA_NUM_CLASSES) {}
+
+    ~BufferArena() {
+        trim();
+    }
+
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    ArenaBuffer acquire(const size_t size) {
+        uint size_class = BUFFER_ARENA_MIN_CLASS;
+        while((1ul << size_class) < size)
+            size_class++;
+
+        if(size_class >= BUFFER_ARENA_NUM_CLASSES)
+            throw std::bad_alloc();
+
+        size_t capacity = 1ul << size_class;
+        char* buf = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto& free_list = free_lists[size_class];
+            if(!free_list.empty()) {
+                buf = free_list.back();
+                free_list.pop_back();
+
+                stats.num_reused++;
+                stats.reused_bytes += capacity;
+            }
+
+            stats.num_acquired++;
+            stats.in_use_bytes += capacity;
+            stats.peak_in_use_bytes = std::max(stats.peak_in_use_bytes, stats.in_use_bytes);
+
+            if(buf == nullptr)
+                stats.allocated_bytes += capacity;
+        }
+
+        if(buf == nullptr)
+            buf = allocate(capacity);
+
+        return ArenaBuffer(this, buf, size, size_class);
+    }
+
+    // frees the buffers in the pool, e.g., at the end of a run of the ExperimentServer. Buffers in use are not affected
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(uint size_class = 0; size_class < free_lists.size(); size_class++) {
+            for(char* buf : free_lists[size_class]) {
+                free(buf);
+                stats.allocated_bytes -= 1ul << size_class;
+            }
+
+            free_lists[size_class].clear();
+        }
+    }
+
+    // keeps the pool, so a new run starts with the buffers of the previous one
+    void reset_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint64_t allocated_bytes = stats.allocated_bytes, in_use_bytes = stats.in_use_bytes;
+        stats = BufferArenaStats();
+        stats.allocated_bytes = allocated_bytes;
+        stats.in_use_bytes = in_use_bytes;
+        stats.peak_in_use_bytes = in_use_bytes;
+    }
+
+    BufferArenaStats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    friend class ArenaBuffer;
+
+    std::mutex mutex;
+    std::vector<std::vector<char*>> free_lists; // by size class
+    BufferArenaStats stats;
+
+    static char* allocate(const size_t capacity) {
+        size_t alignment = capacity >= BUFFER_ARENA_HUGE_PAGE_SIZE ? BUFFER_ARENA_HUGE_PAGE_SIZE : BUFFER_ARENA_ALIGNMENT;
+
+        void* buf = nullptr;
+        if(posix_memalign(&buf, alignment, capacity) != 0)
+            throw std::bad_alloc();
+
+        #ifdef MADV_HUGEPAGE
+        // only a hint, e.g., transparent huge pages may be disabled
+        if(alignment == BUFFER_ARENA_HUGE_PAGE_SIZE)
+            madvise(buf, capacity, MADV_HUGEPAGE);
+        #endif
+
+        return (char*) buf;
+    }
+
+    void give_back(char* buf, const uint size_class) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        free_lists[size_class].push_back(buf);
+        stats.in_use_bytes -= 1ul << size_class;
+    }
+};
+
+inline ArenaBuffer& ArenaBuffer::operator=(ArenaBuffer&& other) {
+    if(this != &other) {
+        release();
+
+        arena = other.arena;
+        buf = other.buf;
+        buf_size = other.buf_size;
+        size_class = other.size_class;
+        other.buf = nullptr;
+    }
+
+    return *this;
+}
+
+inline void ArenaBuffer::release() {
+    if(buf != nullptr)
+        arena->give_back(buf, size_class);
+
+    buf = nullptr;
+    buf_size = 0;
+}
+
+// the buffers of all receive paths of a tool
+BufferArena receive_buffers;
+
+void print_receive_buffer_stats() {
+    BufferArenaStats stats = receive_buffers.get_stats();
+    if(stats.num_acquired == 0)
+        return;
+
+    std::cout << "Receive buffers: " << std::fixed << std::setprecision(2) << stats.peak_in_use_bytes/1048576.0 << " MiB peak in use, "
+        << stats.allocated_bytes/1048576.0 << " MiB allocated, " << stats.reused_bytes/1048576.0 << " MiB reused ("
+        << stats.num_reused << " of " << stats.num_acquired << " buffers taken from the pool)" << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+#endif // BUFFER_ARENA_H
@@ -0,0 +1,132 @@
+#ifndef CHUNKED_RECEIVE_H
+#define CHUNKED_RECEIVE_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <exception>
+
+#include "tools/softmc_session.h"
+#include "tools/buffer_arena.h"
+
+// Receives the data a program sends back in fixed-size chunks instead of all at once, e.g.,
+//   ChunkedReceive rx(platform, ROW_SIZE*num_rows, ROW_SIZE*RECEIVE_CHUNK_ROWS);
+//   const char* chunk; uint64_t offset; uint32_t size;
+//   while(rx.next(chunk, offset, size))
+//       ... analyze the rows in chunk, which starts at byte 'offset' of the data ...
+// A background thread receives the chunks into a small ring of buffers (taken from receive_buffers) while the caller analyzes
+// the chunks that already arrived, so the memory needed is num_slots chunks regardless of how much data the program sends,
+// and the analysis overlaps with the transfer. The receiving thread waits when all slots hold chunks the caller has not
+// finished with yet. A chunk stays valid until the next call of next(). An exception the receiving thread gets (e.g., from replaying
+// a capture) is thrown by next().
+
+#define RECEIVE_RING_SLOTS 4
+
+class ChunkedReceive {
+
+public:
+    ChunkedReceive(SoftMCPlatform& platform, const uint64_t total_size, const uint32_t chunk_size, const uint num_slots = RECEIVE_RING_SLOTS) :
+            total_size(total_size), chunk_size(chunk_size), num_chunks((total_size + chunk_size - 1)/chunk_size),
+            num_received(0), num_released(0), holds_chunk(false), draining(false) {
+
+        uint ring_size = std::max<uint64_t>(std::min<uint64_t>(num_slots, num_chunks), 1);
+        for(uint i = 0; i < ring_size; i++)
+            slots.push_back(receive_buffers.acquire(chunk_size));
+
+        receiver = std::thread(&ChunkedReceive::receive_chunks, this, std::ref(platform));
+    }
+
+    // the rest of the data is still received (and dropped) if the caller stops early so that it does not end up in the
+    // data of the next program
+    ~ChunkedReceive() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            draining = true;
+        }
+
+        cv.notify_all();
+        receiver.join();
+    }
+
+    ChunkedReceive(const ChunkedReceive&) = delete;
+    ChunkedReceive& operator=(const ChunkedReceive&) = delete;
+
+    // Blocks until the next chunk arrives and releases the previous one. Returns false when all chunks were returned
+    bool next(const char*& chunk, uint64_t& offset, uint32_t& size) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(holds_chunk) {
+            num_released++;
+            holds_chunk = false;
+            cv.notify_all();
+        }
+
+        if(num_released == num_chunks)
+            return false;
+
+        cv.wait(lock, [this]() { return num_received > num_released || error; });
+        if(error)
+            std::rethrow_exception(error);
+
+        chunk = slots[num_released % slots.size()].data();
+        offset = num_released*chunk_size;
+        size = chunk_bytes(num_released);
+        holds_chunk = true;
+
+        return true;
+    }
+
+private:
+    const uint64_t total_size;
+    const uint32_t chunk_size;
+    const uint64_t num_chunks;
+
+    std::vector<ArenaBuffer> slots;
+
+    uint64_t num_received;
+    uint64_t num_released;
+    bool holds_chunk;
+    bool draining;
+    std::exception_ptr error;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread receiver;
+
+    uint32_t chunk_bytes(const uint64_t chunk_ind) const {
+        return std::min<uint64_t>(chunk_size, total_size - chunk_ind*chunk_size);
+    }
+
+    void receive_chunks(SoftMCPlatform& platform) {
+        for(uint64_t chunk_ind = 0; chunk_ind < num_chunks; chunk_ind++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return chunk_ind - num_released < slots.size() || draining; });
+            }
+
+            try {
+                receive_data(platform, slots[chunk_ind % slots.size()].data(), chunk_bytes(chunk_ind));
+            } catch(...) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    error = std::current_exception();
+                }
+
+                cv.notify_all();
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                num_received++;
+            }
+
+            cv.notify_all();
+        }
+    }
+};
+
+#endif // CHUNKED_RECEIVE_H
@@ -0,0 +1,157 @@
+#ifndef EXPERIMENT_SERVER_H
+#define EXPERIMENT_SERVER_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <ostream>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "tools/json_struct.h"
+
+// Wire protocol between the ExperimentServer and ExperimentClient:
+//   client -> server: one ExperimentJob serialized as compact JSON and terminated by '\n'
+//   server -> client: free-form text (the output of the job as it runs and server notifications prefixed with EXPSRV_MSG_PREFIX),
+//                     terminated by a line "EXPSRV_MSG_PREFIX job finished with exit code <code>"
+
+#define DEFAULT_EXPSRV_SOCKET "/tmp/utrr_experiment_server.sock"
+#define EXPSRV_MSG_PREFIX "[ExperimentServer]"
+#define EXPSRV_EXIT_MSG EXPSRV_MSG_PREFIX " job finished with exit code "
+
+typedef struct ExperimentJob {
+    std::string tool; // RowScout, TRRAnalyzer, or RowHammerAttacker
+    std::vector<std::string> args; // command line arguments passed to the tool as is
+    std::string out; // if not empty, passed to the tool as --out
+    std::string cwd; // working directory of the client, relative paths in args are resolved against it
+} ExperimentJob;
+
+JS_OBJECT_EXTERNAL(ExperimentJob,
+                JS_MEMBER(tool),
+                JS_MEMBER(args),
+                JS_MEMBER(out),
+                JS_MEMBER(cwd));
+
+std::string job_to_string(const ExperimentJob& job) {
+    return JS::serializeStruct(job, JS::SerializerOptions(JS::SerializerOptions::Compact));
+}
+
+bool job_from_string(const std::string& s_job, ExperimentJob& job) {
+    JS::ParseContext context(s_job);
+    return context.parseTo(job) == JS::Error::NoError;
+}
+
+bool send_all(const int fd, const char* data, size_t size) {
+    while(size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+
+        if(sent < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+
+        data += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+bool send_line(const int fd, const std::string& line) {
+    std::string msg = line + "\n";
+    return send_all(fd, msg.c_str(), msg.size());
+}
+
+// reads from fd until '\n' or EOF. Returns false if nothing could be read
+bool recv_line(const int fd, std::string& line) {
+    line.clear();
+
+    char c;
+    while(true) {
+        ssize_t n = recv(fd, &c, 1, 0);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n <= 0)
+            return !line.empty();
+
+        if(c == '\n')
+            return true;
+
+        line.push_back(c);
+    }
+}
+
+bool make_unix_sockaddr(const std::string& socket_path, sockaddr_un& addr) {
+    if(socket_path.size() >= sizeof(addr.sun_path))
+        return false;
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    return true;
+}
+
+// Submits job to the ExperimentServer at socket_path and writes the output of the job to out as it arrives. Returns the exit code of the
+// job, or -1 with error set if the job could not be submitted or the connection was closed before the job finished
+int run_remote_job(const std::string& socket_path, const ExperimentJob& job, std::ostream& out, std::string& error) {
+    sockaddr_un addr;
+    if(!make_unix_sockaddr(socket_path, addr)) {
+        error = "socket path is too long: " + socket_path;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        error = "could not connect to the ExperimentServer at " + socket_path + ": " + std::strerror(errno);
+        if(fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    if(!send_line(fd, job_to_string(job))) {
+        error = "could not send the job to the ExperimentServer";
+        close(fd);
+        return -1;
+    }
+
+    // stream the output of the job until the server closes the connection
+    const std::string exit_msg = EXPSRV_EXIT_MSG;
+    std::string tail; // the last few hundred characters, to find the exit code in
+    char buf[4096];
+    while(true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n <= 0)
+            break;
+
+        out.write(buf, n);
+        out.flush();
+
+        tail.append(buf, n);
+        if(tail.size() > 2*exit_msg.size() + 64)
+            tail.erase(0, tail.size() - (2*exit_msg.size() + 64));
+    }
+
+    close(fd);
+
+    size_t pos = tail.rfind(exit_msg);
+    if(pos == std::string::npos) {
+        error = "the connection to the ExperimentServer was closed before the job finished";
+        return -1;
+    }
+
+    return std::atoi(tail.c_str() + pos + exit_msg.size());
+}
+
+#endif // EXPERIMENT_SERVER_H
@@ -0,0 +1,232 @@
+#ifndef HAMMER_PATTERN_H
+#define HAMMER_PATTERN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <random>
+#include <algorithm>
+
+// Frequency-domain description of a (non-uniform) hammer pattern.
+//
+// A pattern spans 'ref_intervals' consecutive REF intervals, each of which is divided into 'slots_per_ref' ACT slots.
+// Every slot either activates one row (an ACT followed by a PRE) or stays idle for the same amount of time, and a REF
+// command is issued after the last slot of each REF interval. The pattern is repeated until the requested number of REFs is issued.
+//
+// Each aggressor is described relative to the whole pattern (i.e., ref_intervals*slots_per_ref slots):
+//   offset:    row distance from the anchor row (physical row IDs)
+//   frequency: number of times the aggressor is hammered within the pattern. Hit k starts at slot phase + k*(num_slots/frequency)
+//   phase:     slot at which the first hit starts
+//   amplitude: number of consecutive ACTs to the aggressor per hit
+//
+// Compact string form (used for logging and replaying): "<slots_per_ref>:<ref_intervals>|<offset>,<frequency>,<phase>,<amplitude>;..."
+// E.g., "150:1|1,8,0,2;3,8,2,2" hammers rows anchor+1 and anchor+3 in turns, 8 times per REF interval, twice each time.
+
+#define HAMMER_SLOT_IDLE -1
+
+typedef struct HammerAggressor {
+    int offset;
+    uint frequency;
+    uint phase;
+    uint amplitude;
+} HammerAggressor;
+
+typedef struct HammerPattern {
+    uint slots_per_ref;
+    uint ref_intervals;
+    std::vector<HammerAggressor> aggressors;
+} HammerPattern;
+
+// The exact ACT order of a pattern. slot_offsets[i] is the row offset activated in slot i or HAMMER_SLOT_IDLE
+typedef struct HammerSchedule {
+    uint slots_per_ref;
+    uint ref_intervals;
+    std::vector<int> slot_offsets;
+} HammerSchedule;
+
+uint num_pattern_slots(const HammerPattern& pattern) {
+    return pattern.slots_per_ref*pattern.ref_intervals;
+}
+
+std::string hammer_pattern_to_string(const HammerPattern& pattern) {
+    std::stringstream ss;
+
+    ss << pattern.slots_per_ref << ":" << pattern.ref_intervals << "|";
+    for(uint i = 0; i < pattern.aggressors.size(); i++) {
+        const HammerAggressor& aggr = pattern.aggressors[i];
+
+        if(i > 0)
+            ss << ";";
+        ss << aggr.offset << "," << aggr.frequency << "," << aggr.phase << "," << aggr.amplitude;
+    }
+
+    return ss.str();
+}
+
+// checks whether the pattern is well-formed. Returns an empty string if so, and a description of the problem otherwise
+std::string validate_hammer_pattern(const HammerPattern& pattern) {
+    if(pattern.slots_per_ref == 0 || pattern.ref_intervals == 0)
+        return "slots_per_ref and ref_intervals must be greater than zero";
+
+    if(pattern.aggressors.empty())
+        return "the pattern does not have any aggressors";
+
+    uint num_slots = num_pattern_slots(pattern);
+    uint64_t num_acts = 0;
+    for(auto& aggr : pattern.aggressors) {
+        std::string s_aggr = "aggressor at offset " + std::to_string(aggr.offset) + ": ";
+
+        if(aggr.offset < 0)
+            return s_aggr + "offset must not be negative";
+
+        if(aggr.frequency == 0 || aggr.amplitude == 0)
+            return s_aggr + "frequency and amplitude must be greater than zero";
+
+        if(aggr.phase >= num_slots)
+            return s_aggr + "phase must be smaller than the number of slots (" + std::to_string(num_slots) + ")";
+
+        if(aggr.frequency*aggr.amplitude > num_slots)
+            return s_aggr + "frequency*amplitude exceeds the number of slots (" + std::to_string(num_slots) + ")";
+
+        num_acts += (uint64_t)aggr.frequency*aggr.amplitude;
+    }
+
+    // compile_hammer_pattern() would have to drop the ACTs that do not get a slot
+    if(num_acts > num_slots)
+        return "the aggressors issue " + std::to_string(num_acts) + " ACTs in " + std::to_string(pattern.ref_intervals) + 
+                " REF interval(s), more than the " + std::to_string(pattern.slots_per_ref) + " slots per REF interval allow";
+
+    return "";
+}
+
+// parses the compact string form. Returns an empty string on success, and a description of the problem otherwise
+std::string parse_hammer_pattern(const std::string& s_pattern, HammerPattern& pattern) {
+    pattern.aggressors.clear();
+
+    size_t sep = s_pattern.find('|');
+    if(sep == std::string::npos)
+        return "missing '|' in \"" + s_pattern + "\"";
+
+    char c;
+    std::stringstream ss_header(s_pattern.substr(0, sep));
+    if(!(ss_header >> pattern.slots_per_ref >> c >> pattern.ref_intervals) || c != ':')
+        return "malformed header \"" + s_pattern.substr(0, sep) + "\", expected <slots_per_ref>:<ref_intervals>";
+
+    std::stringstream ss_aggrs(s_pattern.substr(sep + 1));
+    std::string s_aggr;
+    while(std::getline(ss_aggrs, s_aggr, ';')) {
+        HammerAggressor aggr;
+        char c1, c2, c3;
+        std::stringstream ss_aggr(s_aggr);
+
+        if(!(ss_aggr >> aggr.offset >> c1 >> aggr.frequency >> c2 >> aggr.phase >> c3 >> aggr.amplitude) || c1 != ',' || c2 != ',' || c3 != ',')
+            return "malformed aggressor \"" + s_aggr + "\", expected <offset>,<frequency>,<phase>,<amplitude>";
+
+        pattern.aggressors.push_back(aggr);
+    }
+
+    return validate_hammer_pattern(pattern);
+}
+
+// Places the ACTs of each aggressor into the slots. The aggressors are placed in order, and an ACT that falls into an
+// already occupied slot is moved to the next free slot (wrapping around), so the same pattern always compiles to the same schedule.
+// The pattern must be valid (see validate_hammer_pattern()), i.e., every ACT gets a slot.
+HammerSchedule compile_hammer_pattern(const HammerPattern& pattern) {
+    HammerSchedule schedule;
+
+    schedule.slots_per_ref = pattern.slots_per_ref;
+    schedule.ref_intervals = pattern.ref_intervals;
+
+    uint num_slots = num_pattern_slots(pattern);
+    schedule.slot_offsets = std::vector<int>(num_slots, HAMMER_SLOT_IDLE);
+    uint free_slots = num_slots;
+
+    for(auto& aggr : pattern.aggressors) {
+        uint hit_period = num_slots/aggr.frequency;
+
+        for(uint hit = 0; hit < aggr.frequency; hit++) {
+            uint slot = (aggr.phase + hit*hit_period) % num_slots;
+
+            for(uint act = 0; act < aggr.amplitude && free_slots > 0; act++) {
+                while(schedule.slot_offsets[slot] != HAMMER_SLOT_IDLE)
+                    slot = (slot + 1) % num_slots;
+
+                schedule.slot_offsets[slot] = aggr.offset;
+                free_slots--;
+            }
+        }
+    }
+
+    return schedule;
+}
+
+// the rows that the pattern does not hammer within [0, max aggressor offset + 1]. The bitflips are collected from these rows
+std::vector<int> pattern_victim_offsets(const HammerPattern& pattern) {
+    int max_offset = 0;
+    for(auto& aggr : pattern.aggressors)
+        max_offset = std::max(max_offset, aggr.offset);
+
+    std::vector<int> victims;
+    for(int offset = 0; offset <= max_offset + 1; offset++) {
+        bool is_aggr = std::any_of(pattern.aggressors.begin(), pattern.aggressors.end(),
+                        [offset](const HammerAggressor& aggr) {return aggr.offset == offset;});
+
+        if(!is_aggr)
+            victims.push_back(offset);
+    }
+
+    return victims;
+}
+
+std::vector<int> pattern_aggressor_offsets(const HammerPattern& pattern) {
+    std::vector<int> aggrs;
+    for(auto& aggr : pattern.aggressors)
+        if(std::find(aggrs.begin(), aggrs.end(), aggr.offset) == aggrs.end())
+            aggrs.push_back(aggr.offset);
+
+    return aggrs;
+}
+
+// Samples a random pattern for fuzzing. The pattern consists of 1 to max_pairs double-sided aggressor pairs (offsets o and o+2)
+// placed within [1, max_offset]. Both aggressors of a pair share the frequency and the amplitude and are hammered one after another.
+// Frequencies are powers of two so that the hits of different aggressors align with each other as in the patterns that bypass TRR.
+// The pairs are sampled within the slots that the previous pairs left free, so the pattern is always valid. Fewer than the sampled
+// number of pairs are placed when the slots run out. The pattern must have at least two slots
+HammerPattern sample_hammer_pattern(std::mt19937& rng, const uint slots_per_ref, const uint max_ref_intervals,
+                                    const uint max_pairs, const uint max_offset, const uint max_amplitude) {
+    HammerPattern pattern;
+
+    pattern.slots_per_ref = slots_per_ref;
+    pattern.ref_intervals = std::uniform_int_distribution<uint>(1, std::max(max_ref_intervals, 1u))(rng);
+
+    uint num_slots = num_pattern_slots(pattern);
+    uint num_pairs = std::uniform_int_distribution<uint>(1, std::max(max_pairs, 1u))(rng);
+    uint free_slots = num_slots;
+
+    for(uint i = 0; i < num_pairs && free_slots >= 2; i++) {
+        HammerAggressor aggr;
+
+        aggr.offset = std::uniform_int_distribution<int>(1, std::max((int)max_offset - 2, 1))(rng);
+        aggr.amplitude = std::uniform_int_distribution<uint>(1, std::max(std::min(max_amplitude, free_slots/2), 1u))(rng);
+
+        uint max_freq_log2 = 0;
+        while((2u << max_freq_log2)*2*aggr.amplitude <= free_slots)
+            max_freq_log2++;
+        aggr.frequency = 1u << std::uniform_int_distribution<uint>(0, max_freq_log2)(rng);
+
+        aggr.phase = std::uniform_int_distribution<uint>(0, num_slots/aggr.frequency - 1)(rng);
+
+        HammerAggressor pair = aggr;
+        pair.offset = aggr.offset + 2;
+        pair.phase = (aggr.phase + aggr.amplitude) % num_slots;
+
+        pattern.aggressors.push_back(aggr);
+        pattern.aggressors.push_back(pair);
+        free_slots -= 2*aggr.frequency*aggr.amplitude;
+    }
+
+    return pattern;
+}
+
+#endif // HAMMER_PATTERN_H
@@ -0,0 +1,239 @@
+#ifndef JSON_OBJECT_FILE_H
+#define JSON_OBJECT_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tools/json_struct.h"
+
+// A file of pretty-printed JSON objects written one after another, e.g., the output of RowScout. Each object ends with a line that is
+// exactly "}". The file is memory-mapped and the object boundaries are found by looking for such lines, i.e., by scanning for '}'
+// rather than reading line by line. Objects are parsed in parallel on demand, so a lookup by index parses only the requested objects.
+//
+// The byte offsets of the objects are saved to a sidecar index (<file>.idx) so that later runs skip the scan. The index records the
+// size and the modification time of the file and is rebuilt when either changes.
+
+#define JSON_INDEX_MAGIC "UTRRIDX1"
+#define JSON_PARSE_MIN_OBJS_PER_THREAD 64
+
+typedef struct JSONObjectRef {
+    uint64_t offset;
+    uint64_t size;
+} JSONObjectRef;
+
+class JSONObjectFile {
+
+public:
+    JSONObjectFile() : fd(-1), data(nullptr), size(0), mtime_ns(0) {}
+
+    ~JSONObjectFile() {
+        close();
+    }
+
+    JSONObjectFile(const JSONObjectFile&) = delete;
+    JSONObjectFile& operator=(const JSONObjectFile&) = delete;
+
+    // Maps the file and finds its objects, using (and refreshing) the sidecar index when use_index is set.
+    // Returns an empty string on success, and a description of the problem otherwise
+    std::string open(const std::string& filename, const bool use_index = true) {
+        close();
+
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return "cannot open " + filename;
+
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+            return "cannot stat " + filename;
+
+        size = st.st_size;
+        if(size > 0) {
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped == MAP_FAILED) {
+                size = 0;
+                return "cannot map " + filename;
+            }
+
+            data = (const char*) mapped;
+            madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+
+        mtime_ns = (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+        index_filename = filename + ".idx";
+
+        if(use_index && load_index())
+            return "";
+
+        scan();
+
+        // the index is only an optimization, e.g., the directory of the file may not be writable
+        if(use_index)
+            save_index();
+
+        return "";
+    }
+
+    void close() {
+        if(data != nullptr)
+            munmap((void*) data, size);
+        if(fd >= 0)
+            ::close(fd);
+
+        fd = -1;
+        data = nullptr;
+        size = 0;
+        objects.clear();
+    }
+
+    size_t num_objects() const {
+        return objects.size();
+    }
+
+    std::string object(const size_t ind) const {
+        return std::string(data + objects[ind].offset, objects[ind].size);
+    }
+
+    // Parses the objects at 'indices' into 'parsed' (in the same order) using multiple threads. Every object is parsed even when some
+    // fail. Returns an empty string on success, and the error of the first object that failed to parse otherwise
+    template<typename T>
+    std::string parse_objects(const std::vector<size_t>& indices, std::vector<T>& parsed) const {
+        parsed.clear();
+        parsed.resize(indices.size());
+
+        for(auto ind : indices)
+            if(ind >= objects.size())
+                return "there is no object at index " + std::to_string(ind) + ", the file contains " + std::to_string(objects.size()) + " object(s)";
+
+        uint num_threads = std::max(1u, std::thread::hardware_concurrency());
+        num_threads = std::min<size_t>(num_threads, indices.size()/JSON_PARSE_MIN_OBJS_PER_THREAD + 1);
+
+        std::vector<std::string> errors(num_threads);
+        auto parse_range = [&](const uint tid) {
+            size_t first = indices.size()*tid/num_threads, last = indices.size()*(tid + 1)/num_threads;
+
+            for(size_t i = first; i < last; i++) {
+                const JSONObjectRef& obj = objects[indices[i]];
+                JS::ParseContext context(data + obj.offset, obj.size);
+
+                if(context.parseTo(parsed[i]) != JS::Error::NoError && errors[tid].empty())
+                    errors[tid] = "object " + std::to_string(indices[i]) + ": " + context.makeErrorString();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(uint tid = 1; tid < num_threads; tid++)
+            threads.emplace_back(parse_range, tid);
+        parse_range(0);
+        for(auto& t : threads)
+            t.join();
+
+        for(auto& error : errors)
+            if(!error.empty())
+                return error;
+
+        return "";
+    }
+
+private:
+    int fd;
+    const char* data;
+    size_t size;
+    int64_t mtime_ns;
+    std::string index_filename;
+    std::vector<JSONObjectRef> objects;
+
+    // An object ends at a line that is exactly "}". A trailing object without such a line is not an object (same as reading the
+    // file line by line until "}")
+    void scan() {
+        objects.clear();
+
+        uint64_t obj_start = 0;
+        const char* p = data;
+        const char* end = data + size;
+        while(p < end && (p = (const char*) memchr(p, '}', end - p)) != nullptr) {
+            bool line_start = (p == data || p[-1] == '\n');
+            bool line_end = (p + 1 == end || p[1] == '\n');
+
+            if(line_start && line_end) {
+                uint64_t obj_end = (p - data) + 1;
+                objects.push_back({obj_start, obj_end - obj_start});
+                obj_start = obj_end + 1; // skip the newline
+            }
+
+            p++;
+        }
+    }
+
+    typedef struct JSONIndexHeader {
+        char magic[8];
+        uint64_t file_size;
+        int64_t mtime_ns;
+        uint64_t num_objects;
+    } JSONIndexHeader;
+
+    bool load_index() {
+        std::ifstream f_index(index_filename, std::ios::binary);
+        if(!f_index.is_open())
+            return false;
+
+        JSONIndexHeader header;
+        if(!f_index.read((char*) &header, sizeof(header)) || memcmp(header.magic, JSON_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+                header.file_size != size || header.mtime_ns != mtime_ns || header.num_objects > size)
+            return false;
+
+        objects.resize(header.num_objects);
+        if(!f_index.read((char*) objects.data(), objects.size()*sizeof(JSONObjectRef))) {
+            objects.clear();
+            return false;
+        }
+
+        for(auto& obj : objects) {
+            if(obj.offset + obj.size > size) {
+                objects.clear();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // writes to a temporary file first so that concurrent runs never read a partially written index
+    void save_index() const {
+        std::string tmp_filename = index_filename + ".tmp." + std::to_string(getpid());
+
+        JSONIndexHeader header;
+        memcpy(header.magic, JSON_INDEX_MAGIC, sizeof(header.magic));
+        header.file_size = size;
+        header.mtime_ns = mtime_ns;
+        header.num_objects = objects.size();
+
+        {
+            std::ofstream f_index(tmp_filename, std::ios::binary);
+            if(!f_index.is_open())
+                return;
+
+            f_index.write((const char*) &header, sizeof(header));
+            f_index.write((const char*) objects.data(), objects.size()*sizeof(JSONObjectRef));
+            if(!f_index.good()) {
+                f_index.close();
+                unlink(tmp_filename.c_str());
+                return;
+            }
+        }
+
+        if(rename(tmp_filename.c_str(), index_filename.c_str()) != 0)
+            unlink(tmp_filename.c_str());
+    }
+};
+
+#endif // JSON_OBJECT_FILE_H
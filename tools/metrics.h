@@ -0,0 +1,237 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+// Live metrics of a running tool. The tools and the SoftMC helpers update the counters, which are cheap atomic increments,
+// and a background thread periodically writes them to a file in the Prometheus text exposition format (e.g., for the textfile
+// collector of node_exporter) and as JSON. The files are replaced atomically, so a scraper never reads a partially written file.
+
+#define METRICS_EXPORT_INTERVAL_MS 5000
+
+typedef struct ToolMetrics {
+    std::atomic<uint64_t> rows_tested{0};
+    std::atomic<uint64_t> acts_issued{0}; // the hammers the tools issue, i.e., not counting the ACTs to initialize or read rows
+    std::atomic<uint64_t> pcie_bytes_received{0};
+    std::atomic<uint64_t> programs_executed{0};
+    std::atomic<uint64_t> program_generation_ns{0}; // from creating a SoftMCProgram until it is lowered
+
+    // the progress of the progress bar that was displayed last
+    std::atomic<uint64_t> progress_done{0};
+    std::atomic<uint64_t> progress_total{0};
+    std::atomic<int64_t> progress_start_ns{0}; // steady_clock time since epoch
+} ToolMetrics;
+
+ToolMetrics tool_metrics;
+
+void metrics_progress(const uint64_t done, const uint64_t total, const std::chrono::steady_clock::time_point start) {
+    tool_metrics.progress_done = done;
+    tool_metrics.progress_total = total;
+    tool_metrics.progress_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+}
+
+typedef struct MetricsSnapshot {
+    uint64_t rows_tested;
+    uint64_t acts_issued;
+    uint64_t pcie_bytes_received;
+    uint64_t programs_executed;
+    double program_generation_s;
+    double elapsed_s;
+    double rows_per_s; // over the last export interval
+    double acts_per_s;
+    double pcie_bytes_per_s;
+    double progress; // 0 to 1
+    double eta_s; // -1 when unknown
+} MetricsSnapshot;
+
+class MetricsExporter {
+
+public:
+    MetricsExporter() : running(false) {}
+
+    ~MetricsExporter() {
+        stop();
+    }
+
+    // Resets the counters and starts writing them to filename (Prometheus) and to filename with a .json extension every interval_ms.
+    // Returns an empty string on success, and a description of the problem otherwise
+    std::string start(const std::string& filename, const std::string& tool_name, const uint interval_ms = METRICS_EXPORT_INTERVAL_MS) {
+        stop();
+
+        prom_filename = filename;
+        json_filename = filename;
+        size_t ext = json_filename.rfind(".prom");
+        if(ext != std::string::npos && ext == json_filename.size() - 5)
+            json_filename.erase(ext);
+        json_filename += ".json";
+
+        tool = tool_name;
+
+        tool_metrics.rows_tested = 0;
+        tool_metrics.acts_issued = 0;
+        tool_metrics.pcie_bytes_received = 0;
+        tool_metrics.programs_executed = 0;
+        tool_metrics.program_generation_ns = 0;
+        tool_metrics.progress_done = 0;
+        tool_metrics.progress_total = 0;
+
+        start_time = last_time = std::chrono::steady_clock::now();
+        last_rows = last_acts = last_bytes = 0;
+
+        std::string error = write(true);
+        if(!error.empty())
+            return error;
+
+        running = true;
+        exporter = std::thread([this, interval_ms]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(running) {
+                if(cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return !running; }))
+                    break;
+
+                write(true); // a failed periodic write is retried at the next interval
+            }
+        });
+
+        return "";
+    }
+
+    // writes the final values, which report the tool as not running anymore
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!running)
+                return;
+            running = false;
+        }
+
+        cv.notify_all();
+        exporter.join();
+
+        write(false);
+    }
+
+private:
+    std::string prom_filename, json_filename, tool;
+    std::chrono::steady_clock::time_point start_time, last_time;
+    uint64_t last_rows, last_acts, last_bytes;
+
+    bool running;
+    std::thread exporter;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    MetricsSnapshot snapshot() {
+        MetricsSnapshot s;
+        auto now = std::chrono::steady_clock::now();
+
+        s.rows_tested = tool_metrics.rows_tested;
+        s.acts_issued = tool_metrics.acts_issued;
+        s.pcie_bytes_received = tool_metrics.pcie_bytes_received;
+        s.programs_executed = tool_metrics.programs_executed;
+        s.program_generation_s = tool_metrics.program_generation_ns/1e9;
+        s.elapsed_s = std::chrono::duration<double>(now - start_time).count();
+
+        double interval_s = std::chrono::duration<double>(now - last_time).count();
+        s.rows_per_s = interval_s > 0 ? (s.rows_tested - last_rows)/interval_s : 0;
+        s.acts_per_s = interval_s > 0 ? (s.acts_issued - last_acts)/interval_s : 0;
+        s.pcie_bytes_per_s = interval_s > 0 ? (s.pcie_bytes_received - last_bytes)/interval_s : 0;
+
+        last_time = now;
+        last_rows = s.rows_tested;
+        last_acts = s.acts_issued;
+        last_bytes = s.pcie_bytes_received;
+
+        uint64_t done = tool_metrics.progress_done, total = tool_metrics.progress_total;
+        s.progress = total > 0 ? std::min(1.0, (double)done/total) : 0;
+        s.eta_s = -1;
+        if(done > 0 && total >= done) {
+            double progress_s = (std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() - tool_metrics.progress_start_ns)/1e9;
+            s.eta_s = progress_s*(total - done)/done;
+        }
+
+        return s;
+    }
+
+    std::string to_prometheus(const MetricsSnapshot& s, const bool is_running) const {
+        std::stringstream ss;
+        std::string labels = "{tool=\"" + tool + "\"}";
+
+        auto metric = [&](const std::string& name, const std::string& type, const std::string& help, const double value) {
+            ss << "# HELP utrr_" << name << " " << help << std::endl;
+            ss << "# TYPE utrr_" << name << " " << type << std::endl;
+            ss << "utrr_" << name << labels << " " << value << std::endl;
+        };
+
+        ss.precision(15);
+        metric("running", "gauge", "1 while the tool is running.", is_running ? 1 : 0);
+        metric("elapsed_seconds", "gauge", "Time since the tool started.", s.elapsed_s);
+        metric("rows_tested_total", "counter", "Rows tested.", s.rows_tested);
+        metric("rows_per_second", "gauge", "Rows tested per second over the last export interval.", s.rows_per_s);
+        metric("acts_issued_total", "counter", "ACT commands issued to hammer rows.", s.acts_issued);
+        metric("acts_per_second", "gauge", "ACT commands issued per second over the last export interval.", s.acts_per_s);
+        metric("pcie_received_bytes_total", "counter", "Bytes received from the FPGA over PCIe.", s.pcie_bytes_received);
+        metric("pcie_received_bytes_per_second", "gauge", "Bytes received per second over the last export interval.", s.pcie_bytes_per_s);
+        metric("programs_executed_total", "counter", "SoftMC programs executed.", s.programs_executed);
+        metric("program_generation_seconds_total", "counter", "Time spent generating and lowering SoftMC programs.", s.program_generation_s);
+        metric("progress_ratio", "gauge", "Progress of the current progress bar.", s.progress);
+        metric("eta_seconds", "gauge", "Estimated time until the current progress bar completes, -1 when unknown.", s.eta_s);
+
+        return ss.str();
+    }
+
+    std::string to_json(const MetricsSnapshot& s, const bool is_running) const {
+        std::stringstream ss;
+        ss.precision(15);
+
+        ss << "{\"tool\":\"" << tool << "\",\"running\":" << (is_running ? "true" : "false") << ",\"elapsed_seconds\":" << s.elapsed_s
+            << ",\"rows_tested\":" << s.rows_tested << ",\"rows_per_second\":" << s.rows_per_s
+            << ",\"acts_issued\":" << s.acts_issued << ",\"acts_per_second\":" << s.acts_per_s
+            << ",\"pcie_received_bytes\":" << s.pcie_bytes_received << ",\"pcie_received_bytes_per_second\":" << s.pcie_bytes_per_s
+            << ",\"programs_executed\":" << s.programs_executed << ",\"program_generation_seconds\":" << s.program_generation_s
+            << ",\"progress\":" << s.progress << ",\"eta_seconds\":" << s.eta_s << "}" << std::endl;
+
+        return ss.str();
+    }
+
+    static std::string write_atomically(const std::string& filename, const std::string& contents) {
+        std::string tmp_filename = filename + ".tmp";
+
+        {
+            std::ofstream out(tmp_filename);
+            if(!out.is_open())
+                return "cannot open " + tmp_filename;
+
+            out << contents;
+            if(!out.good())
+                return "cannot write to " + tmp_filename;
+        }
+
+        if(std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+            return "cannot rename " + tmp_filename + " to " + filename;
+
+        return "";
+    }
+
+    std::string write(const bool is_running) {
+        MetricsSnapshot s = snapshot();
+
+        std::string error = write_atomically(prom_filename, to_prometheus(s, is_running));
+        if(error.empty())
+            error = write_atomically(json_filename, to_json(s, is_running));
+
+        return error;
+    }
+};
+
+#endif // METRICS_H
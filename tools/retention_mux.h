@@ -0,0 +1,269 @@
+#ifndef RETENTION_MUX_H
+#define RETENTION_MUX_H
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "tools/softmc_utils.h"
+
+// Retention-wait multiplexing: independent experiments run in separate threads and share the board such that the phases of one
+// experiment that use the board (e.g., initializing, hammering, and reading rows) run while the other experiments wait for the
+// retention time of their rows. Each experiment runs its iterations as:
+//   mux.begin_iteration(exp); // holds the board when it returns
+//   ... run programs ...
+//   mux.wait(exp, ms);        // instead of waitMS(ms): releases the board for ms and takes it back
+//   ... run programs ...
+//   mux.end_iteration(exp);   // releases the board, returns how late the iteration took the board back after its waits
+//
+// An iteration only starts when none of its board phases would overlap a board phase of the iterations in progress, so the board is
+// free whenever a wait ends and each wait takes as long as it would when the experiment runs alone. The board phases of an iteration
+// are predicted from the iterations that already finished: the first iteration runs alone, and afterwards phase k of an iteration is
+// expected between the earliest start and the latest end that phase k had so far (relative to the start of its iteration), widened
+// by margin_ms. The experiments should therefore have the same timeline, e.g., the same retention time and number of rows.
+//
+// The prediction can be wrong, e.g., when a phase takes longer than it ever did, and a wait then ends while another experiment holds
+// the board. The wait takes longer than requested, i.e., the rows of the iteration are left without refresh for longer than when the
+// experiment runs alone. end_iteration() returns the longest such overrun of the iteration so that the caller can run the iteration
+// again or flag its results.
+//
+// Only the timing of the waits is kept. The commands of the other experiments still reach the DRAM during a wait, so the experiments
+// must not interfere with each other's rows, e.g., they should use different banks or rows far apart in a bank, and must not issue
+// commands that affect the rows of all banks: a REF refreshes every bank, and REFs and hammers drive the TRR mechanism of the chip,
+// which is shared by all banks. TRRAnalyzer therefore multiplexes only experiments that neither hammer nor refresh, i.e., retention
+// experiments.
+
+#define DEFAULT_MUX_MARGIN_MS 5
+// waits that end at most this late count as on time, e.g., the scheduling latency of the thread
+#define DEFAULT_MUX_LATE_TOLERANCE_MS 1.0
+
+typedef std::chrono::steady_clock mux_clock;
+
+typedef struct MuxPhase {
+    double min_start_ms; // relative to the start of the iteration
+    double max_start_ms;
+    double max_duration_ms;
+} MuxPhase;
+
+typedef struct MuxStats {
+    uint64_t num_iterations = 0;
+    double board_busy_ms = 0;
+    uint64_t num_late_phases = 0; // the phases that could not take the board within the tolerance after their wait
+    uint64_t num_late_iterations = 0; // the iterations with a late phase
+    double max_late_ms = 0;
+} MuxStats;
+
+class RetentionMux {
+
+public:
+    RetentionMux(const uint num_experiments, const double margin_ms = DEFAULT_MUX_MARGIN_MS,
+            const double late_tolerance_ms = DEFAULT_MUX_LATE_TOLERANCE_MS) :
+            experiments(num_experiments), margin_ms(margin_ms), late_tolerance_ms(late_tolerance_ms), board_busy(false),
+            t_created(mux_clock::now()) {}
+
+    RetentionMux(const RetentionMux&) = delete;
+    RetentionMux& operator=(const RetentionMux&) = delete;
+
+    // blocks until the experiment can start an iteration without delaying the other experiments, then takes the board
+    void begin_iteration(const uint exp) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        MuxExperiment& e = experiments[exp];
+        e.pending = true;
+
+        // the condition depends on the time, so it is checked again at least every millisecond
+        while(!can_begin(exp, mux_clock::now()))
+            cv.wait_for(lock, std::chrono::milliseconds(1));
+
+        e.pending = false;
+        e.active = true;
+        e.late_ms = 0;
+        e.t_start = mux_clock::now();
+        e.phases.clear();
+        e.phases.push_back(std::make_pair(0.0, 0.0));
+        board_busy = true;
+    }
+
+    // waits for ms (exactly as waitMS()) while the other experiments use the board
+    void wait(const uint exp, const uint ms) {
+        MuxExperiment& e = experiments[exp];
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            end_phase(e);
+            e.t_wait_end = mux_clock::now() + std::chrono::milliseconds(ms);
+            e.waiting = true;
+            board_busy = false;
+        }
+        cv.notify_all();
+
+        waitMS(ms);
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto t_wait_done = mux_clock::now();
+        cv.wait(lock, [this]() { return !board_busy; });
+
+        double late_ms = ms_between(t_wait_done, mux_clock::now());
+        e.late_ms = std::max(e.late_ms, late_ms);
+        if(late_ms > late_tolerance_ms) {
+            stats.num_late_phases++;
+            stats.max_late_ms = std::max(stats.max_late_ms, late_ms);
+        }
+
+        e.waiting = false;
+        e.phases.push_back(std::make_pair(ms_between(e.t_start, mux_clock::now()), 0.0));
+        board_busy = true;
+    }
+
+    // returns how much later than requested (ms) the longest wait of the iteration ended, 0 if all ended within the tolerance
+    double end_iteration(const uint exp) {
+        MuxExperiment& e = experiments[exp];
+        double late_ms = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            end_phase(e);
+            update_profile(e);
+
+            e.active = false;
+            e.num_iterations++;
+            stats.num_iterations++;
+            board_busy = false;
+
+            if(e.late_ms > late_tolerance_ms) {
+                stats.num_late_iterations++;
+                late_ms = e.late_ms;
+            }
+        }
+        cv.notify_all();
+
+        return late_ms;
+    }
+
+    MuxStats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    void print_stats() {
+        MuxStats s = get_stats();
+        double elapsed_ms = ms_between(t_created, mux_clock::now());
+
+        std::cout << "Retention-wait multiplexing: " << experiments.size() << " experiments, " << s.num_iterations << " iterations in "
+            << std::fixed << std::setprecision(2) << elapsed_ms/1000.0 << " s, board busy " << (elapsed_ms > 0 ? 100.0*s.board_busy_ms/elapsed_ms : 0.0)
+            << "% of the time, " << s.num_late_phases << " phases of " << s.num_late_iterations << " iterations started late (at most "
+            << s.max_late_ms << " ms)" << std::endl;
+        std::cout.unsetf(std::ios_base::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
+private:
+    typedef struct MuxExperiment {
+        bool pending = false; // waits to begin an iteration
+        bool active = false;
+        bool waiting = false;
+        uint64_t num_iterations = 0;
+        double late_ms = 0; // the longest overrun of a wait in the current iteration
+        mux_clock::time_point t_start;
+        mux_clock::time_point t_wait_end;
+        std::vector<std::pair<double, double>> phases; // start and end of each board phase of the current iteration (ms, relative to t_start)
+    } MuxExperiment;
+
+    std::vector<MuxExperiment> experiments;
+    std::vector<MuxPhase> profile;
+    const double margin_ms;
+    const double late_tolerance_ms;
+    bool board_busy;
+
+    const mux_clock::time_point t_created;
+    MuxStats stats;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    static double ms_between(const mux_clock::time_point from, const mux_clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    void end_phase(MuxExperiment& e) {
+        auto& phase = e.phases.back();
+        phase.second = ms_between(e.t_start, mux_clock::now());
+        stats.board_busy_ms += phase.second - phase.first;
+    }
+
+    void update_profile(const MuxExperiment& e) {
+        for(uint k = 0; k < e.phases.size(); k++) {
+            double start = e.phases[k].first, duration = e.phases[k].second - e.phases[k].first;
+
+            if(k == profile.size()) {
+                profile.push_back(MuxPhase{start, start, duration});
+                continue;
+            }
+
+            profile[k].min_start_ms = std::min(profile[k].min_start_ms, start);
+            profile[k].max_start_ms = std::max(profile[k].max_start_ms, start);
+            profile[k].max_duration_ms = std::max(profile[k].max_duration_ms, duration);
+        }
+    }
+
+    // the time in which phase k of an iteration that started at t_start is expected to hold the board (ms, relative to now)
+    std::pair<double, double> phase_window(const mux_clock::time_point t_start, const uint k, const mux_clock::time_point now) const {
+        double start = ms_between(now, t_start);
+        return std::make_pair(start + profile[k].min_start_ms, start + profile[k].max_start_ms + profile[k].max_duration_ms);
+    }
+
+    bool can_begin(const uint exp, const mux_clock::time_point now) const {
+        if(board_busy)
+            return false;
+
+        // the experiments take turns, e.g., an experiment does not start its next iteration before the others started theirs
+        for(uint i = 0; i < experiments.size(); i++) {
+            const MuxExperiment& other = experiments[i];
+            if(i != exp && other.pending && (other.num_iterations < experiments[exp].num_iterations ||
+                    (other.num_iterations == experiments[exp].num_iterations && i < exp)))
+                return false;
+        }
+
+        bool any_active = std::any_of(experiments.begin(), experiments.end(), [](const MuxExperiment& other) { return other.active; });
+        if(!any_active)
+            return true;
+
+        if(profile.empty()) // the first iteration runs alone to measure the phases
+            return false;
+
+        for(uint k = 0; k < profile.size(); k++) {
+            auto new_window = phase_window(now, k, now);
+            new_window.first -= margin_ms;
+            new_window.second += margin_ms;
+
+            for(const MuxExperiment& other : experiments) {
+                if(!other.active)
+                    continue;
+
+                // the board phases other did not start yet. The start of the next one is known once other waits for it
+                for(uint j = other.phases.size(); j < profile.size(); j++) {
+                    auto window = phase_window(other.t_start, j, now);
+                    if(j == other.phases.size() && other.waiting) {
+                        double wait_end = ms_between(now, other.t_wait_end);
+                        window = std::make_pair(std::min(window.first, wait_end), std::max(window.second, wait_end + profile[j].max_duration_ms));
+                    }
+
+                    if(new_window.first < window.second && window.first < new_window.second)
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif // RETENTION_MUX_H
@@ -0,0 +1,105 @@
+#ifndef ROW_GROUP_PIPELINE_H
+#define ROW_GROUP_PIPELINE_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// In pipeline mode (see Pipeline/), RowScout and TRR Analyzer run in the same process. RowScout pushes every row group it verifies to a
+// RowGroupQueue, serialized exactly as it writes the row group to its output file, and TRR Analyzer picks row groups from the queue as
+// they arrive instead of parsing a finished RowScout file. Since the row groups arrive in file order, their positions in the queue are
+// their indices in the RowScout file, e.g., for --row_group_indices in a later run.
+//
+// Both tools use the same board, so they take turns by holding board_mutex() while they run SoftMC programs: RowScout for each row batch
+// it profiles, and TRR Analyzer for each hammerability check and, once it has enough row groups, for the rest of the experiment.
+
+class RowGroupQueue {
+
+public:
+    RowGroupQueue() : num_pushed(0), closed(false), stop_requested(false) {}
+
+    // called by the producer (RowScout) for every verified row group
+    void push(const std::string& s_wrs) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            row_groups.push_back(s_wrs);
+            num_pushed++;
+        }
+
+        cv.notify_all();
+    }
+
+    // called when the producer exits. pop() returns false once the queue is drained afterwards
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+
+        cv.notify_all();
+    }
+
+    // Blocks until a row group is available. Returns false if the producer exited and all row groups were popped.
+    // index is set to the position of the row group in the producer's output
+    bool pop(std::string& s_wrs, uint& index) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return !row_groups.empty() || closed; });
+
+        if(row_groups.empty())
+            return false;
+
+        s_wrs = row_groups.front();
+        row_groups.pop_front();
+        index = num_pushed - row_groups.size() - 1;
+
+        return true;
+    }
+
+    // called by the consumer (TRR Analyzer) once it has all row groups it needs. The producer stops at its next check
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop_requested = true;
+    }
+
+    bool stopped() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stop_requested;
+    }
+
+    std::mutex& board_mutex() {
+        return board;
+    }
+
+private:
+    std::deque<std::string> row_groups;
+    uint num_pushed;
+    bool closed;
+    bool stop_requested;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::mutex board;
+};
+
+// set by the Pipeline through the hook below. nullptr when the tool runs standalone or as an ExperimentServer job
+RowGroupQueue* row_group_queue = nullptr;
+
+// holds the board for the tool when running in pipeline mode, does nothing otherwise
+std::unique_lock<std::mutex> pipeline_board_lock() {
+    return row_group_queue != nullptr ? std::unique_lock<std::mutex>(row_group_queue->board_mutex()) : std::unique_lock<std::mutex>();
+}
+
+typedef void (*UTRRSetRowGroupQueueFn)(RowGroupQueue* queue);
+
+#define UTRR_SET_ROW_GROUP_QUEUE_SYMBOL "utrr_set_row_group_queue"
+
+// exported by the tool libraries (see UTRR_TOOL_MAIN) next to utrr_tool_main
+#ifdef UTRR_TOOL_LIBRARY
+#define UTRR_ROW_GROUP_QUEUE_HOOK() \
+    extern "C" void utrr_set_row_group_queue(RowGroupQueue* queue) { row_group_queue = queue; }
+#else
+#define UTRR_ROW_GROUP_QUEUE_HOOK()
+#endif
+
+#endif // ROW_GROUP_PIPELINE_H
@@ -0,0 +1,272 @@
+#ifndef ROW_MAPPING_H
+#define ROW_MAPPING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <cassert>
+
+// Logical-to-physical row address mapping.
+//
+// Each bit of a physical row address is the XOR of one or more bits of the logical row address. This covers bit permutations
+// (a physical bit that equals a single logical bit) as well as the XOR-based remappings DRAM vendors use. E.g., Samsung chips
+// invert bits 1 and 2 of the row address when bit 3 is set, i.e., p1 = l1 ^ l3 and p2 = l2 ^ l3.
+//
+// Mapping files describe a mapping with one line per remapped physical bit. Bits that are not listed are not remapped:
+//   # comment
+//   name samsung
+//   p1 = l1 ^ l3
+//   p2 = l2 ^ l3
+
+#define ROW_MAPPING_BITS 32
+
+typedef struct RowMapping {
+    std::string name;
+    std::vector<uint32_t> phys_bit_masks; // phys_bit_masks[i] has the logical bits whose XOR is physical bit i
+} RowMapping;
+
+RowMapping identity_row_mapping(const std::string& name = "sequential") {
+    RowMapping mapping;
+    mapping.name = name;
+
+    for(uint i = 0; i < ROW_MAPPING_BITS; i++)
+        mapping.phys_bit_masks.push_back(1u << i);
+
+    return mapping;
+}
+
+uint32_t map_row_id(const RowMapping& mapping, const uint32_t row_id) {
+    uint32_t mapped = 0;
+
+    for(uint i = 0; i < ROW_MAPPING_BITS; i++)
+        mapped |= (uint32_t)(__builtin_popcount(row_id & mapping.phys_bit_masks[i]) & 1) << i;
+
+    return mapped;
+}
+
+// Computes the mapping from physical to logical row addresses by inverting the bit matrix over GF(2).
+// Returns an empty string on success, and a description of the problem otherwise
+std::string invert_row_mapping(const RowMapping& mapping, RowMapping& inverse) {
+    std::vector<uint32_t> rows = mapping.phys_bit_masks;
+    inverse = identity_row_mapping(mapping.name + " (inverse)");
+    std::vector<uint32_t>& inv = inverse.phys_bit_masks;
+
+    // Gauss-Jordan elimination on [rows | inv]
+    for(uint col = 0; col < ROW_MAPPING_BITS; col++) {
+        uint pivot = col;
+        while(pivot < ROW_MAPPING_BITS && !(rows[pivot] & (1u << col)))
+            pivot++;
+
+        if(pivot == ROW_MAPPING_BITS)
+            return "the mapping is not invertible, i.e., multiple logical rows map to the same physical row";
+
+        std::swap(rows[col], rows[pivot]);
+        std::swap(inv[col], inv[pivot]);
+
+        for(uint r = 0; r < ROW_MAPPING_BITS; r++) {
+            if(r != col && (rows[r] & (1u << col))) {
+                rows[r] ^= rows[col];
+                inv[r] ^= inv[col];
+            }
+        }
+    }
+
+    return "";
+}
+
+std::string row_mapping_to_string(const RowMapping& mapping) {
+    std::stringstream ss;
+
+    if(!mapping.name.empty())
+        ss << "name " << mapping.name << std::endl;
+
+    for(uint i = 0; i < ROW_MAPPING_BITS; i++) {
+        if(mapping.phys_bit_masks[i] == (1u << i))
+            continue;
+
+        ss << "p" << i << " =";
+        bool first = true;
+        for(uint j = 0; j < ROW_MAPPING_BITS; j++) {
+            if(mapping.phys_bit_masks[i] & (1u << j)) {
+                ss << (first ? " l" : " ^ l") << j;
+                first = false;
+            }
+        }
+        ss << std::endl;
+    }
+
+    return ss.str();
+}
+
+// parses a mapping file. Returns an empty string on success, and a description of the problem otherwise
+std::string parse_row_mapping(std::istream& is, RowMapping& mapping) {
+    mapping = identity_row_mapping("");
+
+    std::string line;
+    uint line_no = 0;
+    while(std::getline(is, line)) {
+        line_no++;
+        std::string s_line = "line " + std::to_string(line_no) + ": ";
+
+        size_t comment = line.find('#');
+        if(comment != std::string::npos)
+            line = line.substr(0, comment);
+
+        std::stringstream ss(line);
+        std::string token;
+        if(!(ss >> token))
+            continue; // empty line
+
+        if(token == "name") {
+            std::getline(ss >> std::ws, mapping.name);
+            continue;
+        }
+
+        uint phys_bit;
+        if(token.size() < 2 || token[0] != 'p' || !(std::stringstream(token.substr(1)) >> phys_bit) || phys_bit >= ROW_MAPPING_BITS)
+            return s_line + "expected p<bit> = l<bit> [^ l<bit> ...], got \"" + token + "\"";
+
+        if(!(ss >> token) || token != "=")
+            return s_line + "missing '=' after p" + std::to_string(phys_bit);
+
+        uint32_t mask = 0;
+        do {
+            uint log_bit;
+            if(!(ss >> token) || token.size() < 2 || token[0] != 'l' || !(std::stringstream(token.substr(1)) >> log_bit) || log_bit >= ROW_MAPPING_BITS)
+                return s_line + "expected l<bit> with bit < " + std::to_string(ROW_MAPPING_BITS);
+
+            mask ^= 1u << log_bit;
+        } while(ss >> token && token == "^");
+
+        if(mask == 0)
+            return s_line + "physical bit " + std::to_string(phys_bit) + " is always zero";
+
+        mapping.phys_bit_masks[phys_bit] = mask;
+    }
+
+    RowMapping inverse;
+    return invert_row_mapping(mapping, inverse);
+}
+
+std::string load_row_mapping(const std::string& filename, RowMapping& mapping) {
+    std::ifstream is(filename);
+    if(!is.is_open())
+        return "cannot open " + filename;
+
+    std::string error = parse_row_mapping(is, mapping);
+    return error.empty() ? "" : filename + ": " + error;
+}
+
+std::string save_row_mapping(const std::string& filename, const RowMapping& mapping) {
+    std::ofstream os(filename);
+    if(!os.is_open())
+        return "cannot open " + filename;
+
+    os << row_mapping_to_string(mapping);
+    return os.good() ? "" : "cannot write to " + filename;
+}
+
+// Finds the mapping of the low-order num_bits bits of the row address that places the most of the observed neighbour pairs (pairs of
+// logical row IDs that are known to be physically adjacent) next to each other. The other bits are not remapped. Among the mappings
+// that explain the same number of pairs, the one with the fewest XOR terms wins. num_adjacent is set to the number of pairs the
+// returned mapping places next to each other
+RowMapping fit_row_mapping(const std::vector<std::pair<uint32_t, uint32_t>>& neighbour_pairs, const uint num_bits, uint& num_adjacent) {
+    assert(num_bits > 0 && num_bits <= 5 && "the search space grows as (2^num_bits)^num_bits");
+
+    const uint32_t num_masks = 1u << num_bits;
+
+    RowMapping candidate = identity_row_mapping("discovered");
+    RowMapping best = candidate;
+    uint best_terms = num_bits;
+    num_adjacent = 0;
+    for(auto& pair : neighbour_pairs) {
+        int dist = (int)pair.first - (int)pair.second;
+        num_adjacent += (dist == 1 || dist == -1);
+    }
+
+    // enumerates every combination of non-zero masks for the low-order bits
+    std::vector<uint32_t> masks(num_bits, 1);
+    RowMapping inverse;
+    while(true) {
+        uint terms = 0;
+        for(uint i = 0; i < num_bits; i++) {
+            candidate.phys_bit_masks[i] = masks[i];
+            terms += __builtin_popcount(masks[i]);
+        }
+
+        if(invert_row_mapping(candidate, inverse).empty()) {
+            uint adjacent = 0;
+            for(auto& pair : neighbour_pairs) {
+                int dist = (int)map_row_id(candidate, pair.first) - (int)map_row_id(candidate, pair.second);
+                adjacent += (dist == 1 || dist == -1);
+            }
+
+            if(adjacent > num_adjacent || (adjacent == num_adjacent && terms < best_terms)) {
+                best = candidate;
+                best_terms = terms;
+                num_adjacent = adjacent;
+            }
+        }
+
+        uint i = 0;
+        while(i < num_bits && ++masks[i] == num_masks)
+            masks[i++] = 1;
+
+        if(i == num_bits)
+            break;
+    }
+
+    return best;
+}
+
+// Dense forward and inverse tables of a mapping for the rows of a bank. Row IDs outside the bank are mapped bit by bit
+class RowMappingTable {
+
+public:
+    RowMappingTable() : mapping(identity_row_mapping()), inverse(identity_row_mapping()) {}
+
+    // Returns an empty string on success, and a description of the problem otherwise. The table does not change on failure
+    std::string build(const RowMapping& new_mapping, const uint32_t num_rows) {
+        RowMapping new_inverse;
+        std::string error = invert_row_mapping(new_mapping, new_inverse);
+        if(!error.empty())
+            return error;
+
+        std::vector<uint32_t> new_fwd(num_rows), new_inv(num_rows, num_rows);
+        for(uint32_t row_id = 0; row_id < num_rows; row_id++) {
+            uint32_t phys = map_row_id(new_mapping, row_id);
+            if(phys >= num_rows)
+                return "logical row " + std::to_string(row_id) + " maps to physical row " + std::to_string(phys) + " outside the bank";
+
+            new_fwd[row_id] = phys;
+            new_inv[phys] = row_id;
+        }
+
+        mapping = new_mapping;
+        inverse = new_inverse;
+        fwd.swap(new_fwd);
+        inv.swap(new_inv);
+
+        return "";
+    }
+
+    uint32_t to_physical(const uint32_t row_id) const {
+        return row_id < fwd.size() ? fwd[row_id] : map_row_id(mapping, row_id);
+    }
+
+    uint32_t to_logical(const uint32_t row_id) const {
+        return row_id < inv.size() ? inv[row_id] : map_row_id(inverse, row_id);
+    }
+
+    const RowMapping& get_mapping() const {
+        return mapping;
+    }
+
+private:
+    RowMapping mapping, inverse;
+    std::vector<uint32_t> fwd, inv;
+};
+
+#endif // ROW_MAPPING_H
@@ -0,0 +1,124 @@
+#ifndef SHARD_QUEUE_H
+#define SHARD_QUEUE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+
+// The shards of a campaign that runs on several boards (see Orchestrator/). Each board has its own deque of shards and takes shards from
+// its front. A board whose deque is empty steals from the back of the deque of the board with the most remaining shards that has a shard
+// the board can run, so the boards that finish early help the ones that are behind instead of idling until the campaign ends. A shard
+// can run on the boards listed in its eligible_boards, e.g., only the board that holds the module the shard tests, so that stealing
+// never changes the device under test.
+
+typedef struct Shard {
+    uint job_ind;
+    uint shard_ind;
+    std::vector<std::string> args; // added to the arguments of the job
+    std::vector<uint> eligible_boards;
+} Shard;
+
+class ShardQueue {
+
+public:
+    ShardQueue(const uint num_boards) : deques(num_boards), retired(num_boards, false) {}
+
+    // queues shard on the eligible board with the fewest queued shards. Returns false if none of its boards can take it
+    bool push(const Shard& shard) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return push_balanced(shard);
+    }
+
+    // Takes the next shard of board. stolen is set if the shard was queued on another board. Returns false if no shard is left that
+    // the board can run, after which the board does not get any more shards
+    bool next(const uint board, Shard& shard, bool& stolen) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!deques[board].empty()) {
+            shard = deques[board].front();
+            deques[board].pop_front();
+            stolen = false;
+            return true;
+        }
+
+        // the victim is the board with the most remaining shards that has a shard this board can run
+        int victim = -1;
+        for(uint b = 0; b < deques.size(); b++) {
+            if(b == board || !has_eligible(b, board))
+                continue;
+
+            if(victim == -1 || deques[b].size() > deques[victim].size())
+                victim = b;
+        }
+
+        if(victim == -1) {
+            retired[board] = true;
+            return false;
+        }
+
+        auto& victim_deque = deques[victim];
+        for(auto it = victim_deque.rbegin(); it != victim_deque.rend(); it++) {
+            if(is_eligible(*it, board)) {
+                shard = *it;
+                victim_deque.erase(std::next(it).base());
+                stolen = true;
+                return true;
+            }
+        }
+
+        retired[board] = true;
+        return false;
+    }
+
+    // Takes board out of the campaign, e.g., when its ExperimentServer does not respond. Its queued shards move to the other boards.
+    // Returns the shards that no other board can run
+    std::vector<Shard> retire(const uint board) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        retired[board] = true;
+
+        std::vector<Shard> orphans;
+        std::deque<Shard> shards;
+        shards.swap(deques[board]);
+        for(auto& shard : shards) {
+            if(!push_balanced(shard))
+                orphans.push_back(shard);
+        }
+
+        return orphans;
+    }
+
+private:
+    std::vector<std::deque<Shard>> deques;
+    std::vector<bool> retired;
+    std::mutex mutex;
+
+    bool is_eligible(const Shard& shard, const uint board) const {
+        return !retired[board] && std::find(shard.eligible_boards.begin(), shard.eligible_boards.end(), board) != shard.eligible_boards.end();
+    }
+
+    bool has_eligible(const uint victim, const uint board) const {
+        return std::any_of(deques[victim].begin(), deques[victim].end(), [&](const Shard& shard) { return is_eligible(shard, board); });
+    }
+
+    bool push_balanced(const Shard& shard) {
+        int target = -1;
+        for(uint b : shard.eligible_boards) {
+            if(b >= deques.size() || retired[b])
+                continue;
+
+            if(target == -1 || deques[b].size() < deques[target].size())
+                target = b;
+        }
+
+        if(target == -1)
+            return false;
+
+        deques[target].push_back(shard);
+        return true;
+    }
+};
+
+#endif // SHARD_QUEUE_H
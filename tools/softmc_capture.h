@@ -0,0 +1,372 @@
+#ifndef SOFTMC_CAPTURE_H
+#define SOFTMC_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include "tools/softmc_program.h"
+
+// Record/replay of everything a tool exchanges with the SoftMC board. When the UTRR_CAPTURE environment variable names a file, every
+// program the tool executes and every buffer it receives is appended to that file (see execute_program() and receive_data() in
+// tools/softmc_session.h). When UTRR_REPLAY names a capture file, the tool runs without a board: each program it generates is compared
+// with the captured one instead of being executed, receiving data returns the captured data, and waitMS() returns immediately, so the
+// unchanged tool logic runs as fast as the host allows. Replaying stops with an error at the first program that differs from the capture.
+//
+// A capture file starts with SOFTMC_CAPTURE_MAGIC, followed by one record per program or received buffer: a CaptureRecordHeader and
+// the zlib-compressed payload. Records are only appended and each one is flushed when it is written, so the capture of a tool that
+// crashed or was killed holds every record up to the last complete one. A program is captured as the nodes lower() writes to the
+// DRAM Bender Program (see serialize_softmc_nodes()), i.e., every instruction, label, and branch the board receives, bit for bit.
+//
+// The received data is replayed as a stream: a tool may receive the data of a program in differently sized chunks than the captured
+// tool did (e.g., with another --receive_chunk_rows), but not across the programs it executes.
+//
+// Each tool writes its own capture stream, <UTRR_CAPTURE>.<tool>, e.g., ./rowscout.cap.RowScout, and replays <UTRR_REPLAY>.<tool>
+// (see set_stream()). The tools of a Pipeline run in the same process but are loaded as separate libraries, each with its own
+// softmc_capture, so each of them records its own programs in the order it executes them. The ExperimentServer adds the job id
+// to the path, e.g., ./rowscout.cap.job3.RowScout. A stream must be driven by a single thread of the tool, e.g., TRRAnalyzer
+// refuses --num_experiments with a capture since the order in which its experiments use the board depends on the host's timing.
+//
+// A failed capture or replay throws a SoftMCCaptureException, which ends the tool with an error (see UTRR_TOOL_MAIN in
+// tools/softmc_session.h) without taking down the ExperimentServer or Pipeline process that runs it.
+
+#define SOFTMC_CAPTURE_MAGIC "UTRRCAP1"
+#define SOFTMC_CAPTURE_MAGIC_SIZE 8
+
+struct SoftMCCaptureException : public std::runtime_error {
+    SoftMCCaptureException(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+typedef enum SoftMCCaptureMode {
+    SOFTMC_CAPTURE_OFF,
+    SOFTMC_CAPTURE_RECORD,
+    SOFTMC_CAPTURE_REPLAY
+} SoftMCCaptureMode;
+
+typedef enum CaptureRecordType {
+    CAPTURE_PROGRAM = 1,
+    CAPTURE_RECEIVE = 2,
+    CAPTURE_DRAIN = 3 // data received while checking for leftover data (see drain_data())
+} CaptureRecordType;
+
+typedef struct CaptureRecordHeader {
+    uint32_t type;
+    int32_t ret; // what receiveData() returned
+    uint32_t size; // of the payload
+    uint32_t compressed_size;
+} CaptureRecordHeader;
+
+// the mode and the file come from the environment, so that standalone tools, ExperimentServer jobs, and Pipeline stages are captured alike
+SoftMCCaptureMode softmc_capture_mode() {
+    static const SoftMCCaptureMode mode = []() {
+        const char* replay = std::getenv("UTRR_REPLAY");
+        if(replay != nullptr && replay[0] != '\0')
+            return SOFTMC_CAPTURE_REPLAY;
+
+        const char* record = std::getenv("UTRR_CAPTURE");
+        if(record != nullptr && record[0] != '\0')
+            return SOFTMC_CAPTURE_RECORD;
+
+        return SOFTMC_CAPTURE_OFF;
+    }();
+
+    return mode;
+}
+
+bool softmc_replaying() {
+    return softmc_capture_mode() == SOFTMC_CAPTURE_REPLAY;
+}
+
+template<typename T>
+void capture_put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Appends the nodes in the order the board receives them. node_offsets gets the offset in out at which each node starts.
+// The registers an instruction modifies are not part of the program and are left out
+void serialize_softmc_nodes(const std::vector<SoftMCNode>& nodes, std::string& out, std::vector<size_t>& node_offsets) {
+    for(auto& node : nodes) {
+        node_offsets.push_back(out.size());
+        capture_put(out, (uint8_t) node.type);
+
+        switch(node.type) {
+            case SMC_NODE_INST:
+                capture_put(out, node.inst);
+                break;
+            case SMC_NODE_NOPS:
+            case SMC_NODE_SLEEP:
+                capture_put(out, node.count);
+                break;
+            case SMC_NODE_LABEL:
+                capture_put(out, (uint32_t) node.label.size());
+                out.append(node.label);
+                break;
+            case SMC_NODE_BRANCH:
+                capture_put(out, (int32_t) node.br_type);
+                capture_put(out, (int32_t) node.br_rs1);
+                capture_put(out, (int32_t) node.br_rs2);
+                capture_put(out, (uint32_t) node.label.size());
+                out.append(node.label);
+                break;
+            case SMC_NODE_LI:
+                capture_put(out, node.imm);
+                capture_put(out, (int32_t) node.rd);
+                break;
+            case SMC_NODE_ADDI:
+                capture_put(out, (int32_t) node.rs);
+                capture_put(out, node.imm);
+                capture_put(out, (int32_t) node.rd);
+                break;
+        }
+    }
+}
+
+typedef struct SoftMCCaptureStats {
+    uint64_t num_programs = 0;
+    uint64_t num_receives = 0;
+    uint64_t received_bytes = 0;
+    uint64_t file_bytes = 0; // written or read, including the headers
+} SoftMCCaptureStats;
+
+class SoftMCCapture {
+
+public:
+    SoftMCCapture() : file(nullptr), opened(false) {}
+
+    ~SoftMCCapture() {
+        if(file != nullptr)
+            std::fclose(file);
+    }
+
+    SoftMCCapture(const SoftMCCapture&) = delete;
+    SoftMCCapture& operator=(const SoftMCCapture&) = delete;
+
+    // names the stream of the tool, which is appended to the path of the capture file. Has no effect once the file is open
+    void set_stream(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stream = name;
+    }
+
+    void capture_program(const std::vector<SoftMCNode>& nodes) {
+        std::string payload;
+        std::vector<size_t> node_offsets;
+        serialize_softmc_nodes(nodes, payload, node_offsets);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        write_record(CAPTURE_PROGRAM, 0, payload.data(), payload.size());
+        stats.num_programs++;
+    }
+
+    void capture_data(const CaptureRecordType type, const int ret, const void* buf, const uint32_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        write_record(type, ret, buf, size);
+        stats.num_receives++;
+        stats.received_bytes += size;
+    }
+
+    // throws a SoftMCCaptureException if the program differs from the next captured one
+    void replay_program(const std::vector<SoftMCNode>& nodes) {
+        std::string payload;
+        std::vector<size_t> node_offsets;
+        serialize_softmc_nodes(nodes, payload, node_offsets);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(pending_offset < pending.size())
+            fail("program " + std::to_string(stats.num_programs) + " was generated before receiving all data of the previous one");
+
+        int ret;
+        std::string captured;
+        if(!read_record(CAPTURE_PROGRAM, ret, captured))
+            fail("the capture ended before program " + std::to_string(stats.num_programs));
+
+        if(captured != payload) {
+            size_t diff = 0;
+            while(diff < captured.size() && diff < payload.size() && captured[diff] == payload[diff])
+                diff++;
+
+            size_t node_ind = std::upper_bound(node_offsets.begin(), node_offsets.end(), diff) - node_offsets.begin();
+            fail("program " + std::to_string(stats.num_programs) + " differs from the captured one at node " +
+                    std::to_string(node_ind == 0 ? 0 : node_ind - 1) + " (" + std::to_string(nodes.size()) + " nodes generated, " +
+                    std::to_string(payload.size()) + " bytes vs. " + std::to_string(captured.size()) + " bytes captured)");
+        }
+
+        stats.num_programs++;
+    }
+
+    // copies the next 'size' bytes of captured data to buf
+    int replay_data(const CaptureRecordType type, void* buf, const uint32_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        int ret = 0;
+        if(type == CAPTURE_DRAIN) {
+            std::string captured;
+            if(!read_record(CAPTURE_DRAIN, ret, captured) || captured.size() != size)
+                fail("the capture does not have the leftover data the tool checks for after program " + std::to_string(stats.num_programs));
+
+            std::memcpy(buf, captured.data(), size);
+        } else {
+            uint32_t copied = 0;
+            while(copied < size) {
+                if(pending_offset == pending.size()) {
+                    pending_offset = 0;
+                    if(!read_record(CAPTURE_RECEIVE, pending_ret, pending))
+                        fail("the capture has less data than the tool receives after program " + std::to_string(stats.num_programs));
+                }
+
+                uint32_t n = std::min<uint64_t>(size - copied, pending.size() - pending_offset);
+                std::memcpy((char*) buf + copied, pending.data() + pending_offset, n);
+                copied += n;
+                pending_offset += n;
+            }
+
+            ret = pending_ret;
+        }
+
+        stats.num_receives++;
+        stats.received_bytes += size;
+        return ret;
+    }
+
+    void print_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!opened)
+            return;
+
+        double mib = 1024.0*1024.0;
+        std::cout << std::fixed << std::setprecision(2);
+        if(softmc_replaying()) {
+            std::cout << "Replayed " << stats.num_programs << " programs (all identical to the captured ones) and " << stats.received_bytes/mib
+                << " MiB of received data from " << path << std::endl;
+
+            CaptureRecordHeader header;
+            if(pending_offset < pending.size() || std::fread(&header, sizeof(header), 1, file) == 1)
+                std::cout << "WARNING: The capture has more programs or data than the tool used" << std::endl;
+        } else {
+            std::cout << "Captured " << stats.num_programs << " programs and " << stats.received_bytes/mib << " MiB of received data to "
+                << path << " (" << stats.file_bytes/mib << " MiB)" << std::endl;
+        }
+        std::cout.unsetf(std::ios_base::floatfield);
+        std::cout << std::setprecision(6);
+    }
+
+private:
+    FILE* file;
+    bool opened;
+    std::string stream;
+    std::string path;
+    SoftMCCaptureStats stats;
+
+    // the received data that replay_data() did not return yet
+    std::string pending;
+    size_t pending_offset = 0;
+    int pending_ret = 0;
+
+    std::mutex mutex;
+
+    void fail(const std::string& msg) {
+        throw SoftMCCaptureException("Replaying " + path + " failed: " + msg);
+    }
+
+    // the file is opened when it is first used, so that a process that only initializes the board (e.g., the ExperimentServer
+    // before forking its jobs) does not create or read it
+    void open() {
+        if(opened)
+            return;
+
+        opened = true;
+        path = std::getenv(softmc_replaying() ? "UTRR_REPLAY" : "UTRR_CAPTURE");
+        if(!stream.empty())
+            path += "." + stream;
+
+        file = std::fopen(path.c_str(), softmc_replaying() ? "rb" : "wb");
+        if(file == nullptr)
+            throw SoftMCCaptureException("Could not open the SoftMC capture file " + path + ": " + std::strerror(errno));
+
+        char magic[SOFTMC_CAPTURE_MAGIC_SIZE];
+        if(softmc_replaying()) {
+            if(std::fread(magic, sizeof(magic), 1, file) != 1 || std::memcmp(magic, SOFTMC_CAPTURE_MAGIC, sizeof(magic)) != 0)
+                fail("not a SoftMC capture file");
+        } else {
+            std::memcpy(magic, SOFTMC_CAPTURE_MAGIC, sizeof(magic));
+            std::fwrite(magic, sizeof(magic), 1, file);
+        }
+
+        stats.file_bytes += sizeof(magic);
+    }
+
+    void write_record(const CaptureRecordType type, const int ret, const void* payload, const uint32_t size) {
+        open();
+
+        uLongf compressed_size = compressBound(size);
+        std::vector<Bytef> compressed(compressed_size);
+        compress2(compressed.data(), &compressed_size, (const Bytef*) payload, size, Z_BEST_SPEED);
+
+        CaptureRecordHeader header{(uint32_t) type, ret, size, (uint32_t) compressed_size};
+        if(std::fwrite(&header, sizeof(header), 1, file) != 1 || std::fwrite(compressed.data(), compressed_size, 1, file) != 1 ||
+                std::fflush(file) != 0)
+            throw SoftMCCaptureException("Could not write to the SoftMC capture file " + path + ": " + std::strerror(errno));
+
+        stats.file_bytes += sizeof(header) + compressed_size;
+    }
+
+    // Returns false at the end of the capture, including a record that was cut off
+    bool read_record(const CaptureRecordType type, int& ret, std::string& payload) {
+        open();
+
+        CaptureRecordHeader header;
+        if(std::fread(&header, sizeof(header), 1, file) != 1)
+            return false;
+
+        std::vector<Bytef> compressed(header.compressed_size);
+        if(header.compressed_size > 0 && std::fread(compressed.data(), header.compressed_size, 1, file) != 1)
+            return false;
+
+        stats.file_bytes += sizeof(header) + header.compressed_size;
+
+        if(header.type != (uint32_t) type)
+            fail("expected a " + record_name(type) + " record but the capture has a " + record_name((CaptureRecordType) header.type) +
+                    " record after program " + std::to_string(stats.num_programs));
+
+        payload.resize(header.size);
+        uLongf size = header.size;
+        if(uncompress((Bytef*) &payload[0], &size, compressed.data(), header.compressed_size) != Z_OK || size != header.size)
+            fail("a corrupted record after program " + std::to_string(stats.num_programs));
+
+        ret = header.ret;
+        return true;
+    }
+
+    static std::string record_name(const CaptureRecordType type) {
+        switch(type) {
+            case CAPTURE_PROGRAM:
+                return "program";
+            case CAPTURE_RECEIVE:
+                return "received data";
+            case CAPTURE_DRAIN:
+                return "leftover data";
+        }
+
+        return "unknown";
+    }
+};
+
+SoftMCCapture softmc_capture;
+
+void print_capture_stats() {
+    softmc_capture.print_stats();
+}
+
+#endif // SOFTMC_CAPTURE_H
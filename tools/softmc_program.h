@@ -0,0 +1,572 @@
+#ifndef SOFTMC_PROGRAM_H
+#define SOFTMC_PROGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include "instruction.h"
+#include "prog.h"
+#include "tools/trace.h"
+#include "tools/metrics.h"
+
+// SoftMCProgram records the instructions, labels, and branches the program generators emit instead of
+// writing them to a DRAM Bender Program right away. The recorded program is optimized and lowered to a
+// Program by lower(), which must be called to execute it, e.g., platform.execute(prog.lower()).
+//
+// Delays are recorded as such (add_nops() and add_sleep()) rather than as opaque instructions, so that
+// lower() can replace long runs of NOP instructions with a single SLEEP instruction. Every instruction
+// takes one FPGA cycle (SOFTMC_INST_CYCLES DRAM cycles) and SLEEP(n) takes n + SOFTMC_SLEEP_OVERHEAD FPGA cycles,
+// so a run of k NOP instructions is equivalent to SLEEP(k - SOFTMC_SLEEP_OVERHEAD).
+//
+// Merging NOPs into a SLEEP the generator emitted keeps the timing exact whatever SOFTMC_SLEEP_OVERHEAD really is, since the
+// number of SLEEPs does not change. Only replacing a run of NOPs alone with a SLEEP (or splitting a SLEEP longer than
+// SOFTMC_MAX_SLEEP) depends on it, so lower() does that only for runs long enough that a few cycles do not matter.
+//
+// Register loads (add_li()) and increments (add_addi()) are recorded as such as well. lower() tracks the values the
+// registers are known to hold through straight-line code and loops, and removes the loads that write the value the
+// register already holds. A removed load is replaced with a NOP instruction, which is then merged into the delays around it,
+// so the timing of the program does not change. Other instructions are assumed not to modify any register, unless the
+// registers they modify (e.g., via the auto-increment of ACT, READ, and WRITE) are passed to add_inst().
+
+// Every instruction (i.e., a bundle of four mininsts) takes 4 cycles. A taken or not taken branch takes SOFTMC_BRANCH_CYCLES
+#define SOFTMC_INST_CYCLES 4
+#define SOFTMC_BRANCH_CYCLES 24
+
+// FPGA cycles a SLEEP instruction takes in addition to its argument. 0 as the program generators have always assumed, e.g., the
+// tRFC and tREFI delays of the refresh loops (perform_refresh()) are SLEEP(delay/SOFTMC_INST_CYCLES). It is not measured on a board
+#define SOFTMC_SLEEP_OVERHEAD 0
+
+// Shorter runs of NOPs alone are emitted as NOP instructions. 16 instructions (64 DRAM cycles) are longer than tRC, so the
+// pads between the ACTs, PREs, and REFs of hammer loops (tRAS, tRP, tRRD, tFAW) are never turned into SLEEPs
+#define SOFTMC_MIN_SLEEP_RUN 16
+
+// The longest SLEEP lower() emits. Longer delays are split into several SLEEPs. Well within the width of the SLEEP immediate
+#define SOFTMC_MAX_SLEEP 0xFFFF
+
+#define SOFTMC_WIDE_LOAD_INSTS 32 // an SMC_LI and an SMC_LDWD for each 32-bit word of the 512-bit wide data register
+
+typedef enum SoftMCNodeType {
+    SMC_NODE_INST,
+    SMC_NODE_NOPS,  // 'count' instructions of four NOPs
+    SMC_NODE_SLEEP, // SLEEP('count')
+    SMC_NODE_LABEL,
+    SMC_NODE_BRANCH,
+    SMC_NODE_LI,    // SMC_LI('imm', 'rd')
+    SMC_NODE_ADDI   // SMC_ADDI('rs', 'imm', 'rd')
+} SoftMCNodeType;
+
+typedef struct SoftMCNode {
+    SoftMCNodeType type;
+    Inst inst;
+    std::vector<uint32_t> written_regs; // the registers 'inst' modifies
+    uint64_t count;
+    std::string label; // the label or the branch target
+    Program::BR_TYPE br_type;
+    int br_rs1, br_rs2;
+    uint32_t imm;
+    int rs, rd;
+} SoftMCNode;
+
+typedef struct SoftMCProgramStats {
+    uint64_t num_programs = 0;
+    uint64_t recorded_insts = 0;
+    uint64_t lowered_insts = 0;
+    uint64_t removed_loads = 0;
+    uint64_t wide_loads = 0; // loads of the wide data register in the program
+    uint64_t avoided_wide_loads = 0; // loads the program would have without grouping rows by data pattern
+    uint64_t avoided_wide_load_cycles = 0; // DRAM cycles the avoided loads would take to execute
+} SoftMCProgramStats;
+
+// accumulated over all programs lowered by the process. Programs are also lowered on worker threads (e.g., RowHammerAttacker's batch
+// builders), so the counters are atomic as the ones in tools/metrics.h
+typedef struct SoftMCProgramTotals {
+    std::atomic<uint64_t> num_programs{0};
+    std::atomic<uint64_t> recorded_insts{0};
+    std::atomic<uint64_t> lowered_insts{0};
+    std::atomic<uint64_t> removed_loads{0};
+    std::atomic<uint64_t> wide_loads{0};
+    std::atomic<uint64_t> avoided_wide_loads{0};
+    std::atomic<uint64_t> avoided_wide_load_cycles{0};
+} SoftMCProgramTotals;
+
+static SoftMCProgramTotals softmc_program_stats;
+
+// FPGA cycles a node takes when it is executed in straight-line order
+uint64_t softmc_node_fpga_cycles(const SoftMCNode& node) {
+    switch(node.type) {
+        case SMC_NODE_INST:
+        case SMC_NODE_LI:
+        case SMC_NODE_ADDI: return 1;
+        case SMC_NODE_NOPS: return node.count;
+        case SMC_NODE_SLEEP: return node.count + SOFTMC_SLEEP_OVERHEAD;
+        case SMC_NODE_BRANCH: return SOFTMC_BRANCH_CYCLES/SOFTMC_INST_CYCLES;
+        default: return 0;
+    }
+}
+
+uint64_t softmc_node_insts(const SoftMCNode& node) {
+    switch(node.type) {
+        case SMC_NODE_NOPS: return node.count;
+        case SMC_NODE_LABEL: return 0;
+        default: return 1;
+    }
+}
+
+// Checks that 'optimized' issues every instruction, label, and branch of 'original' in the same order and at
+// the same FPGA cycle (counted in straight-line order from the beginning of the program). Since the positions of
+// all branch targets are unchanged as well, the timing of every path through the program is unchanged.
+// The cycles are counted with SOFTMC_SLEEP_OVERHEAD, so this checks the bookkeeping of lower(), not the cost of a SLEEP
+bool softmc_same_timing(const std::vector<SoftMCNode>& original, const std::vector<SoftMCNode>& optimized) {
+    auto is_delay = [](const SoftMCNode& node) {return node.type == SMC_NODE_NOPS || node.type == SMC_NODE_SLEEP;};
+
+    uint64_t cyc_orig = 0, cyc_opt = 0;
+    uint i_opt = 0;
+
+    for(auto& node : original) {
+        if(is_delay(node)) {
+            cyc_orig += softmc_node_fpga_cycles(node);
+            continue;
+        }
+
+        while(i_opt < optimized.size() && is_delay(optimized[i_opt]))
+            cyc_opt += softmc_node_fpga_cycles(optimized[i_opt++]);
+
+        if(i_opt == optimized.size() || optimized[i_opt].type != node.type || cyc_orig != cyc_opt)
+            return false;
+
+        cyc_orig += softmc_node_fpga_cycles(node);
+        cyc_opt += softmc_node_fpga_cycles(optimized[i_opt++]);
+    }
+
+    while(i_opt < optimized.size() && is_delay(optimized[i_opt]))
+        cyc_opt += softmc_node_fpga_cycles(optimized[i_opt++]);
+
+    return i_opt == optimized.size() && cyc_orig == cyc_opt;
+}
+
+// register -> the value it is known to hold
+typedef std::map<int, uint32_t> SoftMCRegValues;
+
+void softmc_update_reg_values(const SoftMCNode& node, SoftMCRegValues& values) {
+    switch(node.type) {
+        case SMC_NODE_LI:
+            values[node.rd] = node.imm;
+            break;
+        case SMC_NODE_ADDI: {
+            auto it = values.find(node.rs);
+            if(it != values.end())
+                values[node.rd] = it->second + node.imm;
+            else
+                values.erase(node.rd);
+            break;
+        }
+        case SMC_NODE_INST:
+            for(auto reg : node.written_regs)
+                values.erase(reg);
+            break;
+        default:
+            break;
+    }
+}
+
+// keeps the registers that hold the same value in both
+void softmc_join_reg_values(SoftMCRegValues& values, const SoftMCRegValues& other) {
+    for(auto it = values.begin(); it != values.end();) {
+        auto it_other = other.find(it->first);
+        if(it_other == other.end() || it_other->second != it->second)
+            it = values.erase(it);
+        else
+            it++;
+    }
+}
+
+// Replaces every SMC_LI that loads a register with the value the register holds on all paths that reach the SMC_LI
+// with a single NOP instruction. Nothing is assumed about the register values at the beginning of the program.
+//
+// The program is split into segments that start at the beginning of the program or at a label and run until the next label.
+// The register values at each label are the join of the values at its fall-through and at the branches that target it, which
+// are computed iteratively until none of them changes. Values are only ever dropped from a label, so this terminates
+std::vector<SoftMCNode> softmc_remove_redundant_loads(const std::vector<SoftMCNode>& nodes, uint64_t& removed_loads) {
+    std::map<std::string, uint> label_pos;
+    for(uint i = 0; i < nodes.size(); i++)
+        if(nodes[i].type == SMC_NODE_LABEL)
+            label_pos[nodes[i].label] = i;
+
+    std::map<uint, SoftMCRegValues> segment_values; // the values at the beginning of each segment reached so far
+    std::vector<uint> worklist;
+
+    auto join_into = [&](const uint pos, const SoftMCRegValues& values) {
+        auto it = segment_values.find(pos);
+        if(it == segment_values.end()) {
+            segment_values[pos] = values;
+        } else {
+            size_t known = it->second.size();
+            softmc_join_reg_values(it->second, values);
+            if(it->second.size() == known)
+                return;
+        }
+
+        worklist.push_back(pos);
+    };
+
+    // walks the segment that starts at 'start'. Calls on_node() with the values before each node
+    auto walk_segment = [&](const uint start, const std::function<void(uint, const SoftMCRegValues&)>& on_node) {
+        SoftMCRegValues values = segment_values[start];
+
+        for(uint i = start; i < nodes.size(); i++) {
+            const SoftMCNode& node = nodes[i];
+
+            if(node.type == SMC_NODE_LABEL && i != start) {
+                join_into(i, values);
+                return;
+            }
+
+            on_node(i, values);
+
+            if(node.type == SMC_NODE_BRANCH) {
+                auto it = label_pos.find(node.label);
+                assert(it != label_pos.end() && "Branch to an undefined label in the SoftMC program");
+                join_into(it->second, values);
+
+                if(node.br_type == Program::JUMP)
+                    return; // the nodes until the next label are not reachable
+            }
+
+            softmc_update_reg_values(node, values);
+        }
+    };
+
+    auto ignore = [](uint, const SoftMCRegValues&) {};
+
+    join_into(0, SoftMCRegValues());
+    while(!worklist.empty()) {
+        uint start = worklist.back();
+        worklist.pop_back();
+        walk_segment(start, ignore);
+    }
+
+    std::vector<SoftMCNode> out = nodes;
+    removed_loads = 0;
+
+    // the values are final, so walking the segments again does not add to the worklist
+    std::map<uint, SoftMCRegValues> final_values = segment_values;
+    for(auto& segment : final_values) {
+        walk_segment(segment.first, [&](uint i, const SoftMCRegValues& values) {
+            if(nodes[i].type != SMC_NODE_LI)
+                return;
+
+            auto it = values.find(nodes[i].rd);
+            if(it != values.end() && it->second == nodes[i].imm) {
+                out[i] = SoftMCNode();
+                out[i].type = SMC_NODE_NOPS;
+                out[i].count = 1;
+                removed_loads++;
+            }
+        });
+    }
+    assert(worklist.empty());
+
+    return out;
+}
+
+// Merges the delays between two other nodes (i.e., consecutive NOP runs and SLEEPs):
+//   - a run with SLEEPs keeps as many SLEEPs, and its NOPs are added to its first SLEEP
+//   - a run of NOPs alone is replaced with a SLEEP if it is at least SOFTMC_MIN_SLEEP_RUN instructions long, and kept otherwise
+//   - SLEEPs longer than SOFTMC_MAX_SLEEP are split
+std::vector<SoftMCNode> softmc_compress_delays(const std::vector<SoftMCNode>& nodes) {
+    std::vector<SoftMCNode> out;
+    out.reserve(nodes.size());
+
+    uint64_t nop_cycles = 0; // FPGA cycles of the NOPs of the current run of delays
+    std::vector<uint64_t> sleeps; // the arguments of the SLEEPs of the current run
+
+    auto add_delay = [&](const SoftMCNodeType type, const uint64_t count) {
+        SoftMCNode delay = SoftMCNode();
+        delay.type = type;
+        delay.count = count;
+        out.push_back(delay);
+    };
+
+    // delays that take 'cycles' FPGA cycles, as SLEEPs of at most SOFTMC_MAX_SLEEP and NOPs for what is too short for a SLEEP
+    auto add_sleeps = [&](uint64_t cycles) {
+        while(cycles > 0) {
+            uint64_t sleep_cycles = std::min<uint64_t>(cycles, SOFTMC_MAX_SLEEP + SOFTMC_SLEEP_OVERHEAD);
+            if(sleep_cycles <= SOFTMC_SLEEP_OVERHEAD) {
+                add_delay(SMC_NODE_NOPS, sleep_cycles);
+                return;
+            }
+
+            add_delay(SMC_NODE_SLEEP, sleep_cycles - SOFTMC_SLEEP_OVERHEAD);
+            cycles -= sleep_cycles;
+        }
+    };
+
+    auto flush_run = [&]() {
+        if(sleeps.empty()) {
+            if(nop_cycles >= SOFTMC_MIN_SLEEP_RUN)
+                add_sleeps(nop_cycles);
+            else if(nop_cycles > 0)
+                add_delay(SMC_NODE_NOPS, nop_cycles);
+        } else {
+            for(uint i = 0; i < sleeps.size(); i++)
+                add_sleeps(sleeps[i] + SOFTMC_SLEEP_OVERHEAD + (i == 0 ? nop_cycles : 0));
+        }
+
+        nop_cycles = 0;
+        sleeps.clear();
+    };
+
+    for(auto& node : nodes) {
+        if(node.type == SMC_NODE_NOPS) {
+            nop_cycles += node.count;
+            continue;
+        }
+
+        if(node.type == SMC_NODE_SLEEP) {
+            sleeps.push_back(node.count);
+            continue;
+        }
+
+        flush_run();
+        out.push_back(node);
+    }
+
+    flush_run();
+
+    return out;
+}
+
+class SoftMCProgram : protected Program {
+
+public:
+    using Program::BR_TYPE;
+    using Program::BL;
+    using Program::BEQ;
+    using Program::JUMP;
+
+    // 'written_regs' are the registers the instruction modifies
+    void add_inst(Inst inst, const std::vector<uint32_t>& written_regs = {}) {
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_INST;
+        node.inst = inst;
+        node.written_regs = written_regs;
+        record(node);
+    }
+
+    void add_li(const uint32_t imm, const int rd) {
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_LI;
+        node.imm = imm;
+        node.rd = rd;
+        record(node);
+    }
+
+    void add_addi(const int rs, const int imm, const int rd) {
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_ADDI;
+        node.rs = rs;
+        node.imm = imm;
+        node.rd = rd;
+        record(node);
+    }
+
+    // 'count' instructions of four NOPs
+    void add_nops(const uint64_t count) {
+        if(count == 0)
+            return;
+
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_NOPS;
+        node.count = count;
+        record(node);
+    }
+
+    void add_sleep(const uint64_t count) {
+        // SLEEP(0) is kept as is since it does not correspond to a number of NOP instructions
+        if(count == 0) {
+            add_inst(SMC_SLEEP(0));
+            return;
+        }
+
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_SLEEP;
+        node.count = count;
+        record(node);
+    }
+
+    void add_label(std::string label) {
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_LABEL;
+        node.label = label;
+        record(node);
+    }
+
+    void add_branch(BR_TYPE type, int rs1, int rs2, std::string target) {
+        SoftMCNode node = SoftMCNode();
+        node.type = SMC_NODE_BRANCH;
+        node.br_type = type;
+        node.br_rs1 = rs1;
+        node.br_rs2 = rs2;
+        node.label = target;
+        record(node);
+    }
+
+    // bookkeeping for the program generators that load the wide data register (see load_wide_data()) and group 
+    // rows by data pattern to load it less often. 'executed' is the number of times the avoided loads would be executed
+    void count_wide_loads(const uint64_t loads) {
+        stats.wide_loads += loads;
+    }
+
+    void count_avoided_wide_loads(const uint64_t avoided, const uint64_t executed) {
+        stats.avoided_wide_loads += avoided;
+        stats.avoided_wide_load_cycles += executed*SOFTMC_WIDE_LOAD_INSTS*SOFTMC_INST_CYCLES;
+    }
+
+    const SoftMCProgramStats& get_stats() const {
+        return stats;
+    }
+
+    // the number of instructions the program consists of before optimizing it
+    uint64_t num_insts() const {
+        uint64_t insts = 0;
+        for(auto& node : nodes)
+            insts += softmc_node_insts(node);
+
+        return insts;
+    }
+
+    const std::vector<SoftMCNode>& get_nodes() const {
+        return nodes;
+    }
+
+    // the optimized nodes lower() wrote to the DRAM Bender Program. Empty before lowering
+    const std::vector<SoftMCNode>& get_lowered_nodes() const {
+        return lowered_nodes;
+    }
+
+    // optimizes the recorded program and writes it to the underlying DRAM Bender Program.
+    // Nothing can be added to the program afterwards
+    Program& lower() {
+        if(lowered)
+            return *this;
+
+        TraceSpan span("lower");
+
+        // removing a load replaces it with a NOP instruction in place, so that step keeps the timing by construction
+        uint64_t removed_loads;
+        std::vector<SoftMCNode> without_loads = softmc_remove_redundant_loads(nodes, removed_loads);
+
+        std::vector<SoftMCNode> optimized = softmc_compress_delays(without_loads);
+        assert(softmc_same_timing(without_loads, optimized) && "Optimizing the SoftMC program changed its timing");
+
+        for(auto& node : optimized) {
+            switch(node.type) {
+                case SMC_NODE_INST:
+                    Program::add_inst(node.inst);
+                    break;
+                case SMC_NODE_NOPS:
+                    for(uint64_t i = 0; i < node.count; i++)
+                        Program::add_inst(__pack_mininsts(SMC_NOP(), SMC_NOP(), SMC_NOP(), SMC_NOP()));
+                    break;
+                case SMC_NODE_SLEEP:
+                    Program::add_inst(SMC_SLEEP(node.count));
+                    break;
+                case SMC_NODE_LABEL:
+                    Program::add_label(node.label);
+                    break;
+                case SMC_NODE_BRANCH:
+                    Program::add_branch(node.br_type, node.br_rs1, node.br_rs2, node.label);
+                    break;
+                case SMC_NODE_LI:
+                    Program::add_inst(SMC_LI(node.imm, node.rd));
+                    break;
+                case SMC_NODE_ADDI:
+                    Program::add_inst(SMC_ADDI(node.rs, (int) node.imm, node.rd));
+                    break;
+            }
+        }
+
+        uint64_t optimized_insts = 0;
+        for(auto& node : optimized)
+            optimized_insts += softmc_node_insts(node);
+
+        lowered_nodes.swap(optimized);
+
+        stats.num_programs = 1;
+        stats.recorded_insts = num_insts();
+        stats.lowered_insts = optimized_insts;
+        stats.removed_loads = removed_loads;
+
+        softmc_program_stats.num_programs++;
+        softmc_program_stats.recorded_insts += stats.recorded_insts;
+        softmc_program_stats.lowered_insts += stats.lowered_insts;
+        softmc_program_stats.removed_loads += stats.removed_loads;
+        softmc_program_stats.wide_loads += stats.wide_loads;
+        softmc_program_stats.avoided_wide_loads += stats.avoided_wide_loads;
+        softmc_program_stats.avoided_wide_load_cycles += stats.avoided_wide_load_cycles;
+
+        tool_metrics.program_generation_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - created).count();
+
+        lowered = true;
+        return *this;
+    }
+
+    // the number of instructions lower() saved. Valid after lowering
+    uint64_t saved_insts() const {
+        return lowered ? stats.recorded_insts - stats.lowered_insts : 0;
+    }
+
+    void pretty_print() {
+        lower().pretty_print();
+    }
+
+private:
+    std::vector<SoftMCNode> nodes;
+    std::vector<SoftMCNode> lowered_nodes;
+    bool lowered = false;
+    SoftMCProgramStats stats;
+    std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now(); // generating the program starts here
+
+    void record(const SoftMCNode& node) {
+        assert(!lowered && "Cannot add to a SoftMC program after lowering it");
+        nodes.push_back(node);
+    }
+};
+
+void print_softmc_program_stats() {
+    SoftMCProgramStats st;
+    st.num_programs = softmc_program_stats.num_programs;
+    st.recorded_insts = softmc_program_stats.recorded_insts;
+    st.lowered_insts = softmc_program_stats.lowered_insts;
+    st.removed_loads = softmc_program_stats.removed_loads;
+    st.wide_loads = softmc_program_stats.wide_loads;
+    st.avoided_wide_loads = softmc_program_stats.avoided_wide_loads;
+    st.avoided_wide_load_cycles = softmc_program_stats.avoided_wide_load_cycles;
+
+    if(st.num_programs == 0)
+        return;
+
+    std::cout << "Lowered " << st.num_programs << " SoftMC program(s): "
+        << st.recorded_insts << " -> " << st.lowered_insts << " instructions ("
+        << st.removed_loads << " redundant register loads turned into delays, "
+        << st.recorded_insts - st.lowered_insts << " instructions saved by compressing NOP runs)" << std::endl;
+
+    if(st.avoided_wide_loads == 0)
+        return;
+
+    std::cout << "Grouping rows by data pattern avoided " << st.avoided_wide_loads << " of " << st.wide_loads + st.avoided_wide_loads 
+        << " wide data register loads: " << st.avoided_wide_loads*SOFTMC_WIDE_LOAD_INSTS << " instructions and " 
+        << st.avoided_wide_load_cycles << " cycles (" << st.avoided_wide_loads*SOFTMC_WIDE_LOAD_INSTS/st.num_programs << " instructions and "
+        << st.avoided_wide_load_cycles/st.num_programs << " cycles per program)" << std::endl;
+}
+
+#endif // SOFTMC_PROGRAM_H
@@ -0,0 +1,160 @@
+#ifndef SOFTMC_SESSION_H
+#define SOFTMC_SESSION_H
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "platform.h"
+#include "tools/softmc_program.h"
+#include "tools/softmc_capture.h"
+#include "tools/trace.h"
+#include "tools/metrics.h"
+
+// Every U-TRR tool exposes its main as a function that takes an optional, already initialized SoftMCPlatform.
+// When the platform is nullptr, the tool initializes its own platform (i.e., the tool runs standalone).
+// When a tool is built with UTRR_TOOL_LIBRARY defined (e.g., 'make lib'), it exports this function as
+// 'utrr_tool_main' instead of defining main() so that the ExperimentServer can dlopen() it and run jobs
+// on the platform it owns.
+typedef int (*UTRRToolMainFn)(SoftMCPlatform* platform, int argc, char** argv);
+
+#define UTRR_TOOL_MAIN_SYMBOL "utrr_tool_main"
+
+#ifdef UTRR_TOOL_LIBRARY
+#define UTRR_TOOL_MAIN(tool_main_fn) \
+    extern "C" int utrr_tool_main(SoftMCPlatform* platform, int argc, char** argv) { return run_utrr_tool(tool_main_fn, platform, argc, argv); }
+#else
+#define UTRR_TOOL_MAIN(tool_main_fn) \
+    int main(int argc, char** argv) { return run_utrr_tool(tool_main_fn, nullptr, argc, argv); }
+#endif
+
+// The tool captures to (or replays) the stream named after it, i.e., the file name in argv[0] (see tools/softmc_capture.h).
+// A failed capture or replay ends the tool with an error instead of exiting the process that runs it
+int run_utrr_tool(UTRRToolMainFn tool_main_fn, SoftMCPlatform* platform, int argc, char** argv) {
+    if(argc > 0) {
+        std::string tool = argv[0];
+        softmc_capture.set_stream(tool.substr(tool.find_last_of('/') + 1));
+    }
+
+    try {
+        return tool_main_fn(platform, argc, argv);
+    } catch(const SoftMCCaptureException& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+#define DEFAULT_SOFTMC_BOARD_LOCK "/tmp/utrr_softmc_board.lock"
+
+// The lock file can be changed with the UTRR_BOARD_LOCK environment variable, e.g., when multiple boards are attached to the same host
+std::string softmc_board_lock_path() {
+    const char* env_path = std::getenv("UTRR_BOARD_LOCK");
+
+    if(env_path != nullptr && env_path[0] != '\0')
+        return std::string(env_path);
+
+    return DEFAULT_SOFTMC_BOARD_LOCK;
+}
+
+// Takes an exclusive, process-wide lock on the SoftMC board so that two tool instances (or a tool and the ExperimentServer) never drive the same board at the same time.
+// The lock is released automatically when the process exits. Returns false if another process holds the lock.
+bool lock_softmc_board() {
+    static int lock_fd = -1;
+
+    if(lock_fd >= 0)
+        return true;
+
+    std::string lock_path = softmc_board_lock_path();
+    int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if(fd < 0) {
+        std::cerr << "ERROR: Could not open the SoftMC board lock file " << lock_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    if(flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        std::cerr << "ERROR: The SoftMC board is in use by another process (lock file: " << lock_path << "). "
+            "Submit the job to the ExperimentServer instead or wait until the other process finishes." << std::endl;
+        close(fd);
+        return false;
+    }
+
+    lock_fd = fd;
+    return true;
+}
+
+// Locks the board and brings the platform to the state all tools expect: FPGA reset and auto-refresh disabled.
+// When replaying a capture, the board is not used at all
+int init_softmc_platform(SoftMCPlatform& platform) {
+    if(softmc_replaying())
+        return SOFTMC_SUCCESS;
+
+    if(!lock_softmc_board())
+        return -1;
+
+    int err;
+    if((err = platform.init()) != SOFTMC_SUCCESS){
+        std::cerr << "Could not initialize SoftMC Platform: " << err << std::endl;
+        return err;
+    }
+
+    platform.reset_fpga();
+
+    // disable refresh
+    platform.set_aref(false);
+
+    return SOFTMC_SUCCESS;
+}
+
+// lowers and executes prog. The time spent in each step shows up in the trace (see tools/trace.h).
+// The program is captured or compared with the captured one as well (see tools/softmc_capture.h)
+void execute_program(SoftMCPlatform& platform, SoftMCProgram& prog) {
+    Program& lowered = prog.lower();
+
+    TraceSpan span("execute");
+    if(softmc_replaying())
+        softmc_capture.replay_program(prog.get_lowered_nodes());
+    else
+        platform.execute(lowered);
+
+    if(softmc_capture_mode() == SOFTMC_CAPTURE_RECORD)
+        softmc_capture.capture_program(prog.get_lowered_nodes());
+
+    tool_metrics.programs_executed++;
+}
+
+int receive_data(SoftMCPlatform& platform, void* buf, const uint32_t size) {
+    TraceSpan span("receive");
+    int ret;
+    if(softmc_replaying())
+        ret = softmc_capture.replay_data(CAPTURE_RECEIVE, buf, size);
+    else
+        ret = platform.receiveData(buf, size);
+
+    if(softmc_capture_mode() == SOFTMC_CAPTURE_RECORD)
+        softmc_capture.capture_data(CAPTURE_RECEIVE, ret, buf, size);
+
+    tool_metrics.pcie_bytes_received += size;
+
+    return ret;
+}
+
+// receives data no program is expected to send, i.e., when checking that nothing is left over from the previous programs.
+// Not counted in the metrics
+int drain_data(SoftMCPlatform& platform, void* buf, const uint32_t size) {
+    if(softmc_replaying())
+        return softmc_capture.replay_data(CAPTURE_DRAIN, buf, size);
+
+    int ret = platform.receiveData(buf, size);
+    if(softmc_capture_mode() == SOFTMC_CAPTURE_RECORD)
+        softmc_capture.capture_data(CAPTURE_DRAIN, ret, buf, size);
+
+    return ret;
+}
+
+#endif // SOFTMC_SESSION_H
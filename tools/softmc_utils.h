@@ -3,16 +3,21 @@
 
 #include <cstdint>
 #include <vector>
+#include <bitset>
 #include <exception>
 #include <cassert>
 #include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <thread>
+#include <atomic>
 
 #include "instruction.h"
 #include "prog.h"
+#include "tools/softmc_program.h"
+#include "tools/softmc_capture.h"
 #include "tools/perfect_hash.h"
+#include "tools/row_mapping.h"
 
 #define CACHE_LINE_BITS 512
 
@@ -24,13 +29,19 @@ struct OutOfSoftMCRegsException : public std::exception {
    }
 };
 
-static uint32_t label_counter = 0;
+// labels are also created on worker threads (e.g., RowHammerAttacker's batch builders)
+static std::atomic<uint32_t> label_counter(0);
 std::string createSMCLabel(const std::string& name) {
     return name + std::to_string(label_counter++);
 }
 
 void waitMS(const uint ret_time_ms) {
-    
+    TraceSpan span("wait");
+
+    // there is no board to wait for when replaying a capture (see tools/softmc_capture.h)
+    if(softmc_replaying())
+        return;
+
     static constexpr std::chrono::duration<double, std::milli> min_sleep_duration(1);
     auto start = std::chrono::high_resolution_clock::now();
     while (std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() < ret_time_ms) {
@@ -43,30 +54,83 @@ Inst all_nops()
   return  __pack_mininsts(SMC_NOP(), SMC_NOP(), SMC_NOP(), SMC_NOP());
 }
 
-int add_op_with_delay (Program& prog, Mininst ins, int before_cycles, int after_cycles) {
+// Loads 'data_pattern' into the wide data register that SMC_WRITE writes to DRAM, 32 bits at a time via reg_tmp. 
+// Takes SOFTMC_WIDE_LOAD_INSTS instructions
+void load_wide_data(SoftMCProgram& prog, const SMC_REG reg_tmp, const std::bitset<512>& data_pattern) {
+    std::bitset<512> bitset_int_mask(0xFFFFFFFF);
+
+    for (int pos = 0; pos < 16; pos++) {
+        prog.add_li((((data_pattern >> 32*pos) & bitset_int_mask).to_ulong() & 0xFFFFFFFF), reg_tmp);
+        prog.add_inst(SMC_LDWD(reg_tmp, pos));
+    }
+
+    prog.count_wide_loads(1);
+}
+
+// the number of times the wide data register is loaded when initializing rows with 'data_patts' in order
+uint num_wide_loads(const std::vector<std::bitset<512>>& data_patts) {
+    uint loads = 0;
+    for(uint i = 0; i < data_patts.size(); i++)
+        if(i == 0 || data_patts[i-1] != data_patts[i])
+            loads++;
+
+    return loads;
+}
+
+// Returns the order to initialize rows in so that the rows with the same data pattern are initialized one after another.
+// Rows are initialized phase by phase in increasing order of 'phases' (e.g., all victims before all aggressors). Within a phase, 
+// the patterns are ordered by their first row, and the rows of a pattern keep their relative order
+std::vector<uint> group_by_data_pattern(const std::vector<std::bitset<512>>& data_patts, const std::vector<uint>& phases) {
+    assert(data_patts.size() == phases.size());
+
+    // the index of the first row of each row's pattern within its phase
+    std::vector<uint> pattern_first(data_patts.size());
+    for(uint i = 0; i < data_patts.size(); i++) {
+        pattern_first[i] = i;
+        for(uint j = 0; j < i; j++) {
+            if(phases[j] == phases[i] && data_patts[j] == data_patts[i]) {
+                pattern_first[i] = pattern_first[j];
+                break;
+            }
+        }
+    }
+
+    std::vector<uint> order(data_patts.size());
+    for(uint i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](const uint a, const uint b) {
+        if(phases[a] != phases[b])
+            return phases[a] < phases[b];
+        return pattern_first[a] < pattern_first[b];
+    });
+
+    return order;
+}
+
+// 'written_regs' are the registers 'ins' modifies, e.g., the column address register of a READ with auto-increment
+int add_op_with_delay (SoftMCProgram& prog, Mininst ins, int before_cycles, int after_cycles, const std::vector<uint32_t>& written_regs = {}) {
     
     int remaining = before_cycles < 0 ? 0 : before_cycles;
 
-    while(remaining >= 4) {
-        prog.add_inst(all_nops());
-        remaining -= 4;
-    }
+    prog.add_nops(remaining/4);
+    remaining %= 4;
 
     switch(remaining) {
         case 0:
-            prog.add_inst(__pack_mininsts(ins, SMC_NOP(), SMC_NOP(), SMC_NOP()));
+            prog.add_inst(__pack_mininsts(ins, SMC_NOP(), SMC_NOP(), SMC_NOP()), written_regs);
             remaining = after_cycles - 3;
             break;
         case 1:
-            prog.add_inst(__pack_mininsts(SMC_NOP(), ins, SMC_NOP(), SMC_NOP()));
+            prog.add_inst(__pack_mininsts(SMC_NOP(), ins, SMC_NOP(), SMC_NOP()), written_regs);
             remaining = after_cycles - 2;
             break;
         case 2:
-            prog.add_inst(__pack_mininsts(SMC_NOP(), SMC_NOP(), ins, SMC_NOP()));
+            prog.add_inst(__pack_mininsts(SMC_NOP(), SMC_NOP(), ins, SMC_NOP()), written_regs);
             remaining = after_cycles - 1;
             break;
         case 3:
-            prog.add_inst(__pack_mininsts(SMC_NOP(), SMC_NOP(), SMC_NOP(), ins));
+            prog.add_inst(__pack_mininsts(SMC_NOP(), SMC_NOP(), SMC_NOP(), ins), written_regs);
             remaining = after_cycles;
             break;
 
@@ -74,32 +138,105 @@ int add_op_with_delay (Program& prog, Mininst ins, int before_cycles, int after_
             assert(false && "This line should not be reached. Possible bug in the program.");
     }
 
-    while (remaining >= 4) {
-        prog.add_inst(all_nops());
-        remaining -= 4;
+    if (remaining >= 4) {
+        prog.add_nops(remaining/4);
+        remaining %= 4;
     }
 
     return remaining;
 }
 
-int add_op_with_delay (Program& prog, Inst ins, int before_cycles, int after_cycles) {
+int add_op_with_delay (SoftMCProgram& prog, Inst ins, int before_cycles, int after_cycles) {
     
     int remaining = before_cycles;
 
-    while(remaining > 0) {
-        prog.add_inst(all_nops());
+    if(remaining > 0)
+        prog.add_nops((remaining + 3)/4);
+
+    prog.add_inst(ins);
+    remaining = after_cycles;
+
+    if (remaining >= 4) {
+        prog.add_nops(remaining/4);
+        remaining %= 4;
+    }
+
+    return remaining;
+}
+
+// same as add_op_with_delay() with SMC_SLEEP(sleep_cycles), but records the SLEEP as a delay that can be merged with the NOPs around it
+int add_sleep_with_delay (SoftMCProgram& prog, uint64_t sleep_cycles, int before_cycles, int after_cycles) {
+
+    int remaining = before_cycles;
+
+    if(remaining > 0)
+        prog.add_nops((remaining + 3)/4);
+
+    prog.add_sleep(sleep_cycles);
+    remaining = after_cycles;
+
+    if (remaining >= 4) {
+        prog.add_nops(remaining/4);
+        remaining %= 4;
+    }
+
+    return remaining;
+}
+
+// same as add_op_with_delay() with SMC_LI(imm, rd), but records the load so that lower() can remove it if it is redundant
+int add_li_with_delay (SoftMCProgram& prog, uint32_t imm, int rd, int before_cycles, int after_cycles) {
+
+    int remaining = before_cycles;
+
+    if(remaining > 0)
+        prog.add_nops((remaining + 3)/4);
+
+    prog.add_li(imm, rd);
+    remaining = after_cycles;
+
+    if (remaining >= 4) {
+        prog.add_nops(remaining/4);
+        remaining %= 4;
+    }
+
+    return remaining;
+}
+
+// The number of instructions add_op_with_delay() emits for a mininst. Sets 'remaining' to what add_op_with_delay() returns
+int op_with_delay_insts(int before_cycles, int after_cycles, int& remaining) {
+
+    int num_insts = 0;
+    int before = before_cycles < 0 ? 0 : before_cycles;
+
+    num_insts += before/4;
+    remaining = after_cycles - (3 - before%4);
+    num_insts++;
+
+    while (remaining >= 4) {
+        num_insts++;
         remaining -= 4;
     }
 
-    prog.add_inst(ins);
+    return num_insts;
+}
+
+// The number of instructions add_op_with_delay() emits for an instruction. Sets 'remaining' to what add_op_with_delay() returns
+int inst_with_delay_insts(int before_cycles, int after_cycles, int& remaining) {
+
+    int num_insts = 0;
+
+    for (int before = before_cycles; before > 0; before -= 4)
+        num_insts++;
+
+    num_insts++;
     remaining = after_cycles;
 
     while (remaining >= 4) {
-        prog.add_inst(all_nops());
+        num_insts++;
         remaining -= 4;
     }
 
-    return remaining;
+    return num_insts;
 }
 
 std::string bin_to_hex(const char* bin, const int length) {
@@ -160,56 +297,56 @@ typedef enum LogPhysRowIDScheme {
     MAX
 } LogPhysRowIDScheme;
 
-LogPhysRowIDScheme logical_physical_conversion_scheme = LogPhysRowIDScheme::SEQUENTIAL;
-
-PhysicalRowID to_physical_row_id(uint logical_row_id) {
-    
-    switch(logical_physical_conversion_scheme) {
-        case LogPhysRowIDScheme::SEQUENTIAL: {
-            return logical_row_id;
-            break;
-        }
+// the built-in mappings selectable with --log_phys_scheme. Other mappings can be loaded from a file (see row_mapping.h)
+RowMapping builtin_row_mapping(const LogPhysRowIDScheme scheme) {
+    switch(scheme) {
         case LogPhysRowIDScheme::SAMSUNG: {
-            if(logical_row_id & 0x8) {
-                PhysicalRowID phys_row_id = logical_row_id & 0xFFFFFFF9;
-                phys_row_id |= (~logical_row_id & 0x00000006); // set bit pos 3 and 2
-
-                return phys_row_id;
-            } else {
-                return logical_row_id;
-            }
-            break;
-        }
-        default: {
-            std::cerr << "ERROR: unimplemented logical to physical row id conversion scheme!" << std::endl;
-            return -1;
+            // bits 1 and 2 are inverted when bit 3 is set
+            RowMapping mapping = identity_row_mapping("samsung");
+            mapping.phys_bit_masks[1] = 0x2 | 0x8;
+            mapping.phys_bit_masks[2] = 0x4 | 0x8;
+            return mapping;
         }
+        default:
+            return identity_row_mapping();
     }
 }
 
-LogicalRowID to_logical_row_id(uint physical_row_id) {
-    switch(logical_physical_conversion_scheme) {
-        case LogPhysRowIDScheme::SEQUENTIAL: {
-            return physical_row_id;
-            break;
-        }
-        case LogPhysRowIDScheme::SAMSUNG: {
-            if(physical_row_id & 0x8) {
-                PhysicalRowID log_row_id = physical_row_id & 0xFFFFFFF9;
-                log_row_id |= (~physical_row_id & 0x00000006); // set bit pos 3 and 2
+RowMappingTable row_mapping_table;
 
-                return log_row_id;
-            } else {
-                return physical_row_id;
-            }
-            break;
-        }
-        default: {
-            std::cerr << "ERROR: unimplemented physical to logical row id conversion scheme!" << std::endl;
-        }
+// Returns an empty string on success, and a description of the problem otherwise
+std::string set_row_mapping(const RowMapping& mapping, const uint num_rows) {
+    return row_mapping_table.build(mapping, num_rows);
+}
+
+const RowMapping& get_row_mapping() {
+    return row_mapping_table.get_mapping();
+}
+
+// sets up the mapping selected with --log_phys_scheme, or the one in mapping_filename when it is not empty.
+// Returns an empty string on success, and a description of the problem otherwise
+std::string init_row_mapping(const uint scheme, const std::string& mapping_filename, const uint num_rows) {
+    RowMapping mapping;
+
+    if(!mapping_filename.empty()) {
+        std::string error = load_row_mapping(mapping_filename, mapping);
+        if(!error.empty())
+            return error;
+    } else if(scheme < uint(LogPhysRowIDScheme::MAX)) {
+        mapping = builtin_row_mapping((LogPhysRowIDScheme) scheme);
+    } else {
+        return "unknown logical to physical row ID conversion scheme " + std::to_string(scheme);
     }
 
-    return 0;
+    return set_row_mapping(mapping, num_rows);
+}
+
+PhysicalRowID to_physical_row_id(uint logical_row_id) {
+    return row_mapping_table.to_physical(logical_row_id);
+}
+
+LogicalRowID to_logical_row_id(uint physical_row_id) {
+    return row_mapping_table.to_logical(physical_row_id);
 }
 
 
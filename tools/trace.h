@@ -0,0 +1,297 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+// Phase-level tracing of the tools. A TraceSpan measures the scope it lives in, e.g.,
+//   { TraceSpan span("execute"); platform.execute(program); }
+// Spans are recorded into a ring buffer of the thread that creates them, so recording a span takes no lock.
+// When tracing is disabled (the default), creating a span only checks a flag.
+//
+// stop_tracing() writes the recorded spans as Chrome trace-event JSON, which can be opened in chrome://tracing or
+// ui.perfetto.dev, and prints the duration histogram of each phase. The histograms cover every span, including the ones
+// that no longer fit into the ring buffers.
+//
+// Span names must be string literals (or otherwise outlive the trace) since only the pointers are recorded.
+//
+// A thread that exits hands its buffer back, and the next thread with the same name (see trace_set_thread_name()) records into it, so
+// threads that are started per task (e.g., RowHammerAttacker's batch builders) appear as one thread in the trace and do not add a buffer each.
+
+#define TRACE_RING_EVENTS (1 << 16) // per thread. The oldest spans are overwritten when a ring is full
+#define TRACE_HIST_BUCKETS 40 // log2 buckets of span durations in ns, i.e., up to ~18 minutes
+
+typedef struct TraceEvent {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+} TraceEvent;
+
+typedef struct TracePhaseStats {
+    const char* name;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t hist[TRACE_HIST_BUCKETS];
+} TracePhaseStats;
+
+typedef struct TraceThreadBuffer {
+    uint tid;
+    std::thread::id thread_id;
+    const char* name; // nullptr for threads that did not set a name
+    bool in_use; // false once the thread that recorded into the buffer exited
+    std::vector<TraceEvent> ring;
+    uint64_t num_recorded; // the next event goes to ring[num_recorded % TRACE_RING_EVENTS]
+    std::vector<TracePhaseStats> phases; // only a handful of phases per tool, a linear search is fine
+} TraceThreadBuffer;
+
+std::atomic<bool> trace_enabled(false);
+std::chrono::steady_clock::time_point trace_epoch;
+std::thread::id trace_main_thread; // the thread that started tracing
+
+// the buffers are never freed so that spans of threads that already exited can still be written. A buffer whose thread exited is
+// reused by the next thread with the same name
+std::mutex trace_buffers_mutex;
+std::vector<TraceThreadBuffer*> trace_buffers;
+
+// hands the buffer of the thread back when the thread exits
+class TraceThreadBufferOwner {
+
+public:
+    ~TraceThreadBufferOwner() {
+        if(buffer == nullptr)
+            return;
+
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+        buffer->in_use = false;
+    }
+
+    TraceThreadBuffer* buffer = nullptr;
+    const char* name = nullptr;
+};
+
+thread_local TraceThreadBufferOwner trace_thread_buffer;
+
+uint64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+// names the calling thread in the trace. Must be called before the thread records its first span, and name must be a string literal
+void trace_set_thread_name(const char* name) {
+    trace_thread_buffer.name = name;
+}
+
+TraceThreadBuffer* trace_get_thread_buffer() {
+    if(trace_thread_buffer.buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+
+        const char* name = trace_thread_buffer.name;
+        auto it = std::find_if(trace_buffers.begin(), trace_buffers.end(), [name](const TraceThreadBuffer* b) {
+            return !b->in_use && (b->name == name || (b->name != nullptr && name != nullptr && std::string(b->name) == name));
+        });
+
+        TraceThreadBuffer* buffer;
+        if(it != trace_buffers.end()) {
+            buffer = *it;
+        } else {
+            buffer = new TraceThreadBuffer();
+            buffer->tid = trace_buffers.size();
+            buffer->name = name;
+            buffer->num_recorded = 0;
+            trace_buffers.push_back(buffer);
+        }
+
+        buffer->thread_id = std::this_thread::get_id();
+        buffer->in_use = true;
+        trace_thread_buffer.buffer = buffer;
+    }
+
+    return trace_thread_buffer.buffer;
+}
+
+uint trace_hist_bucket(const uint64_t dur_ns) {
+    uint bucket = 0;
+    while(bucket < TRACE_HIST_BUCKETS - 1 && (dur_ns >> (bucket + 1)) != 0)
+        bucket++;
+
+    return bucket;
+}
+
+void trace_record(const char* name, const uint64_t start_ns, const uint64_t dur_ns) {
+    TraceThreadBuffer* buffer = trace_get_thread_buffer();
+
+    if(buffer->ring.size() < TRACE_RING_EVENTS)
+        buffer->ring.push_back({name, start_ns, dur_ns});
+    else
+        buffer->ring[buffer->num_recorded % TRACE_RING_EVENTS] = {name, start_ns, dur_ns};
+    buffer->num_recorded++;
+
+    auto it = std::find_if(buffer->phases.begin(), buffer->phases.end(), [&](const TracePhaseStats& p) { return p.name == name; });
+    if(it == buffer->phases.end()) {
+        buffer->phases.push_back(TracePhaseStats{name, 0, 0, 0, {0}});
+        it = buffer->phases.end() - 1;
+    }
+
+    it->count++;
+    it->total_ns += dur_ns;
+    it->max_ns = std::max(it->max_ns, dur_ns);
+    it->hist[trace_hist_bucket(dur_ns)]++;
+}
+
+class TraceSpan {
+
+public:
+    explicit TraceSpan(const char* name) : name(trace_enabled.load(std::memory_order_relaxed) ? name : nullptr), start_ns(0) {
+        if(this->name != nullptr)
+            start_ns = trace_now_ns();
+    }
+
+    ~TraceSpan() {
+        if(name != nullptr && trace_enabled.load(std::memory_order_relaxed))
+            trace_record(name, start_ns, trace_now_ns() - start_ns);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    uint64_t start_ns;
+};
+
+// Discards the spans of a previous run (e.g., a previous ExperimentServer job) and starts recording
+void start_tracing() {
+    std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+
+    for(auto buffer : trace_buffers) {
+        buffer->ring.clear();
+        buffer->num_recorded = 0;
+        buffer->phases.clear();
+    }
+
+    trace_epoch = std::chrono::steady_clock::now();
+    trace_main_thread = std::this_thread::get_id();
+    trace_enabled = true;
+}
+
+// the smallest duration that is longer than 'fraction' of the spans, at the granularity of the histogram buckets
+uint64_t trace_hist_percentile(const TracePhaseStats& phase, const double fraction) {
+    uint64_t target = (uint64_t) std::ceil(phase.count*fraction);
+    uint64_t seen = 0;
+
+    for(uint i = 0; i < TRACE_HIST_BUCKETS; i++) {
+        seen += phase.hist[i];
+        if(seen >= target)
+            return std::min(phase.max_ns, ((uint64_t)2 << i) - 1);
+    }
+
+    return phase.max_ns;
+}
+
+void print_trace_histogram(const std::vector<TracePhaseStats>& phases) {
+    auto ms = [](const uint64_t ns) { return ns/1000000.0; };
+
+    std::cout << "Trace phases (durations in ms, p50/p99 are upper bounds of log2 histogram buckets):" << std::endl;
+    std::cout << std::left << std::setw(18) << "phase" << std::right << std::setw(10) << "count" << std::setw(14) << "total"
+        << std::setw(12) << "mean" << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "max" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+    for(auto& phase : phases) {
+        std::cout << std::left << std::setw(18) << phase.name << std::right << std::setw(10) << phase.count << std::setw(14) << ms(phase.total_ns)
+            << std::setw(12) << ms(phase.total_ns/phase.count) << std::setw(12) << ms(trace_hist_percentile(phase, 0.5))
+            << std::setw(12) << ms(trace_hist_percentile(phase, 0.99)) << std::setw(12) << ms(phase.max_ns) << std::endl;
+
+        // a compact histogram: one character per bucket from the shortest to the longest non-empty bucket
+        uint first = 0, last = TRACE_HIST_BUCKETS - 1;
+        while(phase.hist[first] == 0) first++;
+        while(phase.hist[last] == 0) last--;
+
+        uint64_t max_bucket = *std::max_element(phase.hist, phase.hist + TRACE_HIST_BUCKETS);
+        const char* levels = " .:-=+*#";
+        std::cout << std::setw(18) << "" << "[" << ms((uint64_t)1 << first) << " ms ";
+        for(uint i = first; i <= last; i++)
+            std::cout << levels[phase.hist[i] == 0 ? 0 : 1 + (phase.hist[i]*6)/max_bucket];
+        std::cout << " " << ms(((uint64_t)2 << last) - 1) << " ms]" << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+// Stops recording, writes the spans to filename as Chrome trace-event JSON, and prints the per-phase histograms.
+// Returns an empty string on success, and a description of the problem otherwise
+std::string stop_tracing(const std::string& filename) {
+    if(!trace_enabled)
+        return "";
+
+    trace_enabled = false;
+
+    std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+
+    std::vector<TracePhaseStats> phases;
+    uint64_t num_dropped = 0;
+    for(auto buffer : trace_buffers) {
+        num_dropped += buffer->num_recorded - buffer->ring.size();
+
+        for(auto& thread_phase : buffer->phases) {
+            auto it = std::find_if(phases.begin(), phases.end(), [&](const TracePhaseStats& p) { return std::string(p.name) == thread_phase.name; });
+            if(it == phases.end()) {
+                phases.push_back(thread_phase);
+                continue;
+            }
+
+            it->count += thread_phase.count;
+            it->total_ns += thread_phase.total_ns;
+            it->max_ns = std::max(it->max_ns, thread_phase.max_ns);
+            for(uint i = 0; i < TRACE_HIST_BUCKETS; i++)
+                it->hist[i] += thread_phase.hist[i];
+        }
+    }
+
+    std::sort(phases.begin(), phases.end(), [](const TracePhaseStats& a, const TracePhaseStats& b) { return a.total_ns > b.total_ns; });
+    if(!phases.empty())
+        print_trace_histogram(phases);
+    if(num_dropped > 0)
+        std::cout << "The trace file misses the " << num_dropped << " oldest spans that did not fit into the ring buffers" << std::endl;
+
+    std::ofstream out(filename);
+    if(!out.is_open())
+        return "cannot open " + filename;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    out << std::fixed << std::setprecision(3);
+
+    bool first = true;
+    for(auto buffer : trace_buffers) {
+        if(buffer->ring.empty())
+            continue;
+
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << (buffer->thread_id == trace_main_thread ? "main" : 
+                                                buffer->name != nullptr ? buffer->name : "worker " + std::to_string(buffer->tid)) << "\"}}";
+        first = false;
+
+        // oldest first
+        uint64_t num_events = buffer->ring.size();
+        for(uint64_t i = 0; i < num_events; i++) {
+            const TraceEvent& ev = buffer->ring[(buffer->num_recorded - num_events + i) % TRACE_RING_EVENTS];
+            out << ",\n{\"name\":\"" << ev.name << "\",\"cat\":\"utrr\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << ev.start_ns/1000.0 << ",\"dur\":" << ev.dur_ns/1000.0 << "}";
+        }
+    }
+
+    out << std::endl << "]}" << std::endl;
+
+    return out.good() ? "" : "cannot write to " + filename;
+}
+
+#endif // TRACE_H